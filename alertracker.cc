@@ -28,6 +28,13 @@
 
 #include "json_adapter.h"
 #include "msgpack_adapter.h"
+#include "kis_mem_account.h"
+
+// Approximate size of a backlogged alert, for memory accounting
+static int64_t alert_info_size(kis_alert_info *info) {
+    return sizeof(kis_alert_info) + info->header.length() + info->channel.length() +
+        info->text.length();
+}
 
 Alertracker::Alertracker(GlobalRegistry *in_globalreg) :
     Kis_Net_Httpd_CPPStream_Handler(in_globalreg) {
@@ -244,7 +251,10 @@ int Alertracker::RaiseAlert(int in_ref, kis_packet *in_pack,
     arec->set_time_last(time(0));
 
 	alert_backlog.push_back(info);
+    kis_mem_account::add(KIS_MEM_ALERTS, 1, alert_info_size(info));
+
 	if ((int) alert_backlog.size() > num_backlog) {
+        kis_mem_account::add(KIS_MEM_ALERTS, -1, -alert_info_size(alert_backlog[0]));
 		delete alert_backlog[0];
 		alert_backlog.erase(alert_backlog.begin());
 	}
@@ -92,7 +92,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new tracked_alert(globalreg, get_id()));
+        return AllocTrackedElement<tracked_alert>(globalreg, get_id());
     }
 
     __Proxy(device_key, uint64_t, uint64_t, uint64_t, device_key);
@@ -210,7 +210,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new tracked_alert_definition(globalreg, get_id()));
+        return AllocTrackedElement<tracked_alert_definition>(globalreg, get_id());
     }
 
     __Proxy(header, string, string, string, header);
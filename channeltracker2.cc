@@ -136,10 +136,22 @@ public:
 
     }
 
+    // Count into a map per pool slot so the counting threads never contend;
+    // the slots are sized once here, before any pool thread runs, and never
+    // resized while matching
+    virtual void PrepareSlots(unsigned int in_slots) {
+        slot_count.resize(in_slots);
+    }
+
     // Count all the devices.  We use a filter worker but 'match' on all
     // and count them into our local map
-    virtual void MatchDevice(Devicetracker *devicetracker __attribute__((unused)),
-            shared_ptr<kis_tracked_device_base> device) {
+    virtual void MatchDevice(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& device) {
+        MatchDeviceSlot(devicetracker, device, 0);
+    }
+
+    virtual void MatchDeviceSlot(Devicetracker *devicetracker __attribute__((unused)),
+            const shared_ptr<kis_tracked_device_base>& device, unsigned int in_slot) {
         if (device == NULL)
             return;
 
@@ -150,6 +162,12 @@ public:
         if (device->get_frequency() == 0)
             return;
 
+        // Growing the slots here would move them under the other threads
+        if (in_slot >= slot_count.size())
+            return;
+
+        map<double, unsigned int>& device_count = slot_count[in_slot];
+
         map<double, unsigned int>::iterator i =
             device_count.find(device->get_frequency());
 
@@ -160,8 +178,15 @@ public:
         }
     }
 
-    // Send it back to our channel tracker
+    // Merge the slots and send it back to our channel tracker
     virtual void Finalize(Devicetracker *devicetracker __attribute__((unused))) {
+        map<double, unsigned int> device_count;
+
+        for (auto& s : slot_count) {
+            for (auto& c : s) 
+                device_count[c.first] += c.second;
+        }
+
         channelv2->update_device_counts(device_count);
     }
 
@@ -169,7 +194,7 @@ protected:
     GlobalRegistry *globalreg;
     Channeltracker_V2 *channelv2;
 
-    map<double, unsigned int> device_count;
+    vector<map<double, unsigned int> > slot_count;
 
 };
 
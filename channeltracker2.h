@@ -54,7 +54,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new Channeltracker_V2_Channel(globalreg, get_id()));
+        return AllocTrackedElement<Channeltracker_V2_Channel>(globalreg, get_id());
     }
 
     __Proxy(channel, string, string, string, channel);
@@ -105,23 +105,23 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            packets_rrd.reset(new kis_tracked_rrd<>(globalreg, 
-                        packets_rrd_id, e->get_map_value(packets_rrd_id)));
-            data_rrd.reset(new kis_tracked_rrd<>(globalreg, 
-                        data_rrd_id, e->get_map_value(data_rrd_id)));
-            device_rrd.reset(new kis_tracked_rrd<>(globalreg, 
-                        device_rrd_id, e->get_map_value(device_rrd_id)));
-
-            signal_data.reset(new kis_tracked_signal_data(globalreg, signal_data_id,
-                        e->get_map_value(signal_data_id)));
+            packets_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, 
+                        packets_rrd_id, e->get_map_value(packets_rrd_id));
+            data_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, 
+                        data_rrd_id, e->get_map_value(data_rrd_id));
+            device_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, 
+                        device_rrd_id, e->get_map_value(device_rrd_id));
+
+            signal_data = AllocTrackedElement<kis_tracked_signal_data>(globalreg, signal_data_id,
+                        e->get_map_value(signal_data_id));
         } else {
-            packets_rrd.reset(new kis_tracked_rrd<>(globalreg, packets_rrd_id));
+            packets_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, packets_rrd_id);
 
-            data_rrd.reset(new kis_tracked_rrd<>(globalreg, data_rrd_id));
+            data_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, data_rrd_id);
 
-            device_rrd.reset(new kis_tracked_rrd<>(globalreg, device_rrd_id));
+            device_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, device_rrd_id);
 
-            signal_data.reset(new kis_tracked_signal_data(globalreg, signal_data_id));
+            signal_data = AllocTrackedElement<kis_tracked_signal_data>(globalreg, signal_data_id);
         }
 
         add_map(packets_rrd);
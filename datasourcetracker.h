@@ -218,7 +218,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new datasourcetracker_defaults(globalreg, get_id()));
+        return AllocTrackedElement<datasourcetracker_defaults>(globalreg, get_id());
     }
 
     __Proxy(hop_rate, double, double, double, hop_rate);
@@ -52,11 +52,16 @@
 #include "kismet_json.h"
 #include "base64.h"
 #include "kis_datasource.h"
+#include "kis_threadpool.h"
 
 int Devicetracker_packethook_commontracker(CHAINCALL_PARMS) {
 	return ((Devicetracker *) auxdata)->CommonTracker(in_pack);
 }
 
+int Devicetracker_packethook_modifiedtracker(CHAINCALL_PARMS) {
+	return ((Devicetracker *) auxdata)->ModifiedTracker(in_pack);
+}
+
 Devicetracker::Devicetracker(GlobalRegistry *in_globalreg) :
     Kis_Net_Httpd_CPPStream_Handler(in_globalreg) {
 
@@ -109,7 +114,13 @@ Devicetracker::Devicetracker(GlobalRegistry *in_globalreg) :
         entrytracker->RegisterField("kismet.datatables.draw", TrackerUInt64,
                 "Datatable records draw ID");
 
-    packets_rrd.reset(new kis_tracked_rrd<>(globalreg, 0));
+    // Build a device record once so that all the base device fields are
+    // registered, then resolve the fields we mirror into columns
+    shared_ptr<kis_tracked_device_base> device_builder =
+        AllocTrackedElement<kis_tracked_device_base>(globalreg, device_base_id);
+    device_columns.resolve_fields(entrytracker);
+
+    packets_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, 0);
     packets_rrd_id =
         globalreg->entrytracker->RegisterField("kismet.device.packets_rrd",
                 packets_rrd, "RRD of total packets seen");
@@ -147,6 +158,11 @@ Devicetracker::Devicetracker(GlobalRegistry *in_globalreg) :
 	globalreg->packetchain->RegisterHandler(&Devicetracker_packethook_commontracker,
 											this, CHAINPOS_TRACKER, -100);
 
+    // Devices are modified throughout the tracker stage, so bump their 
+    // versions again once it's over
+	globalreg->packetchain->RegisterHandler(&Devicetracker_packethook_modifiedtracker,
+											this, CHAINPOS_LOGGING, -100);
+
 	// Create the global kistxt and kisxml logfiles
 	// new Dumpfile_Devicetracker(globalreg, "kistxt", "text");
 	// new Dumpfile_Devicetracker(globalreg, "kisxml", "xml");
@@ -195,7 +211,30 @@ Devicetracker::Devicetracker(GlobalRegistry *in_globalreg) :
 		max_devices_timer = -1;
 	}
 
+    max_device_memory =
+        (uint64_t) globalreg->kismet_config->FetchOptUInt("tracker_max_memory", 0) *
+        1024 * 1024;
+
+    if (max_device_memory > 0) {
+        stringstream ss;
+        ss << "Limiting device memory to " << (max_device_memory / 1024 / 1024) <<
+            "MB; devices which have been idle longest, relative to their size, "
+            "will be removed from tracking when this limit is reached.";
+        _MSG(ss.str(), MSGFLAG_INFO);
+    }
+
+    // Device memory is always accounted so it can be reported, and trimmed
+    // every 5 seconds if we have a limit
+    device_memory_timer =
+        globalreg->timetracker->RegisterTimer(SERVER_TIMESLICES_SEC * 5, NULL,
+                1, this);
+
     full_refresh_time = globalreg->timestamp.tv_sec;
+
+    device_version_counter = 0;
+
+    sort_index_max_age =
+        globalreg->kismet_config->FetchOptUInt("tracker_sort_index_age", 1);
 }
 
 Devicetracker::~Devicetracker() {
@@ -206,9 +245,12 @@ Devicetracker::~Devicetracker() {
 
 	globalreg->packetchain->RemoveHandler(&Devicetracker_packethook_commontracker,
 										  CHAINPOS_TRACKER);
+	globalreg->packetchain->RemoveHandler(&Devicetracker_packethook_modifiedtracker,
+										  CHAINPOS_LOGGING);
 
     globalreg->timetracker->RemoveTimer(device_idle_timer);
 	globalreg->timetracker->RemoveTimer(max_devices_timer);
+    globalreg->timetracker->RemoveTimer(device_memory_timer);
 
     // TODO broken for now
     /*
@@ -223,6 +265,7 @@ Devicetracker::~Devicetracker() {
 
     tracked_vec.clear();
     immutable_tracked_vec.clear();
+    device_columns.clear();
 
     pthread_mutex_destroy(&devicelist_mutex);
 }
@@ -280,17 +323,16 @@ string Devicetracker::FetchPhyName(int in_phy) {
 int Devicetracker::FetchNumDevices(int in_phy) {
     local_locker lock(&devicelist_mutex);
 
-	int r = 0;
-
 	if (in_phy == KIS_PHY_ANY)
 		return tracked_map.size();
 
-	for (unsigned int x = 0; x < tracked_vec.size(); x++) {
-		if (DevicetrackerKey::GetPhy(tracked_vec[x]->get_key()) == in_phy)
-			r++;
-	}
+    return device_columns.count_phy(in_phy);
+}
+
+uint64_t Devicetracker::FetchDeviceMemory() {
+    local_locker lock(&devicelist_mutex);
 
-	return r;
+    return device_columns.get_total_memory();
 }
 
 int Devicetracker::FetchNumPackets(int in_phy) {
@@ -506,7 +548,7 @@ shared_ptr<kis_tracked_device_base> Devicetracker::UpdateCommonDevice(mac_addr i
     key = DevicetrackerKey::MakeKey(in_mac, in_phy);
 
 	if ((device = FetchDevice(key)) == NULL) {
-        device.reset(new kis_tracked_device_base(globalreg, device_base_id));
+        device = AllocTrackedElement<kis_tracked_device_base>(globalreg, device_base_id);
 
         // Device ID is the size of the vector so a new device always gets put
         // in it's numbered slot
@@ -611,9 +653,65 @@ shared_ptr<kis_tracked_device_base> Devicetracker::UpdateCommonDevice(mac_addr i
         device->inc_seenby_count(pack_datasrc->ref_source, in_pack->ts.tv_sec, f);
 	}
 
+    device_columns.update_device(device.get());
+
+    // Marked again after the phy is done with it
+    MarkPacketDeviceModified(in_pack, device);
+
     return device;
 }
 
+void Devicetracker::MarkPacketDeviceModified(kis_packet *in_pack,
+        const shared_ptr<kis_tracked_device_base>& device) {
+    MarkDeviceModified(device);
+
+	kis_tracked_device_info *devinfo =
+		(kis_tracked_device_info *) in_pack->fetch(pack_comp_device);
+
+	if (devinfo == NULL) {
+		devinfo = new kis_tracked_device_info;
+		devinfo->devref = device;
+		in_pack->insert(pack_comp_device, devinfo);
+	}
+
+    // A packet only touches a handful of devices
+    for (unsigned int i = 0; i < devinfo->devrefs.size(); i++) {
+        if (devinfo->devrefs[i] == device)
+            return;
+    }
+
+    devinfo->devrefs.push_back(device);
+}
+
+int Devicetracker::ModifiedTracker(kis_packet *in_pack) {
+	kis_tracked_device_info *devinfo =
+		(kis_tracked_device_info *) in_pack->fetch(pack_comp_device);
+
+    if (devinfo == NULL)
+        return 0;
+
+    for (unsigned int i = 0; i < devinfo->devrefs.size(); i++)
+        MarkDeviceModified(devinfo->devrefs[i]);
+
+    return 1;
+}
+
+void Devicetracker::RemoveDeviceRecords(shared_ptr<kis_tracked_device_base> device) {
+    local_locker lock(&devicelist_mutex);
+
+    device_itr mi = tracked_map.find(device->get_key());
+    if (mi != tracked_map.end())
+        tracked_map.erase(mi);
+
+    // Forget it from the immutable vec, but keep its position; we need to 
+    // have vecpos = devid
+    uint64_t id = device->get_kis_internal_id();
+    if (id < immutable_tracked_vec.size())
+        immutable_tracked_vec[id].reset();
+
+    device_columns.remove_device(id);
+}
+
 int Devicetracker::PopulateCommon(shared_ptr<kis_tracked_device_base> device, 
         kis_packet *in_pack) {
 
@@ -718,14 +816,9 @@ int Devicetracker::PopulateCommon(shared_ptr<kis_tracked_device_base> device,
 	if (!(pack_common->channel == "0"))
         device->set_channel(pack_common->channel);
 
-	kis_tracked_device_info *devinfo =
-		(kis_tracked_device_info *) in_pack->fetch(pack_comp_device);
+    device_columns.update_device(device.get());
 
-	if (devinfo == NULL) {
-		devinfo = new kis_tracked_device_info;
-		devinfo->devref = device;
-		in_pack->insert(pack_comp_device, devinfo);
-	}
+    MarkPacketDeviceModified(in_pack, device);
 
 	return 1;
 }
@@ -1638,61 +1731,129 @@ bool devicetracker_sort_internal_id(shared_ptr<kis_tracked_device_base> a,
 }
 
 void Devicetracker::MatchOnDevices(DevicetrackerFilterWorker *worker, bool batch) {
-    // We chunk into blocks of 500 devices and perform the match in 
-    // batches; this prevents a single query from running so long that
-    // things fall down.  It is slightly less efficient on huge data sets,
-    // but the tradeoff is a naive client being able to crash the whole
-    // show by doing a query against 20,000 devices in one go.
-   
+    // Matching is spread across the shared thread pool; each pool thread has
+    // its own slot so workers can accumulate results without locking, and
+    // merge them in Finalize.
+    //
+    // Batched matches (anything a client can trigger) only hold the device
+    // list lock for a bounded time per batch, then release it briefly so
+    // packet processing isn't starved by a naive client running a query
+    // against 20,000 devices in one go.  The batch size is adjusted from the
+    // measured cost of the previous batch, so cheap workers cover the list in
+    // a few large batches and expensive ones in many small ones.
+
+    shared_ptr<Kis_Thread_Pool> pool =
+        static_pointer_cast<Kis_Thread_Pool>(globalreg->FetchGlobal("THREAD_POOL"));
+
+    unsigned int nslots = 1;
+    if (pool != NULL)
+        nslots = pool->get_num_slots();
+
+    worker->PrepareSlots(nslots);
+
+    // Chunk size handed to each pool thread; starts small and is retuned once
+    // we know what a device costs for this worker
+    size_t pool_chunk = 64;
+
+    auto match_range = 
+        [&](const vector<shared_ptr<kis_tracked_device_base> >& vec, size_t start, size_t end) {
+            if (pool == NULL) {
+                for (size_t x = start; x < end; x++) {
+                    if (vec[x] == NULL)
+                        continue;
+                    worker->MatchDeviceSlot(this, vec[x], 0);
+                }
+
+                return;
+            }
+
+            pool->parallel_for(end - start, pool_chunk,
+                    [&](size_t s, size_t e, unsigned int slot) {
+                        for (size_t x = start + s; x < start + e; x++) {
+                            if (vec[x] == NULL)
+                                continue;
+                            worker->MatchDeviceSlot(this, vec[x], slot);
+                        }
+                    });
+        };
+
     // Handle non-batched stuff like internal memory management ops
     if (!batch) {
         local_locker lock(&devicelist_mutex);
 
-        kismet__for_each(tracked_vec.begin(), tracked_vec.end(), 
-                [&](shared_ptr<kis_tracked_device_base> val) {
-                    worker->MatchDevice(this, val);
-                });
+        pool_chunk = std::max((size_t) 64, tracked_vec.size() / (nslots * 8));
+
+        match_range(tracked_vec, 0, tracked_vec.size());
 
         worker->Finalize(this);
         return;
     }
-    
+
+    // Target lock hold per batch and target time per pool chunk, in usec
+    const double target_batch_us = 10000;
+    const double target_chunk_us = 250;
+
+    const size_t min_batch = 100;
+    const size_t max_batch = 50000;
+
     size_t dpos = 0;
-    size_t chunk_sz = 500;
+    size_t batch_sz = 500;
 
     while (1) {
+        bool last_loop = false;
+        size_t nmatched = 0;
+        double elapsed_us = 0;
+
         {
             // Limited scope lock
-            
             local_locker lock(&devicelist_mutex);
 
-            auto b = immutable_tracked_vec.begin() + dpos;
-            auto e = b + chunk_sz;
-            bool last_loop = false;
+            size_t end = dpos + batch_sz;
 
-            if (e > immutable_tracked_vec.end()) {
-                e = immutable_tracked_vec.end();
+            if (end >= immutable_tracked_vec.size()) {
+                end = immutable_tracked_vec.size();
                 last_loop = true;
             }
 
-            // Parallel f-e
-            kismet__for_each(b, e, 
-                    [&](shared_ptr<kis_tracked_device_base> val) {
-                        if (val == NULL)
-                            return;
-                        worker->MatchDevice(this, val);
-                    });
+            if (end > dpos) {
+                struct timeval start_tm, end_tm;
+                gettimeofday(&start_tm, NULL);
+
+                match_range(immutable_tracked_vec, dpos, end);
 
-            if (last_loop)
-                break;
+                gettimeofday(&end_tm, NULL);
+
+                elapsed_us = (end_tm.tv_sec - start_tm.tv_sec) * 1000000.0f +
+                    (end_tm.tv_usec - start_tm.tv_usec);
+                nmatched = end - dpos;
+            }
 
-            dpos += chunk_sz;
+            dpos = end;
+        }
+
+        if (last_loop)
+            break;
+
+        // Retune from what this batch cost; per-device cost is wall time over
+        // all the slots that were working on it
+        if (nmatched > 0) {
+            double dev_us = std::max(elapsed_us * nslots / nmatched, 0.01);
+
+            pool_chunk = (size_t) (target_chunk_us / dev_us);
+            pool_chunk = std::min(std::max(pool_chunk, (size_t) 16), (size_t) 4096);
+
+            // Don't let a single fast batch (or a stalled one) swing the 
+            // batch size too far
+            size_t next_batch = (size_t) (target_batch_us * nslots / dev_us);
+            next_batch = std::min(next_batch, batch_sz * 2);
+            next_batch = std::max(next_batch, batch_sz / 2);
+
+            batch_sz = std::min(std::max(next_batch, min_batch), max_batch);
         }
 
         // We're now unlocked, do a tiny sleep to let another thread grab the lock
         // if it needs to
         usleep(1000);
-
     }
 
     worker->Finalize(this);
@@ -1706,40 +1867,99 @@ bool devicetracker_sort_lastseen(shared_ptr<kis_tracked_device_base> a,
 	return a->get_last_time() < b->get_last_time();
 }
 
+void Devicetracker::UpdateDeviceMemory() {
+    vector<uint64_t> stale_ids;
+    vector<shared_ptr<kis_tracked_device_base> > stale_devs;
+    vector<time_t> stale_times;
+
+    {
+        local_locker lock(&devicelist_mutex);
+
+        // Walking a device is expensive and most devices change every pass on a
+        // busy capture, so only re-measure a share of them each time; a device
+        // which never stops changing is still re-measured about once a minute
+        size_t budget = std::max((size_t) 1024, tracked_vec.size() / 12);
+
+        device_columns.find_memory_stale(budget, stale_ids);
+
+        for (auto i : stale_ids) {
+            stale_devs.push_back(immutable_tracked_vec[i]);
+            stale_times.push_back(device_columns.get_last_time(i));
+        }
+    }
+
+    if (stale_ids.size() == 0)
+        return;
+
+    vector<uint64_t> sizes(stale_ids.size(), 0);
+
+    shared_ptr<Kis_Thread_Pool> pool =
+        static_pointer_cast<Kis_Thread_Pool>(globalreg->FetchGlobal("THREAD_POOL"));
+
+    // The packet path mutates the device maps we walk, so measure under the
+    // lock, but in bounded batches with the lock released in between, the same
+    // as MatchOnDevices
+    const size_t batch_sz = 1024;
+
+    for (size_t bpos = 0; bpos < stale_devs.size(); bpos += batch_sz) {
+        size_t bend = std::min(bpos + batch_sz, stale_devs.size());
+
+        auto measure = [&](size_t s, size_t e, unsigned int slot __attribute__((unused))) {
+            for (size_t x = bpos + s; x < bpos + e; x++) {
+                if (stale_devs[x] != NULL)
+                    sizes[x] = stale_devs[x]->get_memory_estimate();
+            }
+        };
+
+        {
+            local_locker lock(&devicelist_mutex);
+
+            if (pool != NULL)
+                pool->parallel_for(bend - bpos, 64, measure);
+            else
+                measure(0, bend - bpos, 0);
+        }
+
+        if (bend < stale_devs.size())
+            usleep(1000);
+    }
+
+    // Devices removed while we were measuring are ignored by the columns;
+    // devices updated since we took their last_time stay stale
+    local_locker lock(&devicelist_mutex);
+
+    for (size_t x = 0; x < stale_ids.size(); x++)
+        device_columns.set_memory(stale_ids[x], sizes[x], stale_times[x]);
+}
+
 int Devicetracker::timetracker_event(int eventid) {
     if (eventid == device_idle_timer) {
         local_locker lock(&devicelist_mutex);
 
         time_t ts_now = globalreg->timestamp.tv_sec;
-        bool purged = false;
 
-        // Find all eligible devices, remove them from the tracked vec
+        // Scan the last-seen column for eligible devices instead of walking
+        // every device record
+        vector<uint64_t> idle_ids;
+        device_columns.find_idle(ts_now - device_idle_expiration, idle_ids);
+
+        if (idle_ids.size() == 0)
+            return 1;
+
+        for (auto i : idle_ids) {
+            shared_ptr<kis_tracked_device_base> d = immutable_tracked_vec[i];
+
+            if (d != NULL)
+                RemoveDeviceRecords(d);
+        }
+
+        // Removed devices no longer have a valid column row
         tracked_vec.erase(std::remove_if(tracked_vec.begin(), tracked_vec.end(),
                 [&](shared_ptr<kis_tracked_device_base> d) {
-                    if (ts_now - d->get_last_time() > device_idle_expiration) {
-                        // fprintf(stderr, "debug - forgetting device %s age %lu expiration %d\n", d->get_macaddr().Mac2String().c_str(), globalreg->timestamp.tv_sec - d->get_last_time(), device_idle_expiration);
-                        
-                        device_itr mi = tracked_map.find(d->get_key());
-                        if (mi != tracked_map.end())
-                            tracked_map.erase(mi);
-
-                        // Forget it from the immutable vec, but keep its 
-                        // position; we need to have vecpos = devid
-                        auto iti = immutable_tracked_vec.begin() + 
-                            d->get_kis_internal_id();
-                        (*iti).reset();
-
-                        purged = true;
-
-                        return true;
-                    }
-
-                    return false;
-         
+                    return !device_columns.is_valid(d->get_kis_internal_id());
                     }), tracked_vec.end());
 
-        if (purged)
-            UpdateFullRefresh();
+        UpdateFullRefresh();
 
     } else if (eventid == max_devices_timer) {
 		local_locker lock(&devicelist_mutex);
@@ -1755,25 +1975,52 @@ int Devicetracker::timetracker_event(int eventid) {
         // Do an update since we're trimming something
         UpdateFullRefresh();
 
-		// Now things start getting expensive.  Start by sorting the
-		// vector of devices - anything else that has to sort the entire list
-        // has to sort it themselves
-		kismet__stable_sort(tracked_vec.begin(), tracked_vec.end(), 
-                devicetracker_sort_lastseen);
-
+        // Select the oldest devices from the last-seen column; we don't need
+        // to sort the whole device list to find them
 		unsigned int drop = tracked_vec.size() - max_num_devices;
 
-		// Figure out how many we don't care about, and remove them from the map
-		for (unsigned int d = 0; d < drop; d++) {
-			device_itr mi = tracked_map.find(tracked_vec[d]->get_key());
+        vector<uint64_t> old_ids;
+        device_columns.find_oldest(drop, old_ids);
 
-			if (mi != tracked_map.end())
-				tracked_map.erase(mi);
-		}
+        for (auto i : old_ids) {
+            shared_ptr<kis_tracked_device_base> d = immutable_tracked_vec[i];
+
+            if (d != NULL)
+                RemoveDeviceRecords(d);
+        }
 
 		// Clear them out of the vector
-		tracked_vec.erase(tracked_vec.begin(), tracked_vec.begin() + drop);
-	}
+        tracked_vec.erase(std::remove_if(tracked_vec.begin(), tracked_vec.end(),
+                [&](shared_ptr<kis_tracked_device_base> d) {
+                    return !device_columns.is_valid(d->get_kis_internal_id());
+                    }), tracked_vec.end());
+	} else if (eventid == device_memory_timer) {
+        UpdateDeviceMemory();
+
+        local_locker lock(&devicelist_mutex);
+
+        if (max_device_memory == 0 || 
+                device_columns.get_total_memory() <= max_device_memory)
+            return 1;
+
+        vector<uint64_t> evict_ids;
+        device_columns.find_memory_evict(device_columns.get_total_memory() - 
+                max_device_memory, globalreg->timestamp.tv_sec, evict_ids);
+
+        for (auto i : evict_ids) {
+            shared_ptr<kis_tracked_device_base> d = immutable_tracked_vec[i];
+
+            if (d != NULL)
+                RemoveDeviceRecords(d);
+        }
+
+        tracked_vec.erase(std::remove_if(tracked_vec.begin(), tracked_vec.end(),
+                [&](shared_ptr<kis_tracked_device_base> d) {
+                    return !device_columns.is_valid(d->get_kis_internal_id());
+                    }), tracked_vec.end());
+
+        UpdateFullRefresh();
+    }
 
     // Loop
     return 1;
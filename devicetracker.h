@@ -32,6 +32,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <atomic>
 
 #include <stdexcept>
 
@@ -52,6 +53,7 @@
 #include "kis_datasource.h"
 #include "packinfo_signal.h"
 #include "devicetracker_component.h"
+#include "devicetracker_columns.h"
 #include "trackercomponent_legacy.h"
 #include "timetracker.h"
 #include "kis_net_microhttpd.h"
@@ -142,14 +144,16 @@ class Devicetracker;
 class kis_tracked_device_base : public tracker_component {
 public:
     kis_tracked_device_base(GlobalRegistry *in_globalreg, int in_id) :
-        tracker_component(in_globalreg, in_id) {
+        tracker_component(in_globalreg, in_id),
+        mod_version(0) {
 
         register_fields();
         reserve_fields(NULL);
     }
 
     kis_tracked_device_base(GlobalRegistry *in_globalreg, int in_id,
-            SharedTrackerElement e) : tracker_component(in_globalreg, in_id) {
+            SharedTrackerElement e) : tracker_component(in_globalreg, in_id),
+        mod_version(0) {
         
         register_fields();
         reserve_fields(e);
@@ -160,24 +164,24 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_device_base(globalreg, get_id()));
+        return AllocTrackedElement<kis_tracked_device_base>(globalreg, get_id());
     }
 
     __Proxy(key, uint64_t, uint64_t, uint64_t, key);
 
     __Proxy(macaddr, mac_addr, mac_addr, mac_addr, macaddr);
 
-    __Proxy(phyname, string, string, string, phyname);
+    __ProxyInterned(phyname, phyname);
 
     __Proxy(devicename, string, string, string, devicename);
     __Proxy(username, string, string, string, username);
 
-    __Proxy(type_string, string, string, string, type_string);
+    __ProxyInterned(type_string, type_string);
 
     __Proxy(basic_type_set, uint64_t, uint64_t, uint64_t, basic_type_set);
     __ProxyBitset(basic_type_set, uint64_t, basic_type_set);
 
-    __Proxy(crypt_string, string, string, string, crypt_string);
+    __ProxyInterned(crypt_string, crypt_string);
 
     __Proxy(basic_crypt_set, uint64_t, uint64_t, uint64_t, basic_crypt_set);
     void add_basic_crypt(uint64_t in) { (*basic_crypt_set) |= in; }
@@ -230,10 +234,10 @@ public:
     __ProxyDynamicTrackable(packet_rrd_bin_jumbo, mrrdt, packet_rrd_bin_jumbo,
             packet_rrd_bin_jumbo_id);
 
-    __Proxy(channel, string, string, string, channel);
+    __ProxyInterned(channel, channel);
     __Proxy(frequency, double, double, double, frequency);
 
-    __Proxy(manuf, string, string, string, manuf);
+    __ProxyInterned(manuf, manuf);
 
     __Proxy(num_alerts, uint32_t, unsigned int, unsigned int, alert);
 
@@ -270,7 +274,7 @@ public:
 
         // Make a new seenby record
         if (seenby_iter == seenby_map->end()) {
-            seenby.reset(new kis_tracked_seenby_data(globalreg, seenby_val_id));
+            seenby = AllocTrackedElement<kis_tracked_seenby_data>(globalreg, seenby_val_id);
 
             seenby->set_src_uuid(source->get_source_uuid());
             seenby->set_first_time(tv_sec);
@@ -305,6 +309,15 @@ public:
         kis_internal_id = in_id;
     }
 
+    // Non-exported modification version, see Devicetracker::MarkDeviceModified
+    uint64_t get_mod_version() {
+        return mod_version.load(std::memory_order_relaxed);
+    }
+
+    void set_mod_version(uint64_t in_version) {
+        mod_version.store(in_version, std::memory_order_relaxed);
+    }
+
 protected:
     virtual void register_fields() {
         tracker_component::register_fields();
@@ -361,19 +374,16 @@ protected:
         RegisterField("kismet.device.base.datasize", TrackerUInt64,
                 "transmitted data in bytes", &datasize);
 
-        shared_ptr<kis_tracked_rrd<> > packets_rrd_builder(new kis_tracked_rrd<>(globalreg, 0));
         packets_rrd_id =
-            globalreg->entrytracker->RegisterField("kismet.device.base.packets.rrd",
-                    packets_rrd_builder, "packet rate rrd");
+            RegisterComplexField<kis_tracked_rrd<> >("kismet.device.base.packets.rrd",
+                    "packet rate rrd");
 
-        shared_ptr<kis_tracked_rrd<> > data_rrd_builder(new kis_tracked_rrd<>(globalreg, 0));
         data_rrd_id =
-            globalreg->entrytracker->RegisterField("kismet.device.base.datasize.rrd",
-                    data_rrd_builder, "packet size rrd");
+            RegisterComplexField<kis_tracked_rrd<> >("kismet.device.base.datasize.rrd",
+                    "packet size rrd");
 
-        shared_ptr<kis_tracked_signal_data> sig_builder(new kis_tracked_signal_data(globalreg, 0));
         signal_data_id =
-            RegisterComplexField("kismet.device.base.signal", sig_builder,
+            RegisterComplexField<kis_tracked_signal_data>("kismet.device.base.signal",
                     "signal data");
 
         RegisterField("kismet.device.base.freq_khz_map", TrackerDoubleMap,
@@ -395,9 +405,8 @@ protected:
         tag_entry_id =
             RegisterField("kismet.device.base.tag", TrackerString, "arbitrary tag");
 
-        shared_ptr<kis_tracked_location> loc_builder(new kis_tracked_location(globalreg, 0));
         location_id =
-            RegisterComplexField("kismet.device.base.location", loc_builder,
+            RegisterComplexField<kis_tracked_location>("kismet.device.base.location",
                     "location");
 
         RegisterField("kismet.device.base.seenby", TrackerIntMap,
@@ -405,30 +414,27 @@ protected:
 
         // Packet count, not actual frequency, so uint64 not double
         frequency_val_id =
-            globalreg->entrytracker->RegisterField("kismet.device.base.frequency.count",
+            RegisterField("kismet.device.base.frequency.count",
                     TrackerUInt64, "frequency packet count");
 
-        shared_ptr<kis_tracked_seenby_data> seenby_builder(new kis_tracked_seenby_data(globalreg, 0));
         seenby_val_id =
-            RegisterComplexField("kismet.device.base.seenby.data",
-                    seenby_builder, "seen-by data");
-
-        shared_ptr<kis_tracked_minute_rrd<> > bin_rrd_builder(new kis_tracked_minute_rrd<>(globalreg, 0));
+            RegisterComplexField<kis_tracked_seenby_data>("kismet.device.base.seenby.data",
+                    "seen-by data");
 
         packet_rrd_bin_250_id =
-            RegisterComplexField("kismet.device.base.packet.bin.250", bin_rrd_builder, 
+            RegisterComplexField<kis_tracked_minute_rrd<> >("kismet.device.base.packet.bin.250",
                     "Packets up to 250 bytes");
         packet_rrd_bin_500_id =
-            RegisterComplexField("kismet.device.base.packet.bin.500", bin_rrd_builder, 
+            RegisterComplexField<kis_tracked_minute_rrd<> >("kismet.device.base.packet.bin.500",
                     "Packets up to 500 bytes");
         packet_rrd_bin_1000_id =
-            RegisterComplexField("kismet.device.base.packet.bin.1000", bin_rrd_builder, 
+            RegisterComplexField<kis_tracked_minute_rrd<> >("kismet.device.base.packet.bin.1000",
                     "Packets up to 1000 bytes");
         packet_rrd_bin_1500_id =
-            RegisterComplexField("kismet.device.base.packet.bin.1500", bin_rrd_builder, 
+            RegisterComplexField<kis_tracked_minute_rrd<> >("kismet.device.base.packet.bin.1500",
                     "Packets up to 1500 bytes");
         packet_rrd_bin_jumbo_id =
-            RegisterComplexField("kismet.device.base.packet.bin.jumbo", bin_rrd_builder, 
+            RegisterComplexField<kis_tracked_minute_rrd<> >("kismet.device.base.packet.bin.jumbo",
                     "Jumbo packets over 1500 bytes");
     }
 
@@ -436,37 +442,37 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            signal_data.reset(new kis_tracked_signal_data(globalreg, signal_data_id,
-                    e->get_map_value(signal_data_id)));
+            signal_data = AllocTrackedElement<kis_tracked_signal_data>(globalreg, signal_data_id,
+                    e->get_map_value(signal_data_id));
 
-            location.reset(new kis_tracked_location(globalreg, location_id,
-                    e->get_map_value(location_id)));
+            location = AllocTrackedElement<kis_tracked_location>(globalreg, location_id,
+                    e->get_map_value(location_id));
 
-            packets_rrd.reset(new kis_tracked_rrd<>(globalreg,
-                    packets_rrd_id, e->get_map_value(packets_rrd_id)));
+            packets_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg,
+                    packets_rrd_id, e->get_map_value(packets_rrd_id));
 
-            data_rrd.reset(new kis_tracked_rrd<>(globalreg,
-                    data_rrd_id, e->get_map_value(data_rrd_id)));
+            data_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg,
+                    data_rrd_id, e->get_map_value(data_rrd_id));
 
-            packet_rrd_bin_250.reset(new kis_tracked_minute_rrd<>(globalreg,
-                    packet_rrd_bin_250_id, e->get_map_value(packet_rrd_bin_250_id)));
+            packet_rrd_bin_250 = AllocTrackedElement<kis_tracked_minute_rrd<> >(globalreg,
+                    packet_rrd_bin_250_id, e->get_map_value(packet_rrd_bin_250_id));
 
-            packet_rrd_bin_500.reset(new kis_tracked_minute_rrd<>(globalreg,
-                    packet_rrd_bin_500_id, e->get_map_value(packet_rrd_bin_500_id)));
+            packet_rrd_bin_500 = AllocTrackedElement<kis_tracked_minute_rrd<> >(globalreg,
+                    packet_rrd_bin_500_id, e->get_map_value(packet_rrd_bin_500_id));
 
-            packet_rrd_bin_1000.reset(new kis_tracked_minute_rrd<>(globalreg,
-                    packet_rrd_bin_1000_id, e->get_map_value(packet_rrd_bin_1000_id)));
+            packet_rrd_bin_1000 = AllocTrackedElement<kis_tracked_minute_rrd<> >(globalreg,
+                    packet_rrd_bin_1000_id, e->get_map_value(packet_rrd_bin_1000_id));
 
-            packet_rrd_bin_1500.reset(new kis_tracked_minute_rrd<>(globalreg,
-                    packet_rrd_bin_1500_id, e->get_map_value(packet_rrd_bin_1500_id)));
+            packet_rrd_bin_1500 = AllocTrackedElement<kis_tracked_minute_rrd<> >(globalreg,
+                    packet_rrd_bin_1500_id, e->get_map_value(packet_rrd_bin_1500_id));
 
-            packet_rrd_bin_jumbo.reset(new kis_tracked_minute_rrd<>(globalreg,
-                    packet_rrd_bin_jumbo_id, e->get_map_value(packet_rrd_bin_jumbo_id)));
+            packet_rrd_bin_jumbo = AllocTrackedElement<kis_tracked_minute_rrd<> >(globalreg,
+                    packet_rrd_bin_jumbo_id, e->get_map_value(packet_rrd_bin_jumbo_id));
 
         } else {
-            signal_data.reset(new kis_tracked_signal_data(globalreg, signal_data_id));
+            signal_data = AllocTrackedElement<kis_tracked_signal_data>(globalreg, signal_data_id);
 
-            packets_rrd.reset(new kis_tracked_rrd<>(globalreg, packets_rrd_id));
+            packets_rrd = AllocTrackedElement<kis_tracked_rrd<> >(globalreg, packets_rrd_id);
         }
 
         // add using known fields b/c we might add null
@@ -487,6 +493,9 @@ protected:
     // up long-running queries.
     uint64_t kis_internal_id;
 
+    // Changes whenever the device is modified; may be updated by pool threads
+    std::atomic<uint64_t> mod_version;
+
     // Unique key
     SharedTrackerElement key;
 
@@ -602,19 +611,42 @@ public:
 		devref = NULL;
 	}
 
+    // First device the packet updated
     shared_ptr<kis_tracked_device_base> devref;
+
+    // Every device the packet updated, devref included
+    vector<shared_ptr<kis_tracked_device_base> > devrefs;
 };
 
 // Filter-handler class.  Subclassed by a filter supplicant to be passed to the
 // device filter functions.
+//
+// Devices are matched in parallel on the shared worker thread pool, so 
+// MatchDevice must be thread safe.  Workers which accumulate results should 
+// prefer MatchDeviceSlot and keep per-slot results, which need no locking, and
+// merge them in Finalize.
 class DevicetrackerFilterWorker {
 public:
     DevicetrackerFilterWorker() { };
     virtual ~DevicetrackerFilterWorker() { };
 
+    // Called before any matching with the number of pool slots which will be
+    // used
+    virtual void PrepareSlots(unsigned int in_slots __attribute__((unused))) { }
+
     // Perform a match on a device
     virtual void MatchDevice(Devicetracker *devicetracker,
-            shared_ptr<kis_tracked_device_base> base) = 0;
+            const shared_ptr<kis_tracked_device_base>& base) = 0;
+
+    // Perform a match on a device from a specific pool slot; only one thread
+    // uses a given slot at a time.  By default calls MatchDevice.  Matches
+    // run on pool threads while the device list is locked by the caller, so
+    // they must not call devicetracker functions which take the list lock.
+    virtual void MatchDeviceSlot(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& base,
+            unsigned int in_slot __attribute__((unused))) {
+        MatchDevice(devicetracker, base);
+    }
 
     // Finalize operations
     virtual void Finalize(Devicetracker *devicetracker) { }
@@ -623,6 +655,37 @@ protected:
     pthread_mutex_t worker_mutex;
 };
 
+// Filter worker which collects matching devices into a vector object.  Matches
+// are accumulated per pool slot and merged, in device ID order, in Finalize.
+// Subclasses implement MatchFilter, and must call this Finalize if they
+// override it.
+class DevicetrackerVectorFilterWorker : public DevicetrackerFilterWorker {
+public:
+    // in_devvec_object must be a vector object
+    DevicetrackerVectorFilterWorker(SharedTrackerElement in_devvec_object);
+    virtual ~DevicetrackerVectorFilterWorker();
+
+    // Return true if the device should be included; must be thread safe
+    virtual bool MatchFilter(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& device) = 0;
+
+    virtual void PrepareSlots(unsigned int in_slots);
+
+    virtual void MatchDevice(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& device);
+
+    virtual void MatchDeviceSlot(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& device,
+            unsigned int in_slot);
+
+    virtual void Finalize(Devicetracker *devicetracker);
+
+protected:
+    SharedTrackerElement return_dev_vec;
+
+    vector<vector<shared_ptr<kis_tracked_device_base> > > slot_matches;
+};
+
 class Devicetracker : public Kis_Net_Httpd_CPPStream_Handler,
     public TimetrackerEvent, public LifetimeGlobal {
 public:
@@ -656,6 +719,10 @@ public:
 	int FetchNumErrorpackets(int in_phy);
 	int FetchNumFilterpackets(int in_phy);
 
+    // Approximate memory used by all tracked devices, in bytes, as of the
+    // last memory accounting pass
+    uint64_t FetchDeviceMemory();
+
 	int AddFilter(string in_filter);
 	int AddNetCliFilter(string in_filter);
 
@@ -727,6 +794,26 @@ public:
     shared_ptr<kis_tracked_device_base> UpdateCommonDevice(mac_addr in_mac, int in_phy,
             kis_packet *in_pack, unsigned int in_flags);
 
+    // Give a device a new modification version, invalidating cached copies of
+    // it and the ETags clients hold for it.  UpdateCommonDevice does this, and
+    // does it again once the packet has been through every tracker, after the
+    // phy handlers are done with the device; anything else which modifies a
+    // device should call this afterwards.  Doesn't lock, so it is safe to call
+    // from device workers.
+    void MarkDeviceModified(const shared_ptr<kis_tracked_device_base>& device) {
+        device->set_mod_version(device_version_counter.fetch_add(1) + 1);
+    }
+
+    // Mark a device modified by handling a packet, and remember it in the
+    // device info of the packet so it's marked again once the packet has been
+    // through every tracker.  Phys use this for every device a packet touches,
+    // not just the one UpdateCommonDevice returned.
+    void MarkPacketDeviceModified(kis_packet *in_pack,
+            const shared_ptr<kis_tracked_device_base>& device);
+
+    // Re-mark the devices a packet updated once it's been through the trackers
+    int ModifiedTracker(kis_packet *in_packet);
+
     // HTTP handlers
     virtual bool Httpd_VerifyPath(const char *path, const char *method);
 
@@ -735,7 +822,30 @@ public:
             const char *url, const char *method, const char *upload_data,
             size_t *upload_data_size, std::stringstream &stream);
 
+    // The full device lists are streamed as they're sent
+    virtual Kis_Net_Httpd_Stream_Generator *Httpd_CreateStreamGenerator(
+            Kis_Net_Httpd *httpd, Kis_Net_Httpd_Connection *connection,
+            const char *url, const char *method);
+
+    // Single devices are versioned, so they can be cached and revalidated
+    virtual bool Httpd_GetObjectVersion(Kis_Net_Httpd *httpd,
+            Kis_Net_Httpd_Connection *connection, const char *url,
+            uint64_t *ret_version);
+
     virtual int Httpd_PostComplete(Kis_Net_Httpd_Connection *concls);
+
+    // Device list built by a POST, to be serialized (and summarized, if there
+    // is a plan) once the device list lock has been released
+    struct httpd_deferred_list {
+        string path;
+        string wrapper_key;
+        vector<SharedTrackerElement> devices;
+        shared_ptr<TrackerElementSummaryPlan> summary_plan;
+    };
+
+    // Handle a POST under the device list lock
+    int Httpd_PostCompleteLocked(Kis_Net_Httpd_Connection *concls,
+            httpd_deferred_list& ret_deferred);
     
     // Generate a list of all phys, serialized appropriately.  If specified,
     // wrap it in a dictionary and name it with the key in in_wrapper, which
@@ -752,9 +862,12 @@ public:
             vector<SharedElementSummary> summary_vec,
             string in_wrapper_key = "");
 
-    // TODO merge this into a normal serializer call
+    // XML summary of all devices, written a batch of devices at a time
     void httpd_xml_device_summary(std::stringstream &stream);
 
+    // Serializer for the XML device summary document
+    shared_ptr<TrackerElementSerializer> httpd_xml_serializer();
+
     // Timetracker event handler
     virtual int timetracker_event(int eventid);
 
@@ -802,9 +915,16 @@ protected:
     unsigned int max_num_devices;
     int max_devices_timer;
 
+    // Device memory accounting and maximum device memory, in bytes
+    uint64_t max_device_memory;
+    int device_memory_timer;
+
     // Timestamp for the last time we removed a device
     time_t full_refresh_time;
 
+    // Source of device modification versions
+    std::atomic<uint64_t> device_version_counter;
+
 	// Common device component
 	int devcomp_ref_common;
 
@@ -822,6 +942,23 @@ protected:
     // device ID.
     vector<shared_ptr<kis_tracked_device_base> > immutable_tracked_vec;
 
+    // Columnar mirror of hot scalar fields, indexed by device ID like the
+    // immutable vector
+    DevicetrackerColumns device_columns;
+
+    // How long a sort index may be reused while devices are updating
+    time_t sort_index_max_age;
+
+    // Remove a device from every tracking structure; must be called with the
+    // devicelist locked.  Does not touch tracked_vec, callers are usually
+    // iterating it.
+    void RemoveDeviceRecords(shared_ptr<kis_tracked_device_base> device);
+
+    // Re-measure the memory of a share of the devices which have changed since
+    // they were last measured; takes the devicelist lock itself, a batch at a
+    // time
+    void UpdateDeviceMemory();
+
 	// Filtering
 	FilterCore *track_filter;
 
@@ -860,7 +997,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_phy(globalreg, get_id()));
+        return AllocTrackedElement<kis_tracked_phy>(globalreg, get_id());
     }
 
     __Proxy(phy_id, int32_t, int32_t, int32_t, phy_id);
@@ -932,7 +1069,7 @@ private:
 
 // Matching worker to match fields against a string search term
 
-class devicetracker_stringmatch_worker : public DevicetrackerFilterWorker {
+class devicetracker_stringmatch_worker : public DevicetrackerVectorFilterWorker {
 public:
     // Prepare the worker with the query and the vector of paths we
     // query against.  The vector of paths is equivalent to a field
@@ -947,10 +1084,8 @@ public:
 
     virtual ~devicetracker_stringmatch_worker();
 
-    virtual void MatchDevice(Devicetracker *devicetracker,
-            shared_ptr<kis_tracked_device_base> device);
-
-    virtual void Finalize(Devicetracker *devicetracker);
+    virtual bool MatchFilter(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& device);
 
 protected:
     GlobalRegistry *globalreg;
@@ -962,14 +1097,12 @@ protected:
     // Make a macaddr query out of it, too
     uint64_t mac_query_term;
     unsigned int mac_query_term_len;
-
-    SharedTrackerElement return_dev_vec;
 };
 
 #ifdef HAVE_LIBPCRE
 // Retrieve a list of devices based on complex field paths and
 // return them in a vector sharedtrackerelement
-class devicetracker_pcre_worker : public DevicetrackerFilterWorker {
+class devicetracker_pcre_worker : public DevicetrackerVectorFilterWorker {
 public:
     class pcre_filter {
     public:
@@ -1022,10 +1155,8 @@ public:
 
     bool get_error() { return error; }
 
-    virtual void MatchDevice(Devicetracker *devicetracker,
-            shared_ptr<kis_tracked_device_base> device);
-
-    virtual void Finalize(Devicetracker *devicetracker);
+    virtual bool MatchFilter(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& device);
 
 protected:
     GlobalRegistry *globalreg;
@@ -1033,8 +1164,6 @@ protected:
 
     vector<shared_ptr<devicetracker_pcre_worker::pcre_filter> > filter_vec;
     bool error;
-
-    SharedTrackerElement return_dev_vec;
 };
 #else
 class devicetracker_pcre_worker : public DevicetrackerFilterWorker {
@@ -1070,7 +1199,7 @@ public:
     bool get_error() { return true; }
 
     virtual void MatchDevice(Devicetracker *devicetracker,
-            shared_ptr<kis_tracked_device_base> device) { };
+            const shared_ptr<kis_tracked_device_base>& device) { };
 
     virtual void Finalize(Devicetracker *devicetracker) { };
 };
@@ -0,0 +1,453 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <algorithm>
+
+#include "devicetracker.h"
+#include "devicetracker_columns.h"
+#include "devicetracker_component.h"
+#include "entrytracker.h"
+
+DevicetrackerColumns::DevicetrackerColumns() {
+    last_time_id = first_time_id = packets_id = signal_id = last_signal_id =
+        frequency_id = crypt_id = -1;
+
+    total_memory = 0;
+    memory_cursor = 0;
+
+    for (unsigned int c = 0; c < column_max; c++) {
+        sorted_index_time[c] = 0;
+        sorted_index_built[c] = false;
+        sorted_index_moved[c] = false;
+    }
+}
+
+void DevicetrackerColumns::resolve_fields(shared_ptr<EntryTracker> entrytracker) {
+    last_time_id = entrytracker->GetFieldId("kismet.device.base.last_time");
+    first_time_id = entrytracker->GetFieldId("kismet.device.base.first_time");
+    packets_id = entrytracker->GetFieldId("kismet.device.base.packets.total");
+    signal_id = entrytracker->GetFieldId("kismet.device.base.signal");
+    last_signal_id = entrytracker->GetFieldId("kismet.common.signal.last_signal_dbm");
+    frequency_id = entrytracker->GetFieldId("kismet.device.base.frequency");
+    crypt_id = entrytracker->GetFieldId("kismet.device.base.basic_crypt_set");
+}
+
+void DevicetrackerColumns::grow(uint64_t id) {
+    if (id < valid.size())
+        return;
+
+    // Grow geometrically so a busy capture doesn't reallocate every column
+    // on every new device
+    size_t sz = std::max((size_t) id + 1, valid.size() * 2);
+
+    valid.resize(sz, 0);
+    last_time.resize(sz, 0);
+    first_time.resize(sz, 0);
+    packets.resize(sz, 0);
+    signal.resize(sz, 0);
+    frequency.resize(sz, 0);
+    phy.resize(sz, KIS_PHY_ANY);
+    crypt.resize(sz, 0);
+    memory.resize(sz, 0);
+    memory_time.resize(sz, 0);
+    sorted_dirty_mark.resize(sz, 0);
+}
+
+void DevicetrackerColumns::mark_sorted_dirty(column_type in_column, uint64_t id,
+        bool in_moved) {
+    if (!sorted_index_built[in_column])
+        return;
+
+    if (in_moved)
+        sorted_index_moved[in_column] = true;
+
+    uint8_t bit = 1 << in_column;
+
+    if (sorted_dirty_mark[id] & bit)
+        return;
+
+    sorted_dirty_mark[id] |= bit;
+    sorted_dirty[in_column].push_back(id);
+}
+
+void DevicetrackerColumns::update_device(kis_tracked_device_base *device) {
+    uint64_t id = device->get_kis_internal_id();
+
+    grow(id);
+
+    bool added = !valid[id];
+
+    time_t n_last_time = device->get_last_time();
+    time_t n_first_time = device->get_first_time();
+    uint64_t n_packets = device->get_packets();
+    int32_t n_signal = device->get_signal_data()->get_last_signal_dbm();
+    double n_frequency = device->get_frequency();
+    int32_t n_phy = DevicetrackerKey::GetPhy(device->get_key());
+    uint64_t n_crypt = device->get_basic_crypt_set();
+
+    // Only the sorted indexes of columns which actually changed need to be
+    // touched; most packets only move last_time, packets, and signal
+    if (added || last_time[id] != n_last_time)
+        mark_sorted_dirty(column_last_time, id, added);
+    if (added || first_time[id] != n_first_time)
+        mark_sorted_dirty(column_first_time, id, added);
+    if (added || packets[id] != n_packets)
+        mark_sorted_dirty(column_packets, id, added);
+    if (added || signal[id] != n_signal)
+        mark_sorted_dirty(column_signal, id, added);
+    if (added || frequency[id] != n_frequency)
+        mark_sorted_dirty(column_frequency, id, added);
+    if (added || phy[id] != n_phy)
+        mark_sorted_dirty(column_phy, id, added);
+    if (added || crypt[id] != n_crypt)
+        mark_sorted_dirty(column_crypt, id, added);
+
+    valid[id] = 1;
+    last_time[id] = n_last_time;
+    first_time[id] = n_first_time;
+    packets[id] = n_packets;
+    signal[id] = n_signal;
+    frequency[id] = n_frequency;
+    phy[id] = n_phy;
+    crypt[id] = n_crypt;
+}
+
+void DevicetrackerColumns::remove_device(uint64_t id) {
+    if (id >= valid.size())
+        return;
+
+    if (valid[id]) {
+        for (unsigned int c = 0; c < column_max; c++)
+            mark_sorted_dirty((column_type) c, id, true);
+    }
+
+    valid[id] = 0;
+    phy[id] = KIS_PHY_ANY;
+
+    total_memory -= memory[id];
+    memory[id] = 0;
+}
+
+void DevicetrackerColumns::clear() {
+    valid.clear();
+    last_time.clear();
+    first_time.clear();
+    packets.clear();
+    signal.clear();
+    frequency.clear();
+    phy.clear();
+    crypt.clear();
+    memory.clear();
+    memory_time.clear();
+    sorted_dirty_mark.clear();
+
+    total_memory = 0;
+    memory_cursor = 0;
+
+    for (unsigned int c = 0; c < column_max; c++) {
+        sorted_index[c].clear();
+        sorted_dirty[c].clear();
+        sorted_index_built[c] = false;
+        sorted_index_moved[c] = false;
+    }
+}
+
+size_t DevicetrackerColumns::count_phy(int in_phy) const {
+    size_t r = 0;
+    size_t sz = valid.size();
+
+    if (in_phy == KIS_PHY_ANY) {
+        for (size_t x = 0; x < sz; x++)
+            r += valid[x];
+
+        return r;
+    }
+
+    // Removed rows have their phy cleared, so we only need to look at one column
+    const int32_t *p = phy.data();
+    for (size_t x = 0; x < sz; x++)
+        r += (p[x] == in_phy);
+
+    return r;
+}
+
+void DevicetrackerColumns::find_idle(time_t in_cutoff,
+        std::vector<uint64_t>& ret_ids) const {
+    size_t sz = valid.size();
+
+    for (size_t x = 0; x < sz; x++) {
+        if (valid[x] && last_time[x] < in_cutoff)
+            ret_ids.push_back(x);
+    }
+}
+
+void DevicetrackerColumns::find_oldest(size_t in_num,
+        std::vector<uint64_t>& ret_ids) const {
+    std::vector<uint64_t> candidates;
+    size_t sz = valid.size();
+
+    for (size_t x = 0; x < sz; x++) {
+        if (valid[x])
+            candidates.push_back(x);
+    }
+
+    if (in_num >= candidates.size()) {
+        ret_ids.insert(ret_ids.end(), candidates.begin(), candidates.end());
+        return;
+    }
+
+    // We only need the oldest N, not a sorted list
+    std::nth_element(candidates.begin(), candidates.begin() + in_num, candidates.end(),
+            [this](uint64_t a, uint64_t b) {
+                if (last_time[a] == last_time[b])
+                    return a < b;
+                return last_time[a] < last_time[b];
+            });
+
+    ret_ids.insert(ret_ids.end(), candidates.begin(), candidates.begin() + in_num);
+}
+
+void DevicetrackerColumns::set_memory(uint64_t id, uint64_t in_bytes,
+        time_t in_last_time) {
+    if (!is_valid(id))
+        return;
+
+    total_memory -= memory[id];
+    total_memory += in_bytes;
+
+    memory[id] = in_bytes;
+    memory_time[id] = in_last_time;
+}
+
+void DevicetrackerColumns::find_memory_stale(size_t in_max,
+        std::vector<uint64_t>& ret_ids) {
+    size_t sz = valid.size();
+    size_t start = ret_ids.size();
+
+    for (size_t x = 0; x < sz && ret_ids.size() - start < in_max; x++) {
+        if (valid[x] && memory[x] == 0)
+            ret_ids.push_back(x);
+    }
+
+    if (sz == 0)
+        return;
+
+    if (memory_cursor >= sz)
+        memory_cursor = 0;
+
+    size_t x = memory_cursor;
+
+    for (size_t n = 0; n < sz && ret_ids.size() - start < in_max; n++) {
+        if (valid[x] && memory[x] != 0 && memory_time[x] != last_time[x])
+            ret_ids.push_back(x);
+
+        if (++x >= sz)
+            x = 0;
+    }
+
+    memory_cursor = x;
+}
+
+void DevicetrackerColumns::find_memory_evict(uint64_t in_bytes, time_t in_now,
+        std::vector<uint64_t>& ret_ids) const {
+    std::vector<std::pair<double, uint64_t> > candidates;
+    size_t sz = valid.size();
+
+    for (size_t x = 0; x < sz; x++) {
+        if (!valid[x])
+            continue;
+
+        double age = 1;
+        if (in_now > last_time[x])
+            age += in_now - last_time[x];
+
+        candidates.push_back(std::make_pair(age * memory[x], x));
+    }
+
+    // Highest cost first, oldest ID first on ties
+    auto cost_cmp =
+        [](const std::pair<double, uint64_t>& a, const std::pair<double, uint64_t>& b) {
+            if (a.first == b.first)
+                return a.second < b.second;
+            return a.first > b.first;
+        };
+
+    // We usually only need a handful of victims, so select the most expensive
+    // chunk, order just that, and only look further if it wasn't enough
+    uint64_t freed = 0;
+    size_t pos = 0;
+    size_t chunk = 64;
+
+    while (freed < in_bytes && pos < candidates.size()) {
+        auto first = candidates.begin() + pos;
+        auto last = candidates.begin() + std::min(pos + chunk, candidates.size());
+
+        if (last != candidates.end())
+            std::nth_element(first, last, candidates.end(), cost_cmp);
+
+        std::sort(first, last, cost_cmp);
+
+        for (auto c = first; c != last && freed < in_bytes; ++c) {
+            ret_ids.push_back(c->second);
+            freed += memory[c->second];
+        }
+
+        pos += chunk;
+        chunk *= 2;
+    }
+}
+
+DevicetrackerColumns::column_type
+    DevicetrackerColumns::column_for_path(const std::vector<int>& in_path) const {
+
+    if (in_path.size() == 1) {
+        int f = in_path[0];
+
+        if (f < 0)
+            return column_none;
+
+        if (f == last_time_id)
+            return column_last_time;
+        if (f == first_time_id)
+            return column_first_time;
+        if (f == packets_id)
+            return column_packets;
+        if (f == frequency_id)
+            return column_frequency;
+        if (f == crypt_id)
+            return column_crypt;
+    } else if (in_path.size() == 2 && in_path[0] == signal_id &&
+            in_path[1] == last_signal_id && signal_id >= 0) {
+        return column_signal;
+    }
+
+    return column_none;
+}
+
+bool DevicetrackerColumns::less(column_type in_column, uint64_t a, uint64_t b) const {
+    switch (in_column) {
+        case column_last_time:
+            return last_time[a] < last_time[b];
+        case column_first_time:
+            return first_time[a] < first_time[b];
+        case column_packets:
+            return packets[a] < packets[b];
+        case column_signal:
+            return signal[a] < signal[b];
+        case column_frequency:
+            return frequency[a] < frequency[b];
+        case column_phy:
+            return phy[a] < phy[b];
+        case column_crypt:
+            return crypt[a] < crypt[b];
+        default:
+            return a < b;
+    }
+}
+
+void DevicetrackerColumns::rebuild_sorted_index(column_type in_column) {
+    std::vector<uint64_t>& index = sorted_index[in_column];
+    std::vector<uint64_t>& dirty = sorted_dirty[in_column];
+    uint8_t bit = 1 << in_column;
+
+    for (auto d : dirty)
+        sorted_dirty_mark[d] &= ~bit;
+    dirty.clear();
+
+    index.clear();
+
+    size_t sz = valid.size();
+    for (size_t x = 0; x < sz; x++) {
+        if (valid[x])
+            index.push_back(x);
+    }
+
+    std::sort(index.begin(), index.end(),
+            [this, in_column](uint64_t a, uint64_t b) {
+                return less_id(in_column, a, b);
+            });
+
+    sorted_index_built[in_column] = true;
+    sorted_index_moved[in_column] = false;
+}
+
+void DevicetrackerColumns::merge_sorted_index(column_type in_column) {
+    std::vector<uint64_t>& index = sorted_index[in_column];
+    std::vector<uint64_t>& dirty = sorted_dirty[in_column];
+    uint8_t bit = 1 << in_column;
+
+    // Pull every changed row out of the index; what's left is still in order
+    std::vector<uint64_t> kept;
+    kept.reserve(index.size() + dirty.size());
+
+    for (auto i : index) {
+        if (!(sorted_dirty_mark[i] & bit))
+            kept.push_back(i);
+    }
+
+    // Sort the changed rows which still exist on their own and merge them back
+    std::vector<uint64_t> changed;
+    changed.reserve(dirty.size());
+
+    for (auto d : dirty) {
+        sorted_dirty_mark[d] &= ~bit;
+
+        if (valid[d])
+            changed.push_back(d);
+    }
+
+    dirty.clear();
+
+    std::sort(changed.begin(), changed.end(),
+            [this, in_column](uint64_t a, uint64_t b) {
+                return less_id(in_column, a, b);
+            });
+
+    index.resize(kept.size() + changed.size());
+
+    std::merge(kept.begin(), kept.end(), changed.begin(), changed.end(),
+            index.begin(),
+            [this, in_column](uint64_t a, uint64_t b) {
+                return less_id(in_column, a, b);
+            });
+
+    sorted_index_moved[in_column] = false;
+}
+
+const std::vector<uint64_t>& DevicetrackerColumns::get_sorted_index(column_type in_column,
+        time_t in_now, time_t in_max_age) {
+
+    static const std::vector<uint64_t> empty_index;
+
+    if (in_column <= column_none || in_column >= column_max)
+        return empty_index;
+
+    if (!sorted_index_built[in_column]) {
+        rebuild_sorted_index(in_column);
+        sorted_index_time[in_column] = in_now;
+    } else if (sorted_index_moved[in_column] ||
+            (sorted_dirty[in_column].size() != 0 &&
+             in_now - sorted_index_time[in_column] >= in_max_age)) {
+        merge_sorted_index(in_column);
+        sorted_index_time[in_column] = in_now;
+    }
+
+    return sorted_index[in_column];
+}
@@ -0,0 +1,185 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICETRACKER_COLUMNS_H__
+#define __DEVICETRACKER_COLUMNS_H__
+
+#include "config.hpp"
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include <memory>
+
+class kis_tracked_device_base;
+class EntryTracker;
+
+// Columnar mirror of the small set of scalar device fields we constantly scan,
+// sort, and filter on.  Each column is a flat array indexed by the device
+// kis_internal_id, so walking every device for a count or an expiry test is a
+// tight loop over contiguous memory instead of a pointer chase through the
+// tracked element maps.
+//
+// The tracked device record remains authoritative; rows are refreshed by the
+// devicetracker whenever it touches the common device fields (UpdateCommonDevice,
+// PopulateCommon).
+//
+// Not thread safe on its own; all access is protected by the devicelist mutex.
+class DevicetrackerColumns {
+public:
+    // Columns we can sort by
+    enum column_type {
+        column_none = -1,
+        column_last_time = 0,
+        column_first_time,
+        column_packets,
+        column_signal,
+        column_frequency,
+        column_phy,
+        column_crypt,
+        column_max
+    };
+
+    DevicetrackerColumns();
+
+    // Resolve the tracked field IDs which map to columns; must be called once
+    // the device base fields have been registered
+    void resolve_fields(std::shared_ptr<EntryTracker> entrytracker);
+
+    // Refresh the row for a device, growing the columns if needed
+    void update_device(kis_tracked_device_base *device);
+
+    // Mark a row as no longer in use
+    void remove_device(uint64_t id);
+
+    void clear();
+
+    // Number of rows (including removed rows)
+    size_t size() const { return valid.size(); }
+
+    bool is_valid(uint64_t id) const {
+        return id < valid.size() && valid[id];
+    }
+
+    time_t get_last_time(uint64_t id) const { return last_time[id]; }
+    time_t get_first_time(uint64_t id) const { return first_time[id]; }
+    uint64_t get_packets(uint64_t id) const { return packets[id]; }
+    int32_t get_signal(uint64_t id) const { return signal[id]; }
+    double get_frequency(uint64_t id) const { return frequency[id]; }
+    int32_t get_phy(uint64_t id) const { return phy[id]; }
+    uint64_t get_crypt(uint64_t id) const { return crypt[id]; }
+    uint64_t get_memory(uint64_t id) const { return memory[id]; }
+
+    // Record the measured memory of a device, and update the total;
+    // in_last_time is the last_time of the device when it was measured
+    void set_memory(uint64_t id, uint64_t in_bytes, time_t in_last_time);
+
+    // Total measured memory of all valid devices
+    uint64_t get_total_memory() const { return total_memory; }
+
+    // Find up to in_max valid devices which have never been measured, or which
+    // have been updated since they were last measured.  Unmeasured devices come
+    // first; updated devices are taken round-robin across calls so every device
+    // is eventually re-measured even when in_max is smaller than the set.
+    void find_memory_stale(size_t in_max, std::vector<uint64_t>& ret_ids);
+
+    // Find the devices to evict to free at least in_bytes, preferring devices
+    // with the highest cost (idle time multiplied by size) so that a single 
+    // large, long-idle device goes before many small recent ones
+    void find_memory_evict(uint64_t in_bytes, time_t in_now, 
+            std::vector<uint64_t>& ret_ids) const;
+
+    // Count valid devices; in_phy of KIS_PHY_ANY counts everything
+    size_t count_phy(int in_phy) const;
+
+    // Find all valid devices last seen before the cutoff
+    void find_idle(time_t in_cutoff, std::vector<uint64_t>& ret_ids) const;
+
+    // Find the in_num least recently seen devices
+    void find_oldest(size_t in_num, std::vector<uint64_t>& ret_ids) const;
+
+    // Map a resolved summary path to a column, or column_none if the path
+    // isn't one of the mirrored fields
+    column_type column_for_path(const std::vector<int>& in_path) const;
+
+    // Compare two rows by column, for sorting
+    bool less(column_type in_column, uint64_t a, uint64_t b) const;
+
+    // Get the IDs of all valid devices sorted ascending by a column, with
+    // ties broken by ID.  The index is sorted once when first requested; after
+    // that only the rows whose value in that column changed are re-sorted and
+    // merged back in.  Added and removed devices are always merged before the
+    // index is returned, so it holds exactly the valid devices; rows which only
+    // changed value are merged once the index is in_max_age seconds old.
+    const std::vector<uint64_t>& get_sorted_index(column_type in_column,
+            time_t in_now, time_t in_max_age);
+
+protected:
+    std::vector<uint8_t> valid;
+    std::vector<time_t> last_time;
+    std::vector<time_t> first_time;
+    std::vector<uint64_t> packets;
+    std::vector<int32_t> signal;
+    // Channels are phy-specific strings; the frequency is the numeric
+    // equivalent we can actually scan
+    std::vector<double> frequency;
+    std::vector<int32_t> phy;
+    std::vector<uint64_t> crypt;
+
+    // Approximate memory per device, and the last_time of the device when it
+    // was measured; walking a device is expensive so this is refreshed lazily
+    std::vector<uint64_t> memory;
+    std::vector<time_t> memory_time;
+    uint64_t total_memory;
+    // Where the next round-robin search for updated devices starts
+    size_t memory_cursor;
+
+    // Sorted indexes per column, and the rows changed in that column since the
+    // index was last merged.  Changes are only tracked for built indexes; a
+    // bit per column in sorted_dirty_mark keeps each row in a dirty list once,
+    // so merging is never more work than sorting again.
+    std::vector<uint64_t> sorted_index[column_max];
+    std::vector<uint64_t> sorted_dirty[column_max];
+    std::vector<uint8_t> sorted_dirty_mark;
+    time_t sorted_index_time[column_max];
+    bool sorted_index_built[column_max];
+    // Rows have been added or removed since the last merge
+    bool sorted_index_moved[column_max];
+
+    void mark_sorted_dirty(column_type in_column, uint64_t id, bool in_moved);
+    void rebuild_sorted_index(column_type in_column);
+    void merge_sorted_index(column_type in_column);
+
+    // Column order with ties broken by ID
+    bool less_id(column_type in_column, uint64_t a, uint64_t b) const {
+        if (less(in_column, a, b))
+            return true;
+        if (less(in_column, b, a))
+            return false;
+        return a < b;
+    }
+
+    // Field IDs for path to column mapping
+    int last_time_id, first_time_id, packets_id, signal_id, last_signal_id,
+        frequency_id, crypt_id;
+
+    void grow(uint64_t id);
+};
+
+#endif
+
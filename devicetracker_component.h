@@ -58,15 +58,13 @@ public:
     }
 
     // Combine a vector for a higher-level record (seconds to minutes, minutes to 
-    // hours, and so on).
-    static int64_t combine_vector(shared_ptr<TrackerElement> e) {
-        TrackerElementVector v(e);
-
-        int64_t avg = 0;
-        for (TrackerElementVector::iterator i = v.begin(); i != v.end(); ++i) 
-            avg += GetTrackerValue<int64_t>(*i);
-
-        return avg / v.size();
+    // hours, and so on).  The RRD keeps running totals rather than walking the
+    // vector:  in_sum is the sum of the slots holding something other than
+    // default_val(), in_set is the number of those slots, and in_slots is the
+    // size of the vector.
+    static int64_t combine_vector(const int64_t in_sum, const int in_set, 
+            const int in_slots) {
+        return (in_sum + (in_slots - in_set) * default_val()) / in_slots;
     }
 
     // Default 'empty' value
@@ -79,6 +77,12 @@ public:
     }
 };
 
+// Round-robin database of a value over the past minute (per second), hour
+// (per minute), and day (per hour).
+//
+// Buckets are kept as plain int64 vectors instead of a tracked element per
+// value, with running totals per vector so that rolling a sample up to the
+// higher-level records doesn't need to walk them.
 template <class Aggregator = kis_tracked_rrd_default_aggregator>
 class kis_tracked_rrd : public tracker_component {
 public:
@@ -87,6 +91,7 @@ public:
         register_fields();
         reserve_fields(NULL);
         update_first = true;
+        rollup_pending = false;
     }
 
     kis_tracked_rrd(GlobalRegistry *in_globalreg, int in_id, 
@@ -96,12 +101,12 @@ public:
         register_fields();
         reserve_fields(e);
         update_first = true;
+        rollup_pending = false;
 
     }
 
     virtual shared_ptr<TrackerElement> clone_type() {
-        return shared_ptr<TrackerElement>(new kis_tracked_rrd<Aggregator>(globalreg, 
-                    get_id()));
+        return AllocTrackedElement<kis_tracked_rrd<Aggregator> >(globalreg, get_id());
     }
 
     // By default a RRD will fast forward to the current time before
@@ -137,41 +142,32 @@ public:
             // printf("debug - rrd - timewarp to the past?  discard\n");
             return;
         }
-        
-        shared_ptr<TrackerElement> e;
+
+        // Most samples land in the same second as the last one (several per
+        // packet); combine them into the second slot and leave rolling the
+        // minute and hour up until the second changes or we're serialized
+        if (in_time == ltime) {
+            set_slot(minute_b, sec_bucket, 
+                    agg.combine_element((*minute_b.data)[sec_bucket], in_s));
+            rollup_pending = true;
+            return;
+        }
+
+        // Bring the hour and day up to date with the last second before
+        // moving on
+        apply_rollup();
 
         // If we haven't seen data in a day, we reset everything because
         // none of it is valid.  This is the simplest case.
         if (in_time - ltime > (60 * 60 * 24)) {
             // Directly fill in this second, clear rest of the minute
-            TrackerElementVector mv(minute_vec);
-            for (TrackerElementVector::iterator i = mv.begin(); i != mv.end(); ++i) {
-                if (i - mv.begin() == sec_bucket)
-                    (*i)->set(in_s);
-                else
-                    (*i)->set((int64_t) agg.default_val());
-            }
+            reset_slots(minute_b, sec_bucket, in_s);
 
             // Reset the last hour, setting it to a single sample
-            // Get the combined value for the minute
-            int64_t min_val = agg.combine_vector(minute_vec);
-            TrackerElementVector hv = TrackerElementVector(hour_vec);
-            for (TrackerElementVector::iterator i = hv.begin(); i != hv.end(); ++i) {
-                if (i - hv.begin() == min_bucket)
-                    (*i)->set(min_val);
-                else
-                    (*i)->set((int64_t) agg.default_val());
-            }
+            reset_slots(hour_b, min_bucket, combine_bucket(minute_b));
 
             // Reset the last day, setting it to a single sample
-            int64_t hr_val = agg.combine_vector(hour_vec);
-            TrackerElementVector dv = TrackerElementVector(day_vec);
-            for (TrackerElementVector::iterator i = dv.begin(); i != dv.end(); ++i) {
-                if (i - dv.begin() == hour_bucket)
-                    (*i)->set(hr_val);
-                else
-                    (*i)->set((int64_t) agg.default_val());
-            }
+            reset_slots(day_b, hour_bucket, combine_bucket(hour_b));
 
             set_last_time(in_time);
 
@@ -182,42 +178,21 @@ public:
             //   - Average the seconds we know about & set the minute record
             //   - Clear seconds data & set our current value
             //   - Average the minutes we know about & set the hour record
-            //
-           
-            int64_t sec_avg = 0, min_avg = 0;
 
             // We only have this entry in the minute, so set it and get the 
             // combined value
-            
-            TrackerElementVector mv(minute_vec);
-            for (TrackerElementVector::iterator i = mv.begin(); i != mv.end(); ++i) {
-                if (i - mv.begin() == sec_bucket)
-                    (*i)->set(in_s);
-                else
-                    (*i)->set((int64_t) agg.default_val());
-            }
-            sec_avg = agg.combine_vector(minute_vec);
+            reset_slots(minute_b, sec_bucket, in_s);
 
             // We haven't seen anything in this hour, so clear it, set the minute
             // and get the aggregate
-            TrackerElementVector hv = TrackerElementVector(hour_vec);
-            for (TrackerElementVector::iterator i = hv.begin(); i != hv.end(); ++i) {
-                if (i - hv.begin() == min_bucket)
-                    (*i)->set(sec_avg);
-                else
-                    (*i)->set((int64_t) agg.default_val());
-            }
-            min_avg = agg.combine_vector(hour_vec);
+            reset_slots(hour_b, min_bucket, combine_bucket(minute_b));
 
             // Fill the hours between the last time we saw data and now with
             // zeroes; fastforward time
-            for (int h = 0; h < hours_different(last_hour_bucket + 1, hour_bucket); h++) {
-                e = hour_vec->get_vector_value((last_hour_bucket + 1 + h) % 24);
-                e->set((int64_t) agg.default_val());
-            }
+            for (int h = 0; h < hours_different(last_hour_bucket + 1, hour_bucket); h++) 
+                set_slot(day_b, (last_hour_bucket + 1 + h) % 24, agg.default_val());
 
-            e = day_vec->get_vector_value(hour_bucket);
-            e->set(min_avg);
+            set_slot(day_b, hour_bucket, combine_bucket(hour_b));
 
         } else if (in_time - ltime > 60) {
             // - Calculate the average seconds
@@ -227,69 +202,31 @@ public:
             // - Update hours
             // printf("debug - rrd - been over a minute since last value\n");
 
-            int64_t sec_avg = 0, min_avg = 0;
-
-            TrackerElementVector mv(minute_vec);
-            for (TrackerElementVector::iterator i = mv.begin(); i != mv.end(); ++i) {
-                if (i - mv.begin() == sec_bucket)
-                    (*i)->set(in_s);
-                else
-                    (*i)->set((int64_t) agg.default_val());
-            }
-            sec_avg = agg.combine_vector(minute_vec);
+            reset_slots(minute_b, sec_bucket, in_s);
 
             // Zero between last and current
             for (int m = 0; 
-                    m < minutes_different(last_min_bucket + 1, min_bucket); m++) {
-                e = hour_vec->get_vector_value((last_min_bucket + 1 + m) % 60);
-                e->set((int64_t) agg.default_val());
-            }
+                    m < minutes_different(last_min_bucket + 1, min_bucket); m++) 
+                set_slot(hour_b, (last_min_bucket + 1 + m) % 60, agg.default_val());
 
             // Set the updated value
-            e = hour_vec->get_vector_value(min_bucket);
-            e->set((int64_t) sec_avg);
-
-            min_avg = agg.combine_vector(hour_vec);
+            set_slot(hour_b, min_bucket, combine_bucket(minute_b));
 
             // Reset the hour
-            e = day_vec->get_vector_value(hour_bucket);
-            e->set(min_avg);
+            set_slot(day_b, hour_bucket, combine_bucket(hour_b));
 
         } else {
             // printf("debug - rrd - w/in the last minute %d seconds\n", in_time - last_time);
-            // If in_time == last_time then we're updating an existing record,
-            // use the aggregator class to combine it
-            
-            // Otherwise, fast-forward seconds with zero data, then propagate the
-            // changes up
-            if (in_time == ltime) {
-                e = minute_vec->get_vector_value(sec_bucket);
-                e->set(agg.combine_element(GetTrackerValue<int64_t>(e), in_s));
-            } else {
-                for (int s = 0; 
-                        s < minutes_different(last_sec_bucket + 1, sec_bucket); s++) {
-                    e = minute_vec->get_vector_value((last_sec_bucket + 1 + s) % 60);
-                    e->set((int64_t) agg.default_val());
-                }
+            // Fast-forward seconds with zero data, then propagate the changes up
+            for (int s = 0; 
+                    s < minutes_different(last_sec_bucket + 1, sec_bucket); s++) 
+                set_slot(minute_b, (last_sec_bucket + 1 + s) % 60, agg.default_val());
 
-                e = minute_vec->get_vector_value(sec_bucket);
-                e->set((int64_t) in_s);
-            }
+            set_slot(minute_b, sec_bucket, in_s);
 
             // Update all the averages
-            int64_t sec_avg = 0, min_avg = 0;
-
-            sec_avg = agg.combine_vector(minute_vec);
-
-            // Set the minute
-            e = hour_vec->get_vector_value(min_bucket);
-            e->set(sec_avg);
-
-            min_avg = agg.combine_vector(hour_vec);
-
-            // Set the hour
-            e = day_vec->get_vector_value(hour_bucket);
-            e->set(min_avg);
+            set_slot(hour_b, min_bucket, combine_bucket(minute_b));
+            set_slot(day_b, hour_bucket, combine_bucket(hour_b));
         }
 
         set_last_time(in_time);
@@ -304,9 +241,85 @@ public:
         if (update_first) {
             add_sample(agg.default_val(), globalreg->timestamp.tv_sec);
         }
+
+        apply_rollup();
     }
 
 protected:
+    // Propagate samples combined into the current second up to the hour and
+    // day records
+    void apply_rollup() {
+        if (!rollup_pending)
+            return;
+
+        time_t ltime = get_last_time();
+
+        set_slot(hour_b, (ltime / 60) % 60, combine_bucket(minute_b));
+        set_slot(day_b, (ltime / 3600) % 24, combine_bucket(hour_b));
+
+        rollup_pending = false;
+    }
+
+    // One vector of buckets, and the totals the aggregator needs to combine
+    // it: the sum and count of slots not holding the default value
+    struct rrd_bucket {
+        TrackerElement::tracked_int64_vector *data;
+        int64_t sum;
+        int num_set;
+    };
+
+    // Set a slot, keeping the running totals in step
+    void set_slot(rrd_bucket& b, int in_slot, int64_t in_v) {
+        Aggregator agg;
+
+        int64_t& slot = (*b.data)[in_slot];
+
+        if (slot != agg.default_val()) {
+            b.sum -= slot;
+            b.num_set--;
+        }
+
+        if (in_v != agg.default_val()) {
+            b.sum += in_v;
+            b.num_set++;
+        }
+
+        slot = in_v;
+    }
+
+    // Clear a vector to the default value, then set one slot
+    void reset_slots(rrd_bucket& b, int in_slot, int64_t in_v) {
+        Aggregator agg;
+
+        std::fill(b.data->begin(), b.data->end(), agg.default_val());
+        b.sum = 0;
+        b.num_set = 0;
+
+        set_slot(b, in_slot, in_v);
+    }
+
+    int64_t combine_bucket(const rrd_bucket& b) {
+        Aggregator agg;
+        return agg.combine_vector(b.sum, b.num_set, b.data->size());
+    }
+
+    // Attach a bucket to its vector, sizing it and totalling what's there
+    void init_bucket(rrd_bucket& b, SharedTrackerElement in_vec, size_t in_sz) {
+        Aggregator agg;
+
+        b.data = in_vec->get_int64_vector();
+        b.data->resize(in_sz, 0);
+        b.sum = 0;
+        b.num_set = 0;
+
+        for (auto v : *(b.data)) {
+            if (v != agg.default_val()) {
+                b.sum += v;
+                b.num_set++;
+            }
+        }
+    }
+
     inline int minutes_different(int m1, int m2) const {
         if (m1 == m2) {
             return 0;
@@ -343,61 +356,30 @@ protected:
         RegisterField("kismet.common.rrd.last_time", TrackerUInt64,
                 "last time udpated", &last_time);
 
-        RegisterField("kismet.common.rrd.minute_vec", TrackerVector,
+        RegisterField("kismet.common.rrd.minute_vec", TrackerInt64Vector,
                 "past minute values per second", &minute_vec);
-        RegisterField("kismet.common.rrd.hour_vec", TrackerVector,
+        RegisterField("kismet.common.rrd.hour_vec", TrackerInt64Vector,
                 "past hour values per minute", &hour_vec);
-        RegisterField("kismet.common.rrd.day_vec", TrackerVector,
+        RegisterField("kismet.common.rrd.day_vec", TrackerInt64Vector,
                 "past day values per hour", &day_vec);
 
         RegisterField("kismet.common.rrd.blank_val", TrackerInt64,
                 "blank value", &blank_val);
         RegisterField("kismet.common.rrd.aggregator", TrackerString,
                 "aggregator name", &aggregator_name);
-
-        second_entry_id = 
-            RegisterField("kismet.common.rrd.second", TrackerInt64, 
-                    "second value", NULL);
-        minute_entry_id = 
-            RegisterField("kismet.common.rrd.minute", TrackerInt64, 
-                    "minute value", NULL);
-        hour_entry_id = 
-            RegisterField("kismet.common.rrd.hour", TrackerInt64, 
-                    "hour value", NULL);
-
     } 
 
     virtual void reserve_fields(shared_ptr<TrackerElement> e) {
         tracker_component::reserve_fields(e);
 
         // Build slots for all the times
-        int x;
-        if ((x = minute_vec->get_vector()->size()) != 60) {
-            for ( ; x < 60; x++) {
-                SharedTrackerElement me(new TrackerElement(TrackerInt64, 
-                            second_entry_id));
-                minute_vec->add_vector(me);
-            }
-        }
-
-        if ((x = hour_vec->get_vector()->size()) != 60) {
-            for ( ; x < 60; x++) {
-                SharedTrackerElement he(new TrackerElement(TrackerInt64, 
-                            minute_entry_id));
-                hour_vec->add_vector(he);
-            }
-        }
-
-        if ((x = day_vec->get_vector()->size()) != 24) {
-            for ( ; x < 24; x++) {
-                SharedTrackerElement he(new TrackerElement(TrackerInt64, hour_entry_id));
-                day_vec->add_vector(he);
-            }
-        }
+        init_bucket(minute_b, minute_vec, 60);
+        init_bucket(hour_b, hour_vec, 60);
+        init_bucket(day_b, day_vec, 24);
 
         Aggregator agg;
         (*blank_val).set(agg.default_val());
-        (*aggregator_name).set(agg.name());
+        aggregator_name->set_interned(agg.name());
 
     }
 
@@ -408,9 +390,11 @@ protected:
     SharedTrackerElement blank_val;
     SharedTrackerElement aggregator_name;
 
-    int second_entry_id;
-    int minute_entry_id;
-    int hour_entry_id;
+    rrd_bucket minute_b, hour_b, day_b;
+
+    // Samples have been combined into the current second without updating
+    // the hour and day
+    bool rollup_pending;
 
     bool update_first;
 };
@@ -439,8 +423,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_minute_rrd<Aggregator>(globalreg, 
-                    get_id()));
+        return AllocTrackedElement<kis_tracked_minute_rrd<Aggregator> >(globalreg, get_id());
     }
 
     // By default a RRD will fast forward to the current time before
@@ -468,32 +451,25 @@ public:
         if (in_time < ltime) {
             return;
         }
-        
-        SharedTrackerElement e;
+
+        TrackerElement::tracked_int64_vector& mv = *minute_data;
 
         // If we haven't seen data in a minute, wipe
         if (in_time - ltime > 60) {
-            for (int x = 0; x < 60; x++) {
-                e = minute_vec->get_vector_value(x);
-                e->set((int64_t) agg.default_val());
-            }
+            std::fill(mv.begin(), mv.end(), agg.default_val());
         } else {
             // If in_time == last_time then we're updating an existing record, so
             // add that in.
             // Otherwise, fast-forward seconds with zero data, average the seconds,
             // and propagate the averages up
             if (in_time == ltime) {
-                e = minute_vec->get_vector_value(sec_bucket);
-                e->set(agg.combine_element(GetTrackerValue<int64_t>(e), in_s));
+                mv[sec_bucket] = agg.combine_element(mv[sec_bucket], in_s);
             } else {
                 for (int s = 0; 
-                        s < minutes_different(last_sec_bucket + 1, sec_bucket); s++) {
-                    e = minute_vec->get_vector_value((last_sec_bucket + 1 + s) % 60);
-                    e->set((int64_t) agg.default_val());
-                }
+                        s < minutes_different(last_sec_bucket + 1, sec_bucket); s++) 
+                    mv[(last_sec_bucket + 1 + s) % 60] = agg.default_val();
 
-                e = minute_vec->get_vector_value(sec_bucket);
-                e->set((int64_t) in_s);
+                mv[sec_bucket] = in_s;
             }
         }
 
@@ -527,13 +503,9 @@ protected:
         RegisterField("kismet.common.rrd.last_time", TrackerUInt64,
                 "last time udpated", &last_time);
 
-        RegisterField("kismet.common.rrd.minute_vec", TrackerVector,
+        RegisterField("kismet.common.rrd.minute_vec", TrackerInt64Vector,
                 "past minute values per second", &minute_vec);
 
-        second_entry_id = 
-            RegisterField("kismet.common.rrd.second", TrackerInt64, 
-                    "second value", NULL);
-
         RegisterField("kismet.common.rrd.blank_val", TrackerInt64,
                 "blank value", &blank_val);
         RegisterField("kismet.common.rrd.aggregator", TrackerString,
@@ -546,18 +518,12 @@ protected:
         set_last_time(0);
 
         // Build slots for all the times
-        int x;
-        if ((x = minute_vec->get_vector()->size()) != 60) {
-            for ( ; x < 60; x++) {
-                SharedTrackerElement me(new TrackerElement(TrackerInt64, 
-                            second_entry_id));
-                minute_vec->add_vector(me);
-            }
-        }
+        minute_data = minute_vec->get_int64_vector();
+        minute_data->resize(60, 0);
 
         Aggregator agg;
         (*blank_val).set(agg.default_val());
-        (*aggregator_name).set(agg.name());
+        aggregator_name->set_interned(agg.name());
     }
 
     SharedTrackerElement last_time;
@@ -565,7 +531,7 @@ protected:
     SharedTrackerElement blank_val;
     SharedTrackerElement aggregator_name;
 
-    int second_entry_id;
+    TrackerElement::tracked_int64_vector *minute_data;
 
     bool update_first;
 };
@@ -581,38 +547,13 @@ public:
         return a;
     }
 
-    // Select the strongest signal of the bucket
-    static int64_t combine_vector(SharedTrackerElement e) {
-        TrackerElementVector v(e);
-
-        int64_t avg = 0, avgc = 0;
-
-        for (TrackerElementVector::iterator i = v.begin(); i != v.end(); ++i) {
-            int64_t v = GetTrackerValue<int64_t>(*i);
-
-            if (v == 0)
-                continue;
-
-            avg += v;
-            avgc++;
-        }
-
-        if (avgc == 0)
+    // Average the signal of the slots which have one
+    static int64_t combine_vector(const int64_t in_sum, const int in_set,
+            const int in_slots __attribute__((unused))) {
+        if (in_set == 0)
             return default_val();
 
-        return avg / avgc;
-
-#if 0
-        int64_t max = 0;
-        for (TrackerElementVector::iterator i = v.begin(); i != v.end(); ++i) {
-            int64_t v = GetTrackerValue<int64_t>(*i);
-
-            if (max == 0 || max < v)
-                max = v;
-        }
-
-        return max;
-#endif
+        return in_sum / in_set;
     }
 
     // Default 'empty' value, no legit signal would be 0
@@ -654,14 +595,9 @@ public:
     }
 
     // Simple average
-    static int64_t combine_vector(SharedTrackerElement e) {
-        TrackerElementVector v(e);
-
-        int64_t avg = 0;
-        for (TrackerElementVector::iterator i = v.begin(); i != v.end(); ++i) 
-            avg += GetTrackerValue<int64_t>(*i);
-
-        return avg / v.size();
+    static int64_t combine_vector(const int64_t in_sum, const int in_set, 
+            const int in_slots) {
+        return (in_sum + (in_slots - in_set) * default_val()) / in_slots;
     }
 
     // Default 'empty' value, no legit signal would be 0
@@ -702,7 +638,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_ip_data(globalreg, get_id()));
+        return AllocTrackedElement<kis_tracked_ip_data>(globalreg, get_id());
     }
 
     __Proxy(ip_type, int32_t, kis_ipdata_type, kis_ipdata_type, ip_type);
@@ -748,8 +684,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_location_triplet(globalreg, 
-                    get_id()));
+        return AllocTrackedElement<kis_tracked_location_triplet>(globalreg, get_id());
     }
 
     // Use proxy macro to define get/set
@@ -827,7 +762,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_location(globalreg, get_id()));
+        return AllocTrackedElement<kis_tracked_location>(globalreg, get_id());
     }
 
 
@@ -928,17 +863,14 @@ protected:
         RegisterField("kismet.common.location.loc_fix", TrackerUInt8,
                 "location fix precision (2d/3d)", &loc_fix);
 
-        shared_ptr<kis_tracked_location_triplet> 
-            loc_builder(new kis_tracked_location_triplet(globalreg, 0));
-
         min_loc_id = 
-            RegisterComplexField("kismet.common.location.min_loc", loc_builder, 
+            RegisterComplexField<kis_tracked_location_triplet>("kismet.common.location.min_loc",
                     "minimum corner of bounding rectangle");
         max_loc_id = 
-            RegisterComplexField("kismet.common.location.max_loc", loc_builder,
+            RegisterComplexField<kis_tracked_location_triplet>("kismet.common.location.max_loc",
                     "maximum corner of bounding rectangle");
         avg_loc_id = 
-            RegisterComplexField("kismet.common.location.avg_loc", loc_builder,
+            RegisterComplexField<kis_tracked_location_triplet>("kismet.common.location.avg_loc",
                     "average corner of bounding rectangle");
 
         RegisterField("kismet.common.location.avg_lat", TrackerInt64,
@@ -962,17 +894,17 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            min_loc.reset(new kis_tracked_location_triplet(globalreg, min_loc_id, e->get_map_value(min_loc_id)));
+            min_loc = AllocTrackedElement<kis_tracked_location_triplet>(globalreg, min_loc_id, e->get_map_value(min_loc_id));
 
-            max_loc.reset(new kis_tracked_location_triplet(globalreg, max_loc_id, e->get_map_value(max_loc_id)));
+            max_loc = AllocTrackedElement<kis_tracked_location_triplet>(globalreg, max_loc_id, e->get_map_value(max_loc_id));
 
-            avg_loc.reset(new kis_tracked_location_triplet(globalreg, avg_loc_id, e->get_map_value(avg_loc_id)));
+            avg_loc = AllocTrackedElement<kis_tracked_location_triplet>(globalreg, avg_loc_id, e->get_map_value(avg_loc_id));
         } else {
-            min_loc.reset(new kis_tracked_location_triplet(globalreg, min_loc_id));
+            min_loc = AllocTrackedElement<kis_tracked_location_triplet>(globalreg, min_loc_id);
 
-            max_loc.reset(new kis_tracked_location_triplet(globalreg, max_loc_id));
+            max_loc = AllocTrackedElement<kis_tracked_location_triplet>(globalreg, max_loc_id);
 
-            avg_loc.reset(new kis_tracked_location_triplet(globalreg, avg_loc_id));
+            avg_loc = AllocTrackedElement<kis_tracked_location_triplet>(globalreg, avg_loc_id);
         }
 
         add_map(avg_loc);
@@ -1010,7 +942,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_signal_data(globalreg, get_id()));
+        return AllocTrackedElement<kis_tracked_signal_data>(globalreg, get_id());
     }
 
     kis_tracked_signal_data& operator+= (const kis_layer1_packinfo& lay1) {
@@ -1233,10 +1165,8 @@ protected:
                 "maximum noise (RSSI)", &max_noise_rssi);
 
 
-        shared_ptr<kis_tracked_location_triplet> 
-            loc_builder(new kis_tracked_location_triplet(globalreg, 0));
         peak_loc_id = 
-            RegisterComplexField("kismet.common.signal.peak_loc", loc_builder,
+            RegisterComplexField<kis_tracked_location_triplet>("kismet.common.signal.peak_loc",
                     "location of strongest signal");
 
         RegisterField("kismet.common.signal.maxseenrate", TrackerDouble,
@@ -1246,21 +1176,19 @@ protected:
         RegisterField("kismet.common.signal.carrierset", TrackerUInt64,
                 "bitset of observed carrier types", &carrierset);
 
-        shared_ptr<kis_tracked_minute_rrd<kis_tracked_rrd_peak_signal_aggregator> >
-            signal_min_rrd_builder(new kis_tracked_minute_rrd<kis_tracked_rrd_peak_signal_aggregator>(globalreg, 0));
         signal_min_rrd_id =
-            RegisterComplexField("kismet.common.signal.signal_rrd",
-                    signal_min_rrd_builder, "signal data for past minute");
+            RegisterComplexField<kis_tracked_minute_rrd<kis_tracked_rrd_peak_signal_aggregator> >(
+                    "kismet.common.signal.signal_rrd", "signal data for past minute");
     }
 
     virtual void reserve_fields(SharedTrackerElement e) {
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            peak_loc.reset(new kis_tracked_location_triplet(globalreg, peak_loc_id,
-                    e->get_map_value(peak_loc_id))); 
+            peak_loc = AllocTrackedElement<kis_tracked_location_triplet>(globalreg, peak_loc_id,
+                    e->get_map_value(peak_loc_id)); 
 
-            signal_min_rrd.reset(new kis_tracked_minute_rrd<kis_tracked_rrd_peak_signal_aggregator>(globalreg, signal_min_rrd_id, e->get_map_value(signal_min_rrd_id)));
+            signal_min_rrd = AllocTrackedElement<kis_tracked_minute_rrd<kis_tracked_rrd_peak_signal_aggregator> >(globalreg, signal_min_rrd_id, e->get_map_value(signal_min_rrd_id));
         } 
 
         // We MUST add using our known ID because we might be adding null pointers here
@@ -1304,7 +1232,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_signal_data(globalreg, get_id()));
+        return AllocTrackedElement<kis_tracked_signal_data>(globalreg, get_id());
     }
 
     __Proxy(src_uuid, uuid, uuid, uuid, src_uuid);
@@ -1344,7 +1272,7 @@ protected:
         RegisterField("kismet.common.seenby.freq_khz_map", TrackerIntMap,
                 "packets seen per frequency (khz)", &freq_khz_map);
         frequency_val_id =
-            globalreg->entrytracker->RegisterField("kismet.common.seenby.frequency.count",
+            RegisterField("kismet.common.seenby.frequency.count",
                     TrackerUInt64, "frequency packet count");
     }
 
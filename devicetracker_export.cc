@@ -0,0 +1,335 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <string.h>
+#include <stdexcept>
+
+#include "entrytracker.h"
+#include "devicetracker_export.h"
+
+DevicetrackerColumnExport::DevicetrackerColumnExport(
+        const std::shared_ptr<EntryTracker>& entrytracker,
+        const std::vector<SharedElementSummary>& in_fields) {
+    num_rows = 0;
+
+    for (std::vector<SharedElementSummary>::const_iterator fi = in_fields.begin();
+            fi != in_fields.end(); ++fi) {
+        const std::vector<int>& path = (*fi)->resolved_path;
+
+        // Unknown path components resolve to negative ids; report the field
+        // as it was asked for
+        for (size_t p = 0; p < path.size(); p++) {
+            if (path[p] >= 0)
+                continue;
+
+            if ((*fi)->path.length() != 0)
+                throw std::runtime_error("Unknown field '" + (*fi)->path + "'");
+
+            if ((*fi)->rename.length() != 0)
+                throw std::runtime_error("Unknown field '" + (*fi)->rename + "'");
+
+            throw std::runtime_error("Unknown field");
+        }
+
+        if (path.size() == 0)
+            throw std::runtime_error("Empty field");
+
+        int lastid = path[path.size() - 1];
+
+        SharedTrackerElement builder = entrytracker->GetTrackedInstance(lastid);
+
+        if (builder == NULL || type_width(builder->get_type()) == 0)
+            throw std::runtime_error("Field '" + entrytracker->GetFieldName(lastid) +
+                    "' is not a single value and can't be exported as a column");
+
+        column c;
+
+        // Named the same way as a summarized field
+        if ((*fi)->rename.length() != 0)
+            c.name = (*fi)->rename;
+        else
+            c.name = entrytracker->GetFieldName(lastid);
+
+        c.path = path;
+        c.type = builder->get_type();
+        c.width = type_width(c.type);
+
+        columns.push_back(std::move(c));
+    }
+}
+
+size_t DevicetrackerColumnExport::type_width(TrackerType in_type) {
+    switch (in_type) {
+        case TrackerInt8:
+        case TrackerUInt8:
+            return 1;
+        case TrackerInt16:
+        case TrackerUInt16:
+            return 2;
+        case TrackerInt32:
+        case TrackerUInt32:
+        case TrackerFloat:
+            return 4;
+        case TrackerInt64:
+        case TrackerUInt64:
+        case TrackerDouble:
+        case TrackerMac:
+            return 8;
+        case TrackerString:
+        case TrackerUuid:
+            // Dictionary index
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+uint32_t DevicetrackerColumnExport::dict_lookup(column& in_col, const std::string& in_str) {
+    std::unordered_map<std::string, uint32_t>::iterator di = in_col.dict_index.find(in_str);
+
+    if (di != in_col.dict_index.end())
+        return di->second;
+
+    uint32_t idx = in_col.dict.size();
+
+    in_col.dict.push_back(in_str);
+    in_col.dict_index[in_str] = idx;
+
+    return idx;
+}
+
+void DevicetrackerColumnExport::set_value(column& in_col, size_t in_row,
+        TrackerElement *in_elem) {
+    uint8_t *dst = &(in_col.data[in_row * in_col.width]);
+
+    switch (in_col.type) {
+        case TrackerInt8: {
+            int8_t v = in_elem->get_int8();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerUInt8: {
+            uint8_t v = in_elem->get_uint8();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerInt16: {
+            int16_t v = in_elem->get_int16();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerUInt16: {
+            uint16_t v = in_elem->get_uint16();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerInt32: {
+            int32_t v = in_elem->get_int32();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerUInt32: {
+            uint32_t v = in_elem->get_uint32();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerInt64: {
+            int64_t v = in_elem->get_int64();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerUInt64: {
+            uint64_t v = in_elem->get_uint64();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerFloat: {
+            float v = in_elem->get_float();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerDouble: {
+            double v = in_elem->get_double();
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerMac: {
+            uint64_t v = in_elem->get_mac().longmac;
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerString: {
+            uint32_t v = dict_lookup(in_col, in_elem->get_string_ref());
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case TrackerUuid: {
+            uint32_t v = dict_lookup(in_col, in_elem->get_uuid().UUID2String());
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        default:
+            return;
+    }
+
+    in_col.valid[in_row / 8] |= (1 << (in_row % 8));
+}
+
+void DevicetrackerColumnExport::add_row(const SharedTrackerElement& in_record) {
+    size_t row = num_rows++;
+
+    for (std::vector<column>::iterator ci = columns.begin(); ci != columns.end(); ++ci) {
+        // Rows without the field are left zeroed and invalid
+        ci->data.resize(num_rows * ci->width, 0);
+        ci->valid.resize((num_rows + 7) / 8, 0);
+
+        // Walk the path the way a summary does, pre-serializing the parents
+        // so computed fields (such as RRD averages) are current.  The record
+        // holds everything on the path, so there's no need to take a
+        // reference at each step.
+        TrackerElement *elem = in_record.get();
+
+        for (size_t p = 0; p < ci->path.size() && elem != NULL; p++) {
+            if (p > 0)
+                elem->pre_serialize();
+
+            if (elem->get_type() != TrackerMap) {
+                elem = NULL;
+                break;
+            }
+
+            TrackerElement::tracked_map *m = elem->get_map();
+            TrackerElement::map_iterator mi = m->find(ci->path[p]);
+
+            if (mi == m->end())
+                elem = NULL;
+            else
+                elem = mi->second.get();
+        }
+
+        if (elem == NULL || elem->get_type() != ci->type)
+            continue;
+
+        set_value(*ci, row, elem);
+    }
+}
+
+size_t DevicetrackerColumnExport::dict_size(const column& in_col) {
+    if (in_col.type != TrackerString && in_col.type != TrackerUuid)
+        return 0;
+
+    size_t sz = sizeof(uint64_t) * (in_col.dict.size() + 2);
+
+    for (std::vector<std::string>::const_iterator di = in_col.dict.begin();
+            di != in_col.dict.end(); ++di)
+        sz += di->length();
+
+    return sz;
+}
+
+void DevicetrackerColumnExport::write(std::ostream& stream, time_t in_timestamp) {
+    static const char zeros[8] = { 0 };
+
+    kis_column_export_header header;
+    memset(&header, 0, sizeof(header));
+
+    memcpy(header.magic, KIS_COLUMN_EXPORT_MAGIC, sizeof(header.magic));
+    header.version = KIS_COLUMN_EXPORT_VERSION;
+    header.endian = KIS_COLUMN_EXPORT_ENDIAN;
+    header.num_rows = num_rows;
+    header.num_columns = columns.size();
+    header.column_size = sizeof(kis_column_export_column);
+    header.timestamp = in_timestamp;
+
+    // Lay out the names, then each column's sections, in order
+    std::vector<kis_column_export_column> descs(columns.size());
+
+    size_t offset = sizeof(header) + (sizeof(kis_column_export_column) * columns.size());
+
+    for (size_t c = 0; c < columns.size(); c++) {
+        memset(&(descs[c]), 0, sizeof(kis_column_export_column));
+
+        descs[c].type = columns[c].type;
+        descs[c].width = columns[c].width;
+        descs[c].name_offset = offset;
+        descs[c].name_len = columns[c].name.length();
+
+        offset += pad8(columns[c].name.length() + 1);
+    }
+
+    for (size_t c = 0; c < columns.size(); c++) {
+        descs[c].data_offset = offset;
+        offset += pad8(columns[c].data.size());
+
+        descs[c].valid_offset = offset;
+        offset += pad8(columns[c].valid.size());
+
+        descs[c].dict_len = dict_size(columns[c]);
+
+        if (descs[c].dict_len != 0) {
+            descs[c].dict_offset = offset;
+            offset += pad8(descs[c].dict_len);
+        }
+    }
+
+    stream.write((const char *) &header, sizeof(header));
+
+    if (descs.size() != 0)
+        stream.write((const char *) &(descs[0]),
+                sizeof(kis_column_export_column) * descs.size());
+
+    for (size_t c = 0; c < columns.size(); c++) {
+        const std::string& name = columns[c].name;
+
+        stream.write(name.data(), name.length());
+        stream.write(zeros, pad8(name.length() + 1) - name.length());
+    }
+
+    for (size_t c = 0; c < columns.size(); c++) {
+        const column& col = columns[c];
+
+        if (col.data.size() != 0)
+            stream.write((const char *) &(col.data[0]), col.data.size());
+        stream.write(zeros, pad8(col.data.size()) - col.data.size());
+
+        if (col.valid.size() != 0)
+            stream.write((const char *) &(col.valid[0]), col.valid.size());
+        stream.write(zeros, pad8(col.valid.size()) - col.valid.size());
+
+        if (descs[c].dict_len == 0)
+            continue;
+
+        uint64_t count = col.dict.size();
+        stream.write((const char *) &count, sizeof(count));
+
+        uint64_t str_offset = 0;
+        for (size_t d = 0; d < col.dict.size(); d++) {
+            stream.write((const char *) &str_offset, sizeof(str_offset));
+            str_offset += col.dict[d].length();
+        }
+        stream.write((const char *) &str_offset, sizeof(str_offset));
+
+        for (size_t d = 0; d < col.dict.size(); d++)
+            stream.write(col.dict[d].data(), col.dict[d].length());
+
+        stream.write(zeros, pad8(descs[c].dict_len) - descs[c].dict_len);
+    }
+}
+
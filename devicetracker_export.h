@@ -0,0 +1,141 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICETRACKER_EXPORT_H__
+#define __DEVICETRACKER_EXPORT_H__
+
+#include "config.hpp"
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+
+#include "trackedelement.h"
+
+class EntryTracker;
+
+// Columnar bulk export of selected device fields.
+//
+// Instead of a record per device, each field is written as one contiguous
+// column with a fixed width per row, so the file can be memory mapped and
+// the columns used in place:
+//
+//  - numeric fields keep their tracked width (int8 through double)
+//  - MAC addresses are the 48-bit address in a uint64
+//  - strings and UUIDs are uint32 indexes into a per-column dictionary
+//  - each column has a validity bitmap for devices without the field
+//
+// Everything is in host byte order, which the header records, and every
+// section starts on an 8 byte boundary.  The layout is:
+//
+//  header          kis_column_export_header
+//  columns         kis_column_export_column, one per field
+//  names           column names, each NUL terminated and padded
+//  per column      row data, validity bitmap, then the dictionary, if any
+//
+// Dictionaries are a uint64 count, count + 1 uint64 offsets relative to the
+// end of the offset table, and the string bytes; string i is the bytes from
+// offset i up to offset i + 1.
+//
+// Fields are parsed the same way as the summary fields; only scalar fields
+// can be exported.
+
+#define KIS_COLUMN_EXPORT_MAGIC     "KISCOLEX"
+#define KIS_COLUMN_EXPORT_VERSION   1
+#define KIS_COLUMN_EXPORT_ENDIAN    0x01020304
+
+struct kis_column_export_header {
+    char magic[8];
+    uint32_t version;
+    // KIS_COLUMN_EXPORT_ENDIAN as written by the exporting host
+    uint32_t endian;
+    uint64_t num_rows;
+    uint32_t num_columns;
+    uint32_t column_size;
+    uint64_t timestamp;
+    uint64_t reserved;
+};
+
+struct kis_column_export_column {
+    // TrackerType of the field
+    uint32_t type;
+    // Bytes per row in the data section
+    uint32_t width;
+    // Offsets are from the start of the file
+    uint64_t name_offset;
+    uint64_t name_len;
+    uint64_t data_offset;
+    // Bit (row % 8) of byte (row / 8) is set when the row has the field
+    uint64_t valid_offset;
+    // Dictionary for string columns, 0 for others
+    uint64_t dict_offset;
+    uint64_t dict_len;
+    uint64_t reserved;
+};
+
+class DevicetrackerColumnExport {
+public:
+    // Throws std::runtime_error if a field is unknown or isn't a scalar
+    DevicetrackerColumnExport(const std::shared_ptr<EntryTracker>& entrytracker,
+            const std::vector<SharedElementSummary>& in_fields);
+
+    // Append a row for a device (or any tracked record)
+    void add_row(const SharedTrackerElement& in_record);
+
+    size_t size() const { return num_rows; }
+
+    // Write the complete export
+    void write(std::ostream& stream, time_t in_timestamp);
+
+protected:
+    struct column {
+        std::string name;
+        std::vector<int> path;
+
+        TrackerType type;
+        size_t width;
+
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> valid;
+
+        // Dictionary for string columns, in order of first appearance
+        std::unordered_map<std::string, uint32_t> dict_index;
+        std::vector<std::string> dict;
+    };
+
+    std::vector<column> columns;
+    size_t num_rows;
+
+    // Width of the row data for an exportable type, 0 for other types
+    static size_t type_width(TrackerType in_type);
+
+    uint32_t dict_lookup(column& in_col, const std::string& in_str);
+
+    void set_value(column& in_col, size_t in_row, TrackerElement *in_elem);
+
+    static size_t dict_size(const column& in_col);
+
+    static size_t pad8(size_t in_len) { return (in_len + 7) & ~((size_t) 7); }
+};
+
+#endif
+
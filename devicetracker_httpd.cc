@@ -38,6 +38,8 @@
 #include "messagebus.h"
 #include "packetchain.h"
 #include "devicetracker.h"
+#include "devicetracker_query.h"
+#include "devicetracker_export.h"
 #include "packet.h"
 #include "gps_manager.h"
 #include "alertracker.h"
@@ -170,8 +172,10 @@ bool Devicetracker::Httpd_VerifyPath(const char *path, const char *method) {
             if (tokenurl.size() < 4) {
                 return false;
 
-            } else if (tokenurl[2] == "summary") {
+            } else if (tokenurl[2] == "summary" || tokenurl[2] == "query") {
                 return Httpd_CanSerialize(tokenurl[3]);
+            } else if (tokenurl[2] == "export") {
+                return tokenurl[3] == "devices.kcol";
             } else if (tokenurl[2] == "last-time") {
                 if (tokenurl.size() < 5) {
                     return false;
@@ -250,67 +254,33 @@ void Devicetracker::httpd_device_summary(string url, std::stringstream &stream,
         vector<SharedElementSummary> summary_vec,
         string in_wrapper_key) {
 
-    local_locker lock(&devicelist_mutex);
+    vector<SharedTrackerElement> devs;
 
-    SharedTrackerElement devvec =
-        globalreg->entrytracker->GetTrackedInstance(device_summary_base_id);
+    // Summarization compiled once; the serializers write the summary of each
+    // device straight from the device
+    shared_ptr<TrackerElementSummaryPlan> summary_plan;
 
-    TrackerElementSerializer::rename_map rename_map;
+    if (summary_vec.size() != 0)
+        summary_plan.reset(new TrackerElementSummaryPlan(entrytracker, summary_vec));
 
-    // Wrap the dev vec in a dictionary and change its name
-    SharedTrackerElement wrapper = NULL;
+    {
+        // Only hold the device list long enough to take references to the
+        // devices
+        local_locker lock(&devicelist_mutex);
 
-    if (in_wrapper_key != "") {
-        wrapper.reset(new TrackerElement(TrackerMap));
-        wrapper->add_map(devvec);
-        devvec->set_local_name(in_wrapper_key);
-    } else {
-        wrapper = devvec;
+        if (subvec == NULL)
+            devs.assign(tracked_vec.begin(), tracked_vec.end());
+        else
+            devs.assign(subvec->begin(), subvec->end());
     }
 
-    if (subvec == NULL) {
-        for (unsigned int x = 0; x < tracked_vec.size(); x++) {
-            if (summary_vec.size() == 0) {
-                devvec->add_vector(tracked_vec[x]);
-            } else {
-                SharedTrackerElement simple;
-
-                SummarizeTrackerElement(entrytracker, tracked_vec[x], 
-                        summary_vec, simple, rename_map);
-
-                devvec->add_vector(simple);
-            }
-        }
-    } else {
-        for (TrackerElementVector::const_iterator x = subvec->begin();
-                x != subvec->end(); ++x) {
-            if (summary_vec.size() == 0) {
-                devvec->add_vector(*x);
-            } else {
-                SharedTrackerElement simple;
-
-                SummarizeTrackerElement(entrytracker, *x, 
-                        summary_vec, simple, rename_map);
-
-                devvec->add_vector(simple);
-            }
-        }
-    }
-
-    Httpd_Serialize(url, stream, wrapper, &rename_map);
+    // Serialized in parallel batches, locking the device list per batch
+    Httpd_SerializeVector(url, stream, std::move(devs), &devicelist_mutex,
+            in_wrapper_key, summary_plan);
 }
 
-void Devicetracker::httpd_xml_device_summary(std::stringstream &stream) {
-    local_locker lock(&devicelist_mutex);
-
-    SharedTrackerElement devvec =
-        globalreg->entrytracker->GetTrackedInstance(device_summary_base_id);
-
-    for (unsigned int x = 0; x < tracked_vec.size(); x++) {
-        devvec->add_vector(tracked_vec[x]);
-    }
-
-    XmlserializeAdapter *xml = new XmlserializeAdapter(globalreg);
+shared_ptr<TrackerElementSerializer> Devicetracker::httpd_xml_serializer() {
+    shared_ptr<XmlserializeAdapter> xml(new XmlserializeAdapter(globalreg));
 
     xml->RegisterField("kismet.device.list", "SummaryDevices");
     xml->RegisterFieldNamespace("kismet.device.list",
@@ -327,7 +297,7 @@ void Devicetracker::httpd_xml_device_summary(std::stringstream &stream) {
             "http://www.kismetwireless.net/xml/gps.xsd");
 
 
-    xml->RegisterField("kismet.device.summary", "summary");
+    xml->RegisterField("kismet.device.base", "summary");
 
     xml->RegisterField("kismet.device.base.name", "name");
     xml->RegisterField("kismet.device.base.phyname", "phyname");
@@ -363,11 +333,99 @@ void Devicetracker::httpd_xml_device_summary(std::stringstream &stream) {
     xml->RegisterField("kismet.common.location.alt", "alt");
     xml->RegisterField("kismet.common.location.speed", "speed");
 
-    stream << "<?xml version=\"1.0\"?>";
+    return shared_ptr<TrackerElementSerializer>(
+            new XmlserializeAdapterSerializer(globalreg, xml, device_list_base_id));
+}
+
+void Devicetracker::httpd_xml_device_summary(std::stringstream &stream) {
+    vector<SharedTrackerElement> devs;
+
+    {
+        local_locker lock(&devicelist_mutex);
+        devs.assign(tracked_vec.begin(), tracked_vec.end());
+    }
 
-    xml->XmlSerialize(devvec, stream);
+    std::unique_ptr<Kis_Net_Httpd_Stream_Generator>
+        gen(Httpd_StreamVector(httpd_xml_serializer(), std::move(devs),
+                    &devicelist_mutex));
 
-    delete(xml);
+    while (gen->Generate(stream))
+        ;
+}
+
+Kis_Net_Httpd_Stream_Generator *Devicetracker::Httpd_CreateStreamGenerator(
+        Kis_Net_Httpd *httpd __attribute__((unused)),
+        Kis_Net_Httpd_Connection *connection __attribute__((unused)),
+        const char *path, const char *method) {
+
+    if (strcmp(method, "GET") != 0) {
+        return NULL;
+    }
+
+    string stripped = Httpd_StripSuffix(path);
+    string wrapper_key;
+
+    // Only hold the device list long enough to take references to the
+    // devices; the generator locks it again for each device it serializes
+    vector<SharedTrackerElement> devs;
+
+    if (strcmp(path, "/devices/all_devices.xml") == 0) {
+        {
+            local_locker lock(&devicelist_mutex);
+            devs.assign(tracked_vec.begin(), tracked_vec.end());
+        }
+
+        return Httpd_StreamVector(httpd_xml_serializer(), std::move(devs),
+                &devicelist_mutex);
+    }
+
+    if (stripped == "/devices/all_devices") {
+        wrapper_key = "";
+    } else if (stripped == "/devices/all_devices_dt") {
+        wrapper_key = "aaData";
+    } else {
+        return NULL;
+    }
+
+    {
+        local_locker lock(&devicelist_mutex);
+        devs.assign(tracked_vec.begin(), tracked_vec.end());
+    }
+
+    return Httpd_StreamVector(path, std::move(devs), &devicelist_mutex, wrapper_key);
+}
+
+bool Devicetracker::Httpd_GetObjectVersion(
+        Kis_Net_Httpd *httpd __attribute__((unused)),
+        Kis_Net_Httpd_Connection *connection __attribute__((unused)),
+        const char *url, uint64_t *ret_version) {
+
+    vector<string> tokenurl = StrTokenize(url, "/");
+
+    // Only single devices, /devices/by-key/[key]/device.[fmt][/sub/path]
+    if (tokenurl.size() < 5)
+        return false;
+
+    if (tokenurl[1] != "devices" || tokenurl[2] != "by-key")
+        return false;
+
+    if (Httpd_StripSuffix(tokenurl[4]) != "device" || !Httpd_CanSerialize(tokenurl[4]))
+        return false;
+
+    uint64_t key = 0;
+    std::stringstream ss(tokenurl[3]);
+    ss >> key;
+
+    local_locker lock(&devicelist_mutex);
+
+    device_itr tmi = tracked_map.find(key);
+
+    if (tmi == tracked_map.end())
+        return false;
+
+    *ret_version = tmi->second->get_mod_version();
+
+    return true;
 }
 
 void Devicetracker::Httpd_CreateStreamResponse(
@@ -553,8 +611,26 @@ void Devicetracker::Httpd_CreateStreamResponse(
 }
 
 int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
-    local_locker lock(&devicelist_mutex);
+    httpd_deferred_list deferred;
+    int r;
 
+    {
+        local_locker lock(&devicelist_mutex);
+        r = Httpd_PostCompleteLocked(concls, deferred);
+    }
+
+    // Device lists are serialized in parallel batches after the device list
+    // lock is released, locking it again only per batch
+    if (deferred.path != "")
+        Httpd_SerializeVector(deferred.path, concls->response_stream,
+                std::move(deferred.devices), &devicelist_mutex, deferred.wrapper_key,
+                deferred.summary_plan);
+
+    return r;
+}
+
+int Devicetracker::Httpd_PostCompleteLocked(Kis_Net_Httpd_Connection *concls,
+        httpd_deferred_list& ret_deferred) {
     // Split URL and process
     vector<string> tokenurl = StrTokenize(concls->url, "/");
 
@@ -576,6 +652,9 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
 
     SharedStructured regexdata;
 
+    // Compiled filter query, if any
+    shared_ptr<DevicetrackerQuery> device_query;
+
     try {
         // Decode the base64 msgpack and parse it, or parse the json
         if (concls->variable_cache.find("msgpack") != concls->variable_cache.end()) {
@@ -635,10 +714,19 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
 
             }
 
-        } else if (tokenurl[2] == "summary") {
+        } else if (tokenurl[2] == "summary" || tokenurl[2] == "query" ||
+                tokenurl[2] == "export") {
+            // Query is the same as summary, but the query is required and the
+            // fields are optional; export takes the same options as summary
+            bool query_api = tokenurl[2] == "query";
+
             try {
-                SharedStructured fields = structdata->getStructuredByKey("fields");
-                StructuredData::structured_vec fvec = fields->getStructuredArray();
+                StructuredData::structured_vec fvec;
+
+                if (!query_api || structdata->hasKey("fields")) {
+                    SharedStructured fields = structdata->getStructuredByKey("fields");
+                    fvec = fields->getStructuredArray();
+                }
 
                 for (StructuredData::structured_vec::iterator i = fvec.begin(); 
                         i != fvec.end(); ++i) {
@@ -668,11 +756,69 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                 if (structdata->hasKey("regex")) {
                     regexdata = structdata->getStructuredByKey("regex");
                 }
+
+                if (query_api || structdata->hasKey("query")) {
+                    device_query.reset(new DevicetrackerQuery(globalreg, 
+                                structdata->getKeyAsString("query")));
+                }
             } catch(const StructuredDataException e) {
                 concls->response_stream << "Invalid request: ";
                 concls->response_stream << e.what();
                 concls->httpcode = 400;
                 return 1;
+            } catch(const std::runtime_error& e) {
+                concls->response_stream << "Invalid request: ";
+                concls->response_stream << e.what();
+                concls->httpcode = 400;
+                return 1;
+            }
+
+            if (regexdata != NULL && device_query != NULL) {
+                concls->response_stream << "Invalid request: "
+                    "regex and query can not be combined";
+                concls->httpcode = 400;
+                return 1;
+            }
+
+            if (tokenurl[2] == "export") {
+                std::unique_ptr<DevicetrackerColumnExport> exporter;
+
+                try {
+                    exporter.reset(new DevicetrackerColumnExport(entrytracker,
+                                summary_vec));
+                } catch (const std::runtime_error& e) {
+                    concls->response_stream << "Invalid request: ";
+                    concls->response_stream << e.what();
+                    concls->httpcode = 400;
+                    return 1;
+                }
+
+                if (regexdata != NULL || device_query != NULL) {
+                    SharedTrackerElement matchdevs =
+                        globalreg->entrytracker->GetTrackedInstance(device_list_base_id);
+                    TrackerElementVector matchvec(matchdevs);
+
+                    if (device_query != NULL) {
+                        devicetracker_query_worker worker(globalreg, device_query,
+                                matchdevs);
+                        MatchOnDevices(&worker);
+                    } else {
+                        devicetracker_pcre_worker worker(globalreg, regexdata, matchdevs);
+                        MatchOnDevices(&worker);
+                    }
+
+                    for (TrackerElementVector::iterator vi = matchvec.begin();
+                            vi != matchvec.end(); ++vi)
+                        exporter->add_row(*vi);
+                } else {
+                    vector<shared_ptr<kis_tracked_device_base> >::iterator vi;
+                    for (vi = tracked_vec.begin(); vi != tracked_vec.end(); ++vi)
+                        exporter->add_row(*vi);
+                }
+
+                exporter->write(concls->response_stream, globalreg->timestamp.tv_sec);
+
+                return MHD_YES;
             }
 
             // Wrapper we insert under
@@ -682,8 +828,9 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
             SharedTrackerElement dt_length_elem = NULL;
             SharedTrackerElement dt_filter_elem = NULL;
 
-            // Rename cache generated during simplification
-            TrackerElementSerializer::rename_map rename_map;
+            // Summarization compiled once and applied to each device
+            shared_ptr<TrackerElementSummaryPlan> summary_plan(
+                    new TrackerElementSummaryPlan(entrytracker, summary_vec));
 
             SharedTrackerElement outdevs =
                 globalreg->entrytracker->GetTrackedInstance(device_list_base_id);
@@ -703,6 +850,8 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
             unsigned int dt_order_col = -1;
             int dt_order_dir = 0;
             vector<int> dt_order_field;
+            DevicetrackerColumns::column_type dt_order_column = 
+                DevicetrackerColumns::column_none;
 
             if (structdata->getKeyAsBool("datatable", false)) {
                 // fprintf(stderr, "debug - we think we're doing a server-side datatable\n");
@@ -782,6 +931,7 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                         dt_order_dir = 1;
 
                     dt_order_field = summary_vec[dt_order_col]->resolved_path;
+                    dt_order_column = device_columns.column_for_path(dt_order_field);
                 }
 
                 // Force a length if we think we're doing a smart position and
@@ -822,15 +972,24 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                 wrapper->add_map(dt_filter_elem);
             }
 
-            if (regexdata != NULL) {
-                // If we're doing a basic regex outside of devicetables
+            // Datatables pages are summarized here; plain lists are summarized
+            // as they're serialized, once the device list lock is released
+            bool summarize_now = summary_vec.size() != 0 && wrapper != NULL;
+
+            if (regexdata != NULL || device_query != NULL) {
+                // If we're doing a basic regex or a query outside of devicetables
                 // shenanigans...
                 SharedTrackerElement pcredevs =
                     globalreg->entrytracker->GetTrackedInstance(device_list_base_id);
                 TrackerElementVector pcrevec(pcredevs);
 
-                devicetracker_pcre_worker worker(globalreg, regexdata, pcredevs);
-                MatchOnDevices(&worker);
+                if (device_query != NULL) {
+                    devicetracker_query_worker worker(globalreg, device_query, pcredevs);
+                    MatchOnDevices(&worker);
+                } else {
+                    devicetracker_pcre_worker worker(globalreg, regexdata, pcredevs);
+                    MatchOnDevices(&worker);
+                }
                 
                 // Check DT ranges
                 if (dt_start >= pcrevec.size())
@@ -840,7 +999,22 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                     dt_filter_elem->set((uint64_t) pcrevec.size());
 
                 // Sort the list by the selected column
-                if (dt_order_col >= 0) {
+                if (dt_order_col >= 0 &&
+                        dt_order_column != DevicetrackerColumns::column_none) {
+                    // Sort hot fields straight out of the device columns
+                    kismet__stable_sort(pcrevec.begin(), pcrevec.end(), 
+                            [&](SharedTrackerElement a, SharedTrackerElement b) {
+                            uint64_t ia = 
+                                ((kis_tracked_device_base *) a.get())->get_kis_internal_id();
+                            uint64_t ib = 
+                                ((kis_tracked_device_base *) b.get())->get_kis_internal_id();
+
+                            if (dt_order_dir == 0)
+                                return device_columns.less(dt_order_column, ia, ib);
+
+                            return device_columns.less(dt_order_column, ib, ia);
+                        });
+                } else if (dt_order_col >= 0) {
                     kismet__stable_sort(pcrevec.begin(), pcrevec.end(), 
                             [&](SharedTrackerElement a, SharedTrackerElement b) {
                             SharedTrackerElement fa =
@@ -850,6 +1024,7 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
 
                             if (dt_order_dir == 0)
                                 return fa < fb;
+
                             return fb < fa;
                         });
                 }
@@ -867,9 +1042,12 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                 for (vi = pcrevec.begin() + dt_start; vi != ei; ++vi) {
                     SharedTrackerElement simple;
 
-                    SummarizeTrackerElement(entrytracker,
-                            (*vi), summary_vec,
-                            simple, rename_map);
+                    if (!summarize_now) {
+                        outdevs->add_vector(*vi);
+                        continue;
+                    }
+
+                    SummarizeTrackerElement((*vi), summary_plan, simple);
 
                     outdevs->add_vector(simple);
                 }
@@ -886,7 +1064,22 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                         dt_search_paths, matchdevs);
                 MatchOnDevices(&worker);
                 
-                if (dt_order_col >= 0) {
+                if (dt_order_col >= 0 &&
+                        dt_order_column != DevicetrackerColumns::column_none) {
+                    // Sort hot fields straight out of the device columns
+                    kismet__stable_sort(matchvec.begin(), matchvec.end(), 
+                            [&](SharedTrackerElement a, SharedTrackerElement b) {
+                            uint64_t ia = 
+                                ((kis_tracked_device_base *) a.get())->get_kis_internal_id();
+                            uint64_t ib = 
+                                ((kis_tracked_device_base *) b.get())->get_kis_internal_id();
+
+                            if (dt_order_dir == 0)
+                                return device_columns.less(dt_order_column, ia, ib);
+
+                            return device_columns.less(dt_order_column, ib, ia);
+                        });
+                } else if (dt_order_col >= 0) {
                     kismet__stable_sort(matchvec.begin(), matchvec.end(), 
                             [&](SharedTrackerElement a, SharedTrackerElement b) {
                             SharedTrackerElement fa =
@@ -921,9 +1114,60 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                 for (vi = matchvec.begin() + dt_start; vi != ei; ++vi) {
                     SharedTrackerElement simple;
 
-                    SummarizeTrackerElement(entrytracker,
-                            (*vi), summary_vec,
-                            simple, rename_map);
+                    if (!summarize_now) {
+                        outdevs->add_vector(*vi);
+                        continue;
+                    }
+
+                    SummarizeTrackerElement((*vi), summary_plan, simple);
+
+                    outdevs->add_vector(simple);
+                }
+            } else if (dt_order_col >= 0 &&
+                    dt_order_column != DevicetrackerColumns::column_none) {
+                // Sorting the complete list by a mirrored column; slice the page
+                // straight out of the maintained sort index instead of sorting
+                // every device
+                const vector<uint64_t>& index =
+                    device_columns.get_sorted_index(dt_order_column, 
+                            globalreg->timestamp.tv_sec, sort_index_max_age);
+
+                if (dt_start >= index.size())
+                    dt_start = 0;
+
+                if (dt_filter_elem != NULL)
+                    dt_filter_elem->set((uint64_t) index.size());
+
+                size_t dt_end;
+                if (dt_length == 0 ||
+                        dt_length + dt_start >= index.size())
+                    dt_end = index.size();
+                else
+                    dt_end = dt_start + dt_length;
+
+                for (size_t ip = dt_start; ip < dt_end; ip++) {
+                    // The index is ascending, walk it backwards to sort the
+                    // other direction
+                    uint64_t id;
+                    if (dt_order_dir == 0)
+                        id = index[ip];
+                    else
+                        id = index[index.size() - ip - 1];
+
+                    shared_ptr<kis_tracked_device_base> dev = 
+                        immutable_tracked_vec[id];
+
+                    if (dev == NULL)
+                        continue;
+
+                    if (!summarize_now) {
+                        outdevs->add_vector(dev);
+                        continue;
+                    }
+
+                    SharedTrackerElement simple;
+
+                    SummarizeTrackerElement(dev, summary_plan, simple);
 
                     outdevs->add_vector(simple);
                 }
@@ -937,7 +1181,22 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                 if (dt_filter_elem != NULL)
                     dt_filter_elem->set((uint64_t) tracked_vec.size());
 
-                if (dt_order_col >= 0) {
+                if (dt_order_col >= 0 &&
+                        dt_order_column != DevicetrackerColumns::column_none) {
+                    // Sort hot fields straight out of the device columns
+                    kismet__stable_sort(tracked_vec.begin(), tracked_vec.end(), 
+                            [&](SharedTrackerElement a, SharedTrackerElement b) {
+                            uint64_t ia = 
+                                ((kis_tracked_device_base *) a.get())->get_kis_internal_id();
+                            uint64_t ib = 
+                                ((kis_tracked_device_base *) b.get())->get_kis_internal_id();
+
+                            if (dt_order_dir == 0)
+                                return device_columns.less(dt_order_column, ia, ib);
+
+                            return device_columns.less(dt_order_column, ib, ia);
+                        });
+                } else if (dt_order_col >= 0) {
                     kismet__stable_sort(tracked_vec.begin(), tracked_vec.end(), 
                             [&](SharedTrackerElement a, SharedTrackerElement b) {
                             SharedTrackerElement fa =
@@ -965,24 +1224,33 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                 for (vi = tracked_vec.begin() + dt_start; vi != ei; ++vi) {
                     SharedTrackerElement simple;
 
-                    SummarizeTrackerElement(entrytracker,
-                            (*vi), summary_vec,
-                            simple, rename_map);
+                    if (!summarize_now) {
+                        outdevs->add_vector(*vi);
+                        continue;
+                    }
+
+                    SummarizeTrackerElement((*vi), summary_plan, simple);
 
                     outdevs->add_vector(simple);
                 }
             }
 
-            // Apply wrapper if we haven't applied it already
-            if (wrapper_name != "" && wrapper == NULL) {
-                wrapper.reset(new TrackerElement(TrackerMap));
-                wrapper->add_map(outdevs);
-                outdevs->set_local_name(wrapper_name);
-            } else if (wrapper == NULL) {
-                wrapper = outdevs;
+            // Datatables pages are small and wrapped with the page info;
+            // plain lists are serialized once we release the device list
+            if (wrapper == NULL) {
+                TrackerElementVector outvec(outdevs);
+
+                ret_deferred.path = tokenurl[3];
+                ret_deferred.wrapper_key = wrapper_name;
+                ret_deferred.devices.assign(outvec.begin(), outvec.end());
+
+                if (summary_vec.size() != 0)
+                    ret_deferred.summary_plan = summary_plan;
+
+                return 1;
             }
 
-            Httpd_Serialize(tokenurl[3], concls->response_stream, wrapper, &rename_map);
+            Httpd_Serialize(tokenurl[3], concls->response_stream, wrapper);
             return 1;
 
         } else if (tokenurl[2] == "last-time") {
@@ -1024,8 +1292,9 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
 
             wrapper->add_map(updatets);
 
-            // Rename cache generated during simplification
-            TrackerElementSerializer::rename_map rename_map;
+            // Summarization compiled once and applied to each device
+            shared_ptr<TrackerElementSummaryPlan> summary_plan(
+                    new TrackerElementSummaryPlan(entrytracker, summary_vec));
 
             // Create the device vector of all devices, and simplify it
             SharedTrackerElement sourcedevs =
@@ -1050,9 +1319,7 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                     if (vid->get_last_time() > lastts) {
                         SharedTrackerElement simple;
 
-                        SummarizeTrackerElement(entrytracker,
-                                (*vi), summary_vec,
-                                simple, rename_map);
+                        SummarizeTrackerElement((*vi), summary_plan, simple);
 
                         outdevs->add_vector(simple);
                     }
@@ -1064,9 +1331,7 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
                     if ((*vi)->get_last_time() > lastts) {
                         SharedTrackerElement simple;
 
-                        SummarizeTrackerElement(entrytracker,
-                                (*vi), summary_vec,
-                                simple, rename_map);
+                        SummarizeTrackerElement((*vi), summary_plan, simple);
 
                         outdevs->add_vector(simple);
                     }
@@ -1076,7 +1341,7 @@ int Devicetracker::Httpd_PostComplete(Kis_Net_Httpd_Connection *concls) {
             // Put the simplified map in the vector
             wrapper->add_map(outdevs);
 
-            Httpd_Serialize(tokenurl[4], concls->response_stream, wrapper, &rename_map);
+            Httpd_Serialize(tokenurl[4], concls->response_stream, wrapper);
             return MHD_YES;
         }
     }
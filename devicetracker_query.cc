@@ -0,0 +1,564 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <string>
+#include <sstream>
+
+#include "util.h"
+#include "devicetracker.h"
+#include "devicetracker_query.h"
+
+// A compiled constant; we work out every type the value could be compared
+// as up front so evaluation never has to parse anything
+class query_value {
+public:
+    query_value() {
+        num_valid = false;
+        num = 0;
+        mac_valid = false;
+    }
+
+    string str;
+
+    bool num_valid;
+    double num;
+
+    bool mac_valid;
+    mac_addr mac;
+};
+
+class DevicetrackerQuery::query_node {
+public:
+    enum node_type {
+        node_and, node_or, node_not, node_compare, node_range, node_regex
+    };
+
+    enum compare_op {
+        op_eq, op_ne, op_lt, op_le, op_gt, op_ge
+    };
+
+    query_node(node_type in_type) {
+        type = in_type;
+        op = op_eq;
+#ifdef HAVE_LIBPCRE
+        re = NULL;
+        study = NULL;
+#endif
+    }
+
+    ~query_node() {
+#ifdef HAVE_LIBPCRE
+        if (study != NULL)
+            pcre_free(study);
+        if (re != NULL)
+            pcre_free(re);
+#endif
+    }
+
+    bool eval(const SharedTrackerElement& device) const;
+
+    node_type type;
+    compare_op op;
+
+    shared_node left, right;
+
+    // Resolved field path
+    vector<int> path;
+
+    query_value value, value_high;
+
+#ifdef HAVE_LIBPCRE
+    pcre *re;
+    pcre_extra *study;
+#endif
+};
+
+static query_value compile_value(const string& in_str) {
+    query_value v;
+
+    v.str = in_str;
+
+    if (in_str.length() != 0) {
+        char *end;
+        double d = strtod(in_str.c_str(), &end);
+
+        if (*end == '\0') {
+            v.num_valid = true;
+            v.num = d;
+        }
+    }
+
+    if (in_str.find(':') != string::npos) {
+        mac_addr m(in_str);
+
+        if (!m.error) {
+            v.mac_valid = true;
+            v.mac = m;
+        }
+    }
+
+    return v;
+}
+
+// Numeric value of any scalar tracked element
+static bool element_as_double(const SharedTrackerElement& e, double& ret) {
+    switch (e->get_type()) {
+        case TrackerInt8:
+            ret = GetTrackerValue<int8_t>(e);
+            return true;
+        case TrackerUInt8:
+            ret = GetTrackerValue<uint8_t>(e);
+            return true;
+        case TrackerInt16:
+            ret = GetTrackerValue<int16_t>(e);
+            return true;
+        case TrackerUInt16:
+            ret = GetTrackerValue<uint16_t>(e);
+            return true;
+        case TrackerInt32:
+            ret = GetTrackerValue<int32_t>(e);
+            return true;
+        case TrackerUInt32:
+            ret = GetTrackerValue<uint32_t>(e);
+            return true;
+        case TrackerInt64:
+            ret = GetTrackerValue<int64_t>(e);
+            return true;
+        case TrackerUInt64:
+            ret = GetTrackerValue<uint64_t>(e);
+            return true;
+        case TrackerFloat:
+            ret = GetTrackerValue<float>(e);
+            return true;
+        case TrackerDouble:
+            ret = GetTrackerValue<double>(e);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Only uses == and < so it works for mac_addr as well
+template<class T>
+static bool compare_values(DevicetrackerQuery::query_node::compare_op op,
+        const T& a, const T& b) {
+    switch (op) {
+        case DevicetrackerQuery::query_node::op_eq:
+            return a == b;
+        case DevicetrackerQuery::query_node::op_ne:
+            return !(a == b);
+        case DevicetrackerQuery::query_node::op_lt:
+            return a < b;
+        case DevicetrackerQuery::query_node::op_le:
+            return a < b || a == b;
+        case DevicetrackerQuery::query_node::op_gt:
+            return b < a;
+        case DevicetrackerQuery::query_node::op_ge:
+            return !(a < b);
+    }
+
+    return false;
+}
+
+template<class T>
+static bool in_range(const T& v, const T& low, const T& high) {
+    return !(v < low) && (v < high || v == high);
+}
+
+bool DevicetrackerQuery::query_node::eval(const SharedTrackerElement& device) const {
+    if (type == node_and)
+        return left->eval(device) && right->eval(device);
+
+    if (type == node_or)
+        return left->eval(device) || right->eval(device);
+
+    if (type == node_not)
+        return !left->eval(device);
+
+    // Walk the pre-resolved path
+    SharedTrackerElement f = device;
+    for (vector<int>::const_iterator i = path.begin(); i != path.end(); ++i) {
+        f = f->get_map_value(*i);
+
+        if (f == NULL)
+            return false;
+    }
+
+    TrackerType ft = f->get_type();
+
+    if (type == node_regex) {
+#ifdef HAVE_LIBPCRE
+        if (ft != TrackerString)
+            return false;
+
+        const string& s = GetTrackerValue<string>(f);
+        int ovector[128];
+
+        return pcre_exec(re, study, s.c_str(), s.length(), 0, 0, ovector, 128) >= 0;
+#else
+        return false;
+#endif
+    }
+
+    if (ft == TrackerString) {
+        const string& s = GetTrackerValue<string>(f);
+
+        if (type == node_range)
+            return in_range(s, value.str, value_high.str);
+
+        return compare_values(op, s, value.str);
+    }
+
+    if (ft == TrackerMac) {
+        if (!value.mac_valid)
+            return false;
+
+        mac_addr m = GetTrackerValue<mac_addr>(f);
+
+        if (type == node_range)
+            return value_high.mac_valid && in_range(m, value.mac, value_high.mac);
+
+        return compare_values(op, m, value.mac);
+    }
+
+    if (ft == TrackerUuid) {
+        string s = GetTrackerValue<uuid>(f).UUID2String();
+
+        if (type == node_range)
+            return in_range(s, value.str, value_high.str);
+
+        return compare_values(op, s, value.str);
+    }
+
+    double d;
+
+    if (!value.num_valid || !element_as_double(f, d))
+        return false;
+
+    if (type == node_range)
+        return value_high.num_valid && in_range(d, value.num, value_high.num);
+
+    return compare_values(op, d, value.num);
+}
+
+DevicetrackerQuery::DevicetrackerQuery(GlobalRegistry *in_globalreg, string in_query) {
+    globalreg = in_globalreg;
+
+    entrytracker =
+        static_pointer_cast<EntryTracker>(globalreg->FetchGlobal("ENTRY_TRACKER"));
+
+    query = in_query;
+    token_pos = 0;
+
+    tokenize();
+
+    if (tokens.size() == 0)
+        throw std::runtime_error("Empty query");
+
+    root = parse_expr();
+
+    if (token_pos != tokens.size())
+        throw std::runtime_error("Unexpected '" + tokens[token_pos] + "' in query");
+
+    // We don't need the tokens after compiling
+    tokens.clear();
+    token_quoted.clear();
+}
+
+DevicetrackerQuery::~DevicetrackerQuery() {
+
+}
+
+bool DevicetrackerQuery::Match(shared_ptr<kis_tracked_device_base> device) const {
+    SharedTrackerElement e = device;
+    return root->eval(e);
+}
+
+void DevicetrackerQuery::tokenize() {
+    const string special = "()[],!=<>~&|\"'";
+    size_t p = 0;
+
+    while (p < query.length()) {
+        char c = query[p];
+
+        if (isspace(c)) {
+            p++;
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            string s;
+            p++;
+
+            while (p < query.length() && query[p] != c) {
+                if (query[p] == '\\' && p + 1 < query.length())
+                    p++;
+                s += query[p];
+                p++;
+            }
+
+            if (p >= query.length())
+                throw std::runtime_error("Unterminated string in query");
+
+            p++;
+
+            tokens.push_back(s);
+            token_quoted.push_back(true);
+            continue;
+        }
+
+        if (c == '(' || c == ')' || c == '[' || c == ']' || c == ',' || c == '~') {
+            tokens.push_back(string(1, c));
+            token_quoted.push_back(false);
+            p++;
+            continue;
+        }
+
+        if (c == '=' || c == '!' || c == '<' || c == '>') {
+            if (p + 1 < query.length() && query[p + 1] == '=') {
+                tokens.push_back(query.substr(p, 2));
+                p += 2;
+            } else if (c == '=') {
+                // Be forgiving about a single '='
+                tokens.push_back("==");
+                p++;
+            } else {
+                tokens.push_back(string(1, c));
+                p++;
+            }
+
+            token_quoted.push_back(false);
+            continue;
+        }
+
+        if (c == '&' || c == '|') {
+            if (p + 1 >= query.length() || query[p + 1] != c)
+                throw std::runtime_error("Unexpected '" + string(1, c) + "' in query");
+
+            tokens.push_back(query.substr(p, 2));
+            token_quoted.push_back(false);
+            p += 2;
+            continue;
+        }
+
+        size_t start = p;
+        while (p < query.length() && !isspace(query[p]) &&
+                special.find(query[p]) == string::npos)
+            p++;
+
+        tokens.push_back(query.substr(start, p - start));
+        token_quoted.push_back(false);
+    }
+}
+
+bool DevicetrackerQuery::peek(const string& t) {
+    if (token_pos >= tokens.size() || token_quoted[token_pos])
+        return false;
+
+    return StrLower(tokens[token_pos]) == t;
+}
+
+string DevicetrackerQuery::next(const string& in_expected_desc) {
+    if (token_pos >= tokens.size())
+        throw std::runtime_error("Unexpected end of query, expected " +
+                in_expected_desc);
+
+    return tokens[token_pos++];
+}
+
+DevicetrackerQuery::shared_node DevicetrackerQuery::parse_expr() {
+    shared_node n = parse_and();
+
+    while (peek("or") || peek("||")) {
+        token_pos++;
+
+        shared_node o(new query_node(query_node::node_or));
+        o->left = n;
+        o->right = parse_and();
+        n = o;
+    }
+
+    return n;
+}
+
+DevicetrackerQuery::shared_node DevicetrackerQuery::parse_and() {
+    shared_node n = parse_unary();
+
+    while (peek("and") || peek("&&")) {
+        token_pos++;
+
+        shared_node a(new query_node(query_node::node_and));
+        a->left = n;
+        a->right = parse_unary();
+        n = a;
+    }
+
+    return n;
+}
+
+DevicetrackerQuery::shared_node DevicetrackerQuery::parse_unary() {
+    if (peek("not") || peek("!")) {
+        token_pos++;
+
+        shared_node n(new query_node(query_node::node_not));
+        n->left = parse_unary();
+        return n;
+    }
+
+    if (peek("(")) {
+        token_pos++;
+
+        shared_node n = parse_expr();
+
+        if (next("')'") != ")")
+            throw std::runtime_error("Expected ')' in query");
+
+        return n;
+    }
+
+    return parse_predicate();
+}
+
+DevicetrackerQuery::shared_node DevicetrackerQuery::parse_predicate() {
+    bool quoted = token_pos < tokens.size() && token_quoted[token_pos];
+    string field = next("field");
+
+    if (quoted)
+        throw std::runtime_error("Expected field name in query, got string '" +
+                field + "'");
+
+    // Resolve the field path once, now
+    vector<int> path;
+    vector<string> split = StrTokenize(field, "/");
+
+    for (vector<string>::iterator i = split.begin(); i != split.end(); ++i) {
+        if ((*i).length() == 0)
+            continue;
+
+        int id = entrytracker->GetFieldId(*i);
+
+        if (id < 0)
+            throw std::runtime_error("Unknown field '" + *i + "' in query");
+
+        path.push_back(id);
+    }
+
+    if (path.size() == 0)
+        throw std::runtime_error("Expected field name in query, got '" + field + "'");
+
+    if (peek("in")) {
+        token_pos++;
+
+        shared_node n(new query_node(query_node::node_range));
+        n->path = path;
+
+        if (next("'['") != "[")
+            throw std::runtime_error("Expected '[' after 'in' in query");
+
+        n->value = compile_value(next("range start"));
+
+        if (next("','") != ",")
+            throw std::runtime_error("Expected ',' in query range");
+
+        n->value_high = compile_value(next("range end"));
+
+        if (next("']'") != "]")
+            throw std::runtime_error("Expected ']' in query range");
+
+        return n;
+    }
+
+    string op = next("comparison");
+
+    if (op == "~") {
+        shared_node n(new query_node(query_node::node_regex));
+        n->path = path;
+        n->value = compile_value(next("regex"));
+
+#ifdef HAVE_LIBPCRE
+        const char *compile_error, *study_error;
+        int erroroffset;
+        ostringstream errordesc;
+
+        n->re = pcre_compile(n->value.str.c_str(), 0, &compile_error,
+                &erroroffset, NULL);
+
+        if (n->re == NULL) {
+            errordesc << "Could not parse PCRE expression: " << compile_error <<
+                " at character " << erroroffset;
+            throw std::runtime_error(errordesc.str());
+        }
+
+        n->study = pcre_study(n->re, 0, &study_error);
+        if (n->study == NULL && study_error != NULL) {
+            errordesc << "Could not parse PCRE expression, study/optimization "
+                "failure: " << study_error;
+            throw std::runtime_error(errordesc.str());
+        }
+#else
+        throw std::runtime_error("Kismet not compiled with PCRE support");
+#endif
+
+        return n;
+    }
+
+    shared_node n(new query_node(query_node::node_compare));
+    n->path = path;
+
+    if (op == "==")
+        n->op = query_node::op_eq;
+    else if (op == "!=")
+        n->op = query_node::op_ne;
+    else if (op == "<")
+        n->op = query_node::op_lt;
+    else if (op == "<=")
+        n->op = query_node::op_le;
+    else if (op == ">")
+        n->op = query_node::op_gt;
+    else if (op == ">=")
+        n->op = query_node::op_ge;
+    else
+        throw std::runtime_error("Unknown comparison '" + op + "' in query");
+
+    n->value = compile_value(next("value"));
+
+    return n;
+}
+
+devicetracker_query_worker::devicetracker_query_worker(GlobalRegistry *in_globalreg,
+        shared_ptr<DevicetrackerQuery> in_query,
+        SharedTrackerElement in_devvec_object) :
+    DevicetrackerVectorFilterWorker(in_devvec_object) {
+
+    globalreg = in_globalreg;
+    query = in_query;
+}
+
+devicetracker_query_worker::~devicetracker_query_worker() {
+
+}
+
+bool devicetracker_query_worker::MatchFilter(Devicetracker *devicetracker __attribute__((unused)),
+        const shared_ptr<kis_tracked_device_base>& device) {
+    return query->Match(device);
+}
+
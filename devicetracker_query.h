@@ -0,0 +1,115 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICETRACKER_QUERY_H__
+#define __DEVICETRACKER_QUERY_H__
+
+#include "config.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+#ifdef HAVE_LIBPCRE
+#include <pcre.h>
+#endif
+
+#include "globalregistry.h"
+#include "trackedelement.h"
+#include "entrytracker.h"
+#include "macaddr.h"
+#include "devicetracker.h"
+
+// Compiled device filter expression.
+//
+// A query is parsed once into a tree of predicates over pre-resolved field ID
+// paths, and can then be evaluated against any number of devices without any
+// further string handling.  Query syntax:
+//
+//   expr      := and-expr ( ( "or" | "||" ) and-expr )*
+//   and-expr  := unary ( ( "and" | "&&" ) unary )*
+//   unary     := ( "not" | "!" ) unary | "(" expr ")" | predicate
+//   predicate := field op value | field "in" "[" value "," value "]"
+//   op        := "==" | "!=" | "<" | "<=" | ">" | ">=" | "~"
+//
+// Fields are the same paths accepted by the summary API, for example
+// kismet.device.base.signal/kismet.common.signal.last_signal_dbm.  Values may be
+// numbers, MAC addresses with an optional mask (AA:BB:CC:00:00:00/FF:FF:FF:00:00:00),
+// or strings, which may be quoted.  "~" performs a PCRE match on string fields,
+// and "in" is an inclusive range.
+//
+// Compiling THROWS std::runtime_error on any syntax error or unknown field.
+// Once compiled, Match is read-only and may be called from multiple threads.
+class DevicetrackerQuery {
+public:
+    DevicetrackerQuery(GlobalRegistry *in_globalreg, string in_query);
+    ~DevicetrackerQuery();
+
+    bool Match(shared_ptr<kis_tracked_device_base> device) const;
+
+    string get_query() const { return query; }
+
+    class query_node;
+    typedef shared_ptr<query_node> shared_node;
+
+protected:
+    GlobalRegistry *globalreg;
+    shared_ptr<EntryTracker> entrytracker;
+
+    string query;
+    shared_node root;
+
+    // Tokenizer state
+    vector<string> tokens;
+    vector<bool> token_quoted;
+    size_t token_pos;
+
+    void tokenize();
+
+    bool peek(const string& t);
+    string next(const string& in_expected_desc);
+
+    shared_node parse_expr();
+    shared_node parse_and();
+    shared_node parse_unary();
+    shared_node parse_predicate();
+};
+
+// Filter worker which collects every device matching a compiled query into
+// a vector object
+class devicetracker_query_worker : public DevicetrackerVectorFilterWorker {
+public:
+    // in_devvec_object must be a vector object
+    devicetracker_query_worker(GlobalRegistry *in_globalreg,
+            shared_ptr<DevicetrackerQuery> in_query,
+            SharedTrackerElement in_devvec_object);
+
+    virtual ~devicetracker_query_worker();
+
+    virtual bool MatchFilter(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& device);
+
+protected:
+    GlobalRegistry *globalreg;
+
+    shared_ptr<DevicetrackerQuery> query;
+};
+
+#endif
+
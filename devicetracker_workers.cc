@@ -52,11 +52,66 @@
 #include "kismet_json.h"
 #include "base64.h"
 
+DevicetrackerVectorFilterWorker::DevicetrackerVectorFilterWorker(SharedTrackerElement in_devvec_object) {
+    return_dev_vec = in_devvec_object;
+
+    pthread_mutex_init(&worker_mutex, NULL);
+}
+
+DevicetrackerVectorFilterWorker::~DevicetrackerVectorFilterWorker() {
+    pthread_mutex_destroy(&worker_mutex);
+}
+
+void DevicetrackerVectorFilterWorker::PrepareSlots(unsigned int in_slots) {
+    slot_matches.resize(in_slots);
+}
+
+void DevicetrackerVectorFilterWorker::MatchDevice(Devicetracker *devicetracker,
+        const shared_ptr<kis_tracked_device_base>& device) {
+    // Called outside of the pool; lock and append directly
+    if (MatchFilter(devicetracker, device)) {
+        local_locker lock(&worker_mutex);
+        return_dev_vec->add_vector(device);
+    }
+}
+
+void DevicetrackerVectorFilterWorker::MatchDeviceSlot(Devicetracker *devicetracker,
+        const shared_ptr<kis_tracked_device_base>& device, unsigned int in_slot) {
+    if (in_slot >= slot_matches.size()) {
+        MatchDevice(devicetracker, device);
+        return;
+    }
+
+    if (MatchFilter(devicetracker, device))
+        slot_matches[in_slot].push_back(device);
+}
+
+void DevicetrackerVectorFilterWorker::Finalize(Devicetracker *devicetracker __attribute__((unused))) {
+    vector<shared_ptr<kis_tracked_device_base> > merged;
+
+    for (auto& s : slot_matches)
+        merged.insert(merged.end(), s.begin(), s.end());
+
+    slot_matches.clear();
+
+    // Slots complete out of order; put the results back in the order the
+    // devices were seen
+    std::sort(merged.begin(), merged.end(), 
+            [](shared_ptr<kis_tracked_device_base> a, shared_ptr<kis_tracked_device_base> b) {
+                return a->get_kis_internal_id() < b->get_kis_internal_id();
+            });
+
+    local_locker lock(&worker_mutex);
+
+    for (auto d : merged)
+        return_dev_vec->add_vector(d);
+}
 
 devicetracker_stringmatch_worker::devicetracker_stringmatch_worker(GlobalRegistry *in_globalreg,
         string in_query,
         vector<vector<int> > in_paths,
-        SharedTrackerElement in_devvec_object) {
+        SharedTrackerElement in_devvec_object) :
+    DevicetrackerVectorFilterWorker(in_devvec_object) {
 
     globalreg = in_globalreg;
 
@@ -68,18 +123,14 @@ devicetracker_stringmatch_worker::devicetracker_stringmatch_worker(GlobalRegistr
 
     // Preemptively try to compute a mac address partial search term
     mac_addr::PrepareSearchTerm(query, mac_query_term, mac_query_term_len);
-
-    return_dev_vec = in_devvec_object;
-
-    pthread_mutex_init(&worker_mutex, NULL);
 }
 
 devicetracker_stringmatch_worker::~devicetracker_stringmatch_worker() {
-    pthread_mutex_destroy(&worker_mutex);
+
 }
 
-void devicetracker_stringmatch_worker::MatchDevice(Devicetracker *devicetracker __attribute__((unused)),
-        shared_ptr<kis_tracked_device_base> device) {
+bool devicetracker_stringmatch_worker::MatchFilter(Devicetracker *devicetracker __attribute__((unused)),
+        const shared_ptr<kis_tracked_device_base>& device) {
     vector<vector<int> >::iterator i;
 
     bool matched = false;
@@ -101,24 +152,19 @@ void devicetracker_stringmatch_worker::MatchDevice(Devicetracker *devicetracker
                         mac_query_term_len);
         }
 
-        if (matched) {
-            local_locker lock(&worker_mutex);
-            return_dev_vec->add_vector(device);
-            break;
-        }
+        if (matched)
+            return true;
     }
 
-}
-
-void devicetracker_stringmatch_worker::Finalize(Devicetracker *devicetracker __attribute__((unused))) {
-
+    return false;
 }
 
 #ifdef HAVE_LIBPCRE
 
 devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalreg,
         vector<shared_ptr<devicetracker_pcre_worker::pcre_filter> > in_filter_vec,
-        SharedTrackerElement in_devvec_object) {
+        SharedTrackerElement in_devvec_object) :
+    DevicetrackerVectorFilterWorker(in_devvec_object) {
 
     globalreg = in_globalreg;
 
@@ -127,15 +173,12 @@ devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalre
 
     filter_vec = in_filter_vec;
     error = false;
-
-    return_dev_vec = in_devvec_object;
-
-    pthread_mutex_init(&worker_mutex, NULL);
 }
 
 devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalreg,
         SharedStructured raw_pcre_vec,
-        SharedTrackerElement in_devvec_object) {
+        SharedTrackerElement in_devvec_object) :
+    DevicetrackerVectorFilterWorker(in_devvec_object) {
 
     globalreg = in_globalreg;
 
@@ -144,8 +187,6 @@ devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalre
 
     error = false;
 
-    return_dev_vec = in_devvec_object;
-
     // Process a structuredarray of sub-arrays of [target, filter]; throw any 
     // exceptions we encounter
 
@@ -185,14 +226,13 @@ devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalre
 
         filter_vec.push_back(filter);
     }
-
-    pthread_mutex_init(&worker_mutex, NULL);
 }
 
 devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalreg,
         string in_target,
         SharedStructured raw_pcre_vec,
-        SharedTrackerElement in_devvec_object) {
+        SharedTrackerElement in_devvec_object) :
+    DevicetrackerVectorFilterWorker(in_devvec_object) {
 
     globalreg = in_globalreg;
 
@@ -201,8 +241,6 @@ devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalre
 
     error = false;
 
-    return_dev_vec = in_devvec_object;
-
     // Process a structuredarray of sub-arrays of [target, filter]; throw any 
     // exceptions we encounter
 
@@ -237,16 +275,14 @@ devicetracker_pcre_worker::devicetracker_pcre_worker(GlobalRegistry *in_globalre
 
         filter_vec.push_back(filter);
     }
-
-    pthread_mutex_init(&worker_mutex, NULL);
 }
 
 devicetracker_pcre_worker::~devicetracker_pcre_worker() {
-    pthread_mutex_destroy(&worker_mutex);
+
 }
 
-void devicetracker_pcre_worker::MatchDevice(Devicetracker *devicetracker __attribute__((unused)),
-        shared_ptr<kis_tracked_device_base> device) {
+bool devicetracker_pcre_worker::MatchFilter(Devicetracker *devicetracker __attribute__((unused)),
+        const shared_ptr<kis_tracked_device_base>& device) {
     vector<shared_ptr<devicetracker_pcre_worker::pcre_filter> >::iterator i;
 
     bool matched = false;
@@ -281,16 +317,11 @@ void devicetracker_pcre_worker::MatchDevice(Devicetracker *devicetracker __attri
 
         }
 
-        if (matched) {
-            local_locker lock(&worker_mutex);
-            return_dev_vec->add_vector(device);
-        }
+        if (matched)
+            return true;
     }
 
-}
-
-void devicetracker_pcre_worker::Finalize(Devicetracker *devicetracker __attribute__((unused))) {
-
+    return false;
 }
 
 #endif
@@ -35,6 +35,30 @@ EntryTracker::EntryTracker(GlobalRegistry *in_globalreg) :
 	pthread_mutex_init(&entry_mutex, &mutexattr);
 
     next_field_num = 1;
+
+    for (int c = 0; c < max_field_chunks; c++)
+        field_chunks[c] = NULL;
+    max_published_id = 0;
+
+    unknown_field.field_id = -1;
+    unknown_field.field_name = "field.unknown.not.registered";
+    unknown_field.track_type = TrackerUnassigned;
+    unknown_field.json_key = "\"" + unknown_field.field_name + "\"";
+
+    tracked_fields_id =
+        RegisterField("kismet.tracked_fields", TrackerIntMap,
+                "tracked field definitions, by id");
+    tracked_field_id =
+        RegisterField("kismet.tracked_field", TrackerMap, "tracked field definition");
+    tracked_field_id_id =
+        RegisterField("kismet.tracked_field.id", TrackerInt32, "field id");
+    tracked_field_name_id =
+        RegisterField("kismet.tracked_field.name", TrackerString, "field name");
+    tracked_field_type_id =
+        RegisterField("kismet.tracked_field.type", TrackerString, "field type");
+    tracked_field_desc_id =
+        RegisterField("kismet.tracked_field.description", TrackerString,
+                "field description");
 }
 
 EntryTracker::~EntryTracker() {
@@ -42,6 +66,53 @@ EntryTracker::~EntryTracker() {
 
     field_name_map.clear();
     field_id_map.clear();
+
+    for (int c = 0; c < max_field_chunks; c++)
+        delete[] field_chunks[c];
+}
+
+void EntryTracker::publish_field(const shared_ptr<reserved_field>& in_field) {
+    // Escaped the same way JsonAdapter::SanitizeString does
+    string key = MultiReplaceAll(in_field->field_name, "\\", "\\\\");
+    key = MultiReplaceAll(key, "\"", "\\\"");
+    in_field->json_key = "\"" + key + "\"";
+
+    int chunk = in_field->field_id / field_chunk_size;
+
+    if (chunk >= max_field_chunks)
+        return;
+
+    if (field_chunks[chunk] == NULL) {
+        field_chunks[chunk] = new reserved_field *[field_chunk_size];
+        for (int s = 0; s < field_chunk_size; s++)
+            field_chunks[chunk][s] = NULL;
+    }
+
+    field_chunks[chunk][in_field->field_id % field_chunk_size] = in_field.get();
+
+    // Ids are handed out in order under entry_mutex, so this only grows;
+    // the release store makes the slot visible to anyone who sees the id
+    max_published_id.store(in_field->field_id, std::memory_order_release);
+}
+
+EntryTracker::reserved_field *EntryTracker::fetch_published_field(int in_id) {
+    if (in_id < 0 || in_id > max_published_id.load(std::memory_order_acquire))
+        return NULL;
+
+    int chunk = in_id / field_chunk_size;
+
+    if (chunk >= max_field_chunks) {
+        local_locker lock(&entry_mutex);
+
+        id_itr iter = field_id_map.find(in_id);
+
+        if (iter == field_id_map.end())
+            return NULL;
+
+        return iter->second.get();
+    }
+
+    return field_chunks[chunk][in_id % field_chunk_size];
 }
 
 int EntryTracker::RegisterField(string in_name, TrackerType in_type, string in_desc) {
@@ -83,6 +154,8 @@ int EntryTracker::RegisterField(string in_name, TrackerType in_type, string in_d
     field_name_map[mod_name] = definition;
     field_id_map[definition->field_id] = definition;
 
+    publish_field(definition);
+
     return definition->field_id;
 }
 
@@ -122,6 +195,8 @@ int EntryTracker::RegisterField(string in_name, shared_ptr<TrackerElement> in_bu
     // Set the builders ID now that we know it
     definition->builder->set_id(definition->field_id);
 
+    publish_field(definition);
+
     return definition->field_id;
 }
 
@@ -140,15 +215,25 @@ int EntryTracker::GetFieldId(string in_name) {
 }
 
 string EntryTracker::GetFieldName(int in_id) {
-    local_locker lock(&entry_mutex);
+    return GetFieldNameRef(in_id);
+}
 
-    id_itr iter = field_id_map.find(in_id);
+const string& EntryTracker::GetFieldNameRef(int in_id) {
+    reserved_field *definition = fetch_published_field(in_id);
 
-    if (iter == field_id_map.end()) {
-        return "field.unknown.not.registered";
-    }
+    if (definition == NULL)
+        return unknown_field.field_name;
 
-    return iter->second->field_name;
+    return definition->field_name;
+}
+
+const string& EntryTracker::GetFieldJsonKey(int in_id) {
+    reserved_field *definition = fetch_published_field(in_id);
+
+    if (definition == NULL)
+        return unknown_field.json_key;
+
+    return definition->json_key;
 }
 
 shared_ptr<TrackerElement> EntryTracker::RegisterAndGetField(string in_name, 
@@ -163,7 +248,7 @@ shared_ptr<TrackerElement> EntryTracker::RegisterAndGetField(string in_name,
 
     fn = RegisterField(in_name, in_type, in_desc);
 
-    return shared_ptr<TrackerElement>(new TrackerElement(in_type, fn));
+    return AllocTrackedElement<TrackerElement>(in_type, fn);
 }
 
 shared_ptr<TrackerElement> EntryTracker::RegisterAndGetField(string in_name, 
@@ -183,21 +268,16 @@ shared_ptr<TrackerElement> EntryTracker::RegisterAndGetField(string in_name,
 
 
 shared_ptr<TrackerElement> EntryTracker::GetTrackedInstance(int in_id) {
-    local_locker lock(&entry_mutex);
+    // Builders are complete before a field is published and are only read
+    // by clone_type, so this doesn't need the lock either
+    reserved_field *definition = fetch_published_field(in_id);
 
-    id_itr iter = field_id_map.find(in_id);
-
-    if (iter == field_id_map.end()) {
+    if (definition == NULL)
         return NULL;
-    }
-
-    shared_ptr<reserved_field> definition = iter->second;
-
-    definition = iter->second;
 
     if (definition->builder == NULL)
-        return shared_ptr<TrackerElement>(new TrackerElement(definition->track_type, 
-                    definition->field_id));
+        return AllocTrackedElement<TrackerElement>(definition->track_type, 
+                definition->field_id);
     else
         return definition->builder->clone_type(definition->field_id);
 }
@@ -214,11 +294,11 @@ shared_ptr<TrackerElement> EntryTracker::GetTrackedInstance(string in_name) {
         return NULL;
     }
 
-    shared_ptr<reserved_field> definition = iter->second;
+    const shared_ptr<reserved_field>& definition = iter->second;
 
     if (definition->builder == NULL)
-        return shared_ptr<TrackerElement>(new TrackerElement(definition->track_type, 
-                    definition->field_id));
+        return AllocTrackedElement<TrackerElement>(definition->track_type, 
+                definition->field_id);
     else
         return definition->builder->clone_type(definition->field_id);
 }
@@ -230,9 +310,53 @@ bool EntryTracker::Httpd_VerifyPath(const char *path, const char *method) {
     if (strcmp(path, "/system/tracked_fields.html") == 0)
         return true;
 
+    if (Httpd_StripSuffix(path) == "/system/tracked_fields" && Httpd_CanSerialize(path))
+        return true;
+
     return false;
 }
 
+SharedTrackerElement EntryTracker::build_field_schema() {
+    local_locker lock(&entry_mutex);
+
+    SharedTrackerElement fields =
+        AllocTrackedElement<TrackerElement>(TrackerIntMap, tracked_fields_id);
+
+    for (id_itr i = field_id_map.begin(); i != field_id_map.end(); ++i) {
+        SharedTrackerElement field =
+            AllocTrackedElement<TrackerElement>(TrackerMap, tracked_field_id);
+
+        SharedTrackerElement id =
+            AllocTrackedElement<TrackerElement>(TrackerInt32, tracked_field_id_id);
+        id->set((int32_t) i->first);
+        field->add_map(id);
+
+        SharedTrackerElement name =
+            AllocTrackedElement<TrackerElement>(TrackerString, tracked_field_name_id);
+        name->set(i->second->field_name);
+        field->add_map(name);
+
+        // Complex fields report the type of their builder
+        TrackerType type = i->second->track_type;
+        if (i->second->builder != NULL)
+            type = i->second->builder->get_type();
+
+        SharedTrackerElement typestr =
+            AllocTrackedElement<TrackerElement>(TrackerString, tracked_field_type_id);
+        typestr->set(TrackerElement::type_to_string(type));
+        field->add_map(typestr);
+
+        SharedTrackerElement desc =
+            AllocTrackedElement<TrackerElement>(TrackerString, tracked_field_desc_id);
+        desc->set(i->second->field_description);
+        field->add_map(desc);
+
+        fields->add_intmap(i->first, field);
+    }
+
+    return fields;
+}
+
 void EntryTracker::Httpd_CreateStreamResponse(
         Kis_Net_Httpd *httpd __attribute__((unused)),
         Kis_Net_Httpd_Connection *connection __attribute__((unused)),
@@ -279,6 +403,11 @@ void EntryTracker::Httpd_CreateStreamResponse(
         return;
     }
 
+    if (Httpd_StripSuffix(path) == "/system/tracked_fields") {
+        Httpd_Serialize(path, stream, build_field_schema());
+        return;
+    }
+
 }
 
 void EntryTracker::RegisterSerializer(string in_name, 
@@ -320,6 +449,17 @@ bool EntryTracker::CanSerialize(string in_name) {
     return false;
 }
 
+shared_ptr<TrackerElementSerializer> EntryTracker::GetSerializer(string in_name) {
+    local_locker lock(&entry_mutex);
+
+    serial_itr i = serializer_map.find(in_name);
+
+    if (i == serializer_map.end())
+        return NULL;
+
+    return i->second;
+}
+
 bool EntryTracker::Serialize(string in_name, std::stringstream &stream,
         SharedTrackerElement e,
         TrackerElementSerializer::rename_map *name_map) {
@@ -27,6 +27,7 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <atomic>
 
 #include <pthread.h>
 
@@ -79,6 +80,12 @@ public:
     int GetFieldId(string in_name);
     string GetFieldName(int in_id);
 
+    // Lookups by id which don't lock, for serializers; the returned strings
+    // live as long as the tracker.  Unknown ids give a placeholder name.
+    const string& GetFieldNameRef(int in_id);
+    // Field name already escaped and quoted as a JSON string
+    const string& GetFieldJsonKey(int in_id);
+
     // Get a field instance
     // Return: NULL if unknown
     shared_ptr<TrackerElement> GetTrackedInstance(string in_name);
@@ -91,6 +98,10 @@ public:
     bool Serialize(string type, std::stringstream &stream, SharedTrackerElement elem,
             TrackerElementSerializer::rename_map *name_map = NULL);
 
+    // Fetch a serializer, for callers which serialize incrementally; returns
+    // NULL if there is no serializer for the type
+    shared_ptr<TrackerElementSerializer> GetSerializer(string type);
+
     // HTTP api
     virtual bool Httpd_VerifyPath(const char *path, const char *method);
 
@@ -119,8 +130,33 @@ protected:
 
         // Might as well track this for auto-doc
         string field_description;
+
+        // Quoted and escaped name for JSON output
+        string json_key;
     };
 
+    // Fields indexed by id so they can be read without taking entry_mutex.
+    // Slots are written once, under the mutex, before max_published_id is
+    // raised past them and never change afterwards; the table is made of
+    // fixed chunks so it never moves as it grows.  Ids past the end of the
+    // table fall back to the locked map.
+    static const int field_chunk_size = 1024;
+    static const int max_field_chunks = 256;
+    reserved_field **field_chunks[max_field_chunks];
+    std::atomic<int> max_published_id;
+
+    void publish_field(const shared_ptr<reserved_field>& in_field);
+    reserved_field *fetch_published_field(int in_id);
+
+    reserved_field unknown_field;
+
+    // Fields describing the fields, for the schema endpoint
+    int tracked_fields_id, tracked_field_id, tracked_field_id_id,
+        tracked_field_name_id, tracked_field_type_id, tracked_field_desc_id;
+
+    // Map of every field by id, for clients decoding compact output
+    SharedTrackerElement build_field_schema();
+
     map<string, shared_ptr<reserved_field> > field_name_map;
     typedef map<string, shared_ptr<reserved_field> >::iterator name_itr;
 
@@ -275,7 +275,8 @@ kismet_ui.AddDeviceDetail("dot11", "Wi-Fi (802.11)", 0, {
                 field: "dot11.device/dot11.device.wpa_handshake_list",
                 id: "wpa_handshake",
                 filter: function(opts) {
-                    return (opts['data']['dot11.device']['dot11.device.wpa_handshake_list'].length);
+                    return ('dot11.device.wpa_handshake_list' in opts['data']['dot11.device'] &&
+                        opts['data']['dot11.device']['dot11.device.wpa_handshake_list'].length);
                 },
                 groupTitle: "WPA Key Exchange",
 
@@ -321,7 +322,8 @@ kismet_ui.AddDeviceDetail("dot11", "Wi-Fi (802.11)", 0, {
                 id: "advertised_ssid",
 
                 filter: function(opts) {
-                    return (Object.keys(opts['data']['dot11.device']['dot11.device.advertised_ssid_map']).length >= 1);
+                    return ('dot11.device.advertised_ssid_map' in opts['data']['dot11.device'] &&
+                        Object.keys(opts['data']['dot11.device']['dot11.device.advertised_ssid_map']).length >= 1);
                 },
 
                 groupIterate: true,
@@ -421,7 +423,8 @@ kismet_ui.AddDeviceDetail("dot11", "Wi-Fi (802.11)", 0, {
                 id: "client_behavior",
 
                 filter: function(opts) {
-                    return (Object.keys(opts['data']['dot11.device']['dot11.device.client_map']).length >= 1);
+                    return ('dot11.device.client_map' in opts['data']['dot11.device'] &&
+                        Object.keys(opts['data']['dot11.device']['dot11.device.client_map']).length >= 1);
                 },
 
                 groupIterate: true,
@@ -563,7 +566,8 @@ kismet_ui.AddDeviceDetail("dot11", "Wi-Fi (802.11)", 0, {
                 id: "client_list",
 
                 filter: function(opts) {
-                    return (Object.keys(opts['data']['dot11.device']['dot11.device.associated_client_map']).length >= 1);
+                    return ('dot11.device.associated_client_map' in opts['data']['dot11.device'] &&
+                        Object.keys(opts['data']['dot11.device']['dot11.device.associated_client_map']).length >= 1);
                 },
 
                 groupIterate: true,
@@ -19,6 +19,7 @@
 #include "config.hpp"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <list>
 #include <map>
@@ -35,17 +36,232 @@
 #include "json_adapter.h"
 
 
+// JSON output is built in a plain string buffer; these append to the end of
+// it without going through iostreams or building temporary strings
+
+static const char json_hex_upper[] = "0123456789ABCDEF";
+static const char json_hex_lower[] = "0123456789abcdef";
+
+// Append a string with JSON escaping, in one pass.  Runs of characters which
+// don't need escaping are copied as a block.
+static void json_append_escaped(string &buf, const char *in, size_t len) {
+    size_t run = 0;
+
+    for (size_t x = 0; x < len; x++) {
+        unsigned char c = (unsigned char) in[x];
+
+        if (c != '"' && c != '\\' && c >= 0x20)
+            continue;
+
+        buf.append(in + run, x - run);
+        run = x + 1;
+
+        switch (c) {
+            case '"':
+                buf.append("\\\"", 2);
+                break;
+            case '\\':
+                buf.append("\\\\", 2);
+                break;
+            case '\n':
+                buf.append("\\n", 2);
+                break;
+            case '\r':
+                buf.append("\\r", 2);
+                break;
+            case '\t':
+                buf.append("\\t", 2);
+                break;
+            default:
+                // Remaining control characters aren't legal in a JSON string
+                buf.append("\\u00", 4);
+                buf.push_back(json_hex_lower[c >> 4]);
+                buf.push_back(json_hex_lower[c & 0xF]);
+                break;
+        }
+    }
+
+    buf.append(in + run, len - run);
+}
+
+static void json_append_string(string &buf, const string &in) {
+    buf.push_back('"');
+    json_append_escaped(buf, in.data(), in.length());
+    buf.push_back('"');
+}
+
+static void json_append_uint(string &buf, uint64_t v) {
+    char tmp[20];
+    int pos = 20;
+
+    do {
+        tmp[--pos] = '0' + (v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    buf.append(tmp + pos, 20 - pos);
+}
+
+static void json_append_int(string &buf, int64_t v) {
+    if (v < 0) {
+        buf.push_back('-');
+        // Negate as unsigned so INT64_MIN doesn't overflow
+        json_append_uint(buf, 0 - (uint64_t) v);
+    } else {
+        json_append_uint(buf, (uint64_t) v);
+    }
+}
+
+// Shortest representation which reads back as the same value; most values
+// are found at the first precision tried
+static void json_append_double(string &buf, double v) {
+    char tmp[32];
+    int len = 0;
+
+    for (int prec = 15; prec <= 17; prec++) {
+        len = snprintf(tmp, sizeof(tmp), "%.*g", prec, v);
+
+        if (strtod(tmp, NULL) == v)
+            break;
+    }
+
+    buf.append(tmp, len);
+}
+
+static void json_append_float(string &buf, float v) {
+    char tmp[32];
+    int len = 0;
+
+    for (int prec = 6; prec <= 9; prec++) {
+        len = snprintf(tmp, sizeof(tmp), "%.*g", prec, (double) v);
+
+        if (strtof(tmp, NULL) == v)
+            break;
+    }
+
+    buf.append(tmp, len);
+}
+
+// 6 bytes as AA:BB:CC:DD:EE:FF, the same as mac_addr::Mac2String
+static void json_append_mac_bytes(string &buf, uint64_t v) {
+    for (int x = 0; x < MAC_LEN_MAX; x++) {
+        uint8_t b = (uint8_t) (v >> ((MAC_LEN_MAX - x - 1) * 8));
+
+        if (x != 0)
+            buf.push_back(':');
+
+        buf.push_back(json_hex_upper[b >> 4]);
+        buf.push_back(json_hex_upper[b & 0xF]);
+    }
+}
+
+static void json_append_hex_bytes(string &buf, const uint8_t *in, size_t len,
+        const char *hexchars) {
+    for (size_t x = 0; x < len; x++) {
+        buf.push_back(hexchars[in[x] >> 4]);
+        buf.push_back(hexchars[in[x] & 0xF]);
+    }
+}
+
+// Same layout as uuid::UUID2String
+static void json_append_uuid(string &buf, const uuid &u) {
+    uint32_t tl = *(u.time_low);
+    uint16_t words[3] = { *(u.time_mid), *(u.time_hi), *(u.clock_seq) };
+
+    for (int s = 28; s >= 0; s -= 4)
+        buf.push_back(json_hex_lower[(tl >> s) & 0xF]);
+
+    for (int w = 0; w < 3; w++) {
+        buf.push_back('-');
+        for (int s = 12; s >= 0; s -= 4)
+            buf.push_back(json_hex_lower[(words[w] >> s) & 0xF]);
+    }
+
+    buf.push_back('-');
+    json_append_hex_bytes(buf, u.node, 6, json_hex_lower);
+}
+
+// Compact keys are the field id, quoted since json keys must be strings
+static void json_append_field_id(string &buf, int id) {
+    buf.push_back('"');
+    json_append_int(buf, id);
+    buf.push_back('"');
+}
+
+// Write a record projected through a summary plan straight from the record,
+// the same as the simplified map SummarizeTrackerElement would have built
+static void json_pack_summary(GlobalRegistry *globalreg, string &buf,
+        const SharedTrackerElement& in_elem, const TrackerElementSummaryPlan& in_plan,
+        TrackerElementSerializer::rename_map *name_map, bool compact) {
+    vector<TrackerElementSummaryPlan::resolved_field> resolved;
+
+    in_plan.resolve(in_elem, resolved);
+
+    buf.push_back('{');
+
+    for (size_t x = 0; x < resolved.size(); x++) {
+        const TrackerElementSummaryPlan::resolved_field &r = resolved[x];
+
+        if (x != 0)
+            buf.push_back(',');
+
+        if (r.elem == NULL) {
+            // Fields the record doesn't have are sent as 0
+            json_append_string(buf, r.plan_field->missing_name);
+            buf.append(": 0", 3);
+            continue;
+        }
+
+        if (r.plan_field->rename.length() != 0)
+            json_append_string(buf, r.plan_field->rename);
+        else if (r.elem->get_local_name() != "")
+            json_append_string(buf, r.elem->get_local_name());
+        else if (compact)
+            json_append_field_id(buf, r.elem->get_id());
+        else
+            buf.append(globalreg->entrytracker->GetFieldJsonKey(r.elem->get_id()));
+
+        buf.append(": ", 2);
+
+        JsonAdapter::PackBuffer(globalreg, buf, r.elem, name_map, compact);
+    }
+
+    buf.push_back('}');
+}
+
 string JsonAdapter::SanitizeString(string in) {
-    string itr = MultiReplaceAll(in, "\\", "\\\\");
-    itr = MultiReplaceAll(itr, "\"", "\\\"");
-    return itr;
+    string r;
+    r.reserve(in.length());
+    json_append_escaped(r, in.data(), in.length());
+    return r;
 }
 
 void JsonAdapter::Pack(GlobalRegistry *globalreg, std::stringstream &stream,
-    SharedTrackerElement e, TrackerElementSerializer::rename_map *name_map) {
+    const SharedTrackerElement& e, TrackerElementSerializer::rename_map *name_map,
+    bool compact) {
+
+    string buf;
+    buf.reserve(4096);
+
+    PackBuffer(globalreg, buf, e, name_map, compact);
+
+    stream.write(buf.data(), buf.length());
+}
+
+void JsonAdapter::PackBuffer(GlobalRegistry *globalreg, string &buf,
+    const SharedTrackerElement& e, TrackerElementSerializer::rename_map *name_map,
+    bool compact) {
 
     if (e == NULL) {
-        stream << "0";
+        buf.push_back('0');
+        return;
+    }
+
+    TrackerElementSummaryRef *summary_ref = e->get_summary_ref();
+
+    if (summary_ref != NULL) {
+        json_pack_summary(globalreg, buf, summary_ref->get_summarized_element(),
+                *(summary_ref->get_plan()), name_map, compact);
         return;
     }
 
@@ -63,6 +279,7 @@ void JsonAdapter::Pack(GlobalRegistry *globalreg, std::stringstream &stream,
     }
 
     TrackerElement::tracked_vector *tvec;
+    TrackerElement::tracked_int64_vector *tint64vec;
     TrackerElement::vector_iterator vec_iter;
 
     TrackerElement::tracked_map *tmap;
@@ -81,72 +298,86 @@ void JsonAdapter::Pack(GlobalRegistry *globalreg, std::stringstream &stream,
     TrackerElement::double_map_iterator double_map_iter;
 
     mac_addr mac;
-    uuid euuid;
 
     string tname;
 
     shared_ptr<uint8_t> bytes;
 
-    size_t sz;
-    ios::fmtflags fflags;
+    char fmt[64];
+    int fmt_len;
 
     switch (e->get_type()) {
         case TrackerString:
-            stream << "\"" << SanitizeString(GetTrackerValue<string>(e)) << "\"";
+            json_append_string(buf, e->get_string_ref());
             break;
         case TrackerInt8:
-            stream << (int) GetTrackerValue<int8_t>(e);
+            json_append_int(buf, GetTrackerValue<int8_t>(e));
             break;
         case TrackerUInt8:
-            stream << (unsigned int) GetTrackerValue<uint8_t>(e);
+            json_append_uint(buf, GetTrackerValue<uint8_t>(e));
             break;
         case TrackerInt16:
-            stream << (int) GetTrackerValue<int16_t>(e);
+            json_append_int(buf, GetTrackerValue<int16_t>(e));
             break;
         case TrackerUInt16:
-            stream << (unsigned int) GetTrackerValue<uint16_t>(e);
+            json_append_uint(buf, GetTrackerValue<uint16_t>(e));
             break;
         case TrackerInt32:
-            stream << GetTrackerValue<int32_t>(e);
+            json_append_int(buf, GetTrackerValue<int32_t>(e));
             break;
         case TrackerUInt32:
-            stream << GetTrackerValue<uint32_t>(e);
+            json_append_uint(buf, GetTrackerValue<uint32_t>(e));
             break;
         case TrackerInt64:
-            stream << GetTrackerValue<int64_t>(e);
+            json_append_int(buf, GetTrackerValue<int64_t>(e));
             break;
         case TrackerUInt64:
-            stream << GetTrackerValue<uint64_t>(e);
+            json_append_uint(buf, GetTrackerValue<uint64_t>(e));
             break;
         case TrackerFloat:
-            stream << fixed << GetTrackerValue<float>(e);
+            json_append_float(buf, GetTrackerValue<float>(e));
             break;
         case TrackerDouble:
-            stream << fixed << GetTrackerValue<double>(e);
+            json_append_double(buf, GetTrackerValue<double>(e));
             break;
         case TrackerMac:
             mac = GetTrackerValue<mac_addr>(e);
             // Mac is quoted as a string value
-            stream << "\"" << mac.MacFull2String() << "\"";
+            buf.push_back('"');
+            json_append_mac_bytes(buf, mac.longmac);
+            buf.push_back('/');
+            json_append_mac_bytes(buf, mac.longmask);
+            buf.push_back('"');
             break;
         case TrackerUuid:
-            euuid = GetTrackerValue<uuid>(e);
             // UUID is quoted as a string value
-            stream << "\"" << euuid.UUID2String() << "\"";
+            buf.push_back('"');
+            json_append_uuid(buf, GetTrackerValue<uuid>(e));
+            buf.push_back('"');
             break;
         case TrackerVector:
             tvec = e->get_vector();
-            stream << "[";
+            buf.push_back('[');
             for (vec_iter = tvec->begin(); vec_iter != tvec->end(); /* */ ) {
-                JsonAdapter::Pack(globalreg, stream, *vec_iter, name_map);
+                JsonAdapter::PackBuffer(globalreg, buf, *vec_iter, name_map, compact);
                 if (++vec_iter != tvec->end())
-                    stream << ",";
+                    buf.push_back(',');
+            }
+            buf.push_back(']');
+            break;
+        case TrackerInt64Vector:
+            tint64vec = e->get_int64_vector();
+            buf.push_back('[');
+            for (size_t x = 0; x < tint64vec->size(); x++) {
+                if (x != 0)
+                    buf.push_back(',');
+                json_append_int(buf, (*tint64vec)[x]);
             }
-            stream << "]";
+            buf.push_back(']');
             break;
         case TrackerMap:
             tmap = e->get_map();
-            stream << "{";
+            buf.push_back('{');
             for (map_iter = tmap->begin(); map_iter != tmap->end(); /* */) {
                 bool named = false;
 
@@ -159,90 +390,88 @@ void JsonAdapter::Pack(GlobalRegistry *globalreg, std::stringstream &stream,
                     }
                 }
 
-                if (!named) {
-                    if (map_iter->second == NULL) {
-                        tname = globalreg->entrytracker->GetFieldName(map_iter->first);
-                    } else {
-                        if ((tname = map_iter->second->get_local_name()) == "")
-                            tname = 
-                                globalreg->entrytracker->GetFieldName(map_iter->first);
-                    }
-                }
-
-                tname = SanitizeString(tname);
+                if (!named && map_iter->second != NULL &&
+                        (tname = map_iter->second->get_local_name()) != "")
+                    named = true;
 
-                stream << "\"" << 
-                    tname <<
-                    "\": ";
-                JsonAdapter::Pack(globalreg, stream, map_iter->second, name_map);
+                // Registered names come pre-escaped from the entry tracker
+                if (named)
+                    json_append_string(buf, tname);
+                else if (compact)
+                    json_append_field_id(buf, map_iter->first);
+                else
+                    buf.append(globalreg->entrytracker->GetFieldJsonKey(map_iter->first));
+                buf.append(": ", 2);
+                JsonAdapter::PackBuffer(globalreg, buf, map_iter->second, name_map, compact);
                 if (++map_iter != tmap->end()) // Increment iter in loop
-                    stream << ",";
+                    buf.push_back(',');
             }
-            stream << "}";
+            buf.push_back('}');
             break;
         case TrackerIntMap:
             tintmap = e->get_intmap();
-            stream << "{";
+            buf.push_back('{');
             for (int_map_iter = tintmap->begin(); int_map_iter != tintmap->end(); /* */) {
                 // Integer dictionary keys in json are still quoted as strings
-                stream << "\"" << int_map_iter->first << "\": ";
-                JsonAdapter::Pack(globalreg, stream, int_map_iter->second, name_map);
+                buf.push_back('"');
+                json_append_int(buf, int_map_iter->first);
+                buf.append("\": ", 3);
+                JsonAdapter::PackBuffer(globalreg, buf, int_map_iter->second, name_map, compact);
                 if (++int_map_iter != tintmap->end()) // Increment iter in loop
-                    stream << ",";
+                    buf.push_back(',');
             }
-            stream << "}";
+            buf.push_back('}');
             break;
         case TrackerMacMap:
             tmacmap = e->get_macmap();
-            stream << "{";
+            buf.push_back('{');
             for (mac_map_iter = tmacmap->begin(); 
                     mac_map_iter != tmacmap->end(); /* */) {
                 // Mac keys are strings and we push only the mac not the mask */
-                stream << "\"" << mac_map_iter->first.Mac2String() << "\": ";
-                JsonAdapter::Pack(globalreg, stream, mac_map_iter->second, name_map);
+                buf.push_back('"');
+                json_append_mac_bytes(buf, mac_map_iter->first.longmac);
+                buf.append("\": ", 3);
+                JsonAdapter::PackBuffer(globalreg, buf, mac_map_iter->second, name_map, compact);
                 if (++mac_map_iter != tmacmap->end())
-                    stream << ",";
+                    buf.push_back(',');
             }
-            stream << "}";
+            buf.push_back('}');
             break;
         case TrackerStringMap:
             tstringmap = e->get_stringmap();
-            stream << "{";
+            buf.push_back('{');
             for (string_map_iter = tstringmap->begin();
                     string_map_iter != tstringmap->end(); /* */) {
-                stream << "\"" << string_map_iter->first << "\": ";
-                JsonAdapter::Pack(globalreg, stream, string_map_iter->second, name_map);
+                json_append_string(buf, string_map_iter->first);
+                buf.append(": ", 2);
+                JsonAdapter::PackBuffer(globalreg, buf, string_map_iter->second, name_map, compact);
                 if (++string_map_iter != tstringmap->end())
-                    stream << ",";
+                    buf.push_back(',');
             }
-            stream << "}";
+            buf.push_back('}');
             break;
         case TrackerDoubleMap:
             tdoublemap = e->get_doublemap();
-            stream << "{";
+            buf.push_back('{');
             for (double_map_iter = tdoublemap->begin();
                     double_map_iter != tdoublemap->end(); /* */) {
-                // Double keys are handled as strings in json
-                stream << "\"" << fixed << double_map_iter->first << "\": ";
-                JsonAdapter::Pack(globalreg, stream, double_map_iter->second, name_map);
+                // Double keys are handled as strings in json; clients look
+                // them up by the string, so they keep the fixed format
+                fmt_len = snprintf(fmt, sizeof(fmt), "\"%f\": ", double_map_iter->first);
+                buf.append(fmt, fmt_len);
+                JsonAdapter::PackBuffer(globalreg, buf, double_map_iter->second, name_map, compact);
                 if (++double_map_iter != tdoublemap->end())
-                    stream << ",";
+                    buf.push_back(',');
             }
-            stream << "}";
+            buf.push_back('}');
             break;
         case TrackerByteArray:
             bytes = e->get_bytearray();
-            sz = e->get_bytearray_size();
-           
-            fflags = stream.flags();
-
-            stream << "\"";
-            for (size_t szx = 0; szx < sz; szx++) {
-                stream << std::uppercase << std::setfill('0') << std::setw(2) 
-                    << std::hex << (int) (bytes.get()[szx] & 0xFF);
-            }
-            stream << "\"";
-            stream.flags(fflags);
+
+            buf.push_back('"');
+            json_append_hex_bytes(buf, bytes.get(), e->get_bytearray_size(), 
+                    json_hex_upper);
+            buf.push_back('"');
 
             break;
 
@@ -251,3 +480,42 @@ void JsonAdapter::Pack(GlobalRegistry *globalreg, std::stringstream &stream,
             break;
     }
 }
+
+void JsonAdapter::Serializer::serialize_vector_open(std::stringstream &stream,
+        size_t in_count __attribute__((unused)), const string& in_wrapper_key) {
+    if (in_wrapper_key != "")
+        stream << "{\"" << SanitizeString(in_wrapper_key) << "\": ";
+
+    stream << "[";
+}
+
+void JsonAdapter::Serializer::serialize_vector_element(std::stringstream &stream,
+        size_t in_index, const SharedTrackerElement& in_elem, rename_map *name_map) {
+    if (in_index != 0)
+        stream << ",";
+
+    Pack(globalreg, stream, in_elem, name_map, compact);
+}
+
+void JsonAdapter::Serializer::serialize_vector_summary(std::stringstream &stream,
+        size_t in_index, const SharedTrackerElement& in_elem,
+        const shared_ptr<TrackerElementSummaryPlan>& in_plan) {
+    string buf;
+    buf.reserve(1024);
+
+    if (in_index != 0)
+        buf.push_back(',');
+
+    json_pack_summary(globalreg, buf, in_elem, *in_plan, NULL, compact);
+
+    stream.write(buf.data(), buf.length());
+}
+
+void JsonAdapter::Serializer::serialize_vector_close(std::stringstream &stream,
+        const string& in_wrapper_key) {
+    stream << "]";
+
+    if (in_wrapper_key != "")
+        stream << "}";
+}
+
@@ -28,20 +28,47 @@
 
 namespace JsonAdapter {
 
-void Pack(GlobalRegistry *globalreg, std::stringstream &stream, SharedTrackerElement e,
-        TrackerElementSerializer::rename_map *name_map = NULL);
+// In compact mode, tracked fields are keyed by their field ID (as a string,
+// since JSON keys must be) instead of their name; fields with a local name
+// or a summary rename keep the name
+void Pack(GlobalRegistry *globalreg, std::stringstream &stream, 
+        const SharedTrackerElement& e,
+        TrackerElementSerializer::rename_map *name_map = NULL,
+        bool compact = false);
+
+// Append the JSON for an element to a string buffer
+void PackBuffer(GlobalRegistry *globalreg, string &buf,
+        const SharedTrackerElement& e,
+        TrackerElementSerializer::rename_map *name_map = NULL,
+        bool compact = false);
 
 string SanitizeString(string in);
 
 class Serializer : public TrackerElementSerializer {
 public:
-    Serializer(GlobalRegistry *in_globalreg) :
-        TrackerElementSerializer(in_globalreg) { }
+    Serializer(GlobalRegistry *in_globalreg, bool in_compact = false) :
+        TrackerElementSerializer(in_globalreg),
+        compact(in_compact) { }
 
-    virtual void serialize(SharedTrackerElement in_elem, std::stringstream &stream,
+    virtual void serialize(const SharedTrackerElement& in_elem, std::stringstream &stream,
             rename_map *name_map = NULL) {
-        Pack(globalreg, stream, in_elem, name_map);
+        Pack(globalreg, stream, in_elem, name_map, compact);
     }
+
+    virtual bool can_stream_vector() { return true; }
+
+    virtual void serialize_vector_open(std::stringstream &stream, size_t in_count,
+            const string& in_wrapper_key);
+    virtual void serialize_vector_element(std::stringstream &stream, size_t in_index,
+            const SharedTrackerElement& in_elem, rename_map *name_map = NULL);
+    virtual void serialize_vector_summary(std::stringstream &stream, size_t in_index,
+            const SharedTrackerElement& in_elem,
+            const shared_ptr<TrackerElementSummaryPlan>& in_plan);
+    virtual void serialize_vector_close(std::stringstream &stream,
+            const string& in_wrapper_key);
+
+protected:
+    bool compact;
 };
 
 }
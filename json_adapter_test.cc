@@ -0,0 +1,287 @@
+/* test harness for compact JSON summaries
+ *
+ * Summarizes records holding nested vectors and maps, and sends them through
+ * the normal and the compact JSON serializers, both streamed the way the
+ * device list endpoints do and packed whole.  The two documents must hold
+ * the same values; tracked fields must be keyed by their quoted field ID in
+ * the compact one, and renamed, local-named and missing fields by the same
+ * name in both.
+ *
+ * # build kismet
+ * make
+ *
+ * # build test harness
+ * g++ -o json_adapter_test.o -c json_adapter_test.cc
+ * g++ -o json_adapter_test json_adapter_test.o \
+ *      $(filter-out kismet_server.o, $(PSO)) $(LIBS)
+ *
+ * ./json_adapter_test
+ *
+ */
+
+#include "config.hpp"
+
+#include <stdio.h>
+#include <sstream>
+#include <set>
+
+#include "globalregistry.h"
+#include "entrytracker.h"
+#include "trackedelement.h"
+#include "json_adapter.h"
+#include "kismet_json.h"
+#include "kis_net_microhttpd.h"
+
+static int failures = 0;
+
+#define CHECK(c) \
+    do { \
+        if (!(c)) { \
+            fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); \
+            failures++; \
+        } \
+    } while (0)
+
+static EntryTracker *tracker;
+
+// Keys which are names in both documents
+static std::set<string> named_keys;
+
+static SharedTrackerElement new_field(const string& in_name, TrackerType in_type) {
+    return SharedTrackerElement(new TrackerElement(in_type,
+                tracker->GetFieldId(in_name)));
+}
+
+// A record with vectors of maps holding vectors, maps of maps, and an int map
+// of maps
+static SharedTrackerElement build_record(int in_num) {
+    SharedTrackerElement rec = new_field("test.record", TrackerMap);
+
+    SharedTrackerElement name = new_field("test.name", TrackerString);
+    name->set("record " + IntToString(in_num));
+    rec->add_map(name);
+
+    SharedTrackerElement list = new_field("test.list", TrackerVector);
+    rec->add_map(list);
+
+    for (int e = 0; e < 3; e++) {
+        SharedTrackerElement entry = new_field("test.entry", TrackerMap);
+
+        SharedTrackerElement value = new_field("test.entry.value", TrackerUInt64);
+        value->set((uint64_t) (in_num * 100 + e));
+        entry->add_map(value);
+
+        SharedTrackerElement tags = new_field("test.entry.tags", TrackerVector);
+        for (int t = 0; t < e; t++) {
+            SharedTrackerElement tag = new_field("test.tag", TrackerString);
+            tag->set("tag " + IntToString(t));
+            tags->add_vector(tag);
+        }
+        entry->add_map(tags);
+
+        // Local names are kept in compact mode
+        SharedTrackerElement custom = new_field("test.entry.value", TrackerInt32);
+        custom->set((int32_t) -e);
+        custom->set_local_name("custom");
+        entry->add_map(custom);
+
+        list->add_vector(entry);
+    }
+
+    SharedTrackerElement sub = new_field("test.sub", TrackerMap);
+    SharedTrackerElement inner = new_field("test.sub.inner", TrackerMap);
+    SharedTrackerElement inner_value = new_field("test.sub.inner.value", TrackerDouble);
+    inner_value->set((double) in_num + 0.5);
+    inner->add_map(inner_value);
+    sub->add_map(inner);
+    rec->add_map(sub);
+
+    SharedTrackerElement intmap = new_field("test.intmap", TrackerIntMap);
+    for (int k = 0; k < 2; k++) {
+        SharedTrackerElement entry = new_field("test.entry", TrackerMap);
+        SharedTrackerElement value = new_field("test.entry.value", TrackerUInt64);
+        value->set((uint64_t) k);
+        entry->add_map(value);
+        intmap->add_intmap(k * 10, entry);
+    }
+    rec->add_map(intmap);
+
+    return rec;
+}
+
+// Walk the normal and compact documents together
+static void compare_json(struct JSON_value *normal, struct JSON_value *compact,
+        const string& in_path) {
+    CHECK(normal->value.tok_type == compact->value.tok_type);
+
+    if (normal->value.tok_type != compact->value.tok_type) {
+        fprintf(stderr, "    at %s\n", in_path.c_str());
+        return;
+    }
+
+    if (normal->value.tok_type == JSON_start) {
+        CHECK(normal->value_map.size() == compact->value_map.size());
+
+        for (map<string, struct JSON_value *>::iterator i = normal->value_map.begin();
+                i != normal->value_map.end(); ++i) {
+            string key = i->first;
+            int id = tracker->GetFieldId(i->first);
+
+            // Int map keys and names are the same in both; tracked fields are
+            // keyed by ID
+            if (id >= 0 && named_keys.find(i->first) == named_keys.end())
+                key = IntToString(id);
+
+            map<string, struct JSON_value *>::iterator ci =
+                compact->value_map.find(key);
+
+            CHECK(ci != compact->value_map.end());
+
+            if (ci == compact->value_map.end()) {
+                fprintf(stderr, "    no %s at %s\n", key.c_str(), in_path.c_str());
+                continue;
+            }
+
+            compare_json(i->second, ci->second, in_path + "/" + i->first);
+        }
+    } else if (normal->value.tok_type == JSON_arrstart) {
+        CHECK(normal->value_array.size() == compact->value_array.size());
+
+        for (unsigned int x = 0; x < normal->value_array.size() &&
+                x < compact->value_array.size(); x++)
+            compare_json(normal->value_array[x], compact->value_array[x],
+                    in_path + "[" + IntToString(x) + "]");
+    } else {
+        CHECK(normal->value.tok_str == compact->value.tok_str);
+    }
+}
+
+static void compare_documents(const string& normal, const string& compact) {
+    string err;
+
+    struct JSON_value *nj = JSON_parse(normal, err);
+    CHECK(nj != NULL && err.length() == 0);
+
+    struct JSON_value *cj = JSON_parse(compact, err);
+    CHECK(cj != NULL && err.length() == 0);
+
+    if (nj != NULL && cj != NULL)
+        compare_json(nj, cj, "");
+
+    // No field names left in the compact document, and the IDs are quoted
+    CHECK(compact.find("\"test.") == string::npos);
+    CHECK(compact.find("\"" + IntToString(tracker->GetFieldId("test.entry.value")) +
+                "\": ") != string::npos);
+    CHECK(compact.find("\"" + IntToString(tracker->GetFieldId("test.sub.inner")) +
+                "\": ") != string::npos);
+
+    // Renamed paths, local names and missing fields keep their names
+    CHECK(normal.find("\"deep\": ") != string::npos);
+    CHECK(compact.find("\"deep\": ") != string::npos);
+    CHECK(compact.find("\"n\": ") != string::npos);
+    CHECK(compact.find("\"custom\": ") != string::npos);
+    CHECK(compact.find("\"test.absent\": 0") == string::npos);
+    CHECK(compact.find("\"absent\": 0") != string::npos);
+
+    if (nj != NULL)
+        JSON_delete(nj);
+    if (cj != NULL)
+        JSON_delete(cj);
+}
+
+static string stream_json(shared_ptr<TrackerElementSerializer> ser,
+        vector<SharedTrackerElement> in_vec,
+        shared_ptr<TrackerElementSummaryPlan> in_plan) {
+    std::stringstream stream;
+
+    Kis_Net_Httpd_Vector_Stream_Generator gen(ser, in_vec, NULL, "records", NULL,
+            in_plan);
+
+    while (gen.Generate(stream))
+        ;
+
+    return stream.str();
+}
+
+int main(void) {
+    GlobalRegistry *globalreg = new GlobalRegistry();
+    shared_ptr<EntryTracker> entrytracker =
+        EntryTracker::create_entrytracker(globalreg);
+    globalreg->entrytracker = entrytracker.get();
+    tracker = entrytracker.get();
+
+    tracker->RegisterField("test.record", TrackerMap, "record");
+    tracker->RegisterField("test.name", TrackerString, "name");
+    tracker->RegisterField("test.list", TrackerVector, "list of entries");
+    tracker->RegisterField("test.entry", TrackerMap, "entry");
+    tracker->RegisterField("test.entry.value", TrackerUInt64, "entry value");
+    tracker->RegisterField("test.entry.tags", TrackerVector, "entry tags");
+    tracker->RegisterField("test.tag", TrackerString, "tag");
+    tracker->RegisterField("test.sub", TrackerMap, "sub map");
+    tracker->RegisterField("test.sub.inner", TrackerMap, "inner map");
+    tracker->RegisterField("test.sub.inner.value", TrackerDouble, "inner value");
+    tracker->RegisterField("test.intmap", TrackerIntMap, "int map of entries");
+    tracker->RegisterField("test.absent", TrackerUInt8, "never present");
+
+    vector<SharedTrackerElement> recs;
+    for (int i = 0; i < 4; i++)
+        recs.push_back(build_record(i));
+
+    vector<SharedElementSummary> summary;
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "test.name", "n", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "test.list", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "test.sub/test.sub.inner", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "test.sub/test.sub.inner/test.sub.inner.value", "deep",
+                    entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "test.intmap", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "test.absent", "absent", entrytracker)));
+
+    named_keys.insert("n");
+    named_keys.insert("deep");
+    named_keys.insert("custom");
+    named_keys.insert("absent");
+    named_keys.insert("records");
+
+    shared_ptr<TrackerElementSummaryPlan> plan(
+            new TrackerElementSummaryPlan(entrytracker, summary));
+
+    shared_ptr<TrackerElementSerializer> normal_ser(
+            new JsonAdapter::Serializer(globalreg));
+    shared_ptr<TrackerElementSerializer> compact_ser(
+            new JsonAdapter::Serializer(globalreg, true));
+
+    // Streamed, as the device list endpoints do
+    string normal = stream_json(normal_ser, recs, plan);
+    string compact = stream_json(compact_ser, recs, plan);
+
+    compare_documents(normal, compact);
+    CHECK(normal.find("\"test.sub.inner\": ") != string::npos);
+    CHECK(normal.find("\"tag 1\"") != string::npos);
+
+    // Packed whole, as a summarized record on its own
+    for (unsigned int i = 0; i < recs.size(); i++) {
+        SharedTrackerElement simple;
+        SummarizeTrackerElement(recs[i], plan, simple);
+
+        std::stringstream ns, cs;
+        JsonAdapter::Pack(globalreg, ns, simple, NULL, false);
+        JsonAdapter::Pack(globalreg, cs, simple, NULL, true);
+
+        compare_documents(ns.str(), cs.str());
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        fprintf(stderr, "normal: %s\ncompact: %s\n", normal.c_str(), compact.c_str());
+        return 1;
+    }
+
+    printf("ok\n");
+    return 0;
+}
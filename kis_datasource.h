@@ -594,7 +594,7 @@ public:
             in_shared_builder __attribute__((unused))) { return NULL; };
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new KisDatasourceBuilder(globalreg, get_id()));
+        return AllocTrackedElement<KisDatasourceBuilder>(globalreg, get_id());
     }
 
     __Proxy(source_type, string, string, string, source_type);
@@ -696,7 +696,7 @@ public:
     virtual ~KisDatasourceInterface() { };
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new KisDatasourceInterface(globalreg, get_id()));
+        return AllocTrackedElement<KisDatasourceInterface>(globalreg, get_id());
     }
 
     __Proxy(interface, string, string, string, interface);
@@ -0,0 +1,142 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_FLAT_MAP_H__
+#define __KIS_FLAT_MAP_H__
+
+#include "config.hpp"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// Sorted-vector map with the subset of the std::map / std::multimap interface
+// the tracked element code uses.
+//
+// Tracked components hold a few dozen fields each, and there are a lot of
+// them; storing the fields in one contiguous array instead of one tree node
+// per field saves an allocation and several pointers per field, and lookups
+// in a small sorted array are faster than chasing tree nodes.
+//
+// Unlike std::map, inserting or erasing invalidates all iterators, and the
+// key in an element is not const (don't change it).
+//
+// When in_multi is true, duplicate keys are allowed and are kept in insertion
+// order, like std::multimap.
+template<class K, class V, bool in_multi = false>
+class kis_flat_map {
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<K, V> value_type;
+    typedef std::vector<value_type> container_type;
+    typedef typename container_type::iterator iterator;
+    typedef typename container_type::const_iterator const_iterator;
+    typedef typename container_type::size_type size_type;
+
+    iterator begin() { return data.begin(); }
+    iterator end() { return data.end(); }
+    const_iterator begin() const { return data.begin(); }
+    const_iterator end() const { return data.end(); }
+
+    size_type size() const { return data.size(); }
+    size_type capacity() const { return data.capacity(); }
+    bool empty() const { return data.empty(); }
+
+    void clear() { data.clear(); }
+    void reserve(size_type n) { data.reserve(n); }
+    void shrink_to_fit() { data.shrink_to_fit(); }
+
+    iterator lower_bound(const K& k) {
+        return std::lower_bound(data.begin(), data.end(), k,
+                [](const value_type& a, const K& b) { return a.first < b; });
+    }
+
+    iterator upper_bound(const K& k) {
+        return std::upper_bound(data.begin(), data.end(), k,
+                [](const K& a, const value_type& b) { return a < b.first; });
+    }
+
+    iterator find(const K& k) {
+        iterator i = lower_bound(k);
+
+        if (i != data.end() && !(k < i->first))
+            return i;
+
+        return data.end();
+    }
+
+    size_type count(const K& k) {
+        return upper_bound(k) - lower_bound(k);
+    }
+
+    // Insert a value; for a non-multi map, an existing key is left untouched
+    // and its position is returned, like std::map::insert
+    iterator insert(const value_type& v) {
+        // Fields are almost always added in increasing order, so check the
+        // end before searching
+        if (data.empty() || data.back().first < v.first ||
+                (in_multi && !(v.first < data.back().first))) {
+            data.push_back(v);
+            return data.end() - 1;
+        }
+
+        if (in_multi)
+            return data.insert(upper_bound(v.first), v);
+
+        iterator i = lower_bound(v.first);
+
+        if (i != data.end() && !(v.first < i->first))
+            return i;
+
+        return data.insert(i, v);
+    }
+
+    iterator emplace(const K& k, const V& v) {
+        return insert(value_type(k, v));
+    }
+
+    V& operator[](const K& k) {
+        iterator i = lower_bound(k);
+
+        if (i != data.end() && !(k < i->first))
+            return i->second;
+
+        return data.insert(i, value_type(k, V()))->second;
+    }
+
+    iterator erase(iterator i) {
+        return data.erase(i);
+    }
+
+    size_type erase(const K& k) {
+        iterator b = lower_bound(k);
+        iterator e = upper_bound(k);
+        size_type n = e - b;
+
+        data.erase(b, e);
+
+        return n;
+    }
+
+protected:
+    container_type data;
+};
+
+#endif
+
@@ -0,0 +1,165 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <pthread.h>
+#include <atomic>
+
+#include "kis_mem_account.h"
+
+// Counters of one thread.  Only the owning thread changes them, with a plain
+// load and store rather than a locked add; readers may see a count a moment
+// out of date, but never a torn one.
+class kis_mem_thread_counters {
+public:
+    kis_mem_thread_counters();
+    ~kis_mem_thread_counters();
+
+    void add(unsigned int in_slot, int64_t in_value) {
+        slots[in_slot].store(slots[in_slot].load(std::memory_order_relaxed) + in_value,
+                std::memory_order_relaxed);
+    }
+
+    std::atomic<int64_t> slots[kis_mem_account::num_slots];
+
+    kis_mem_thread_counters *prev;
+    kis_mem_thread_counters *next;
+};
+
+// Every live thread's counters, and the totals of threads which have exited
+// (or which account after their counters are gone).  Static storage is
+// zero-initialized and the mutex statically initialized before anything can
+// run, so this is safe to use from other static constructors and destructors.
+static pthread_mutex_t counters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static kis_mem_thread_counters *counters_list = NULL;
+static std::atomic<int64_t> retired_slots[kis_mem_account::num_slots];
+
+static thread_local kis_mem_thread_counters thread_counters;
+
+// Set once a thread's counters have been folded into the totals; trivial, so
+// it outlives them
+static thread_local bool thread_counters_gone = false;
+
+kis_mem_thread_counters::kis_mem_thread_counters() {
+    for (unsigned int i = 0; i < kis_mem_account::num_slots; i++)
+        slots[i].store(0, std::memory_order_relaxed);
+
+    pthread_mutex_lock(&counters_mutex);
+
+    prev = NULL;
+    next = counters_list;
+    if (counters_list != NULL)
+        counters_list->prev = this;
+    counters_list = this;
+
+    pthread_mutex_unlock(&counters_mutex);
+}
+
+kis_mem_thread_counters::~kis_mem_thread_counters() {
+    thread_counters_gone = true;
+
+    pthread_mutex_lock(&counters_mutex);
+
+    for (unsigned int i = 0; i < kis_mem_account::num_slots; i++)
+        retired_slots[i].fetch_add(slots[i].load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+
+    if (prev != NULL)
+        prev->next = next;
+    else
+        counters_list = next;
+
+    if (next != NULL)
+        next->prev = prev;
+
+    pthread_mutex_unlock(&counters_mutex);
+}
+
+void kis_mem_account::add_slots(unsigned int in_slot, int64_t in_count,
+        int64_t in_bytes) {
+    if (thread_counters_gone) {
+        retired_slots[in_slot].fetch_add(in_count, std::memory_order_relaxed);
+        retired_slots[in_slot + 1].fetch_add(in_bytes, std::memory_order_relaxed);
+        return;
+    }
+
+    kis_mem_thread_counters& c = thread_counters;
+
+    c.add(in_slot, in_count);
+    c.add(in_slot + 1, in_bytes);
+}
+
+int64_t kis_mem_account::sum_slot(unsigned int in_slot) {
+    pthread_mutex_lock(&counters_mutex);
+
+    int64_t r = retired_slots[in_slot].load(std::memory_order_relaxed);
+
+    for (kis_mem_thread_counters *c = counters_list; c != NULL; c = c->next)
+        r += c->slots[in_slot].load(std::memory_order_relaxed);
+
+    pthread_mutex_unlock(&counters_mutex);
+
+    return r;
+}
+
+void kis_mem_account::add(kis_mem_category in_cat, int64_t in_count,
+        int64_t in_bytes) {
+    add_slots(in_cat * 2, in_count, in_bytes);
+}
+
+void kis_mem_account::add_element(int in_type, int64_t in_count, int64_t in_bytes) {
+    if (in_type < 0 || in_type >= max_element_type)
+        return;
+
+    add_slots((KIS_MEM_MAX_CATEGORY + in_type) * 2, in_count, in_bytes);
+}
+
+int64_t kis_mem_account::get_count(kis_mem_category in_cat) {
+    return sum_slot(in_cat * 2);
+}
+
+int64_t kis_mem_account::get_bytes(kis_mem_category in_cat) {
+    return sum_slot(in_cat * 2 + 1);
+}
+
+int64_t kis_mem_account::get_element_count(int in_type) {
+    return sum_slot((KIS_MEM_MAX_CATEGORY + in_type) * 2);
+}
+
+int64_t kis_mem_account::get_element_bytes(int in_type) {
+    return sum_slot((KIS_MEM_MAX_CATEGORY + in_type) * 2 + 1);
+}
+
+const char *kis_mem_account::category_name(kis_mem_category in_cat) {
+    switch (in_cat) {
+        case KIS_MEM_PACKETCHAIN:
+            return "packetchain";
+        case KIS_MEM_RINGBUF:
+            return "ringbuf";
+        case KIS_MEM_HTTPD:
+            return "httpd";
+        case KIS_MEM_ALERTS:
+            return "alerts";
+        case KIS_MEM_HTTPD_CACHE:
+            return "httpd_cache";
+        default:
+            return "unknown";
+    }
+}
+
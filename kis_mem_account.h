@@ -0,0 +1,71 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_MEM_ACCOUNT_H__
+#define __KIS_MEM_ACCOUNT_H__
+
+#include "config.hpp"
+
+#include <stdint.h>
+
+// Process-wide counters of live objects and approximate bytes, by subsystem
+// and by tracked element type, published in /system/memory.
+//
+// Counters are updated as objects are created and destroyed, which for
+// tracked elements is constantly and from every thread, so each thread keeps
+// its own counters and only the thread itself writes them; reading a counter
+// sums every thread.  Byte counts are estimates of the fixed size of each
+// object, not exact heap use.
+enum kis_mem_category {
+    KIS_MEM_PACKETCHAIN = 0,
+    KIS_MEM_RINGBUF = 1,
+    KIS_MEM_HTTPD = 2,
+    KIS_MEM_ALERTS = 3,
+    KIS_MEM_HTTPD_CACHE = 4,
+    KIS_MEM_MAX_CATEGORY = 5
+};
+
+class kis_mem_account {
+public:
+    // Large enough for every TrackerType
+    static const int max_element_type = 32;
+
+    static void add(kis_mem_category in_cat, int64_t in_count, int64_t in_bytes);
+
+    static void add_element(int in_type, int64_t in_count, int64_t in_bytes);
+
+    // Reading sums the counters of every thread, under a lock
+    static int64_t get_count(kis_mem_category in_cat);
+    static int64_t get_bytes(kis_mem_category in_cat);
+    static int64_t get_element_count(int in_type);
+    static int64_t get_element_bytes(int in_type);
+
+    static const char *category_name(kis_mem_category in_cat);
+
+    // Counter slots: a count and a byte total for each category, then for
+    // each element type
+    static const unsigned int num_slots =
+        (KIS_MEM_MAX_CATEGORY + max_element_type) * 2;
+
+protected:
+    static void add_slots(unsigned int in_slot, int64_t in_count, int64_t in_bytes);
+    static int64_t sum_slot(unsigned int in_slot);
+};
+
+#endif
+
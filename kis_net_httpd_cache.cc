@@ -0,0 +1,198 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <stdio.h>
+
+#include "util.h"
+#include "kis_mem_account.h"
+#include "kis_net_httpd_cache.h"
+
+Kis_Net_Httpd_Object_Cache::Kis_Net_Httpd_Object_Cache() {
+    pthread_mutex_init(&mutex, NULL);
+
+    num_bytes = 0;
+    max_bytes = 0;
+
+    num_hits = 0;
+    num_misses = 0;
+    num_not_modified = 0;
+
+    start_time = time(0);
+}
+
+Kis_Net_Httpd_Object_Cache::~Kis_Net_Httpd_Object_Cache() {
+    {
+        local_locker lock(&mutex);
+
+        while (lru.size() > 0)
+            remove(lru.begin());
+    }
+
+    pthread_mutex_destroy(&mutex);
+}
+
+void Kis_Net_Httpd_Object_Cache::set_max_bytes(size_t in_max) {
+    local_locker lock(&mutex);
+
+    max_bytes = in_max;
+
+    while (num_bytes > max_bytes && lru.size() > 0)
+        remove(--lru.end());
+}
+
+std::string Kis_Net_Httpd_Object_Cache::make_etag(uint64_t in_version,
+        const char *in_variant) {
+    char tag[96];
+
+    if (in_variant != NULL)
+        snprintf(tag, 96, "\"%lx-%llx-%s\"", (unsigned long) start_time,
+                (unsigned long long) in_version, in_variant);
+    else
+        snprintf(tag, 96, "\"%lx-%llx\"", (unsigned long) start_time,
+                (unsigned long long) in_version);
+
+    return std::string(tag);
+}
+
+bool Kis_Net_Httpd_Object_Cache::etag_matches(const std::string& in_header,
+        const std::string& in_etag) {
+    size_t pos = 0;
+
+    // If-None-Match is a comma separated list of tags, or '*'; we never hand
+    // out weak tags, but clients are allowed to send ours back marked weak
+    while (pos < in_header.length()) {
+        size_t end = in_header.find(',', pos);
+
+        if (end == std::string::npos)
+            end = in_header.length();
+
+        size_t s = in_header.find_first_not_of(" \t", pos);
+        size_t e = in_header.find_last_not_of(" \t", end - 1);
+
+        if (s != std::string::npos && s < end && e != std::string::npos && e >= s) {
+            if (in_header.compare(s, 2, "W/") == 0)
+                s += 2;
+
+            if (in_header.compare(s, e - s + 1, "*") == 0 ||
+                    in_header.compare(s, e - s + 1, in_etag) == 0)
+                return true;
+        }
+
+        pos = end + 1;
+    }
+
+    return false;
+}
+
+std::shared_ptr<const std::string> Kis_Net_Httpd_Object_Cache::find(
+        const std::string& in_url, uint64_t in_version) {
+    local_locker lock(&mutex);
+
+    std::unordered_map<std::string, std::list<cache_entry>::iterator>::iterator i =
+        index.find(in_url);
+
+    if (i == index.end()) {
+        num_misses++;
+        return NULL;
+    }
+
+    // An older version will never be wanted again
+    if (i->second->version != in_version) {
+        remove(i->second);
+        num_misses++;
+        return NULL;
+    }
+
+    lru.splice(lru.begin(), lru, i->second);
+
+    num_hits++;
+
+    return lru.front().body;
+}
+
+void Kis_Net_Httpd_Object_Cache::insert(const std::string& in_url,
+        uint64_t in_version, std::shared_ptr<const std::string> in_body) {
+    local_locker lock(&mutex);
+
+    std::unordered_map<std::string, std::list<cache_entry>::iterator>::iterator i =
+        index.find(in_url);
+
+    if (i != index.end()) {
+        // A slower request may finish after a newer version was cached
+        if (i->second->version > in_version)
+            return;
+
+        remove(i->second);
+    }
+
+    cache_entry ce;
+    ce.url = in_url;
+    ce.version = in_version;
+    ce.body = in_body;
+
+    size_t sz = entry_size(ce);
+
+    // Don't let a single huge body flush everything else
+    if (sz > max_bytes / 4)
+        return;
+
+    while (num_bytes + sz > max_bytes && lru.size() > 0)
+        remove(--lru.end());
+
+    lru.push_front(ce);
+    index[in_url] = lru.begin();
+
+    num_bytes += sz;
+    kis_mem_account::add(KIS_MEM_HTTPD_CACHE, 1, sz);
+}
+
+void Kis_Net_Httpd_Object_Cache::count_not_modified() {
+    local_locker lock(&mutex);
+    num_not_modified++;
+}
+
+void Kis_Net_Httpd_Object_Cache::get_stats(size_t *ret_entries, size_t *ret_bytes,
+        uint64_t *ret_hits, uint64_t *ret_misses, uint64_t *ret_not_modified) {
+    local_locker lock(&mutex);
+
+    *ret_entries = lru.size();
+    *ret_bytes = num_bytes;
+    *ret_hits = num_hits;
+    *ret_misses = num_misses;
+    *ret_not_modified = num_not_modified;
+}
+
+size_t Kis_Net_Httpd_Object_Cache::entry_size(const cache_entry& in_entry) {
+    // The body, the URL held by both the entry and the index, and roughly
+    // the list and hash nodes
+    return in_entry.body->length() + (in_entry.url.length() * 2) +
+        sizeof(cache_entry) + 64;
+}
+
+void Kis_Net_Httpd_Object_Cache::remove(std::list<cache_entry>::iterator in_itr) {
+    size_t sz = entry_size(*in_itr);
+
+    num_bytes -= sz;
+    kis_mem_account::add(KIS_MEM_HTTPD_CACHE, -1, -((int64_t) sz));
+
+    index.erase(in_itr->url);
+    lru.erase(in_itr);
+}
+
@@ -0,0 +1,100 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_NET_HTTPD_CACHE_H__
+#define __KIS_NET_HTTPD_CACHE_H__
+
+#include "config.hpp"
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+// Cache of serialized response bodies for endpoints which can report a
+// version for the object behind a URL (such as a device, whose version is
+// bumped whenever it is modified).
+//
+// Bodies are keyed by URL, which already encodes the object, the
+// serialization format, and any sub-path, and are only returned while the
+// version they were generated from is still current.  The same versions are
+// used for ETags, so a client which already has the current version can be
+// answered with a 304 without looking at the object at all.
+//
+// Memory is bounded; the least recently used bodies are discarded first.
+class Kis_Net_Httpd_Object_Cache {
+public:
+    Kis_Net_Httpd_Object_Cache();
+    ~Kis_Net_Httpd_Object_Cache();
+
+    // Maximum bytes of cached bodies; 0 disables caching (ETags still work)
+    void set_max_bytes(size_t in_max);
+
+    // Quoted ETag for an object version.  Versions restart with the server,
+    // so the tag includes the server start time to keep a tag from a
+    // previous run from matching.  Different representations of the same
+    // version (such as compressed ones) need their own variant.
+    std::string make_etag(uint64_t in_version, const char *in_variant = NULL);
+
+    // Does an If-None-Match header value match an ETag
+    static bool etag_matches(const std::string& in_header, const std::string& in_etag);
+
+    // Find the body for a URL generated from the given version; returns NULL
+    // on a miss or if the cached body is from an older version
+    std::shared_ptr<const std::string> find(const std::string& in_url,
+            uint64_t in_version);
+
+    // Cache the body for a URL, replacing any older version
+    void insert(const std::string& in_url, uint64_t in_version,
+            std::shared_ptr<const std::string> in_body);
+
+    // Count a request answered with a 304
+    void count_not_modified();
+
+    void get_stats(size_t *num_entries, size_t *num_bytes, uint64_t *num_hits,
+            uint64_t *num_misses, uint64_t *num_not_modified);
+
+protected:
+    struct cache_entry {
+        std::string url;
+        uint64_t version;
+        std::shared_ptr<const std::string> body;
+    };
+
+    pthread_mutex_t mutex;
+
+    // Most recently used first
+    std::list<cache_entry> lru;
+    std::unordered_map<std::string, std::list<cache_entry>::iterator> index;
+
+    size_t num_bytes, max_bytes;
+    uint64_t num_hits, num_misses, num_not_modified;
+
+    time_t start_time;
+
+    static size_t entry_size(const cache_entry& in_entry);
+
+    // Remove an entry; must be called with the mutex held
+    void remove(std::list<cache_entry>::iterator in_itr);
+};
+
+#endif
+
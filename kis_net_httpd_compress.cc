@@ -0,0 +1,236 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "util.h"
+#include "kis_mem_account.h"
+#include "kis_net_httpd_compress.h"
+
+// zlib state for the window and memory level we use, per zconf.h
+#define KIS_HTTPD_DEFLATE_MEM   ((1 << (15 + 2)) + (1 << (8 + 9)) + 6 * 1024)
+
+// Output is grown in pieces of this size
+#define KIS_HTTPD_DEFLATE_CHUNK (16 * 1024)
+
+static uint64_t thread_cpu_usec() {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+
+    return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+Kis_Net_Httpd_Compress_Stats::Kis_Net_Httpd_Compress_Stats() {
+    pthread_mutex_init(&mutex, NULL);
+
+    num_responses = 0;
+    bytes_in = 0;
+    bytes_out = 0;
+    cpu_usec = 0;
+}
+
+Kis_Net_Httpd_Compress_Stats::~Kis_Net_Httpd_Compress_Stats() {
+    pthread_mutex_destroy(&mutex);
+}
+
+void Kis_Net_Httpd_Compress_Stats::add(uint64_t in_bytes_in, uint64_t in_bytes_out,
+        uint64_t in_cpu_usec) {
+    local_locker lock(&mutex);
+
+    num_responses++;
+    bytes_in += in_bytes_in;
+    bytes_out += in_bytes_out;
+    cpu_usec += in_cpu_usec;
+}
+
+void Kis_Net_Httpd_Compress_Stats::get_stats(uint64_t *ret_responses,
+        uint64_t *ret_bytes_in, uint64_t *ret_bytes_out, uint64_t *ret_cpu_usec) {
+    local_locker lock(&mutex);
+
+    *ret_responses = num_responses;
+    *ret_bytes_in = bytes_in;
+    *ret_bytes_out = bytes_out;
+    *ret_cpu_usec = cpu_usec;
+}
+
+Kis_Net_Httpd_Deflater::Kis_Net_Httpd_Deflater(int in_encoding, int in_level,
+        Kis_Net_Httpd_Compress_Stats *in_stats) {
+    encoding = in_encoding;
+    stats = in_stats;
+
+    total_in = 0;
+    total_out = 0;
+    cpu_usec = 0;
+
+    memset(&zs, 0, sizeof(z_stream));
+
+    if (in_level < Z_BEST_SPEED)
+        in_level = Z_BEST_SPEED;
+    if (in_level > Z_BEST_COMPRESSION)
+        in_level = Z_BEST_COMPRESSION;
+
+    // gzip gets the gzip wrapper; http 'deflate' is the zlib format, not a
+    // raw deflate stream
+    int window_bits = 15;
+    if (encoding == KIS_HTTPD_ENCODING_GZIP)
+        window_bits += 16;
+
+    valid = (deflateInit2(&zs, in_level, Z_DEFLATED, window_bits, 8,
+                Z_DEFAULT_STRATEGY) == Z_OK);
+
+    if (valid)
+        kis_mem_account::add(KIS_MEM_HTTPD, 0, KIS_HTTPD_DEFLATE_MEM);
+}
+
+Kis_Net_Httpd_Deflater::~Kis_Net_Httpd_Deflater() {
+    if (valid) {
+        deflateEnd(&zs);
+        kis_mem_account::add(KIS_MEM_HTTPD, 0, -KIS_HTTPD_DEFLATE_MEM);
+    }
+
+    if (stats != NULL && total_in > 0)
+        stats->add(total_in, total_out, cpu_usec);
+}
+
+bool Kis_Net_Httpd_Deflater::compress(const char *in_data, size_t in_len,
+        bool in_finish, std::string& out) {
+    if (!valid)
+        return false;
+
+    if (in_len == 0 && !in_finish)
+        return true;
+
+    uint64_t start_usec = thread_cpu_usec();
+    size_t start_sz = out.length();
+
+    int flush = in_finish ? Z_FINISH : Z_NO_FLUSH;
+    int r;
+
+    zs.next_in = (Bytef *) in_data;
+    zs.avail_in = in_len;
+
+    // Deflate directly into the tail of the output, growing it until zlib
+    // has consumed everything (and, when finishing, written the trailer)
+    do {
+        size_t pos = out.length();
+        out.resize(pos + KIS_HTTPD_DEFLATE_CHUNK);
+
+        zs.next_out = (Bytef *) &(out[pos]);
+        zs.avail_out = KIS_HTTPD_DEFLATE_CHUNK;
+
+        r = deflate(&zs, flush);
+
+        out.resize(pos + KIS_HTTPD_DEFLATE_CHUNK - zs.avail_out);
+
+        if (r == Z_STREAM_ERROR) {
+            valid = false;
+            break;
+        }
+    } while (zs.avail_out == 0 || (in_finish && r != Z_STREAM_END));
+
+    total_in += in_len;
+    total_out += out.length() - start_sz;
+    cpu_usec += thread_cpu_usec() - start_usec;
+
+    return valid;
+}
+
+const char *Kis_Net_Httpd_Deflater::encoding_name(int in_encoding) {
+    if (in_encoding == KIS_HTTPD_ENCODING_GZIP)
+        return "gzip";
+    if (in_encoding == KIS_HTTPD_ENCODING_DEFLATE)
+        return "deflate";
+
+    return "identity";
+}
+
+float Kis_Net_Httpd_Deflater::accept_quality(const char *in_header,
+        const char *in_encoding) {
+    if (in_header == NULL)
+        return 0;
+
+    float named_q = -1, wild_q = -1;
+    size_t name_len = strlen(in_encoding);
+
+    const char *pos = in_header;
+
+    // Accept-Encoding is a comma separated list of 'coding[;q=value]'
+    while (*pos != 0) {
+        const char *end = strchr(pos, ',');
+        if (end == NULL)
+            end = pos + strlen(pos);
+
+        while (pos < end && (*pos == ' ' || *pos == '\t'))
+            pos++;
+
+        const char *tok_end = pos;
+        while (tok_end < end && *tok_end != ';' && *tok_end != ' ' && *tok_end != '\t')
+            tok_end++;
+
+        size_t tok_len = tok_end - pos;
+
+        float q = 1;
+        const char *qpos = strstr(tok_end, "q=");
+        if (qpos != NULL && qpos < end)
+            q = strtof(qpos + 2, NULL);
+
+        if ((tok_len == name_len && strncasecmp(pos, in_encoding, name_len) == 0) ||
+                (name_len == 4 && tok_len == 6 && strncasecmp(pos, "x-gzip", 6) == 0 &&
+                 strcasecmp(in_encoding, "gzip") == 0))
+            named_q = q;
+        else if (tok_len == 1 && *pos == '*')
+            wild_q = q;
+
+        if (*end == 0)
+            break;
+
+        pos = end + 1;
+    }
+
+    if (named_q >= 0)
+        return named_q;
+
+    if (wild_q >= 0)
+        return wild_q;
+
+    return 0;
+}
+
+int Kis_Net_Httpd_Deflater::negotiate(const char *in_header) {
+    if (in_header == NULL)
+        return KIS_HTTPD_ENCODING_IDENTITY;
+
+    float gzip_q = accept_quality(in_header, "gzip");
+    float deflate_q = accept_quality(in_header, "deflate");
+
+    if (gzip_q > 0 && gzip_q >= deflate_q)
+        return KIS_HTTPD_ENCODING_GZIP;
+
+    if (deflate_q > 0)
+        return KIS_HTTPD_ENCODING_DEFLATE;
+
+    return KIS_HTTPD_ENCODING_IDENTITY;
+}
+
@@ -0,0 +1,92 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_NET_HTTPD_COMPRESS_H__
+#define __KIS_NET_HTTPD_COMPRESS_H__
+
+#include "config.hpp"
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <zlib.h>
+
+// Content encodings we can produce
+#define KIS_HTTPD_ENCODING_IDENTITY     0
+#define KIS_HTTPD_ENCODING_GZIP         1
+#define KIS_HTTPD_ENCODING_DEFLATE      2
+
+// Totals for every compressed response, published in /system/status
+class Kis_Net_Httpd_Compress_Stats {
+public:
+    Kis_Net_Httpd_Compress_Stats();
+    ~Kis_Net_Httpd_Compress_Stats();
+
+    void add(uint64_t in_bytes_in, uint64_t in_bytes_out, uint64_t in_cpu_usec);
+
+    void get_stats(uint64_t *ret_responses, uint64_t *ret_bytes_in,
+            uint64_t *ret_bytes_out, uint64_t *ret_cpu_usec);
+
+protected:
+    pthread_mutex_t mutex;
+
+    uint64_t num_responses, bytes_in, bytes_out, cpu_usec;
+};
+
+// Streaming zlib encoder for one response.  Data can be fed in any number
+// of pieces; compressed output is appended as it becomes available, and
+// everything is flushed when the last piece is marked as finished.
+//
+// The totals and the CPU time spent compressing are added to the stats
+// when the deflater is destroyed.
+class Kis_Net_Httpd_Deflater {
+public:
+    Kis_Net_Httpd_Deflater(int in_encoding, int in_level,
+            Kis_Net_Httpd_Compress_Stats *in_stats);
+    ~Kis_Net_Httpd_Deflater();
+
+    // Compress len bytes of data, appending output to out; returns false if
+    // zlib failed, after which nothing more can be compressed
+    bool compress(const char *in_data, size_t in_len, bool in_finish,
+            std::string& out);
+
+    int get_encoding() { return encoding; }
+
+    // Content-Encoding header value for an encoding
+    static const char *encoding_name(int in_encoding);
+
+    // Quality value (0 to 1) given to an encoding by an Accept-Encoding
+    // header, taking '*' into account
+    static float accept_quality(const char *in_header, const char *in_encoding);
+
+    // Preferred encoding we can produce for an Accept-Encoding header;
+    // gzip wins ties
+    static int negotiate(const char *in_header);
+
+protected:
+    int encoding;
+    bool valid;
+
+    z_stream zs;
+
+    Kis_Net_Httpd_Compress_Stats *stats;
+    uint64_t total_in, total_out, cpu_usec;
+};
+
+#endif
+
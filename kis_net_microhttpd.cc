@@ -44,6 +44,8 @@
 #include "kis_net_microhttpd.h"
 #include "base64.h"
 #include "entrytracker.h"
+#include "kis_mem_account.h"
+#include "kis_threadpool.h"
 
 Kis_Net_Httpd::Kis_Net_Httpd(GlobalRegistry *in_globalreg) {
     globalreg = in_globalreg;
@@ -99,6 +101,16 @@ Kis_Net_Httpd::Kis_Net_Httpd(GlobalRegistry *in_globalreg) {
     pem_path = globalreg->kismet_config->FetchOpt("httpd_ssl_cert");
     key_path = globalreg->kismet_config->FetchOpt("httpd_ssl_key");
 
+    // Cached object responses, in megabytes
+    object_cache.set_max_bytes((size_t) 
+            globalreg->kismet_config->FetchOptUInt("httpd_cache_max", 16) * 1024 * 1024);
+
+    // Response compression
+    compress_level = 
+        globalreg->kismet_config->FetchOptInt("httpd_compression", 6);
+    compress_min = 
+        globalreg->kismet_config->FetchOptUInt("httpd_compression_min", 1024);
+
     RegisterMimeType("html", "text/html");
     RegisterMimeType("svg", "image/svg+xml");
     RegisterMimeType("css", "text/css");
@@ -106,7 +118,10 @@ Kis_Net_Httpd::Kis_Net_Httpd(GlobalRegistry *in_globalreg) {
     RegisterMimeType("gif", "image/gif");
     RegisterMimeType("ico", "image/x-icon");
     RegisterMimeType("json", "application/json");
+    RegisterMimeType("cjson", "application/json");
+    RegisterMimeType("xml", "application/xml");
     RegisterMimeType("pcap", "application/vnd.tcpdump.pcap");
+    RegisterMimeType("kcol", "application/octet-stream");
 
     vector<string> mimeopts = globalreg->kismet_config->FetchOptVec("httpd_mime");
     for (unsigned int i = 0; i < mimeopts.size(); i++) {
@@ -484,6 +499,7 @@ int Kis_Net_Httpd::http_request_handler(void *cls, struct MHD_Connection *connec
     // If we don't have a connection state, make one
     if (*ptr == NULL) {
         concls = new Kis_Net_Httpd_Connection();
+        kis_mem_account::add(KIS_MEM_HTTPD, 1, sizeof(Kis_Net_Httpd_Connection));
         // fprintf(stderr, "debug - allocated new connection state %p\n", concls);
 
         *ptr = (void *) concls;
@@ -605,6 +621,9 @@ void Kis_Net_Httpd::http_request_completed(void *cls __attribute__((unused)),
         con_info->postprocessor = NULL;
     }
 
+    kis_mem_account::add(KIS_MEM_HTTPD, -1, 
+            -((int64_t) (sizeof(Kis_Net_Httpd_Connection) + con_info->response_sz)));
+
     delete(con_info);
     *con_cls = NULL;
 }
@@ -622,6 +641,32 @@ static void free_callback(void *cls) {
     fclose(file);
 }
 
+// Open a regular file inside the data dir
+static FILE *open_static_file(const char *path, const char *datadir_path,
+        struct stat *buf) {
+    char *realpath_path = realpath(path, NULL);
+
+    if (realpath_path == NULL)
+        return NULL;
+
+    FILE *f = NULL;
+
+    if (strstr(realpath_path, datadir_path) == realpath_path)
+        f = fopen(realpath_path, "rb");
+
+    free(realpath_path);
+
+    if (f == NULL)
+        return NULL;
+
+    if (fstat(fileno(f), buf) != 0 || (!S_ISREG(buf->st_mode))) {
+        fclose(f);
+        return NULL;
+    }
+
+    return f;
+}
+
 string Kis_Net_Httpd::GetMimeType(string ext) {
     std::map<string, string>::iterator mi = mime_type_map.find(ext);
     if (mi != mime_type_map.end()) {
@@ -646,88 +691,96 @@ int Kis_Net_Httpd::handle_static_file(void *cls, Kis_Net_Httpd_Connection *conne
     if (fullfile[fullfile.size() - 1] == '/')
         fullfile += "index.html";
 
-    char *realpath_path;
-    const char *datadir_path;
+    const char *datadir_path = kishttpd->http_data_dir.c_str();
 
-    datadir_path = kishttpd->http_data_dir.c_str();
-    realpath_path = realpath(fullfile.c_str(), NULL);
+    struct MHD_Response *response;
+    struct stat buf;
 
-    if (realpath_path == NULL) {
+    FILE *f = open_static_file(fullfile.c_str(), datadir_path, &buf);
+
+    if (f == NULL)
         return -1;
-    } else {
-        // Make sure we're hosted inside the data dir
-        if (strstr(realpath_path, datadir_path) == realpath_path) {
-
-            struct MHD_Response *response;
-            struct stat buf;
-
-            FILE *f = fopen(realpath_path, "rb");
-            int fd;
-            free(realpath_path);
-            
-            if (f != NULL) {
-                fd = fileno(f);
-                if (fstat(fd, &buf) != 0 || (!S_ISREG(buf.st_mode))) {
-                    fclose(f);
-                    return -1;
-                }
 
-                response = MHD_create_response_from_callback(buf.st_size, 32 * 1024,
-                        &file_reader, f, &free_callback);
+    // Serve a precompressed sibling instead, if there is one at least as new
+    // as the file and the client takes gzip
+    bool has_gz = false, use_gz = false;
+    struct stat gzbuf;
 
-                if (response == NULL) {
-                    fclose(f);
-                    return -1;
-                }
+    FILE *gzf = open_static_file((fullfile + ".gz").c_str(), datadir_path, &gzbuf);
 
-                if (connection->session != NULL) {
-                    std::stringstream cookiestr;
-                    std::stringstream cookie;
+    if (gzf != NULL) {
+        if (gzbuf.st_mtime >= buf.st_mtime) {
+            has_gz = true;
 
-                    cookiestr << KIS_SESSION_COOKIE << "=";
-                    cookiestr << connection->session->sessionid;
-                    cookiestr << "; Path=/";
+            const char *accept =
+                MHD_lookup_connection_value(connection->connection, MHD_HEADER_KIND,
+                        "Accept-Encoding");
 
-                    MHD_add_response_header(response, MHD_HTTP_HEADER_SET_COOKIE, 
-                                cookiestr.str().c_str());
-                }
+            use_gz = Kis_Net_Httpd_Deflater::accept_quality(accept, "gzip") > 0;
+        }
+
+        if (use_gz) {
+            fclose(f);
+            f = gzf;
+            buf = gzbuf;
+        } else {
+            fclose(gzf);
+        }
+    }
 
-                char lastmod[31];
-                struct tm tmstruct;
-                localtime_r(&(buf.st_ctime), &tmstruct);
-                strftime(lastmod, 31, "%a, %d %b %Y %H:%M:%S %Z", &tmstruct);
-                MHD_add_response_header(response, "Last-Modified", lastmod);
+    response = MHD_create_response_from_callback(buf.st_size, 32 * 1024,
+            &file_reader, f, &free_callback);
 
-                string suffix = GetSuffix(url);
-                string mime = kishttpd->GetMimeType(suffix);
+    if (response == NULL) {
+        fclose(f);
+        return -1;
+    }
 
-                if (mime != "") {
-                    MHD_add_response_header(response, "Content-Type", mime.c_str());
-                }
+    if (connection->session != NULL) {
+        std::stringstream cookiestr;
+        std::stringstream cookie;
 
-                // Allow any?
-                MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
+        cookiestr << KIS_SESSION_COOKIE << "=";
+        cookiestr << connection->session->sessionid;
+        cookiestr << "; Path=/";
 
-                // Never let the browser cache our responses.  Maybe moderate this
-                // in the future to cache for 60 seconds or something?
-                MHD_add_response_header(response, "Cache-Control", "no-cache");
-                MHD_add_response_header(response, "Pragma", "no-cache");
-                MHD_add_response_header(response, 
-                        "Expires", "Sat, 01 Jan 2000 00:00:00 GMT");
+        MHD_add_response_header(response, MHD_HTTP_HEADER_SET_COOKIE, 
+                cookiestr.str().c_str());
+    }
 
-                MHD_queue_response(connection->connection, MHD_HTTP_OK, response);
-                MHD_destroy_response(response);
+    char lastmod[31];
+    struct tm tmstruct;
+    localtime_r(&(buf.st_ctime), &tmstruct);
+    strftime(lastmod, 31, "%a, %d %b %Y %H:%M:%S %Z", &tmstruct);
+    MHD_add_response_header(response, "Last-Modified", lastmod);
 
-                return 1;
-            }
+    string suffix = GetSuffix(url);
+    string mime = kishttpd->GetMimeType(suffix);
 
-            return -1;
-        } else {
-            return -1;
-        }
+    if (mime != "") {
+        MHD_add_response_header(response, "Content-Type", mime.c_str());
     }
 
-    return -1;
+    if (has_gz)
+        MHD_add_response_header(response, "Vary", "Accept-Encoding");
+
+    if (use_gz)
+        MHD_add_response_header(response, "Content-Encoding", "gzip");
+
+    // Allow any?
+    MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
+
+    // Never let the browser cache our responses.  Maybe moderate this
+    // in the future to cache for 60 seconds or something?
+    MHD_add_response_header(response, "Cache-Control", "no-cache");
+    MHD_add_response_header(response, "Pragma", "no-cache");
+    MHD_add_response_header(response, 
+            "Expires", "Sat, 01 Jan 2000 00:00:00 GMT");
+
+    MHD_queue_response(connection->connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+
+    return 1;
 }
 
 void Kis_Net_Httpd::AppendHttpSession(Kis_Net_Httpd *httpd,
@@ -791,6 +844,60 @@ int Kis_Net_Httpd::SendStandardHttpResponse(Kis_Net_Httpd *httpd,
     return SendHttpResponse(httpd, connection);
 }
 
+int Kis_Net_Httpd::NegotiateEncoding(Kis_Net_Httpd_Connection *connection) {
+    if (compress_level <= 0)
+        return KIS_HTTPD_ENCODING_IDENTITY;
+
+    return Kis_Net_Httpd_Deflater::negotiate(
+            MHD_lookup_connection_value(connection->connection, MHD_HEADER_KIND,
+                "Accept-Encoding"));
+}
+
+Kis_Net_Httpd_Deflater *Kis_Net_Httpd::CreateDeflater(int in_encoding) {
+    return new Kis_Net_Httpd_Deflater(in_encoding, compress_level, &compress_stats);
+}
+
+void Kis_Net_Httpd::AppendEncodingHeaders(Kis_Net_Httpd_Connection *connection,
+        int in_encoding) {
+    if (compress_level <= 0)
+        return;
+
+    MHD_add_response_header(connection->response, "Vary", "Accept-Encoding");
+
+    if (in_encoding != KIS_HTTPD_ENCODING_IDENTITY)
+        MHD_add_response_header(connection->response, "Content-Encoding",
+                Kis_Net_Httpd_Deflater::encoding_name(in_encoding));
+}
+
+void Kis_Net_Httpd::CreateBufferResponse(Kis_Net_Httpd_Connection *connection,
+        const string& in_body) {
+    int encoding = KIS_HTTPD_ENCODING_IDENTITY;
+    string compressed;
+
+    if (in_body.length() >= compress_min)
+        encoding = NegotiateEncoding(connection);
+
+    if (encoding != KIS_HTTPD_ENCODING_IDENTITY) {
+        Kis_Net_Httpd_Deflater deflater(encoding, compress_level, &compress_stats);
+
+        if (!deflater.compress(in_body.data(), in_body.length(), true, compressed))
+            encoding = KIS_HTTPD_ENCODING_IDENTITY;
+    }
+
+    const string& body = 
+        (encoding == KIS_HTTPD_ENCODING_IDENTITY) ? in_body : compressed;
+
+    connection->response = 
+        MHD_create_response_from_buffer(body.length(),
+                (void *) body.data(), MHD_RESPMEM_MUST_COPY);
+
+    AppendEncodingHeaders(connection, encoding);
+
+    // The response holds its copy until the connection completes
+    connection->response_sz = body.length();
+    kis_mem_account::add(KIS_MEM_HTTPD, 0, body.length());
+}
+
 Kis_Net_Httpd_Handler::Kis_Net_Httpd_Handler(GlobalRegistry *in_globalreg) {
     httpd = NULL;
     http_globalreg = in_globalreg;
@@ -839,6 +946,92 @@ bool Kis_Net_Httpd_CPPStream_Handler::Httpd_Serialize(string path,
     return entrytracker->Serialize(httpd->GetSuffix(path), stream, e, name_map);
 }
 
+Kis_Net_Httpd_Stream_Generator *Kis_Net_Httpd_CPPStream_Handler::Httpd_StreamVector(
+        string path, vector<SharedTrackerElement> in_vec, pthread_mutex_t *in_mutex,
+        string in_wrapper_key, shared_ptr<TrackerElementSummaryPlan> in_plan) {
+    shared_ptr<TrackerElementSerializer> ser =
+        entrytracker->GetSerializer(httpd->GetSuffix(path));
+
+    return Httpd_StreamVector(ser, std::move(in_vec), in_mutex, in_wrapper_key, in_plan);
+}
+
+Kis_Net_Httpd_Stream_Generator *Kis_Net_Httpd_CPPStream_Handler::Httpd_StreamVector(
+        shared_ptr<TrackerElementSerializer> ser, vector<SharedTrackerElement> in_vec,
+        pthread_mutex_t *in_mutex, string in_wrapper_key,
+        shared_ptr<TrackerElementSummaryPlan> in_plan) {
+    if (ser == NULL || !ser->can_stream_vector())
+        return NULL;
+
+    shared_ptr<Kis_Thread_Pool> pool =
+        static_pointer_cast<Kis_Thread_Pool>(http_globalreg->FetchGlobal("THREAD_POOL"));
+
+    return new Kis_Net_Httpd_Vector_Stream_Generator(ser, std::move(in_vec), 
+            in_mutex, in_wrapper_key, pool, in_plan);
+}
+
+bool Kis_Net_Httpd_CPPStream_Handler::Httpd_SerializeVector(string path,
+        std::stringstream &stream, vector<SharedTrackerElement> in_vec,
+        pthread_mutex_t *in_mutex, string in_wrapper_key,
+        shared_ptr<TrackerElementSummaryPlan> in_plan) {
+    shared_ptr<TrackerElementSerializer> ser =
+        entrytracker->GetSerializer(httpd->GetSuffix(path));
+
+    if (ser == NULL)
+        return false;
+
+    if (ser->can_stream_vector()) {
+        std::unique_ptr<Kis_Net_Httpd_Stream_Generator>
+            gen(Httpd_StreamVector(path, std::move(in_vec), in_mutex, in_wrapper_key,
+                        in_plan));
+
+        while (gen->Generate(stream))
+            ;
+
+        return true;
+    }
+
+    SharedTrackerElement vec(new TrackerElement(TrackerVector));
+    SharedTrackerElement wrapper = vec;
+
+    if (in_wrapper_key != "") {
+        wrapper.reset(new TrackerElement(TrackerMap));
+        wrapper->add_map(vec);
+        vec->set_local_name(in_wrapper_key);
+    }
+
+    for (vector<SharedTrackerElement>::iterator vi = in_vec.begin();
+            vi != in_vec.end(); ++vi) {
+        if (in_plan == NULL) {
+            vec->add_vector(*vi);
+        } else {
+            SharedTrackerElement simple;
+
+            SummarizeTrackerElement(*vi, in_plan, simple);
+
+            vec->add_vector(simple);
+        }
+    }
+
+    if (in_mutex != NULL) {
+        local_locker lock(in_mutex);
+        return Httpd_Serialize(path, stream, wrapper);
+    }
+
+    return Httpd_Serialize(path, stream, wrapper);
+}
+
+ssize_t Kis_Net_Httpd_CPPStream_Handler::stream_generator_cb(void *cls, 
+        uint64_t pos __attribute__((unused)), char *buf, size_t max) {
+    Kis_Net_Httpd_Stream_Generator *gen = (Kis_Net_Httpd_Stream_Generator *) cls;
+
+    return gen->Read(buf, max);
+}
+
+static void free_stream_generator_callback(void *cls) {
+    Kis_Net_Httpd_Stream_Generator *gen = (Kis_Net_Httpd_Stream_Generator *) cls;
+    delete(gen);
+}
+
 int Kis_Net_Httpd_CPPStream_Handler::Httpd_HandleGetRequest(Kis_Net_Httpd *httpd, 
         Kis_Net_Httpd_Connection *connection,
         const char *url, const char *method, const char *upload_data,
@@ -847,18 +1040,127 @@ int Kis_Net_Httpd_CPPStream_Handler::Httpd_HandleGetRequest(Kis_Net_Httpd *httpd
     std::stringstream stream;
     int ret;
 
+    Kis_Net_Httpd_Stream_Generator *gen =
+        Httpd_CreateStreamGenerator(httpd, connection, url, method);
+
+    if (gen != NULL) {
+        int encoding = httpd->NegotiateEncoding(connection);
+
+        if (encoding != KIS_HTTPD_ENCODING_IDENTITY)
+            gen->SetDeflater(httpd->CreateDeflater(encoding));
+
+        connection->response = 
+            MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 32 * 1024,
+                    &stream_generator_cb, gen, &free_stream_generator_callback);
+
+        httpd->AppendEncodingHeaders(connection, encoding);
+
+        return httpd->SendStandardHttpResponse(httpd, connection, url);
+    }
+
+    uint64_t version;
+
+    if (Httpd_GetObjectVersion(httpd, connection, url, &version))
+        return Httpd_SendVersionedResponse(httpd, connection, url, method,
+                upload_data, upload_data_size, version);
+
     Httpd_CreateStreamResponse(httpd, connection, url, method, upload_data,
             upload_data_size, stream);
 
-    connection->response = 
-        MHD_create_response_from_buffer(stream.str().length(),
-                (void *) stream.str().data(), MHD_RESPMEM_MUST_COPY);
+    httpd->CreateBufferResponse(connection, stream.str());
 
     ret = httpd->SendStandardHttpResponse(httpd, connection, url);
     
     return ret;
 }
 
+int Kis_Net_Httpd_CPPStream_Handler::Httpd_SendVersionedResponse(Kis_Net_Httpd *httpd,
+        Kis_Net_Httpd_Connection *connection,
+        const char *url, const char *method, const char *upload_data,
+        size_t *upload_data_size, uint64_t in_version) {
+
+    Kis_Net_Httpd_Object_Cache *cache = httpd->GetObjectCache();
+
+    // Each encoding is a different representation, with its own tag and its
+    // own cached body; '#' never appears in a request path
+    int encoding = httpd->NegotiateEncoding(connection);
+
+    string etag, cache_key;
+
+    if (encoding == KIS_HTTPD_ENCODING_IDENTITY) {
+        etag = cache->make_etag(in_version);
+        cache_key = url;
+    } else {
+        etag = cache->make_etag(in_version, 
+                Kis_Net_Httpd_Deflater::encoding_name(encoding));
+        cache_key = string(url) + "#" + Kis_Net_Httpd_Deflater::encoding_name(encoding);
+    }
+
+    const char *match = 
+        MHD_lookup_connection_value(connection->connection, MHD_HEADER_KIND,
+                "If-None-Match");
+
+    if (match != NULL && Kis_Net_Httpd_Object_Cache::etag_matches(match, etag)) {
+        cache->count_not_modified();
+
+        connection->httpcode = 304;
+        connection->response = 
+            MHD_create_response_from_buffer(0, (void *) "", MHD_RESPMEM_PERSISTENT);
+        MHD_add_response_header(connection->response, "ETag", etag.c_str());
+        httpd->AppendEncodingHeaders(connection, KIS_HTTPD_ENCODING_IDENTITY);
+
+        return httpd->SendStandardHttpResponse(httpd, connection, url);
+    }
+
+    // Cached bodies are stored already compressed, so a hit costs neither
+    // serializing nor compressing
+    shared_ptr<const string> body = cache->find(cache_key, in_version);
+
+    if (body == NULL) {
+        std::stringstream stream;
+
+        Httpd_CreateStreamResponse(httpd, connection, url, method, upload_data,
+                upload_data_size, stream);
+
+        shared_ptr<string> generated(new string(stream.str()));
+
+        if (encoding != KIS_HTTPD_ENCODING_IDENTITY) {
+            std::unique_ptr<Kis_Net_Httpd_Deflater> 
+                deflater(httpd->CreateDeflater(encoding));
+            shared_ptr<string> compressed(new string());
+
+            if (deflater->compress(generated->data(), generated->length(), true,
+                        *compressed)) {
+                generated = compressed;
+            } else {
+                encoding = KIS_HTTPD_ENCODING_IDENTITY;
+                etag = cache->make_etag(in_version);
+                cache_key = url;
+            }
+        }
+
+        // Only cache complete, successful responses
+        if (connection->httpcode == 200)
+            cache->insert(cache_key, in_version, generated);
+
+        body = generated;
+    }
+
+    connection->response = 
+        MHD_create_response_from_buffer(body->length(),
+                (void *) body->data(), MHD_RESPMEM_MUST_COPY);
+
+    httpd->AppendEncodingHeaders(connection, encoding);
+
+    if (connection->httpcode == 200)
+        MHD_add_response_header(connection->response, "ETag", etag.c_str());
+
+    connection->response_sz = body->length();
+    kis_mem_account::add(KIS_MEM_HTTPD, 0, body->length());
+
+    return httpd->SendStandardHttpResponse(httpd, connection, url);
+}
+
 int Kis_Net_Httpd_CPPStream_Handler::Httpd_HandlePostRequest(Kis_Net_Httpd *httpd, 
         Kis_Net_Httpd_Connection *connection,
         const char *url, const char *method, const char *upload_data,
@@ -867,10 +1169,7 @@ int Kis_Net_Httpd_CPPStream_Handler::Httpd_HandlePostRequest(Kis_Net_Httpd *http
     // Call the post complete and populate our stream
     Httpd_PostComplete(connection);
 
-    connection->response = 
-        MHD_create_response_from_buffer(connection->response_stream.str().length(),
-                (void *) connection->response_stream.str().data(), 
-                MHD_RESPMEM_MUST_COPY);
+    httpd->CreateBufferResponse(connection, connection->response_stream.str());
 
     return httpd->SendStandardHttpResponse(httpd, connection, url);
 }
@@ -1036,6 +1335,161 @@ void Kis_Net_Httpd_No_Files_Handler::Httpd_CreateStreamResponse(Kis_Net_Httpd *h
     stream << "</html>";
 }
 
+Kis_Net_Httpd_Stream_Generator::Kis_Net_Httpd_Stream_Generator() {
+    pending_pos = 0;
+    complete = false;
+    accounted_sz = 0;
+}
+
+Kis_Net_Httpd_Stream_Generator::~Kis_Net_Httpd_Stream_Generator() {
+    kis_mem_account::add(KIS_MEM_HTTPD, 0, -((int64_t) accounted_sz));
+}
+
+void Kis_Net_Httpd_Stream_Generator::SetDeflater(Kis_Net_Httpd_Deflater *in_deflater) {
+    deflater.reset(in_deflater);
+}
+
+ssize_t Kis_Net_Httpd_Stream_Generator::Read(char *buf, size_t in_max) {
+    // Generate until we have a full block for microhttpd or we're done
+    while (!complete && pending.length() - pending_pos < in_max) {
+        std::stringstream stream;
+
+        complete = !Generate(stream);
+
+        if (deflater != NULL) {
+            string piece = stream.str();
+
+            // If compression fails partway there's no way to recover the
+            // response, so end it and let the client see it truncated
+            if (!deflater->compress(piece.data(), piece.length(), complete, pending))
+                complete = true;
+        } else {
+            pending.append(stream.str());
+        }
+    }
+
+    size_t avail = pending.length() - pending_pos;
+
+    if (avail == 0)
+        return MHD_CONTENT_READER_END_OF_STREAM;
+
+    if (avail > in_max)
+        avail = in_max;
+
+    memcpy(buf, pending.data() + pending_pos, avail);
+    pending_pos += avail;
+
+    // Drop what's been sent so the buffer only ever holds the unsent tail
+    if (pending_pos == pending.length()) {
+        pending.clear();
+        pending_pos = 0;
+    } else {
+        pending.erase(0, pending_pos);
+        pending_pos = 0;
+    }
+
+    if (pending.capacity() != accounted_sz) {
+        kis_mem_account::add(KIS_MEM_HTTPD, 0, 
+                (int64_t) pending.capacity() - (int64_t) accounted_sz);
+        accounted_sz = pending.capacity();
+    }
+
+    return (ssize_t) avail;
+}
+
+// Elements serialized into each buffer, and chunks per pool slot in each
+// batch; a batch is generated per piece, so this bounds both how long the
+// mutex is held and how much is buffered at once
+#define KIS_HTTPD_VECTOR_CHUNK          32
+#define KIS_HTTPD_VECTOR_SLOT_CHUNKS    4
+
+Kis_Net_Httpd_Vector_Stream_Generator::Kis_Net_Httpd_Vector_Stream_Generator(
+        shared_ptr<TrackerElementSerializer> in_serializer,
+        vector<SharedTrackerElement> in_vec, pthread_mutex_t *in_mutex,
+        string in_wrapper_key, shared_ptr<Kis_Thread_Pool> in_pool,
+        shared_ptr<TrackerElementSummaryPlan> in_plan) {
+    serializer = in_serializer;
+    elem_vec = std::move(in_vec);
+    mutex = in_mutex;
+    wrapper_key = in_wrapper_key;
+    pool = in_pool;
+    plan = in_plan;
+
+    opened = false;
+    elem_pos = 0;
+}
+
+bool Kis_Net_Httpd_Vector_Stream_Generator::Generate(std::stringstream &stream) {
+    if (!opened) {
+        serializer->serialize_vector_open(stream, elem_vec.size(), wrapper_key);
+        opened = true;
+        return true;
+    }
+
+    if (elem_pos < elem_vec.size()) {
+        unsigned int nslots = 1;
+        if (pool != NULL)
+            nslots = pool->get_num_slots();
+
+        size_t batch_end = elem_pos +
+            (KIS_HTTPD_VECTOR_CHUNK * KIS_HTTPD_VECTOR_SLOT_CHUNKS * nslots);
+        if (batch_end > elem_vec.size())
+            batch_end = elem_vec.size();
+
+        size_t batch_sz = batch_end - elem_pos;
+
+        // Chunks start on multiples of the chunk size, so each one knows its
+        // buffer; if the pool runs the batch as a single range it all lands
+        // in the first buffer, which is still in order
+        vector<std::stringstream> chunk_streams((batch_sz + KIS_HTTPD_VECTOR_CHUNK - 1) /
+                KIS_HTTPD_VECTOR_CHUNK);
+
+        auto serialize_range = [&](size_t start, size_t end,
+                unsigned int slot __attribute__((unused))) {
+            std::stringstream& cs = chunk_streams[start / KIS_HTTPD_VECTOR_CHUNK];
+
+            for (size_t x = elem_pos + start; x < elem_pos + end; x++) {
+                if (plan != NULL)
+                    serializer->serialize_vector_summary(cs, x, elem_vec[x], plan);
+                else
+                    serializer->serialize_vector_element(cs, x, elem_vec[x]);
+            }
+        };
+
+        auto serialize_batch = [&]() {
+            if (pool != NULL)
+                pool->parallel_for(batch_sz, KIS_HTTPD_VECTOR_CHUNK, serialize_range);
+            else
+                serialize_range(0, batch_sz, 0);
+        };
+
+        // The pool threads work under our lock, the same as device matching
+        if (mutex != NULL) {
+            local_locker lock(mutex);
+            serialize_batch();
+        } else {
+            serialize_batch();
+        }
+
+        for (size_t c = 0; c < chunk_streams.size(); c++) {
+            string chunk = chunk_streams[c].str();
+            stream.write(chunk.data(), chunk.length());
+        }
+
+        // We're done with these elements, don't keep them alive any longer
+        for (size_t x = elem_pos; x < batch_end; x++)
+            elem_vec[x].reset();
+
+        elem_pos = batch_end;
+
+        return true;
+    }
+
+    serializer->serialize_vector_close(stream, wrapper_key);
+
+    return false;
+}
+
 Kis_Net_Httpd_Ringbuf_Stream_Aux::Kis_Net_Httpd_Ringbuf_Stream_Aux(
         Kis_Net_Httpd_Ringbuf_Stream_Handler *in_handler,
         Kis_Net_Httpd_Connection *in_httpd_connection,
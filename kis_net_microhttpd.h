@@ -36,12 +36,15 @@
 #include "trackedelement.h"
 #include "ringbuf2.h"
 #include "ringbuf_handler.h"
+#include "kis_net_httpd_cache.h"
+#include "kis_net_httpd_compress.h"
 
 class Kis_Net_Httpd;
 class Kis_Net_Httpd_Session;
 class Kis_Net_Httpd_Connection;
 
 class EntryTracker;
+class Kis_Thread_Pool;
 
 // Basic request handler from MHD
 class Kis_Net_Httpd_Handler {
@@ -135,6 +138,72 @@ protected:
 
 };
 
+// A response which is generated a piece at a time as it is sent, instead of
+// being built whole before sending starts.  The generated data is buffered
+// only until microhttpd asks for it, so memory use is bounded by the send
+// block size plus the largest single piece.
+class Kis_Net_Httpd_Stream_Generator {
+public:
+    Kis_Net_Httpd_Stream_Generator();
+    virtual ~Kis_Net_Httpd_Stream_Generator();
+
+    // Append the next piece of the response to the stream; returns false once
+    // the response is complete
+    virtual bool Generate(std::stringstream &stream) = 0;
+
+    // Fill up to in_max bytes of buf for microhttpd, generating as needed;
+    // returns MHD_CONTENT_READER_END_OF_STREAM when everything has been sent
+    ssize_t Read(char *buf, size_t in_max);
+
+    // Compress the response as it is generated; takes ownership
+    void SetDeflater(Kis_Net_Httpd_Deflater *in_deflater);
+
+protected:
+    std::unique_ptr<Kis_Net_Httpd_Deflater> deflater;
+
+    // Generated data (compressed, if we have a deflater) not yet handed to 
+    // microhttpd starts at pending_pos
+    string pending;
+    size_t pending_pos;
+
+    bool complete;
+
+    // Buffer capacity reported to the memory accounting
+    size_t accounted_sz;
+};
+
+// Stream a vector of tracked elements, serializing a batch of elements per
+// piece.  The elements are referenced, not copied, so they stay valid if they
+// are removed from their tracker while the response is being sent; in_mutex,
+// if set, is held while each batch is serialized.
+//
+// With a thread pool, each batch is cut into chunks which are serialized in
+// parallel into their own buffers, then appended in order.
+//
+// With a summary plan, each element is written as its summary straight from
+// the element, without building a summarized copy.
+class Kis_Net_Httpd_Vector_Stream_Generator : public Kis_Net_Httpd_Stream_Generator {
+public:
+    Kis_Net_Httpd_Vector_Stream_Generator(
+            shared_ptr<TrackerElementSerializer> in_serializer,
+            vector<SharedTrackerElement> in_vec, pthread_mutex_t *in_mutex,
+            string in_wrapper_key, shared_ptr<Kis_Thread_Pool> in_pool = NULL,
+            shared_ptr<TrackerElementSummaryPlan> in_plan = NULL);
+
+    virtual bool Generate(std::stringstream &stream);
+
+protected:
+    shared_ptr<TrackerElementSerializer> serializer;
+    vector<SharedTrackerElement> elem_vec;
+    pthread_mutex_t *mutex;
+    string wrapper_key;
+    shared_ptr<Kis_Thread_Pool> pool;
+    shared_ptr<TrackerElementSummaryPlan> plan;
+
+    bool opened;
+    size_t elem_pos;
+};
+
 // Take a C++ stream and use it as a response
 class Kis_Net_Httpd_CPPStream_Handler : public Kis_Net_Httpd_Handler {
 public:
@@ -150,6 +219,31 @@ public:
             const char *url, const char *method, const char *upload_data,
             size_t *upload_data_size, std::stringstream &stream) = 0;
 
+    // Endpoints with potentially large responses can return a generator
+    // here; the response is then produced as it is sent instead of through
+    // Httpd_CreateStreamResponse.  Return NULL to use the stream response.
+    virtual Kis_Net_Httpd_Stream_Generator *Httpd_CreateStreamGenerator(
+            Kis_Net_Httpd *httpd __attribute__((unused)),
+            Kis_Net_Httpd_Connection *connection __attribute__((unused)),
+            const char *url __attribute__((unused)), 
+            const char *method __attribute__((unused))) {
+        return NULL;
+    }
+
+    // Endpoints serving a single versioned object (such as one device) can
+    // report the version of the object behind the URL here.  Responses then
+    // carry an ETag, a client which already has the current version gets a
+    // 304, and the generated body is cached until the version changes, so
+    // the URL must completely determine the response for a given version.
+    // Return false to generate the response normally.
+    virtual bool Httpd_GetObjectVersion(
+            Kis_Net_Httpd *httpd __attribute__((unused)),
+            Kis_Net_Httpd_Connection *connection __attribute__((unused)),
+            const char *url __attribute__((unused)),
+            uint64_t *ret_version __attribute__((unused))) {
+        return false;
+    }
+
     virtual int Httpd_HandleGetRequest(Kis_Net_Httpd *httpd, 
             Kis_Net_Httpd_Connection *connection,
             const char *url, const char *method, const char *upload_data,
@@ -160,11 +254,47 @@ public:
             const char *url, const char *method, const char *upload_data,
             size_t *upload_data_size);
 
+    // Answer a GET for a versioned object from the ETag or the cache, 
+    // generating and caching the body if needed
+    int Httpd_SendVersionedResponse(Kis_Net_Httpd *httpd,
+            Kis_Net_Httpd_Connection *connection,
+            const char *url, const char *method, const char *upload_data,
+            size_t *upload_data_size, uint64_t in_version);
+
     // Shortcuts to the entry tracker and serializer since most endpoints will
     // need to serialize
     virtual bool Httpd_Serialize(string path, std::stringstream &stream,
             SharedTrackerElement e, 
             TrackerElementSerializer::rename_map *name_map = NULL);
+
+    // Generator streaming a vector in the serialization format of the path,
+    // optionally summarizing each element with in_plan; returns NULL if that
+    // serializer can't stream
+    virtual Kis_Net_Httpd_Stream_Generator *Httpd_StreamVector(string path,
+            vector<SharedTrackerElement> in_vec, pthread_mutex_t *in_mutex,
+            string in_wrapper_key = "",
+            shared_ptr<TrackerElementSummaryPlan> in_plan = NULL);
+
+    // Generator streaming a vector with a specific serializer, for formats
+    // which aren't registered with the entrytracker
+    virtual Kis_Net_Httpd_Stream_Generator *Httpd_StreamVector(
+            shared_ptr<TrackerElementSerializer> in_serializer,
+            vector<SharedTrackerElement> in_vec, pthread_mutex_t *in_mutex,
+            string in_wrapper_key = "",
+            shared_ptr<TrackerElementSummaryPlan> in_plan = NULL);
+
+    // Serialize a vector in the format of the path all at once, in parallel
+    // batches the same way as Httpd_StreamVector; in_mutex, if set, is only
+    // held while each batch is serialized.  Serializers which can't stream
+    // get the whole vector under the mutex.
+    virtual bool Httpd_SerializeVector(string path, std::stringstream &stream,
+            vector<SharedTrackerElement> in_vec, pthread_mutex_t *in_mutex,
+            string in_wrapper_key = "",
+            shared_ptr<TrackerElementSummaryPlan> in_plan = NULL);
+
+    // Called by microhttpd for more of a generated response; cls is the
+    // Kis_Net_Httpd_Stream_Generator
+    static ssize_t stream_generator_cb(void *cls, uint64_t pos, char *buf, size_t max);
 };
 
 // Fallback handler to report that we can't serve static files
@@ -280,6 +410,7 @@ public:
         connection = NULL;
         response = NULL;
         custom_extension = NULL;
+        response_sz = 0;
     }
 
     // response generated by post
@@ -320,6 +451,10 @@ public:
 
     // Custom arbitrary value inserted by other processors
     void *custom_extension;
+
+    // Size of the response body copied into the response, for memory
+    // accounting
+    size_t response_sz;
 };
 
 class Kis_Net_Httpd_Session {
@@ -395,6 +530,28 @@ public:
     static int SendStandardHttpResponse(Kis_Net_Httpd *httpd,
             Kis_Net_Httpd_Connection *connection, const char *url);
 
+    // Cache of versioned object responses
+    Kis_Net_Httpd_Object_Cache *GetObjectCache() { return &object_cache; }
+
+    // Content encoding to use for a response, from the Accept-Encoding of the
+    // request; identity if the client doesn't take compression or we're 
+    // configured not to compress
+    int NegotiateEncoding(Kis_Net_Httpd_Connection *connection);
+
+    // Deflater for a negotiated encoding at the configured level
+    Kis_Net_Httpd_Deflater *CreateDeflater(int in_encoding);
+
+    // Append Content-Encoding for the encoding, and Vary if responses can
+    // be compressed at all
+    void AppendEncodingHeaders(Kis_Net_Httpd_Connection *connection, int in_encoding);
+
+    // Create the response for a complete body, compressing it if the client
+    // accepts compression and the body is large enough to be worth it
+    void CreateBufferResponse(Kis_Net_Httpd_Connection *connection, 
+            const string& in_body);
+
+    Kis_Net_Httpd_Compress_Stats *GetCompressStats() { return &compress_stats; }
+
     // Catch MHD panics and try to close more elegantly
     static void MHD_Panic(void *cls, const char *file, unsigned int line,
             const char *reason);
@@ -420,6 +577,15 @@ protected:
 
     std::map<string, string> mime_type_map;
 
+    Kis_Net_Httpd_Object_Cache object_cache;
+
+    // zlib level, 0 to disable compression, and the smallest complete body
+    // worth compressing
+    int compress_level;
+    size_t compress_min;
+
+    Kis_Net_Httpd_Compress_Stats compress_stats;
+
     pthread_mutex_t controller_mutex;
 
     // Handle the requests and dispatch to controllers
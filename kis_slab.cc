@@ -0,0 +1,215 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <atomic>
+#include <vector>
+
+#include "util.h"
+#include "kis_slab.h"
+
+// Every pool gets a slot in each thread's cache list
+static std::atomic<size_t> next_pool_index(0);
+
+// The caches a thread holds for every pool it has used; returned to their
+// pools when the thread exits.  Pools are never destroyed, so this is safe
+// however late the thread goes away.
+class kis_slab_thread_caches {
+public:
+    ~kis_slab_thread_caches();
+
+    std::vector<kis_slab_pool::thread_cache> caches;
+    std::vector<kis_slab_pool *> pools;
+};
+
+static thread_local kis_slab_thread_caches thread_caches;
+
+// Set once a thread's caches have been torn down; blocks freed after that
+// (during static destruction on the main thread, for instance) go straight
+// to the pool.  Trivial, so it outlives the cache list.
+static thread_local bool thread_caches_gone = false;
+
+kis_slab_thread_caches::~kis_slab_thread_caches() {
+    thread_caches_gone = true;
+
+    for (size_t i = 0; i < pools.size(); i++) {
+        if (pools[i] != NULL)
+            pools[i]->spill(caches[i], caches[i].count);
+    }
+}
+
+kis_slab_pool::kis_slab_pool(size_t in_block_sz) {
+    pthread_mutex_init(&mutex, NULL);
+
+    // Blocks hold a free list pointer when unused, and need to stay aligned
+    // for anything we might put in them
+    if (in_block_sz < sizeof(void *))
+        in_block_sz = sizeof(void *);
+
+    block_sz = (in_block_sz + 15) & ~((size_t) 15);
+
+    // Aim for roughly 16k slabs, but always fit a useful number of blocks
+    blocks_per_slab = 16384 / block_sz;
+    if (blocks_per_slab < 16)
+        blocks_per_slab = 16;
+
+    free_list = NULL;
+    cur_slab = NULL;
+    cur_pos = blocks_per_slab;
+
+    num_used = 0;
+    num_slabs = 0;
+
+    pool_index = next_pool_index++;
+
+    // Move about 8k of blocks at a time
+    cache_batch = 8192 / block_sz;
+    if (cache_batch < 8)
+        cache_batch = 8;
+    if (cache_batch > 64)
+        cache_batch = 64;
+}
+
+kis_slab_pool::thread_cache *kis_slab_pool::local_cache() {
+    if (thread_caches_gone)
+        return NULL;
+
+    if (thread_caches.caches.size() <= pool_index) {
+        thread_caches.caches.resize(pool_index + 1);
+        thread_caches.pools.resize(pool_index + 1, NULL);
+    }
+
+    thread_caches.pools[pool_index] = this;
+
+    return &(thread_caches.caches[pool_index]);
+}
+
+void *kis_slab_pool::allocate() {
+    thread_cache *c = local_cache();
+    thread_cache tc;
+
+    if (c == NULL)
+        c = &tc;
+
+    if (c->count == 0)
+        refill(*c);
+
+    void *r = c->head;
+    c->head = *((void **) r);
+    c->count--;
+
+    // Without a thread cache, don't strand the rest of the batch
+    if (c == &tc)
+        spill(tc, tc.count);
+
+    return r;
+}
+
+void kis_slab_pool::deallocate(void *in_block) {
+    if (in_block == NULL)
+        return;
+
+    thread_cache *c = local_cache();
+    thread_cache tc;
+
+    if (c == NULL)
+        c = &tc;
+
+    *((void **) in_block) = c->head;
+    c->head = in_block;
+    c->count++;
+
+    // Keep at most two batches; a thread which mostly frees (the serializer
+    // releasing what the packet thread built, say) hands them back in bulk
+    if (c == &tc)
+        spill(tc, tc.count);
+    else if (c->count >= cache_batch * 2)
+        spill(*c, cache_batch);
+}
+
+void kis_slab_pool::refill(thread_cache& in_cache) {
+    local_locker lock(&mutex);
+
+    while (in_cache.count < cache_batch) {
+        void *r;
+
+        if (free_list != NULL) {
+            r = free_list;
+            free_list = *((void **) free_list);
+        } else {
+            if (cur_pos >= blocks_per_slab) {
+                cur_slab = (char *) malloc(block_sz * blocks_per_slab);
+
+                if (cur_slab == NULL) {
+                    if (in_cache.count != 0)
+                        break;
+
+                    throw std::bad_alloc();
+                }
+
+                cur_pos = 0;
+                num_slabs++;
+            }
+
+            r = cur_slab + (block_sz * cur_pos);
+            cur_pos++;
+        }
+
+        *((void **) r) = in_cache.head;
+        in_cache.head = r;
+        in_cache.count++;
+        num_used++;
+    }
+}
+
+void kis_slab_pool::spill(thread_cache& in_cache, size_t in_count) {
+    if (in_count == 0 || in_cache.count == 0)
+        return;
+
+    if (in_count > in_cache.count)
+        in_count = in_cache.count;
+
+    // Split the first in_count blocks off the cache before taking the lock
+    void *first = in_cache.head;
+    void *last = first;
+
+    for (size_t x = 1; x < in_count; x++)
+        last = *((void **) last);
+
+    in_cache.head = *((void **) last);
+    in_cache.count -= in_count;
+
+    local_locker lock(&mutex);
+
+    *((void **) last) = free_list;
+    free_list = first;
+
+    num_used -= in_count;
+}
+
+size_t kis_slab_pool::get_num_used() {
+    local_locker lock(&mutex);
+    return num_used;
+}
+
+size_t kis_slab_pool::get_slab_bytes() {
+    local_locker lock(&mutex);
+    return num_slabs * blocks_per_slab * block_sz;
+}
+
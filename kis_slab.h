@@ -0,0 +1,148 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_SLAB_H__
+#define __KIS_SLAB_H__
+
+#include "config.hpp"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <new>
+#include <memory>
+
+// Pool of fixed-size blocks carved out of larger slabs.
+//
+// Freed blocks go onto a free list and are handed back out before any new
+// slab is allocated; slabs are never returned to the system, so a pool's
+// footprint is its high-water mark.
+//
+// Each thread keeps a small cache of free blocks per pool, so most allocations
+// and frees never touch the pool lock; the cache is refilled from, and spilled
+// back to, the shared free list a batch at a time, and is returned to the pool
+// when the thread exits.
+class kis_slab_pool {
+public:
+    kis_slab_pool(size_t in_block_sz);
+
+    void *allocate();
+    void deallocate(void *in_block);
+
+    size_t get_block_size() { return block_sz; }
+
+    // Blocks currently handed out, including those sitting in thread caches
+    size_t get_num_used();
+    // Bytes allocated from the system for slabs
+    size_t get_slab_bytes();
+
+    // Free blocks held by one thread for this pool
+    struct thread_cache {
+        thread_cache() : head(NULL), count(0) { }
+
+        void *head;
+        size_t count;
+    };
+
+    // Move blocks between a thread cache and the shared free list
+    void refill(thread_cache& in_cache);
+    void spill(thread_cache& in_cache, size_t in_count);
+
+protected:
+    // This thread's cache for this pool, or NULL once the thread is exiting
+    thread_cache *local_cache();
+
+    pthread_mutex_t mutex;
+
+    size_t block_sz;
+    size_t blocks_per_slab;
+
+    // Position of our cache in each thread's cache list, and how many blocks
+    // move between a thread cache and the free list at a time
+    size_t pool_index;
+    size_t cache_batch;
+
+    // Free blocks are chained through their first word
+    void *free_list;
+
+    // Current slab and the offset of the next never-used block in it
+    char *cur_slab;
+    size_t cur_pos;
+
+    size_t num_used;
+    size_t num_slabs;
+};
+
+// Minimal allocator handing out single objects from a pool per type.
+//
+// Intended for use with std::allocate_shared, which rebinds the allocator to
+// its internal object-plus-refcount type; the element and its reference count
+// then live in one block from that type's pool instead of two separate heap
+// allocations.  Array allocations fall through to the normal heap.
+template<class T>
+class kis_slab_allocator {
+public:
+    typedef T value_type;
+
+    template<class U>
+    struct rebind {
+        typedef kis_slab_allocator<U> other;
+    };
+
+    kis_slab_allocator() { }
+
+    template<class U>
+    kis_slab_allocator(const kis_slab_allocator<U>& a __attribute__((unused))) { }
+
+    T *allocate(size_t n) {
+        if (n != 1)
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+
+        return static_cast<T *>(pool().allocate());
+    }
+
+    void deallocate(T *p, size_t n) {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+
+        pool().deallocate(p);
+    }
+
+    // One pool per allocated type; deliberately never destroyed so that
+    // elements released during static destruction at exit are still safe
+    static kis_slab_pool& pool() {
+        static kis_slab_pool *p = new kis_slab_pool(sizeof(T));
+        return *p;
+    }
+};
+
+template<class T, class U>
+bool operator==(const kis_slab_allocator<T>& a __attribute__((unused)),
+        const kis_slab_allocator<U>& b __attribute__((unused))) {
+    return true;
+}
+
+template<class T, class U>
+bool operator!=(const kis_slab_allocator<T>& a __attribute__((unused)),
+        const kis_slab_allocator<U>& b __attribute__((unused))) {
+    return false;
+}
+
+#endif
+
@@ -0,0 +1,121 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <unordered_map>
+
+#include "util.h"
+#include "kis_string_pool.h"
+
+struct string_pool_state {
+    string_pool_state() {
+        pthread_mutex_init(&mutex, NULL);
+        num_bytes = 0;
+        num_lookups = 0;
+        num_hits = 0;
+    }
+
+    pthread_mutex_t mutex;
+
+    std::unordered_map<std::string, unsigned int> strings;
+
+    size_t num_bytes;
+    uint64_t num_lookups;
+    uint64_t num_hits;
+};
+
+// Deliberately never destroyed, see kis_string_pool
+static string_pool_state& pool_state() {
+    static string_pool_state *s = new string_pool_state();
+    return *s;
+}
+
+const kis_string_pool::entry *kis_string_pool::acquire(const std::string& in_str) {
+    if (in_str.length() == 0)
+        return NULL;
+
+    string_pool_state& s = pool_state();
+
+    local_locker lock(&s.mutex);
+
+    s.num_lookups++;
+
+    std::unordered_map<std::string, unsigned int>::iterator i = 
+        s.strings.find(in_str);
+
+    if (i != s.strings.end()) {
+        s.num_hits++;
+        i->second++;
+        return &(*i);
+    }
+
+    i = s.strings.insert(std::make_pair(in_str, 1)).first;
+    s.num_bytes += in_str.length();
+
+    return &(*i);
+}
+
+void kis_string_pool::retain(const entry *in_entry) {
+    if (in_entry == NULL)
+        return;
+
+    string_pool_state& s = pool_state();
+
+    local_locker lock(&s.mutex);
+
+    // Entries are owned by the pool map, which only hands out const
+    // pointers to keep the key safe; the count is ours to change
+    const_cast<entry *>(in_entry)->second++;
+}
+
+void kis_string_pool::release(const entry *in_entry) {
+    if (in_entry == NULL)
+        return;
+
+    string_pool_state& s = pool_state();
+
+    local_locker lock(&s.mutex);
+
+    if (--(const_cast<entry *>(in_entry)->second) > 0)
+        return;
+
+    // Look the node up by its own key and erase by position; erasing by
+    // key would hold a reference into the node being destroyed
+    std::unordered_map<std::string, unsigned int>::iterator i = 
+        s.strings.find(in_entry->first);
+
+    if (i == s.strings.end())
+        return;
+
+    s.num_bytes -= i->first.length();
+    s.strings.erase(i);
+}
+
+void kis_string_pool::get_stats(size_t *num_strings, size_t *num_bytes,
+        uint64_t *num_lookups, uint64_t *num_hits) {
+    string_pool_state& s = pool_state();
+
+    local_locker lock(&s.mutex);
+
+    *num_strings = s.strings.size();
+    *num_bytes = s.num_bytes;
+    *num_lookups = s.num_lookups;
+    *num_hits = s.num_hits;
+}
+
@@ -0,0 +1,63 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_STRING_POOL_H__
+#define __KIS_STRING_POOL_H__
+
+#include "config.hpp"
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <utility>
+
+// Global pool of interned strings.
+//
+// Many tracked strings - manufacturers, phy names, channels, SSIDs - repeat
+// across thousands of devices.  Interning stores one reference-counted copy
+// of each distinct value; holders (interned TrackerString elements) keep a
+// pointer to the shared entry, so equal values share storage.
+//
+// Entries are released when the last reference goes away.  The pool is
+// process-wide and is never destroyed, so entries held by objects released
+// during static destruction stay valid.
+class kis_string_pool {
+public:
+    // The string and its reference count; entries are the nodes of the pool
+    // map and do not move once created
+    typedef std::pair<const std::string, unsigned int> entry;
+
+    // Find or create the entry for a string and take a reference to it.
+    // Empty strings are not pooled and return NULL.
+    static const entry *acquire(const std::string& in_str);
+
+    // Take an additional reference to an existing entry
+    static void retain(const entry *in_entry);
+
+    // Drop a reference, removing the entry when it is no longer used
+    static void release(const entry *in_entry);
+
+    // Distinct strings in the pool, the bytes used by their contents, and
+    // how many acquire calls there have been and how many found an
+    // existing entry
+    static void get_stats(size_t *num_strings, size_t *num_bytes,
+            uint64_t *num_lookups, uint64_t *num_hits);
+};
+
+#endif
+
@@ -0,0 +1,260 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.hpp"
+
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdexcept>
+#include <sstream>
+
+#include "util.h"
+#include "messagebus.h"
+#include "configfile.h"
+#include "kis_threadpool.h"
+
+Kis_Thread_Pool::Kis_Thread_Pool(GlobalRegistry *in_globalreg) {
+    globalreg = in_globalreg;
+
+    pthread_mutex_init(&job_mutex, NULL);
+    pthread_mutex_init(&state_mutex, NULL);
+    pthread_cond_init(&job_cond, NULL);
+    pthread_cond_init(&done_cond, NULL);
+
+    job_generation = 0;
+    active_workers = 0;
+    shutdown = false;
+    job_error = false;
+
+    // Default to one thread per CPU, counting the caller
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 1)
+        ncpus = 1;
+
+    unsigned int nthreads =
+        globalreg->kismet_config->FetchOptUInt("worker_threads", (unsigned int) ncpus);
+
+    if (nthreads < 1)
+        nthreads = 1;
+
+    // Slot 0 is always the calling thread
+    for (unsigned int s = 0; s < nthreads; s++)
+        queues.push_back(new slot_queue());
+
+    for (unsigned int s = 1; s < nthreads; s++) {
+        thread_aux *aux = new thread_aux();
+        aux->pool = this;
+        aux->slot = s;
+
+        pthread_t t;
+        if (pthread_create(&t, NULL, Kis_Thread_Pool::thread_main, aux) != 0) {
+            _MSG("Failed to create worker thread: " + kis_strerror_r(errno),
+                    MSGFLAG_ERROR);
+            delete aux;
+            break;
+        }
+
+        threads.push_back(t);
+        thread_auxes.push_back(aux);
+    }
+
+    stringstream ss;
+    ss << "Using " << get_num_slots() << " worker thread(s) for device processing";
+    _MSG(ss.str(), MSGFLAG_INFO);
+}
+
+Kis_Thread_Pool::~Kis_Thread_Pool() {
+    globalreg->RemoveGlobal("THREAD_POOL");
+
+    pthread_mutex_lock(&state_mutex);
+    shutdown = true;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&state_mutex);
+
+    for (unsigned int t = 0; t < threads.size(); t++)
+        pthread_join(threads[t], NULL);
+
+    for (unsigned int t = 0; t < thread_auxes.size(); t++)
+        delete thread_auxes[t];
+
+    for (unsigned int q = 0; q < queues.size(); q++)
+        delete queues[q];
+
+    pthread_cond_destroy(&done_cond);
+    pthread_cond_destroy(&job_cond);
+    pthread_mutex_destroy(&state_mutex);
+    pthread_mutex_destroy(&job_mutex);
+}
+
+void *Kis_Thread_Pool::thread_main(void *aux) {
+    thread_aux *taux = (thread_aux *) aux;
+
+    // Leave signal handling to the main thread
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    taux->pool->worker_loop(taux->slot);
+
+    return NULL;
+}
+
+void Kis_Thread_Pool::worker_loop(unsigned int in_slot) {
+    uint64_t seen_generation = 0;
+
+    while (1) {
+        range_func f;
+
+        pthread_mutex_lock(&state_mutex);
+
+        while (!shutdown && job_generation == seen_generation)
+            pthread_cond_wait(&job_cond, &state_mutex);
+
+        if (shutdown) {
+            pthread_mutex_unlock(&state_mutex);
+            break;
+        }
+
+        seen_generation = job_generation;
+        f = job_func;
+
+        pthread_mutex_unlock(&state_mutex);
+
+        run_chunks(in_slot, f);
+
+        pthread_mutex_lock(&state_mutex);
+        if (--active_workers == 0)
+            pthread_cond_signal(&done_cond);
+        pthread_mutex_unlock(&state_mutex);
+    }
+}
+
+bool Kis_Thread_Pool::take_chunk(unsigned int in_slot,
+        std::pair<size_t, size_t>& ret_chunk) {
+
+    slot_queue *q = queues[in_slot];
+
+    pthread_mutex_lock(&q->mutex);
+    if (q->chunks.size() != 0) {
+        ret_chunk = q->chunks.front();
+        q->chunks.pop_front();
+        pthread_mutex_unlock(&q->mutex);
+        return true;
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    // Steal from the end of someone else's queue, which is the work furthest
+    // from where they're currently working
+    for (unsigned int o = 1; o < queues.size(); o++) {
+        slot_queue *vq = queues[(in_slot + o) % queues.size()];
+
+        pthread_mutex_lock(&vq->mutex);
+        if (vq->chunks.size() != 0) {
+            ret_chunk = vq->chunks.back();
+            vq->chunks.pop_back();
+            pthread_mutex_unlock(&vq->mutex);
+            return true;
+        }
+        pthread_mutex_unlock(&vq->mutex);
+    }
+
+    return false;
+}
+
+void Kis_Thread_Pool::run_chunks(unsigned int in_slot, range_func& in_func) {
+    std::pair<size_t, size_t> chunk;
+
+    while (take_chunk(in_slot, chunk)) {
+        try {
+            in_func(chunk.first, chunk.second, in_slot);
+        } catch (const std::exception& e) {
+            pthread_mutex_lock(&state_mutex);
+            if (!job_error) {
+                job_error = true;
+                job_error_msg = e.what();
+            }
+            pthread_mutex_unlock(&state_mutex);
+        }
+    }
+}
+
+void Kis_Thread_Pool::parallel_for(size_t in_count, size_t in_chunk,
+        range_func in_func) {
+
+    if (in_count == 0)
+        return;
+
+    if (in_chunk == 0)
+        in_chunk = 1;
+
+    // Not worth waking anyone up
+    if (threads.size() == 0 || in_count <= in_chunk) {
+        in_func(0, in_count, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&job_mutex);
+
+    // Deal the chunks out in contiguous blocks per slot so each thread starts
+    // with neighboring work
+    size_t nchunks = (in_count + in_chunk - 1) / in_chunk;
+    size_t per_slot = (nchunks + queues.size() - 1) / queues.size();
+
+    for (size_t c = 0; c < nchunks; c++) {
+        size_t start = c * in_chunk;
+        size_t end = start + in_chunk;
+
+        if (end > in_count)
+            end = in_count;
+
+        slot_queue *q = queues[c / per_slot];
+
+        pthread_mutex_lock(&q->mutex);
+        q->chunks.push_back(std::make_pair(start, end));
+        pthread_mutex_unlock(&q->mutex);
+    }
+
+    pthread_mutex_lock(&state_mutex);
+    job_func = in_func;
+    job_error = false;
+    job_error_msg = "";
+    active_workers = threads.size();
+    job_generation++;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&state_mutex);
+
+    run_chunks(0, in_func);
+
+    pthread_mutex_lock(&state_mutex);
+    while (active_workers > 0)
+        pthread_cond_wait(&done_cond, &state_mutex);
+
+    job_func = NULL;
+
+    bool err = job_error;
+    string err_msg = job_error_msg;
+
+    pthread_mutex_unlock(&state_mutex);
+
+    pthread_mutex_unlock(&job_mutex);
+
+    if (err)
+        throw std::runtime_error(err_msg);
+}
+
@@ -0,0 +1,123 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_THREADPOOL_H__
+#define __KIS_THREADPOOL_H__
+
+#include "config.hpp"
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "globalregistry.h"
+
+// Shared work-stealing thread pool for splitting large loops (such as
+// matching against every device) across CPUs.
+//
+// A range is cut into chunks which are dealt out in contiguous blocks to one
+// queue per thread; each thread works from the front of its own queue and
+// steals from the back of another queue when it runs dry, so uneven chunk cost
+// doesn't leave threads idle.
+//
+// The calling thread always participates as slot 0.  Each thread is given a
+// slot number which is stable for the duration of a parallel_for call, so
+// callers can keep per-slot results without locking.
+class Kis_Thread_Pool : public LifetimeGlobal {
+public:
+    static shared_ptr<Kis_Thread_Pool> create_threadpool(GlobalRegistry *in_globalreg) {
+        shared_ptr<Kis_Thread_Pool> mon(new Kis_Thread_Pool(in_globalreg));
+        in_globalreg->RegisterLifetimeGlobal(mon);
+        in_globalreg->InsertGlobal("THREAD_POOL", mon);
+        return mon;
+    }
+
+private:
+    Kis_Thread_Pool(GlobalRegistry *in_globalreg);
+
+public:
+    virtual ~Kis_Thread_Pool();
+
+    // Function called with [start, end) and the slot of the executing thread
+    typedef std::function<void (size_t, size_t, unsigned int)> range_func;
+
+    // Number of execution slots, including the calling thread
+    unsigned int get_num_slots() { return threads.size() + 1; }
+
+    // Run in_func over [0, in_count) in chunks of up to in_chunk, blocking until
+    // every chunk is complete.  Only one range runs on the pool at a time.
+    // If in_func throws, the remaining chunks are still processed and the first
+    // error is re-thrown as a std::runtime_error once the range is complete.
+    void parallel_for(size_t in_count, size_t in_chunk, range_func in_func);
+
+protected:
+    GlobalRegistry *globalreg;
+
+    class slot_queue {
+    public:
+        slot_queue() {
+            pthread_mutex_init(&mutex, NULL);
+        }
+
+        ~slot_queue() {
+            pthread_mutex_destroy(&mutex);
+        }
+
+        pthread_mutex_t mutex;
+        std::deque<std::pair<size_t, size_t> > chunks;
+    };
+
+    class thread_aux {
+    public:
+        Kis_Thread_Pool *pool;
+        unsigned int slot;
+    };
+
+    vector<pthread_t> threads;
+    vector<thread_aux *> thread_auxes;
+    vector<slot_queue *> queues;
+
+    // Serializes parallel_for callers
+    pthread_mutex_t job_mutex;
+
+    // Job state; workers wait for the generation to change
+    pthread_mutex_t state_mutex;
+    pthread_cond_t job_cond;
+    pthread_cond_t done_cond;
+
+    uint64_t job_generation;
+    unsigned int active_workers;
+    bool shutdown;
+    range_func job_func;
+
+    bool job_error;
+    string job_error_msg;
+
+    static void *thread_main(void *aux);
+    void worker_loop(unsigned int in_slot);
+
+    // Pop from our own queue, or steal from the back of another
+    bool take_chunk(unsigned int in_slot, std::pair<size_t, size_t>& ret_chunk);
+
+    void run_chunks(unsigned int in_slot, range_func& in_func);
+};
+
+#endif
+
@@ -76,6 +76,7 @@
 #include "gps_manager.h"
 
 #include "devicetracker.h"
+#include "kis_threadpool.h"
 #include "phy_80211.h"
 #include "phy_rtl433.h"
 #include "phy_zwave.h"
@@ -840,6 +841,11 @@ int main(int argc, char *argv[], char *envp[]) {
     entrytracker->RegisterSerializer("cmd", shared_ptr<TrackerElementSerializer>(new MsgpackAdapter::Serializer(globalregistry)));
     entrytracker->RegisterSerializer("jcmd", shared_ptr<TrackerElementSerializer>(new JsonAdapter::Serializer(globalregistry)));
 
+    // Compact formats key fields by id; clients decode them with the map
+    // from /system/tracked_fields
+    entrytracker->RegisterSerializer("cmsgpack", shared_ptr<TrackerElementSerializer>(new MsgpackAdapter::Serializer(globalregistry, true)));
+    entrytracker->RegisterSerializer("cjson", shared_ptr<TrackerElementSerializer>(new JsonAdapter::Serializer(globalregistry, true)));
+
 
     if (daemonize) {
         if (fork() != 0) {
@@ -888,6 +894,12 @@ int main(int argc, char *argv[], char *envp[]) {
     // Create the alert tracker
     Alertracker::create_alertracker(globalregistry);
 
+    if (globalregistry->fatal_condition)
+        CatchShutdown(-1);
+
+    // Create the shared worker thread pool used by the device tracker
+    Kis_Thread_Pool::create_threadpool(globalregistry);
+
     if (globalregistry->fatal_condition)
         CatchShutdown(-1);
 
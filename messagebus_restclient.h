@@ -47,7 +47,7 @@ public:
         }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new tracked_message(globalreg, get_id()));
+        return AllocTrackedElement<tracked_message>(globalreg, get_id());
     }
 
     __Proxy(message, string, string, string, message);
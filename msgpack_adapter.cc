@@ -35,9 +35,48 @@
 #include "devicetracker_component.h"
 #include "msgpack_adapter.h"
 
-void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
-        msgpack::packer<std::stringstream> &o,
-        TrackerElementSerializer::rename_map *name_map) {
+// Write a record projected through a summary plan straight from the record,
+// the same as the simplified map SummarizeTrackerElement would have built
+static void msgpack_pack_summary(GlobalRegistry *globalreg,
+        const SharedTrackerElement& in_elem, const TrackerElementSummaryPlan& in_plan,
+        MsgpackAdapter::BufferPacker &o,
+        TrackerElementSerializer::rename_map *name_map, bool compact) {
+    vector<TrackerElementSummaryPlan::resolved_field> resolved;
+
+    in_plan.resolve(in_elem, resolved);
+
+    o.pack_array(2);
+    o.pack((int) TrackerMap);
+    o.pack_map(resolved.size());
+
+    for (size_t x = 0; x < resolved.size(); x++) {
+        const TrackerElementSummaryPlan::resolved_field &r = resolved[x];
+
+        if (r.elem == NULL) {
+            o.pack(r.plan_field->missing_name);
+            o.pack_array(2);
+            o.pack((int) TrackerUInt8);
+            o.pack((uint8_t) 0);
+            continue;
+        }
+
+        string tname;
+
+        if (r.plan_field->rename.length() != 0)
+            o.pack(r.plan_field->rename);
+        else if ((tname = r.elem->get_local_name()) != "")
+            o.pack(tname);
+        else if (compact)
+            o.pack(r.elem->get_id());
+        else
+            o.pack(globalreg->entrytracker->GetFieldNameRef(r.elem->get_id()));
+
+        MsgpackAdapter::Packer(globalreg, r.elem, o, name_map, compact);
+    }
+}
+
+void MsgpackAdapter::Packer(GlobalRegistry *globalreg, const SharedTrackerElement& v,
+        BufferPacker &o, TrackerElementSerializer::rename_map *name_map, bool compact) {
 
     if (v == NULL) {
         o.pack_array(2);
@@ -46,6 +85,15 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
         return;
     }
 
+    // Summarized records are written straight from the original record
+    TrackerElementSummaryRef *summary_ref = v->get_summary_ref();
+
+    if (summary_ref != NULL) {
+        msgpack_pack_summary(globalreg, summary_ref->get_summarized_element(),
+                *(summary_ref->get_plan()), o, name_map, compact);
+        return;
+    }
+
     // If we have a rename map, find out if we've got a pathed element that needs
     // to be custom-serialized
     if (name_map != NULL) {
@@ -60,9 +108,16 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
     }
 
     o.pack_array(2);
-    o.pack((int) v->get_type());
+
+    // Int64 vectors are an internal storage format; on the wire they're the
+    // same vector of typed int64s they have always been
+    if (v->get_type() == TrackerInt64Vector)
+        o.pack((int) TrackerVector);
+    else
+        o.pack((int) v->get_type());
 
     TrackerElement::tracked_vector *tvec;
+    TrackerElement::tracked_int64_vector *tint64vec;
     unsigned int x;
 
     TrackerElement::tracked_map *tmap;
@@ -134,7 +189,18 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
 
             o.pack_array(v->size());
             for (x = 0; x < tvec->size(); x++) {
-                Packer(globalreg, (*tvec)[x], o, name_map);
+                Packer(globalreg, (*tvec)[x], o, name_map, compact);
+            }
+
+            break;
+        case TrackerInt64Vector:
+            tint64vec = v->get_int64_vector();
+
+            o.pack_array(tint64vec->size());
+            for (x = 0; x < tint64vec->size(); x++) {
+                o.pack_array(2);
+                o.pack((int) TrackerInt64);
+                o.pack((*tint64vec)[x]);
             }
 
             break;
@@ -152,11 +218,13 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
                     if (map_iter->second != NULL &&
                             (tname = map_iter->second->get_local_name()) != "")
                         o.pack(tname);
+                    else if (compact)
+                        o.pack(map_iter->first);
                     else
-                        o.pack(globalreg->entrytracker->GetFieldName(map_iter->first));
+                        o.pack(globalreg->entrytracker->GetFieldNameRef(map_iter->first));
                 }
 
-                Packer(globalreg, map_iter->second, o, name_map);
+                Packer(globalreg, map_iter->second, o, name_map, compact);
             }
             break;
         case TrackerIntMap:
@@ -165,7 +233,7 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
             for (int_map_iter = tintmap->begin(); int_map_iter != tintmap->end(); 
                     ++int_map_iter) {
                 o.pack(int_map_iter->first);
-                Packer(globalreg, int_map_iter->second, o, name_map);
+                Packer(globalreg, int_map_iter->second, o, name_map, compact);
             }
             break;
         case TrackerMacMap:
@@ -177,7 +245,7 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
                 // Macmaps need to go out as just the mac string,
                 // not a vector of mac+mask
                 o.pack(mac_map_iter->first.MacFull2String());
-                Packer(globalreg, mac_map_iter->second, o, name_map);
+                Packer(globalreg, mac_map_iter->second, o, name_map, compact);
             }
             break;
         case TrackerStringMap:
@@ -187,7 +255,7 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
                     string_map_iter != tstringmap->end();
                     ++string_map_iter) {
                 o.pack(string_map_iter->first);
-                Packer(globalreg, string_map_iter->second, o, name_map);
+                Packer(globalreg, string_map_iter->second, o, name_map, compact);
             }
             break;
         case TrackerDoubleMap:
@@ -197,7 +265,7 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
                     double_map_iter != tdoublemap->end();
                     ++double_map_iter) {
                 o.pack(double_map_iter->first);
-                Packer(globalreg, double_map_iter->second, o, name_map);
+                Packer(globalreg, double_map_iter->second, o, name_map, compact);
             }
             break;
         case TrackerByteArray:
@@ -215,9 +283,65 @@ void MsgpackAdapter::Packer(GlobalRegistry *globalreg, SharedTrackerElement v,
 }
 
 void MsgpackAdapter::Pack(GlobalRegistry *globalreg, std::stringstream &stream,
-        SharedTrackerElement e, TrackerElementSerializer::rename_map *name_map) {
-    msgpack::packer<std::stringstream> packer(&stream);
-    Packer(globalreg, e, packer, name_map);
+        const SharedTrackerElement& e, TrackerElementSerializer::rename_map *name_map,
+        bool compact) {
+    string buf;
+    buf.reserve(4096);
+
+    PackBuffer(globalreg, buf, e, name_map, compact);
+
+    stream.write(buf.data(), buf.length());
+}
+
+void MsgpackAdapter::PackBuffer(GlobalRegistry *globalreg, string &buf,
+        const SharedTrackerElement& e, TrackerElementSerializer::rename_map *name_map,
+        bool compact) {
+    StringBuffer sbuf(buf);
+    BufferPacker packer(&sbuf);
+
+    Packer(globalreg, e, packer, name_map, compact);
+}
+
+void MsgpackAdapter::Serializer::serialize_vector_open(std::stringstream &stream,
+        size_t in_count, const string& in_wrapper_key) {
+    msgpack::packer<std::stringstream> o(&stream);
+
+    if (in_wrapper_key != "") {
+        o.pack_array(2);
+        o.pack((int) TrackerMap);
+        o.pack_map(1);
+        o.pack(in_wrapper_key);
+    }
+
+    o.pack_array(2);
+    o.pack((int) TrackerVector);
+    o.pack_array(in_count);
+}
+
+void MsgpackAdapter::Serializer::serialize_vector_element(std::stringstream &stream,
+        size_t in_index __attribute__((unused)), const SharedTrackerElement& in_elem, 
+        rename_map *name_map) {
+    Pack(globalreg, stream, in_elem, name_map, compact);
+}
+
+void MsgpackAdapter::Serializer::serialize_vector_summary(std::stringstream &stream,
+        size_t in_index __attribute__((unused)), const SharedTrackerElement& in_elem,
+        const shared_ptr<TrackerElementSummaryPlan>& in_plan) {
+    string buf;
+    buf.reserve(1024);
+
+    StringBuffer sbuf(buf);
+    BufferPacker o(&sbuf);
+
+    msgpack_pack_summary(globalreg, in_elem, *in_plan, o, NULL, compact);
+
+    stream.write(buf.data(), buf.length());
+}
+
+void MsgpackAdapter::Serializer::serialize_vector_close(
+        std::stringstream &stream __attribute__((unused)),
+        const string& in_wrapper_key __attribute__((unused))) {
+    // Msgpack arrays and maps are sized up front, there's nothing to close
 }
 
 void MsgpackAdapter::AsStringVector(msgpack::object &obj, 
@@ -38,23 +38,65 @@ namespace MsgpackAdapter {
 
 typedef map<string, msgpack::object> MsgpackStrMap;
 
-void Packer(GlobalRegistry *globalreg, SharedTrackerElement v, 
-        msgpack::packer<std::stringstream> &packer,
-        TrackerElementSerializer::rename_map *name_map = NULL);
+// Output for msgpack::packer which appends to a string, so packing writes
+// into one contiguous buffer instead of going through iostream writes
+class StringBuffer {
+public:
+    StringBuffer(string &in_buf) : buf(in_buf) { }
+
+    void write(const char *in_data, size_t in_len) {
+        buf.append(in_data, in_len);
+    }
+
+protected:
+    string &buf;
+};
+
+typedef msgpack::packer<StringBuffer> BufferPacker;
+
+// In compact mode, tracked fields are keyed by their field ID instead of
+// their name; fields with a local name or a summary rename keep the name
+void Packer(GlobalRegistry *globalreg, const SharedTrackerElement& v, 
+        BufferPacker &packer,
+        TrackerElementSerializer::rename_map *name_map = NULL,
+        bool compact = false);
 
 void Pack(GlobalRegistry *globalreg, std::stringstream &stream, 
-        SharedTrackerElement e, 
-        TrackerElementSerializer::rename_map *name_map = NULL);
+        const SharedTrackerElement& e, 
+        TrackerElementSerializer::rename_map *name_map = NULL,
+        bool compact = false);
+
+// Pack directly into a buffer, appending to anything already in it
+void PackBuffer(GlobalRegistry *globalreg, string &buf,
+        const SharedTrackerElement& e,
+        TrackerElementSerializer::rename_map *name_map = NULL,
+        bool compact = false);
 
 class Serializer : public TrackerElementSerializer {
 public:
-    Serializer(GlobalRegistry *in_globalreg) :
-        TrackerElementSerializer(in_globalreg) { }
+    Serializer(GlobalRegistry *in_globalreg, bool in_compact = false) :
+        TrackerElementSerializer(in_globalreg),
+        compact(in_compact) { }
 
-    virtual void serialize(SharedTrackerElement in_elem, std::stringstream &stream,
+    virtual void serialize(const SharedTrackerElement& in_elem, std::stringstream &stream,
             rename_map *name_map = NULL) {
-        Pack(globalreg, stream, in_elem, name_map);
+        Pack(globalreg, stream, in_elem, name_map, compact);
     }
+
+    virtual bool can_stream_vector() { return true; }
+
+    virtual void serialize_vector_open(std::stringstream &stream, size_t in_count,
+            const string& in_wrapper_key);
+    virtual void serialize_vector_element(std::stringstream &stream, size_t in_index,
+            const SharedTrackerElement& in_elem, rename_map *name_map = NULL);
+    virtual void serialize_vector_summary(std::stringstream &stream, size_t in_index,
+            const SharedTrackerElement& in_elem,
+            const shared_ptr<TrackerElementSummaryPlan>& in_plan);
+    virtual void serialize_vector_close(std::stringstream &stream,
+            const string& in_wrapper_key);
+
+protected:
+    bool compact;
 };
 
 // Convert to std::vector<std::string>.  MAY THROW EXCEPTIONS.
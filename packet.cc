@@ -34,6 +34,7 @@
 #include "packetchain.h"
 #include "macaddr.h"
 #include "packet_ieee80211.h"
+#include "kis_mem_account.h"
 
 kis_packet::kis_packet(GlobalRegistry *in_globalreg) {
 	globalreg = in_globalreg;
@@ -43,6 +44,9 @@ kis_packet::kis_packet(GlobalRegistry *in_globalreg) {
 
 	// Stock and init the content vector
 	content_vec.resize(MAX_PACKET_COMPONENTS, NULL);
+
+	kis_mem_account::add(KIS_MEM_PACKETCHAIN, 1, sizeof(kis_packet) +
+			MAX_PACKET_COMPONENTS * sizeof(packet_component *));
 	/*
 	   for (unsigned int y = 0; y < MAX_PACKET_COMPONENTS; y++)
 	   content_vec[y] = NULL;
@@ -50,6 +54,9 @@ kis_packet::kis_packet(GlobalRegistry *in_globalreg) {
 }
 
 kis_packet::~kis_packet() {
+	kis_mem_account::add(KIS_MEM_PACKETCHAIN, -1, -((int64_t) (sizeof(kis_packet) +
+			MAX_PACKET_COMPONENTS * sizeof(packet_component *))));
+
 	// Delete everything we contain when we die.  I hope whomever put
 	// it there expected this.
 	for (unsigned int y = 0; y < MAX_PACKET_COMPONENTS; y++) {
@@ -115,7 +115,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new kis_tracked_packet(globalreg, get_id()));
+        return AllocTrackedElement<kis_tracked_packet>(globalreg, get_id());
     }
 
     __Proxy(ts_sec, uint64_t, time_t, time_t, ts_sec);
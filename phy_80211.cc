@@ -700,10 +700,15 @@ void Kis_80211_Phy::HandleSSID(shared_ptr<kis_tracked_device_base> basedev,
 
             ssid->set_beacon_info(dot11info->beacon_info);
 
-            ssid->set_wps_state(dot11info->wps);
-            ssid->set_wps_manuf(dot11info->wps_manuf);
-            ssid->set_wps_model_name(dot11info->wps_model_name);
-            ssid->set_wps_model_number(dot11info->wps_model_number);
+            // WPS fields are dynamic; only create them if we saw WPS
+            if (dot11info->wps)
+                ssid->set_wps_state(dot11info->wps);
+            if (dot11info->wps_manuf != "")
+                ssid->set_wps_manuf(dot11info->wps_manuf);
+            if (dot11info->wps_model_name != "")
+                ssid->set_wps_model_name(dot11info->wps_model_name);
+            if (dot11info->wps_model_number != "")
+                ssid->set_wps_model_number(dot11info->wps_model_number);
 
             // Do we not know the basedev manuf?
             if (basedev->get_manuf() == "" && dot11info->wps_manuf != "")
@@ -1159,6 +1164,7 @@ void Kis_80211_Phy::HandleClient(shared_ptr<kis_tracked_device_base> basedev,
                     backdot11->get_associated_client_map()->mac_end()) {
 
                 backdot11->get_associated_client_map()->add_macmap(basedev->get_macaddr(), basedev->get_tracker_key());
+                devicetracker->MarkPacketDeviceModified(in_pack, backdev);
             }
         }
     }
@@ -1425,6 +1431,8 @@ int Kis_80211_Phy::TrackerDot11(kis_packet *in_pack) {
                     }
 
                     eapoldot11->set_wpa_present_handshake(keymask);
+
+                    devicetracker->MarkPacketDeviceModified(in_pack, eapolbase);
                 }
             }
         }
@@ -1435,16 +1443,19 @@ int Kis_80211_Phy::TrackerDot11(kis_packet *in_pack) {
 		int wps = 0;
 		string ssidchan = "0";
 		string ssidtxt = "<Unknown>";
-        TrackerElementIntMap ssidmap(dot11dev->get_advertised_ssid_map());
-
-        for (TrackerElementIntMap::iterator si = ssidmap.begin();
-                si != ssidmap.end(); ++si) {
-            shared_ptr<dot11_advertised_ssid> ssid = 
-                static_pointer_cast<dot11_advertised_ssid>(si->second);
-            if (ssid->get_crypt_set() & crypt_wps) {
-                ssidchan = ssid->get_channel();
-                ssidtxt = ssid->get_ssid();
-                break;
+
+        if (dot11dev->get_tracker_advertised_ssid_map() != NULL) {
+            TrackerElementIntMap ssidmap(dot11dev->get_tracker_advertised_ssid_map());
+
+            for (TrackerElementIntMap::iterator si = ssidmap.begin();
+                    si != ssidmap.end(); ++si) {
+                shared_ptr<dot11_advertised_ssid> ssid = 
+                    static_pointer_cast<dot11_advertised_ssid>(si->second);
+                if (ssid->get_crypt_set() & crypt_wps) {
+                    ssidchan = ssid->get_channel();
+                    ssidtxt = ssid->get_ssid();
+                    break;
+                }
             }
         }
 
@@ -1774,8 +1785,9 @@ void Kis_80211_Phy::GenerateHandshakePcap(shared_ptr<kis_tracked_device_base> de
         shared_ptr<dot11_tracked_device> dot11dev =
             static_pointer_cast<dot11_tracked_device>(dev->get_map_value(dot11_device_entry_id));
 
-        if (dot11dev != NULL) {
-            TrackerElementVector hsvec(dot11dev->get_wpa_key_vec());
+        // No handshake vector if we've never seen a handshake
+        if (dot11dev != NULL && dot11dev->get_tracker_wpa_key_vec() != NULL) {
+            TrackerElementVector hsvec(dot11dev->get_tracker_wpa_key_vec());
 
             for (TrackerElementVector::iterator i = hsvec.begin(); 
                     i != hsvec.end(); ++i) {
@@ -1825,6 +1837,42 @@ void Kis_80211_Phy::GenerateHandshakePcap(shared_ptr<kis_tracked_device_base> de
     close(readfd);
 }
 
+bool Kis_80211_Phy::Httpd_GetObjectVersion(Kis_Net_Httpd *httpd,
+        Kis_Net_Httpd_Connection *connection, const char *url,
+        uint64_t *ret_version) {
+
+    vector<string> tokenurl = StrTokenize(url, "/");
+
+    if (tokenurl.size() < 6)
+        return false;
+
+    if (tokenurl[1] != "phy" || tokenurl[2] != "phy80211" || 
+            tokenurl[3] != "handshake")
+        return false;
+
+    mac_addr dmac(tokenurl[4]);
+    if (dmac.error)
+        return false;
+
+    if (tokenurl[5] != tokenurl[4] + "-handshake.pcap")
+        return false;
+
+    // Without a login, fall through to the normal response which asks for one
+    if (!httpd->HasValidSession(connection, false))
+        return false;
+
+    devicelist_scope_locker dlocker(devicetracker);
+
+    shared_ptr<kis_tracked_device_base> dev = devicetracker->FetchDevice(dmac, phyid);
+
+    if (dev == NULL)
+        return false;
+
+    *ret_version = dev->get_mod_version();
+
+    return true;
+}
+
 void Kis_80211_Phy::Httpd_CreateStreamResponse(Kis_Net_Httpd *httpd,
         Kis_Net_Httpd_Connection *connection,
         const char *url, const char *method, const char *upload_data,
@@ -2014,7 +2062,7 @@ public:
 
     // Compare against our PCRE and export msgpack objects if we match
     virtual void MatchDevice(Devicetracker *devicetracker, 
-            shared_ptr<kis_tracked_device_base> device) {
+            const shared_ptr<kis_tracked_device_base>& device) {
 
         shared_ptr<dot11_tracked_device> dot11dev =
             static_pointer_cast<dot11_tracked_device>(device->get_map_value(dot11_device_entry_id));
@@ -2024,62 +2072,83 @@ public:
             return;
         }
 
-        // Iterate over all the SSID records
-        TrackerElementIntMap adv_ssid_map(dot11dev->get_advertised_ssid_map());
-        shared_ptr<dot11_advertised_ssid> ssid = NULL;
-        TrackerElementIntMap::iterator int_itr;
+        // The maps are dynamic and may not exist; don't create them here, we're
+        // running on the pool
+        SharedTrackerElement adv_ssid_elem = dot11dev->get_tracker_advertised_ssid_map();
+        SharedTrackerElement probe_elem = dot11dev->get_tracker_probed_ssid_map();
+        SharedTrackerElement client_elem = dot11dev->get_tracker_client_map();
 
-        for (int_itr = adv_ssid_map.begin(); int_itr != adv_ssid_map.end(); ++int_itr) {
-            // Always leave one
-            if (adv_ssid_map.size() <= 1)
-                break;
+        TrackerElementIntMap::iterator int_itr;
 
-            ssid = static_pointer_cast<dot11_advertised_ssid>(int_itr->second);
+        bool modified = false;
 
-            if (globalreg->timestamp.tv_sec - ssid->get_last_time() > timeout) {
-                fprintf(stderr, "debug - forgetting dot11ssid %s expiration %d\n", ssid->get_ssid().c_str(), timeout);
-                adv_ssid_map.erase(int_itr);
-                int_itr = adv_ssid_map.begin();
-                devicetracker->UpdateFullRefresh();
+        // Iterate over all the SSID records
+        if (adv_ssid_elem != NULL) {
+            TrackerElementIntMap adv_ssid_map(adv_ssid_elem);
+            shared_ptr<dot11_advertised_ssid> ssid = NULL;
+
+            for (int_itr = adv_ssid_map.begin(); int_itr != adv_ssid_map.end(); ++int_itr) {
+                // Always leave one
+                if (adv_ssid_map.size() <= 1)
+                    break;
+
+                ssid = static_pointer_cast<dot11_advertised_ssid>(int_itr->second);
+
+                if (globalreg->timestamp.tv_sec - ssid->get_last_time() > timeout) {
+                    fprintf(stderr, "debug - forgetting dot11ssid %s expiration %d\n", ssid->get_ssid().c_str(), timeout);
+                    adv_ssid_map.erase(int_itr);
+                    int_itr = adv_ssid_map.begin();
+                    devicetracker->UpdateFullRefresh();
+                    modified = true;
+                }
             }
         }
 
-        TrackerElementIntMap probe_map(dot11dev->get_probed_ssid_map());
-        shared_ptr<dot11_probed_ssid> pssid = NULL;
+        if (probe_elem != NULL) {
+            TrackerElementIntMap probe_map(probe_elem);
+            shared_ptr<dot11_probed_ssid> pssid = NULL;
 
-        for (int_itr = probe_map.begin(); int_itr != probe_map.end(); ++int_itr) {
-            // Always leave one
-            if (probe_map.size() <= 1)
-                break;
+            for (int_itr = probe_map.begin(); int_itr != probe_map.end(); ++int_itr) {
+                // Always leave one
+                if (probe_map.size() <= 1)
+                    break;
 
-            pssid = static_pointer_cast<dot11_probed_ssid>(int_itr->second);
+                pssid = static_pointer_cast<dot11_probed_ssid>(int_itr->second);
 
-            if (globalreg->timestamp.tv_sec - pssid->get_last_time() > timeout) {
-                fprintf(stderr, "debug - forgetting dot11probessid %s expiration %d\n", pssid->get_ssid().c_str(), timeout);
-                probe_map.erase(int_itr);
-                int_itr = probe_map.begin();
-                devicetracker->UpdateFullRefresh();
+                if (globalreg->timestamp.tv_sec - pssid->get_last_time() > timeout) {
+                    fprintf(stderr, "debug - forgetting dot11probessid %s expiration %d\n", pssid->get_ssid().c_str(), timeout);
+                    probe_map.erase(int_itr);
+                    int_itr = probe_map.begin();
+                    devicetracker->UpdateFullRefresh();
+                    modified = true;
+                }
             }
         }
 
-        TrackerElementMacMap client_map(dot11dev->get_client_map());
-        shared_ptr<dot11_client> client = NULL;
-        TrackerElementMacMap::iterator mac_itr;
+        if (client_elem != NULL) {
+            TrackerElementMacMap client_map(client_elem);
+            shared_ptr<dot11_client> client = NULL;
+            TrackerElementMacMap::iterator mac_itr;
 
-        for (mac_itr = client_map.begin(); mac_itr != client_map.end(); ++mac_itr) {
-            // Always leave one
-            if (client_map.size() <= 1)
-                break;
+            for (mac_itr = client_map.begin(); mac_itr != client_map.end(); ++mac_itr) {
+                // Always leave one
+                if (client_map.size() <= 1)
+                    break;
 
-            client = static_pointer_cast<dot11_client>(mac_itr->second);
+                client = static_pointer_cast<dot11_client>(mac_itr->second);
 
-            if (globalreg->timestamp.tv_sec - client->get_last_time() > timeout) {
-                fprintf(stderr, "debug - forgetting client link from %s to %s expiration %d\n", device->get_macaddr().Mac2String().c_str(), mac_itr->first.Mac2String().c_str(), timeout);
-                client_map.erase(mac_itr);
-                mac_itr = client_map.begin();
-                devicetracker->UpdateFullRefresh();
+                if (globalreg->timestamp.tv_sec - client->get_last_time() > timeout) {
+                    fprintf(stderr, "debug - forgetting client link from %s to %s expiration %d\n", device->get_macaddr().Mac2String().c_str(), mac_itr->first.Mac2String().c_str(), timeout);
+                    client_map.erase(mac_itr);
+                    mac_itr = client_map.begin();
+                    devicetracker->UpdateFullRefresh();
+                    modified = true;
+                }
             }
         }
+
+        if (modified)
+            devicetracker->MarkDeviceModified(device);
     }
 
 protected:
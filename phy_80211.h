@@ -243,7 +243,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new dot11_tracked_eapol(globalreg, get_id()));
+        return AllocTrackedElement<dot11_tracked_eapol>(globalreg, get_id());
     }
 
     __Proxy(eapol_time, uint64_t, time_t, time_t, eapol_time);
@@ -285,7 +285,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new dot11_11d_tracked_range_info(globalreg, get_id()));
+        return AllocTrackedElement<dot11_11d_tracked_range_info>(globalreg, get_id());
     }
 
 
@@ -324,10 +324,10 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new dot11_probed_ssid(globalreg, get_id()));
+        return AllocTrackedElement<dot11_probed_ssid>(globalreg, get_id());
     }
 
-    __Proxy(ssid, string, string, string, ssid);
+    __ProxyInterned(ssid, ssid);
     __Proxy(ssid_len, uint32_t, unsigned int, unsigned int, ssid_len);
     __Proxy(bssid, mac_addr, mac_addr, mac_addr, bssid);
     __Proxy(first_time, uint64_t, time_t, time_t, first_time);
@@ -356,8 +356,8 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            location.reset(new kis_tracked_location(globalreg, location_id, 
-                    e->get_map_value(location_id)));
+            location = AllocTrackedElement<kis_tracked_location>(globalreg, location_id, 
+                    e->get_map_value(location_id));
         }
 
         add_map(location_id, location);
@@ -394,16 +394,16 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new dot11_advertised_ssid(globalreg, get_id()));
+        return AllocTrackedElement<dot11_advertised_ssid>(globalreg, get_id());
     }
 
-    __Proxy(ssid, string, string, string, ssid);
+    __ProxyInterned(ssid, ssid);
     __Proxy(ssid_len, uint32_t, unsigned int, unsigned int, ssid_len);
 
     __Proxy(ssid_beacon, uint8_t, bool, bool, ssid_beacon);
     __Proxy(ssid_probe_response, uint8_t, bool, bool, ssid_probe_response);
 
-    __Proxy(channel, string, string, string, channel);
+    __ProxyInterned(channel, channel);
 
     __Proxy(first_time, uint64_t, time_t, time_t, first_time);
     __Proxy(last_time, uint64_t, time_t, time_t, last_time);
@@ -422,7 +422,7 @@ public:
 
     __Proxy(ietag_checksum, uint32_t, uint32_t, uint32_t, ietag_checksum);
 
-    __Proxy(dot11d_country, string, string, string, dot11d_country);
+    __ProxyInterned(dot11d_country, dot11d_country);
 
     __ProxyTrackable(dot11d_vec, TrackerElement, dot11d_vec);
 
@@ -432,7 +432,8 @@ public:
         d11vec.clear();
         
         for (unsigned int x = 0; x < vec.size(); x++) {
-            shared_ptr<dot11_11d_tracked_range_info> ri(new dot11_11d_tracked_range_info(globalreg, dot11d_country_entry_id));
+            shared_ptr<dot11_11d_tracked_range_info> ri =
+                AllocTrackedElement<dot11_11d_tracked_range_info>(globalreg, dot11d_country_entry_id);
             ri->set_startchan(vec[x].startchan);
             ri->set_numchan(vec[x].numchan);
             ri->set_txpower(vec[x].txpower);
@@ -441,11 +442,15 @@ public:
         }
     }
 
-    __Proxy(wps_state, uint32_t, uint32_t, uint32_t, wps_state);
-    __Proxy(wps_manuf, string, string, string, wps_manuf);
-    __Proxy(wps_device_name, string, string, string, wps_device_name);
-    __Proxy(wps_model_name, string, string, string, wps_model_name);
-    __Proxy(wps_model_number, string, string, string, wps_model_number);
+    // WPS fields only exist for SSIDs which advertise WPS
+    __ProxyDynamic(wps_state, uint32_t, uint32_t, uint32_t, wps_state, wps_state_id);
+    __ProxyDynamic(wps_manuf, string, string, string, wps_manuf, wps_manuf_id);
+    __ProxyDynamic(wps_device_name, string, string, string, 
+            wps_device_name, wps_device_name_id);
+    __ProxyDynamic(wps_model_name, string, string, string, 
+            wps_model_name, wps_model_name_id);
+    __ProxyDynamic(wps_model_number, string, string, string, 
+            wps_model_number, wps_model_number_id);
 
     __ProxyDynamicTrackable(location, kis_tracked_location, location, location_id);
 
@@ -489,16 +494,21 @@ protected:
         __RegisterComplexField(dot11_11d_tracked_range_info, dot11d_country_entry_id, 
                 "dot11.advertisedssid.dot11d_entry", "dot11d entry");
 
-        RegisterField("dot11.advertisedssid.wps_state", TrackerUInt32,
-                "bitfield wps state", &wps_state);
-        RegisterField("dot11.advertisedssid.wps_manuf", TrackerString,
-                "WPS manufacturer", &wps_manuf);
-        RegisterField("dot11.advertisedssid.wps_device_name", TrackerString,
-                "wps device name", &wps_device_name);
-        RegisterField("dot11.advertisedssid.wps_model_name", TrackerString,
-                "wps model name", &wps_model_name);
-        RegisterField("dot11.advertisedssid.wps_model_number", TrackerString,
-                "wps model number", &wps_model_number);
+        wps_state_id =
+            RegisterDynamicField("dot11.advertisedssid.wps_state", TrackerUInt32,
+                    "bitfield wps state", &wps_state);
+        wps_manuf_id =
+            RegisterDynamicField("dot11.advertisedssid.wps_manuf", TrackerString,
+                    "WPS manufacturer", &wps_manuf);
+        wps_device_name_id =
+            RegisterDynamicField("dot11.advertisedssid.wps_device_name", TrackerString,
+                    "wps device name", &wps_device_name);
+        wps_model_name_id =
+            RegisterDynamicField("dot11.advertisedssid.wps_model_name", TrackerString,
+                    "wps model name", &wps_model_name);
+        wps_model_number_id =
+            RegisterDynamicField("dot11.advertisedssid.wps_model_number", TrackerString,
+                    "wps model number", &wps_model_number);
 
         __RegisterComplexField(kis_tracked_location, location_id, 
                 "dot11.advertisedssid.location", "location");
@@ -508,8 +518,8 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            location.reset(new kis_tracked_location(globalreg, location_id, 
-                    e->get_map_value(location_id)));
+            location = AllocTrackedElement<kis_tracked_location>(globalreg, location_id, 
+                    e->get_map_value(location_id));
         }
 
         add_map(location_id, location);
@@ -537,10 +547,15 @@ protected:
 
     // WPS components
     SharedTrackerElement wps_state;
+    int wps_state_id;
     SharedTrackerElement wps_manuf;
+    int wps_manuf_id;
     SharedTrackerElement wps_device_name;
+    int wps_device_name_id;
     SharedTrackerElement wps_model_name;
+    int wps_model_name_id;
     SharedTrackerElement wps_model_number;
+    int wps_model_number_id;
 
     int location_id;
     shared_ptr<kis_tracked_location> location;
@@ -567,7 +582,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new dot11_client(globalreg, get_id()));
+        return AllocTrackedElement<dot11_client>(globalreg, get_id());
     }
 
     __Proxy(bssid, mac_addr, mac_addr, mac_addr, bssid);
@@ -657,10 +672,10 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            ipdata.reset(new kis_tracked_ip_data(globalreg, ipdata_id, 
-                    e->get_map_value(ipdata_id)));
-            location.reset(new kis_tracked_location(globalreg, location_id, 
-                    e->get_map_value(location_id)));
+            ipdata = AllocTrackedElement<kis_tracked_ip_data>(globalreg, ipdata_id, 
+                    e->get_map_value(ipdata_id));
+            location = AllocTrackedElement<kis_tracked_location>(globalreg, location_id, 
+                    e->get_map_value(location_id));
         }
 
         add_map(ipdata_id, ipdata);
@@ -726,7 +741,7 @@ public:
     }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new dot11_tracked_device(globalreg, get_id()));
+        return AllocTrackedElement<dot11_tracked_device>(globalreg, get_id());
     }
 
     dot11_tracked_device(GlobalRegistry *in_globalreg, int in_id, 
@@ -744,25 +759,33 @@ public:
     __Proxy(type_set, uint64_t, uint64_t, uint64_t, type_set);
     __ProxyBitset(type_set, uint64_t, type_set);
 
-    __ProxyTrackable(client_map, TrackerElement, client_map);
+    // Client, SSID, and association maps only exist once the device has 
+    // done something to fill them in; get_<map> creates the map, 
+    // get_tracker_<map> returns NULL if it doesn't exist yet
+    __ProxyDynamicTrackable(client_map, TrackerElement, client_map, client_map_id);
     shared_ptr<dot11_client> new_client() {
-        return shared_ptr<dot11_client>(new dot11_client(globalreg, client_map_entry_id));
+        return AllocTrackedElement<dot11_client>(globalreg, client_map_entry_id);
     }
 
-    __ProxyTrackable(advertised_ssid_map, TrackerElement, advertised_ssid_map);
+    __ProxyDynamicTrackable(advertised_ssid_map, TrackerElement, 
+            advertised_ssid_map, advertised_ssid_map_id);
     shared_ptr<dot11_advertised_ssid> new_advertised_ssid() {
-        return shared_ptr<dot11_advertised_ssid>(new dot11_advertised_ssid(globalreg, advertised_ssid_map_entry_id));
+        return AllocTrackedElement<dot11_advertised_ssid>(globalreg, advertised_ssid_map_entry_id);
     }
 
-    __ProxyTrackable(probed_ssid_map, TrackerElement, probed_ssid_map);
+    __ProxyDynamicTrackable(probed_ssid_map, TrackerElement, 
+            probed_ssid_map, probed_ssid_map_id);
     shared_ptr<dot11_probed_ssid> new_probed_ssid() {
-        return shared_ptr<dot11_probed_ssid>(new dot11_probed_ssid(globalreg, probed_ssid_map_entry_id));
+        return AllocTrackedElement<dot11_probed_ssid>(globalreg, probed_ssid_map_entry_id);
     }
 
-    __ProxyTrackable(associated_client_map, TrackerElement, associated_client_map);
+    __ProxyDynamicTrackable(associated_client_map, TrackerElement, 
+            associated_client_map, associated_client_map_id);
 
-    __Proxy(client_disconnects, uint64_t, uint64_t, uint64_t, client_disconnects);
-    __ProxyIncDec(client_disconnects, uint64_t, uint64_t, client_disconnects);
+    __ProxyDynamic(client_disconnects, uint64_t, uint64_t, uint64_t, 
+            client_disconnects, client_disconnects_id);
+    __ProxyDynamicIncDec(client_disconnects, uint64_t, uint64_t, 
+            client_disconnects, client_disconnects_id);
 
     __Proxy(last_sequence, uint64_t, uint64_t, uint64_t, last_sequence);
     __Proxy(bss_timestamp, uint64_t, uint64_t, uint64_t, bss_timestamp);
@@ -781,68 +804,74 @@ public:
 
     __Proxy(last_bssid, mac_addr, mac_addr, mac_addr, last_bssid);
 
-    __Proxy(last_probed_ssid, string, string, string, last_probed_ssid);
+    __ProxyInterned(last_probed_ssid, last_probed_ssid);
     __Proxy(last_probed_ssid_csum, uint32_t, uint32_t, 
             uint32_t, last_probed_ssid_csum);
 
-    __Proxy(last_beaconed_ssid, string, string, string, last_beaconed_ssid);
+    __ProxyInterned(last_beaconed_ssid, last_beaconed_ssid);
     __Proxy(last_beaconed_ssid_csum, uint32_t, uint32_t, 
             uint32_t, last_beaconed_ssid_csum);
 
     __Proxy(last_beacon_timestamp, uint64_t, time_t, 
             time_t, last_beacon_timestamp);
 
-    __Proxy(wps_m3_count, uint64_t, uint64_t, uint64_t, wps_m3_count);
-    __ProxyIncDec(wps_m3_count, uint64_t, uint64_t, wps_m3_count);
+    __ProxyDynamic(wps_m3_count, uint64_t, uint64_t, uint64_t, 
+            wps_m3_count, wps_m3_count_id);
+    __ProxyDynamicIncDec(wps_m3_count, uint64_t, uint64_t, 
+            wps_m3_count, wps_m3_count_id);
 
-    __Proxy(wps_m3_last, uint64_t, uint64_t, uint64_t, wps_m3_last);
+    __ProxyDynamic(wps_m3_last, uint64_t, uint64_t, uint64_t, 
+            wps_m3_last, wps_m3_last_id);
 
-    __ProxyTrackable(wpa_key_vec, TrackerElement, wpa_key_vec);
+    __ProxyDynamicTrackable(wpa_key_vec, TrackerElement, wpa_key_vec, wpa_key_vec_id);
     shared_ptr<dot11_tracked_eapol> create_eapol_packet() {
         return static_pointer_cast<dot11_tracked_eapol>(tracker->GetTrackedInstance(wpa_key_entry_id));
     }
 
-    __Proxy(wpa_present_handshake, uint8_t, uint8_t, uint8_t, wpa_present_handshake);
+    __ProxyDynamic(wpa_present_handshake, uint8_t, uint8_t, uint8_t, 
+            wpa_present_handshake, wpa_present_handshake_id);
 
 protected:
     virtual void register_fields() {
         RegisterField("dot11.device.typeset", TrackerUInt64,
                 "bitset of device type", &type_set);
 
-        RegisterField("dot11.device.client_map", TrackerMacMap,
-                "client behavior", &client_map);
+        client_map_id =
+            RegisterDynamicField("dot11.device.client_map", TrackerMacMap,
+                    "client behavior", &client_map);
 
-        shared_ptr<dot11_client> client_builder(new dot11_client(globalreg, 0));
         client_map_entry_id =
-            RegisterComplexField("dot11.device.client", client_builder, "client record");
+            RegisterComplexField<dot11_client>("dot11.device.client", "client record");
 
-        RegisterField("dot11.device.advertised_ssid_map", TrackerIntMap,
-                "advertised SSIDs", &advertised_ssid_map);
+        advertised_ssid_map_id =
+            RegisterDynamicField("dot11.device.advertised_ssid_map", TrackerIntMap,
+                    "advertised SSIDs", &advertised_ssid_map);
 
-        shared_ptr<dot11_advertised_ssid> adv_ssid_builder(new dot11_advertised_ssid(globalreg, 0));
         advertised_ssid_map_entry_id =
-            RegisterComplexField("dot11.device.advertised_ssid",
-                    adv_ssid_builder, "advertised ssid");
+            RegisterComplexField<dot11_advertised_ssid>("dot11.device.advertised_ssid",
+                    "advertised ssid");
 
-        RegisterField("dot11.device.probed_ssid_map", TrackerIntMap,
-                "probed SSIDs", &probed_ssid_map);
+        probed_ssid_map_id =
+            RegisterDynamicField("dot11.device.probed_ssid_map", TrackerIntMap,
+                    "probed SSIDs", &probed_ssid_map);
 
-        shared_ptr<dot11_probed_ssid> probe_ssid_builder(new dot11_probed_ssid(globalreg, 0));
         probed_ssid_map_entry_id =
-            RegisterComplexField("dot11.device.probed_ssid",
-                    probe_ssid_builder, "probed ssid");
+            RegisterComplexField<dot11_probed_ssid>("dot11.device.probed_ssid",
+                    "probed ssid");
 
-        RegisterField("dot11.device.associated_client_map", TrackerMacMap,
-                "associated clients", &associated_client_map);
+        associated_client_map_id =
+            RegisterDynamicField("dot11.device.associated_client_map", TrackerMacMap,
+                    "associated clients", &associated_client_map);
 
         // Key of associated device, indexed by mac address
         associated_client_map_entry_id =
             RegisterField("dot11.device.associated_client", TrackerUInt64,
                     "associated client");
 
-        RegisterField("dot11.device.client_disconnects", TrackerUInt64,
-                "client disconnects in last second", 
-                &client_disconnects);
+        client_disconnects_id =
+            RegisterDynamicField("dot11.device.client_disconnects", TrackerUInt64,
+                    "client disconnects in last second", 
+                    &client_disconnects);
 
         RegisterField("dot11.device.last_sequence", TrackerUInt64,
                 "last sequence number", &last_sequence);
@@ -880,40 +909,49 @@ protected:
                 "unix timestamp of last beacon frame", 
                 &last_beacon_timestamp);
 
-        RegisterField("dot11.device.wps_m3_count", TrackerUInt64,
-                "WPS M3 message count", &wps_m3_count);
-        RegisterField("dot11.device.wps_m3_last", TrackerUInt64,
-                "WPS M3 last message", &wps_m3_last);
+        wps_m3_count_id =
+            RegisterDynamicField("dot11.device.wps_m3_count", TrackerUInt64,
+                    "WPS M3 message count", &wps_m3_count);
+        wps_m3_last_id =
+            RegisterDynamicField("dot11.device.wps_m3_last", TrackerUInt64,
+                    "WPS M3 last message", &wps_m3_last);
 
-        RegisterField("dot11.device.wpa_handshake_list", TrackerVector,
-                "WPA handshakes", &wpa_key_vec);
+        wpa_key_vec_id =
+            RegisterDynamicField("dot11.device.wpa_handshake_list", TrackerVector,
+                    "WPA handshakes", &wpa_key_vec);
 
         __RegisterComplexField(dot11_tracked_eapol, wpa_key_entry_id, 
                 "dot11.eapol.key", "WPA handshake key");
 
-        RegisterField("dot11.device.wpa_present_handshake", TrackerUInt8,
-                "handshake sequences seen (bitmask)", &wpa_present_handshake);
+        wpa_present_handshake_id =
+            RegisterDynamicField("dot11.device.wpa_present_handshake", TrackerUInt8,
+                    "handshake sequences seen (bitmask)", &wpa_present_handshake);
     }
 
     SharedTrackerElement type_set;
 
     // Records of this device behaving as a client
     SharedTrackerElement client_map;
+    int client_map_id;
     int client_map_entry_id;
 
     // Records of this device advertising SSIDs
     SharedTrackerElement advertised_ssid_map;
+    int advertised_ssid_map_id;
     int advertised_ssid_map_entry_id;
 
     // Records of this device probing for a network
     SharedTrackerElement probed_ssid_map;
+    int probed_ssid_map_id;
     int probed_ssid_map_entry_id;
 
     // Mac addresses of clients who have talked to this network
     SharedTrackerElement associated_client_map;
+    int associated_client_map_id;
     int associated_client_map_entry_id;
 
     SharedTrackerElement client_disconnects;
+    int client_disconnects_id;
     SharedTrackerElement last_sequence;
     SharedTrackerElement bss_timestamp;
     SharedTrackerElement num_fragments;
@@ -927,12 +965,16 @@ protected:
     SharedTrackerElement last_bssid;
     SharedTrackerElement last_beacon_timestamp;
     SharedTrackerElement wps_m3_count;
+    int wps_m3_count_id;
     SharedTrackerElement wps_m3_last;
+    int wps_m3_last_id;
 
     SharedTrackerElement wpa_key_vec;
+    int wpa_key_vec_id;
     int wpa_key_entry_id;
 
     SharedTrackerElement wpa_present_handshake;
+    int wpa_present_handshake_id;
 };
 
 class dot11_ssid_alert {
@@ -1033,6 +1075,11 @@ public:
             const char *url, const char *method, const char *upload_data,
             size_t *upload_data_size, std::stringstream &stream);
 
+    // Handshake captures only change with their device, so they're versioned
+    virtual bool Httpd_GetObjectVersion(Kis_Net_Httpd *httpd,
+            Kis_Net_Httpd_Connection *connection, const char *url,
+            uint64_t *ret_version);
+
     virtual int Httpd_PostComplete(Kis_Net_Httpd_Connection *concls);
 
     // Timetracker event handler
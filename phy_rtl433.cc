@@ -345,6 +345,10 @@ bool Kis_RTL433_Phy::json_to_rtl(struct JSON_value *json) {
 
     }
 
+    // The pseudopacket never reaches the modified tracker, so bump the
+    // version again now that the rtl433 records are written
+    devicetracker->MarkDeviceModified(basedev);
+
     if (newrtl && commondev != NULL) {
         string info = "Detected new RTL433 RF device '" + commondev->get_model() + "'";
 
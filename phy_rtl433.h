@@ -81,26 +81,13 @@ public:
         return b;
     }
 
-    // Simple average
-    static int64_t combine_vector(SharedTrackerElement e) {
-        TrackerElementVector v(e);
-
-        int64_t avg = 0;
-        int64_t avg_c = 0;
-
-        for (TrackerElementVector::iterator i = v.begin(); i != v.end(); ++i)  {
-            int64_t v = GetTrackerValue<int64_t>(*i);
-
-            if (v != default_val()) {
-                avg += GetTrackerValue<int64_t>(*i);
-                avg_c++;
-            }
-        }
-
-        if (avg_c == 0)
+    // Average of the slots which aren't empty
+    static int64_t combine_vector(const int64_t in_sum, const int in_set,
+            const int in_slots __attribute__((unused))) {
+        if (in_set == 0)
             return default_val();
 
-        return avg / avg_c;
+        return in_sum / in_set;
     }
 
     // Default 'empty' value, no legit signal would be 0
@@ -124,7 +111,7 @@ public:
         }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new rtl433_tracked_common(globalreg, get_id()));
+        return AllocTrackedElement<rtl433_tracked_common>(globalreg, get_id());
     }
 
     rtl433_tracked_common(GlobalRegistry *in_globalreg, int in_id, 
@@ -187,7 +174,7 @@ public:
         }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new rtl433_tracked_thermometer(globalreg, get_id()));
+        return AllocTrackedElement<rtl433_tracked_thermometer>(globalreg, get_id());
     }
 
     rtl433_tracked_thermometer(GlobalRegistry *in_globalreg, int in_id, 
@@ -210,18 +197,16 @@ protected:
             RegisterField("rtl433.device.temperature", TrackerDouble,
                     "Temperature in degrees Celsius", &temperature);
 
-        shared_ptr<kis_tracked_rrd<rtl433_empty_aggregator> > rrd_builder(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, 0));
         temperature_rrd_id =
-            RegisterComplexField("rtl433.device.temperature_rrd", rrd_builder,
+            RegisterComplexField<kis_tracked_rrd<rtl433_empty_aggregator> >("rtl433.device.temperature_rrd",
                     "Temperature RRD");
 
         humidity_id =
             RegisterField("rtl433.device.humidity", TrackerInt32,
                     "Humidity", &humidity);
 
-        rrd_builder.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, 0));
         humidity_rrd_id =
-            RegisterComplexField("rtl433.device.humidity_rrd", rrd_builder,
+            RegisterComplexField<kis_tracked_rrd<rtl433_empty_aggregator> >("rtl433.device.humidity_rrd",
                     "Humidity RRD");
     }
 
@@ -229,16 +214,16 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            temperature_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, temperature_rrd_id, e->get_map_value(temperature_rrd_id)));
+            temperature_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, temperature_rrd_id, e->get_map_value(temperature_rrd_id));
             add_map(temperature_rrd);
 
-            humidity_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, humidity_rrd_id, e->get_map_value(humidity_rrd_id)));
+            humidity_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, humidity_rrd_id, e->get_map_value(humidity_rrd_id));
             add_map(humidity_rrd);
         } else {
-            temperature_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, temperature_rrd_id));
+            temperature_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, temperature_rrd_id);
             add_map(temperature_rrd);
 
-            humidity_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, humidity_rrd_id));
+            humidity_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, humidity_rrd_id);
             add_map(humidity_rrd);
         }
     }
@@ -269,7 +254,7 @@ public:
         }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new rtl433_tracked_weatherstation(globalreg, get_id()));
+        return AllocTrackedElement<rtl433_tracked_weatherstation>(globalreg, get_id());
     }
 
     rtl433_tracked_weatherstation(GlobalRegistry *in_globalreg, int in_id, 
@@ -296,36 +281,32 @@ protected:
             RegisterField("rtl433.device.wind_dir", TrackerInt32,
                     "Wind direction in degrees", &wind_dir);
 
-        shared_ptr<kis_tracked_rrd<rtl433_empty_aggregator> > rrd_builder(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, 0));
         wind_dir_rrd_id =
-            RegisterComplexField("rtl433.device.wind_dir_rrd", rrd_builder,
+            RegisterComplexField<kis_tracked_rrd<rtl433_empty_aggregator> >("rtl433.device.wind_dir_rrd",
                     "Wind direction RRD");
 
         wind_speed_id =
             RegisterField("rtl433.device.wind_speed", TrackerInt32,
                     "Wind speed in Kph", &wind_speed);
 
-        rrd_builder.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, 0));
         wind_speed_rrd_id =
-            RegisterComplexField("rtl433.device.wind_speed_rrd", rrd_builder,
+            RegisterComplexField<kis_tracked_rrd<rtl433_empty_aggregator> >("rtl433.device.wind_speed_rrd",
                     "Wind speed RRD");
 
         wind_gust_id =
             RegisterField("rtl433.device.wind_gust", TrackerInt32,
                     "Wind gust in Kph", &wind_gust);
 
-        rrd_builder.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, 0));
         wind_gust_rrd_id =
-            RegisterComplexField("rtl433.device.wind_gust_rrd", rrd_builder,
+            RegisterComplexField<kis_tracked_rrd<rtl433_empty_aggregator> >("rtl433.device.wind_gust_rrd",
                     "Wind gust RRD");
 
         rain_id =
             RegisterField("rtl433.device.rain", TrackerInt32,
                     "Measured rain", &rain);
 
-        rrd_builder.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, 0));
         rain_rrd_id =
-            RegisterComplexField("rtl433.device.rain_rrd", rrd_builder,
+            RegisterComplexField<kis_tracked_rrd<rtl433_empty_aggregator> >("rtl433.device.rain_rrd",
                     "Rain RRD");
 
     }
@@ -334,28 +315,28 @@ protected:
         tracker_component::reserve_fields(e);
 
         if (e != NULL) {
-            wind_dir_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, wind_dir_rrd_id, e->get_map_value(wind_dir_rrd_id)));
+            wind_dir_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, wind_dir_rrd_id, e->get_map_value(wind_dir_rrd_id));
             add_map(wind_dir_rrd);
 
-            wind_speed_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, wind_speed_rrd_id, e->get_map_value(wind_speed_rrd_id)));
+            wind_speed_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, wind_speed_rrd_id, e->get_map_value(wind_speed_rrd_id));
             add_map(wind_speed_rrd);
 
-            wind_gust_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, wind_gust_rrd_id, e->get_map_value(wind_gust_rrd_id)));
+            wind_gust_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, wind_gust_rrd_id, e->get_map_value(wind_gust_rrd_id));
             add_map(wind_gust_rrd);
 
-            rain_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, rain_rrd_id, e->get_map_value(rain_rrd_id)));
+            rain_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, rain_rrd_id, e->get_map_value(rain_rrd_id));
             add_map(rain_rrd);
         } else {
-            wind_dir_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, wind_dir_rrd_id));
+            wind_dir_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, wind_dir_rrd_id);
             add_map(wind_dir_rrd);
 
-            wind_speed_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, wind_speed_rrd_id));
+            wind_speed_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, wind_speed_rrd_id);
             add_map(wind_speed_rrd);
 
-            wind_gust_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, wind_gust_rrd_id));
+            wind_gust_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, wind_gust_rrd_id);
             add_map(wind_gust_rrd);
 
-            rain_rrd.reset(new kis_tracked_rrd<rtl433_empty_aggregator>(globalreg, rain_rrd_id));
+            rain_rrd = AllocTrackedElement<kis_tracked_rrd<rtl433_empty_aggregator> >(globalreg, rain_rrd_id);
             add_map(rain_rrd);
         }
     }
@@ -183,6 +183,10 @@ bool Kis_Zwave_Phy::json_to_record(struct JSON_value *json) {
         zdev->set_deviceid(devid);
     }
 
+    // The pseudopacket never reaches the modified tracker, so bump the
+    // version again now that the zwave record is written
+    devicetracker->MarkDeviceModified(basedev);
+
     if (newzdev && basedev != NULL) {
         _MSG("Detected new Z-Wave device '" + basedev->get_devicename() + "'",
                 MSGFLAG_INFO);
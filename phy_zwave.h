@@ -47,7 +47,7 @@ public:
         }
 
     virtual SharedTrackerElement clone_type() {
-        return SharedTrackerElement(new zwave_tracked_device(globalreg, get_id()));
+        return AllocTrackedElement<zwave_tracked_device>(globalreg, get_id());
     }
 
     zwave_tracked_device(GlobalRegistry *in_globalreg, int in_id,
@@ -22,6 +22,7 @@
 
 #include "util.h"
 #include "ringbuf2.h"
+#include "kis_mem_account.h"
 
 RingbufV2::RingbufV2(size_t in_sz) {
     buffer = new uint8_t[in_sz];
@@ -30,10 +31,14 @@ RingbufV2::RingbufV2(size_t in_sz) {
     start_pos = 0;
     length = 0;
 
+    kis_mem_account::add(KIS_MEM_RINGBUF, 1, sizeof(RingbufV2) + buffer_sz);
+
     pthread_mutex_init(&buffer_locker, NULL);
 }
 
 RingbufV2::~RingbufV2() {
+    kis_mem_account::add(KIS_MEM_RINGBUF, -1, -((int64_t) (sizeof(RingbufV2) + buffer_sz)));
+
     {
         local_locker lock(&buffer_locker);
         delete[] buffer;
@@ -30,6 +30,8 @@
 #include "system_monitor.h"
 #include "msgpack_adapter.h"
 #include "json_adapter.h"
+#include "kis_string_pool.h"
+#include "alertracker.h"
 
 Systemmonitor::Systemmonitor(GlobalRegistry *in_globalreg) :
     tracker_component(in_globalreg, 0),
@@ -54,6 +56,38 @@ Systemmonitor::Systemmonitor(GlobalRegistry *in_globalreg) :
     mem_per_page = sysconf(_SC_PAGESIZE);
 #endif
 
+    mem_report_id =
+        globalreg->entrytracker->RegisterField("kismet.system.memory.report",
+                TrackerMap, "memory use report");
+    mem_subsystems_id =
+        globalreg->entrytracker->RegisterField("kismet.system.memory.subsystems",
+                TrackerStringMap, "live objects and bytes by subsystem");
+    mem_types_id =
+        globalreg->entrytracker->RegisterField("kismet.system.memory.types",
+                TrackerStringMap, "live tracked elements and bytes by element type");
+    mem_fields_id =
+        globalreg->entrytracker->RegisterField("kismet.system.memory.fields",
+                TrackerStringMap, "tracked device elements and bytes by field");
+    mem_entry_id =
+        globalreg->entrytracker->RegisterField("kismet.system.memory.entry",
+                TrackerMap, "memory use of one category");
+    mem_entry_count_id =
+        globalreg->entrytracker->RegisterField("kismet.system.memory.count",
+                TrackerUInt64, "live objects");
+    mem_entry_bytes_id =
+        globalreg->entrytracker->RegisterField("kismet.system.memory.bytes",
+                TrackerUInt64, "approximate bytes");
+
+    alert_memgrowth_ref =
+        globalreg->alertracker->ActivateConfiguredAlert("MEMGROWTH",
+                "Memory used by one part of Kismet more than doubled within a "
+                "minute, and by a significant amount.  This may indicate a "
+                "leak, or a flood of devices or data.");
+
+    last_memgrowth_check = 0;
+    for (int c = 0; c <= KIS_MEM_MAX_CATEGORY; c++)
+        memgrowth_bytes[c] = 0;
+
     struct timeval trigger_tm;
     trigger_tm.tv_sec = globalreg->timestamp.tv_sec + 1;
     trigger_tm.tv_usec = 0;
@@ -98,6 +132,56 @@ void Systemmonitor::register_fields() {
         RegisterField("kismet.system.devices.count", TrackerUInt64,
                 "number of devices in devicetracker", &devices);
 
+    devices_memory_id =
+        RegisterField("kismet.system.devices.memory", TrackerUInt64,
+                "estimated memory used by tracked devices in kbytes", &devices_memory);
+
+    strings_count_id =
+        RegisterField("kismet.system.strings.count", TrackerUInt64,
+                "distinct strings in the interned string pool", &strings_count);
+    strings_bytes_id =
+        RegisterField("kismet.system.strings.bytes", TrackerUInt64,
+                "bytes of string data in the interned string pool", &strings_bytes);
+    strings_hit_rate_id =
+        RegisterField("kismet.system.strings.hit_rate", TrackerDouble,
+                "percentage of interned string lookups which shared an existing string",
+                &strings_hit_rate);
+
+    httpd_cache_entries_id =
+        RegisterField("kismet.system.httpd_cache.entries", TrackerUInt64,
+                "responses in the httpd object cache", &httpd_cache_entries);
+    httpd_cache_bytes_id =
+        RegisterField("kismet.system.httpd_cache.bytes", TrackerUInt64,
+                "approximate bytes used by the httpd object cache", &httpd_cache_bytes);
+    httpd_cache_hits_id =
+        RegisterField("kismet.system.httpd_cache.hits", TrackerUInt64,
+                "responses served from the httpd object cache", &httpd_cache_hits);
+    httpd_cache_misses_id =
+        RegisterField("kismet.system.httpd_cache.misses", TrackerUInt64,
+                "cacheable responses which had to be generated", &httpd_cache_misses);
+    httpd_cache_not_modified_id =
+        RegisterField("kismet.system.httpd_cache.not_modified", TrackerUInt64,
+                "requests answered with 304 not modified from a matching etag",
+                &httpd_cache_not_modified);
+
+    httpd_compress_responses_id =
+        RegisterField("kismet.system.httpd_compress.responses", TrackerUInt64,
+                "http responses sent compressed", &httpd_compress_responses);
+    httpd_compress_bytes_in_id =
+        RegisterField("kismet.system.httpd_compress.bytes_in", TrackerUInt64,
+                "bytes of http responses before compression", &httpd_compress_bytes_in);
+    httpd_compress_bytes_out_id =
+        RegisterField("kismet.system.httpd_compress.bytes_out", TrackerUInt64,
+                "bytes of http responses after compression", &httpd_compress_bytes_out);
+    httpd_compress_ratio_id =
+        RegisterField("kismet.system.httpd_compress.ratio", TrackerDouble,
+                "overall compression ratio of http responses (bytes in / bytes out)",
+                &httpd_compress_ratio);
+    httpd_compress_cpu_usec_id =
+        RegisterField("kismet.system.httpd_compress.cpu_usec", TrackerUInt64,
+                "cpu time spent compressing http responses, in microseconds",
+                &httpd_compress_cpu_usec);
+
     shared_ptr<kis_tracked_rrd<> > rrd_builder(new kis_tracked_rrd<>(globalreg, 0));
 
     mem_rrd_id =
@@ -135,6 +219,47 @@ int Systemmonitor::timetracker_event(int eventid) {
     set_devices(num_devices);
     devices_rrd->add_sample(num_devices, globalreg->timestamp.tv_sec);
 
+    set_devices_memory(devicetracker->FetchDeviceMemory() / 1024);
+
+    check_memory_growth();
+
+    size_t num_strings, num_string_bytes;
+    uint64_t num_lookups, num_hits;
+    kis_string_pool::get_stats(&num_strings, &num_string_bytes, 
+            &num_lookups, &num_hits);
+
+    set_strings_count(num_strings);
+    set_strings_bytes(num_string_bytes);
+    if (num_lookups > 0)
+        set_strings_hit_rate(((double) num_hits * 100) / num_lookups);
+
+    if (globalreg->httpd_server != NULL) {
+        size_t num_entries, num_cache_bytes;
+        uint64_t num_cache_hits, num_cache_misses, num_not_modified;
+
+        globalreg->httpd_server->GetObjectCache()->get_stats(&num_entries,
+                &num_cache_bytes, &num_cache_hits, &num_cache_misses, 
+                &num_not_modified);
+
+        set_httpd_cache_entries(num_entries);
+        set_httpd_cache_bytes(num_cache_bytes);
+        set_httpd_cache_hits(num_cache_hits);
+        set_httpd_cache_misses(num_cache_misses);
+        set_httpd_cache_not_modified(num_not_modified);
+
+        uint64_t num_compressed, num_compress_in, num_compress_out, num_compress_usec;
+
+        globalreg->httpd_server->GetCompressStats()->get_stats(&num_compressed,
+                &num_compress_in, &num_compress_out, &num_compress_usec);
+
+        set_httpd_compress_responses(num_compressed);
+        set_httpd_compress_bytes_in(num_compress_in);
+        set_httpd_compress_bytes_out(num_compress_out);
+        set_httpd_compress_cpu_usec(num_compress_usec);
+        if (num_compress_out > 0)
+            set_httpd_compress_ratio((double) num_compress_in / num_compress_out);
+    }
+
 #ifdef SYS_LINUX
     // Grab the memory from /proc
     std::string procline;
@@ -211,6 +336,10 @@ bool Systemmonitor::Httpd_VerifyPath(const char *path, const char *method) {
         return true;
     if (strcmp(path, "/system/status.json") == 0)
         return true;
+    if (strcmp(path, "/system/memory.msgpack") == 0)
+        return true;
+    if (strcmp(path, "/system/memory.json") == 0)
+        return true;
 
     return false;
 }
@@ -235,7 +364,154 @@ void Systemmonitor::Httpd_CreateStreamResponse(
     } else if (strcmp(path, "/system/status.json") == 0) {
         JsonAdapter::Pack(globalreg, stream, 
             static_pointer_cast<Systemmonitor>(globalreg->FetchGlobal("SYSTEM_MONITOR")));
+    } else if (strcmp(path, "/system/memory.msgpack") == 0) {
+        MsgpackAdapter::Pack(globalreg, stream, build_memory_report());
+    } else if (strcmp(path, "/system/memory.json") == 0) {
+        JsonAdapter::Pack(globalreg, stream, build_memory_report());
+    }
+
+}
+
+// Accumulate per-field memory of every device, one map per pool slot
+class SystemmonitorMemoryWorker : public DevicetrackerFilterWorker {
+public:
+    virtual void PrepareSlots(unsigned int in_slots) {
+        slot_maps.resize(in_slots);
+    }
+
+    virtual void MatchDevice(Devicetracker *devicetracker,
+            const shared_ptr<kis_tracked_device_base>& base) {
+        MatchDeviceSlot(devicetracker, base, 0);
+    }
+
+    virtual void MatchDeviceSlot(Devicetracker *devicetracker __attribute__((unused)),
+            const shared_ptr<kis_tracked_device_base>& base, unsigned int in_slot) {
+        base->get_memory_by_field(slot_maps[in_slot]);
+    }
+
+    vector<TrackerElement::field_memory_map> slot_maps;
+};
+
+SharedTrackerElement Systemmonitor::build_memory_entry(uint64_t in_count, 
+        uint64_t in_bytes) {
+    SharedTrackerElement entry = 
+        AllocTrackedElement<TrackerElement>(TrackerMap, mem_entry_id);
+
+    SharedTrackerElement count =
+        AllocTrackedElement<TrackerElement>(TrackerUInt64, mem_entry_count_id);
+    count->set(in_count);
+    entry->add_map(count);
+
+    SharedTrackerElement bytes =
+        AllocTrackedElement<TrackerElement>(TrackerUInt64, mem_entry_bytes_id);
+    bytes->set(in_bytes);
+    entry->add_map(bytes);
+
+    return entry;
+}
+
+SharedTrackerElement Systemmonitor::build_memory_report() {
+    SharedTrackerElement report = 
+        AllocTrackedElement<TrackerElement>(TrackerMap, mem_report_id);
+
+    SharedTrackerElement subsystems =
+        AllocTrackedElement<TrackerElement>(TrackerStringMap, mem_subsystems_id);
+    report->add_map(subsystems);
+
+    for (int c = 0; c < KIS_MEM_MAX_CATEGORY; c++) {
+        kis_mem_category cat = (kis_mem_category) c;
+        subsystems->add_stringmap(kis_mem_account::category_name(cat),
+                build_memory_entry(kis_mem_account::get_count(cat), 
+                    kis_mem_account::get_bytes(cat)));
+    }
+
+    size_t num_strings, num_string_bytes;
+    uint64_t num_lookups, num_hits;
+    kis_string_pool::get_stats(&num_strings, &num_string_bytes, 
+            &num_lookups, &num_hits);
+    subsystems->add_stringmap("strings", 
+            build_memory_entry(num_strings, num_string_bytes));
+
+    SharedTrackerElement types =
+        AllocTrackedElement<TrackerElement>(TrackerStringMap, mem_types_id);
+    report->add_map(types);
+
+    for (int t = 0; t <= TrackerInt64Vector; t++) {
+        if (kis_mem_account::get_element_count(t) == 0)
+            continue;
+
+        types->add_stringmap(TrackerElement::type_to_string((TrackerType) t),
+                build_memory_entry(kis_mem_account::get_element_count(t),
+                    kis_mem_account::get_element_bytes(t)));
+    }
+
+    // Per-field use needs a walk of every device, so it is only done when
+    // someone asks for it
+    SystemmonitorMemoryWorker worker;
+    devicetracker->MatchOnDevices(&worker);
+
+    map<string, TrackerElement::field_memory> named;
+    for (auto& s : worker.slot_maps) {
+        for (auto& f : s) {
+            TrackerElement::field_memory& fm = 
+                named[globalreg->entrytracker->GetFieldNameRef(f.first)];
+            fm.count += f.second.count;
+            fm.bytes += f.second.bytes;
+        }
+    }
+
+    SharedTrackerElement fields =
+        AllocTrackedElement<TrackerElement>(TrackerStringMap, mem_fields_id);
+    report->add_map(fields);
+
+    for (auto& n : named)
+        fields->add_stringmap(n.first, build_memory_entry(n.second.count, n.second.bytes));
+
+    return report;
+}
+
+void Systemmonitor::check_memory_growth() {
+    if (alert_memgrowth_ref < 0)
+        return;
+
+    if (globalreg->timestamp.tv_sec - last_memgrowth_check < 60)
+        return;
+
+    // Only complain about growth which is large in absolute terms too, so
+    // small buffers doubling don't trip it
+    const int64_t min_growth = 32 * 1024 * 1024;
+
+    int64_t cur_bytes[KIS_MEM_MAX_CATEGORY + 1];
+
+    for (int c = 0; c < KIS_MEM_MAX_CATEGORY; c++)
+        cur_bytes[c] = kis_mem_account::get_bytes((kis_mem_category) c);
+
+    cur_bytes[KIS_MEM_MAX_CATEGORY] = 0;
+    for (int t = 0; t < kis_mem_account::max_element_type; t++)
+        cur_bytes[KIS_MEM_MAX_CATEGORY] += kis_mem_account::get_element_bytes(t);
+
+    if (last_memgrowth_check != 0) {
+        for (int c = 0; c <= KIS_MEM_MAX_CATEGORY; c++) {
+            if (cur_bytes[c] - memgrowth_bytes[c] < min_growth ||
+                    cur_bytes[c] < memgrowth_bytes[c] * 2)
+                continue;
+
+            string name = "tracked elements";
+            if (c < KIS_MEM_MAX_CATEGORY)
+                name = kis_mem_account::category_name((kis_mem_category) c);
+
+            string text = "Memory used by " + name + " grew from " + 
+                LongIntToString(memgrowth_bytes[c] / 1024) + "KB to " +
+                LongIntToString(cur_bytes[c] / 1024) + "KB in the last minute";
+
+            globalreg->alertracker->RaiseAlert(alert_memgrowth_ref, NULL,
+                    mac_addr(0), mac_addr(0), mac_addr(0), mac_addr(0), "0", text);
+        }
     }
 
+    for (int c = 0; c <= KIS_MEM_MAX_CATEGORY; c++)
+        memgrowth_bytes[c] = cur_bytes[c];
+
+    last_memgrowth_check = globalreg->timestamp.tv_sec;
 }
 
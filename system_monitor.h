@@ -28,6 +28,7 @@
 #include "timetracker.h"
 #include "devicetracker_component.h"
 #include "devicetracker.h"
+#include "kis_mem_account.h"
 #include "kis_net_microhttpd.h"
 
 class Systemmonitor : public tracker_component, public Kis_Net_Httpd_CPPStream_Handler,
@@ -63,6 +64,28 @@ public:
 
     __Proxy(memory, uint64_t, uint64_t, uint64_t, memory);
     __Proxy(devices, uint64_t, uint64_t, uint64_t, devices);
+    __Proxy(devices_memory, uint64_t, uint64_t, uint64_t, devices_memory);
+
+    __Proxy(strings_count, uint64_t, uint64_t, uint64_t, strings_count);
+    __Proxy(strings_bytes, uint64_t, uint64_t, uint64_t, strings_bytes);
+    __Proxy(strings_hit_rate, double, double, double, strings_hit_rate);
+
+    __Proxy(httpd_cache_entries, uint64_t, uint64_t, uint64_t, httpd_cache_entries);
+    __Proxy(httpd_cache_bytes, uint64_t, uint64_t, uint64_t, httpd_cache_bytes);
+    __Proxy(httpd_cache_hits, uint64_t, uint64_t, uint64_t, httpd_cache_hits);
+    __Proxy(httpd_cache_misses, uint64_t, uint64_t, uint64_t, httpd_cache_misses);
+    __Proxy(httpd_cache_not_modified, uint64_t, uint64_t, uint64_t, 
+            httpd_cache_not_modified);
+
+    __Proxy(httpd_compress_responses, uint64_t, uint64_t, uint64_t, 
+            httpd_compress_responses);
+    __Proxy(httpd_compress_bytes_in, uint64_t, uint64_t, uint64_t, 
+            httpd_compress_bytes_in);
+    __Proxy(httpd_compress_bytes_out, uint64_t, uint64_t, uint64_t, 
+            httpd_compress_bytes_out);
+    __Proxy(httpd_compress_ratio, double, double, double, httpd_compress_ratio);
+    __Proxy(httpd_compress_cpu_usec, uint64_t, uint64_t, uint64_t, 
+            httpd_compress_cpu_usec);
 
     virtual void pre_serialize();
 
@@ -75,6 +98,15 @@ protected:
     virtual void register_fields();
     virtual void reserve_fields(SharedTrackerElement e);
 
+    // Build the /system/memory report; walks every device to break down
+    // tracked memory by field
+    SharedTrackerElement build_memory_report();
+    SharedTrackerElement build_memory_entry(uint64_t in_count, uint64_t in_bytes);
+
+    // Compare memory accounting to the last check and alert on categories
+    // which have grown abnormally
+    void check_memory_growth();
+
     shared_ptr<Devicetracker> devicetracker;
 
     int battery_perc_id;
@@ -107,7 +139,58 @@ protected:
     int devices_rrd_id;
     shared_ptr<kis_tracked_rrd<> > devices_rrd;
 
+    int devices_memory_id;
+    SharedTrackerElement devices_memory;
+
+    int strings_count_id;
+    SharedTrackerElement strings_count;
+
+    int strings_bytes_id;
+    SharedTrackerElement strings_bytes;
+
+    int strings_hit_rate_id;
+    SharedTrackerElement strings_hit_rate;
+
+    int httpd_cache_entries_id;
+    SharedTrackerElement httpd_cache_entries;
+
+    int httpd_cache_bytes_id;
+    SharedTrackerElement httpd_cache_bytes;
+
+    int httpd_cache_hits_id;
+    SharedTrackerElement httpd_cache_hits;
+
+    int httpd_cache_misses_id;
+    SharedTrackerElement httpd_cache_misses;
+
+    int httpd_cache_not_modified_id;
+    SharedTrackerElement httpd_cache_not_modified;
+
+    int httpd_compress_responses_id;
+    SharedTrackerElement httpd_compress_responses;
+
+    int httpd_compress_bytes_in_id;
+    SharedTrackerElement httpd_compress_bytes_in;
+
+    int httpd_compress_bytes_out_id;
+    SharedTrackerElement httpd_compress_bytes_out;
+
+    int httpd_compress_ratio_id;
+    SharedTrackerElement httpd_compress_ratio;
+
+    int httpd_compress_cpu_usec_id;
+    SharedTrackerElement httpd_compress_cpu_usec;
+
     long mem_per_page;
+
+    // Memory report fields; not part of the status record
+    int mem_report_id, mem_subsystems_id, mem_types_id, mem_fields_id;
+    int mem_entry_id, mem_entry_count_id, mem_entry_bytes_id;
+
+    // Growth alerting, per subsystem plus tracked elements as a whole
+    int alert_memgrowth_ref;
+    time_t last_memgrowth_check;
+    int64_t memgrowth_bytes[KIS_MEM_MAX_CATEGORY + 1];
 };
 
 #endif
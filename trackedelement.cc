@@ -19,19 +19,25 @@
 #include "config.hpp"
 
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
+#include <atomic>
+#include <typeinfo>
+#include <string.h>
 
 #include "util.h"
 
 #include "trackedelement.h"
 #include "globalregistry.h"
 #include "entrytracker.h"
+#include "kis_mem_account.h"
 
 #include "alphanum.hpp"
 
 void TrackerElement::Initialize() {
     this->type = TrackerUnassigned;
     reference_count = 0;
+    string_interned = false;
 
     set_id(-1);
 
@@ -76,6 +82,9 @@ TrackerElement::TrackerElement(TrackerType type, int id) {
 }
 
 TrackerElement::~TrackerElement() {
+    if (type != TrackerUnassigned)
+        kis_mem_account::add_element(type, -1, -((int64_t) get_type_size(type)));
+
     // If we contain references to other things, unlink them.  This may cause them to
     // auto-delete themselves.
     if (type == TrackerVector) {
@@ -91,13 +100,18 @@ TrackerElement::~TrackerElement() {
     } else if (type == TrackerDoubleMap) {
         delete dataunion.subdoublemap_value;
     } else if (type == TrackerString) {
-        delete(dataunion.string_value);
+        if (string_interned)
+            kis_string_pool::release(dataunion.interned_value);
+        else
+            delete(dataunion.string_value);
     } else if (type == TrackerMac) {
         delete(dataunion.mac_value);
     } else if (type == TrackerUuid) {
         delete dataunion.uuid_value;
     } else if (type == TrackerByteArray) {
         delete dataunion.bytearray_value;
+    } else if (type == TrackerInt64Vector) {
+        delete dataunion.int64vector_value;
     }
 }
 
@@ -105,6 +119,11 @@ void TrackerElement::set_type(TrackerType in_type) {
     if (type == in_type)
         return;
 
+    if (type != TrackerUnassigned)
+        kis_mem_account::add_element(type, -1, -((int64_t) get_type_size(type)));
+    if (in_type != TrackerUnassigned)
+        kis_mem_account::add_element(in_type, 1, get_type_size(in_type));
+
     /* Purge old types if we change type */
     if (type == TrackerVector && dataunion.subvector_value != NULL) {
         delete(dataunion.subvector_value);
@@ -130,6 +149,10 @@ void TrackerElement::set_type(TrackerType in_type) {
     } else if (type == TrackerUuid && dataunion.uuid_value != NULL) {
         delete(dataunion.uuid_value);
         dataunion.uuid_value = NULL;
+    } else if (type == TrackerString && string_interned) {
+        kis_string_pool::release(dataunion.interned_value);
+        dataunion.interned_value = NULL;
+        string_interned = false;
     } else if (type == TrackerString && dataunion.string_value != NULL) {
         delete(dataunion.string_value);
         dataunion.string_value = NULL;
@@ -137,6 +160,9 @@ void TrackerElement::set_type(TrackerType in_type) {
         delete(dataunion.bytearray_value);
         dataunion.bytearray_value = NULL;
         bytearray_value_len = 0;
+    } else if (type == TrackerInt64Vector && dataunion.int64vector_value != NULL) {
+        delete(dataunion.int64vector_value);
+        dataunion.int64vector_value = NULL;
     }
 
     this->type = in_type;
@@ -162,9 +188,35 @@ void TrackerElement::set_type(TrackerType in_type) {
     } else if (type == TrackerByteArray) {
         dataunion.bytearray_value = new shared_ptr<uint8_t>();
         bytearray_value_len = 0;
+    } else if (type == TrackerInt64Vector) {
+        dataunion.int64vector_value = new tracked_int64_vector();
     }
 }
 
+void TrackerElement::set_interned(const string& v) {
+    except_type_mismatch(TrackerString);
+
+    if (!string_interned) {
+        delete(dataunion.string_value);
+        dataunion.interned_value = kis_string_pool::acquire(v);
+        string_interned = true;
+        return;
+    }
+
+    // Most sets repeat the current value (channel, manuf, ssid on every
+    // packet), so avoid going to the pool when nothing changed
+    if (dataunion.interned_value == NULL) {
+        if (v.length() == 0)
+            return;
+    } else if (dataunion.interned_value->first == v) {
+        return;
+    }
+
+    const kis_string_pool::entry *old = dataunion.interned_value;
+    dataunion.interned_value = kis_string_pool::acquire(v);
+    kis_string_pool::release(old);
+}
+
 TrackerElement& TrackerElement::operator++(int) {
     switch (type) {
         case TrackerInt8:
@@ -706,7 +758,7 @@ TrackerElement::mac_map_iterator TrackerElement::mac_find(mac_addr k) {
     return dataunion.submacmap_value->find(k);
 }
 
-void TrackerElement::add_macmap(mac_addr i, shared_ptr<TrackerElement> s) {
+void TrackerElement::add_macmap(mac_addr i, const shared_ptr<TrackerElement>& s) {
     except_type_mismatch(TrackerMacMap);
 
     (*dataunion.submacmap_value)[i] = s;
@@ -775,7 +827,7 @@ TrackerElement::string_map_iterator TrackerElement::string_find(string k) {
     return dataunion.substringmap_value->find(k);
 }
 
-void TrackerElement::add_stringmap(string i, shared_ptr<TrackerElement> s) {
+void TrackerElement::add_stringmap(string i, const shared_ptr<TrackerElement>& s) {
     except_type_mismatch(TrackerStringMap);
 
     (*dataunion.substringmap_value)[i] = s;
@@ -844,7 +896,7 @@ TrackerElement::double_map_iterator TrackerElement::double_find(double k) {
     return dataunion.subdoublemap_value->find(k);
 }
 
-void TrackerElement::add_doublemap(double i, shared_ptr<TrackerElement> s) {
+void TrackerElement::add_doublemap(double i, const shared_ptr<TrackerElement>& s) {
     except_type_mismatch(TrackerDoubleMap);
 
     (*dataunion.subdoublemap_value)[i] = s;
@@ -929,18 +981,22 @@ string TrackerElement::type_to_string(TrackerType t) {
             return "map[double, x]";
         case TrackerByteArray:
             return "bytearray";
+        case TrackerInt64Vector:
+            return "vector[int64]";
+        case TrackerSummary:
+            return "summary";
         default:
             return "unknown";
     }
 }
 
-void TrackerElement::add_map(int f, shared_ptr<TrackerElement> s) {
+void TrackerElement::add_map(int f, const shared_ptr<TrackerElement>& s) {
     except_type_mismatch(TrackerMap);
 
     dataunion.submap_value->emplace(f, s);
 }
 
-void TrackerElement::add_map(shared_ptr<TrackerElement> s) {
+void TrackerElement::add_map(const shared_ptr<TrackerElement>& s) {
     except_type_mismatch(TrackerMap);
 
     dataunion.submap_value->emplace(s->get_id(), s);
@@ -955,7 +1011,7 @@ void TrackerElement::del_map(int f) {
     }
 }
 
-void TrackerElement::del_map(shared_ptr<TrackerElement> e) {
+void TrackerElement::del_map(const shared_ptr<TrackerElement>& e) {
     del_map(e->get_id());
 }
 
@@ -970,6 +1026,12 @@ void TrackerElement::insert_map(tracked_pair p) {
     dataunion.submap_value->insert(p);
 }
 
+void TrackerElement::reserve_map(size_t n) {
+    except_type_mismatch(TrackerMap);
+
+    dataunion.submap_value->reserve(n);
+}
+
 void TrackerElement::clear_map() {
     except_type_mismatch(TrackerMap);
     
@@ -987,7 +1049,7 @@ shared_ptr<TrackerElement> TrackerElement::get_intmap_value(int idx) {
 
     int_map_iterator i = dataunion.subintmap_value->find(idx);
 
-    if (i == dataunion.submap_value->end()) {
+    if (i == dataunion.subintmap_value->end()) {
         return NULL;
     }
 
@@ -1030,10 +1092,17 @@ void TrackerElement::insert_intmap(int_map_pair p) {
     dataunion.subintmap_value->insert(p);
 }
 
-void TrackerElement::add_intmap(int i, shared_ptr<TrackerElement> s) {
+void TrackerElement::add_intmap(int i, const shared_ptr<TrackerElement>& s) {
     except_type_mismatch(TrackerIntMap);
 
-    (*dataunion.subintmap_value)[i] = s;
+    // Don't use operator[] here; growing the map could invalidate s if it
+    // refers to one of our own elements
+    int_map_iterator itr = dataunion.subintmap_value->find(i);
+
+    if (itr != dataunion.subintmap_value->end())
+        itr->second = s;
+    else
+        dataunion.subintmap_value->emplace(i, s);
 }
 
 void TrackerElement::del_intmap(int i) {
@@ -1051,7 +1120,7 @@ void TrackerElement::del_intmap(int_map_iterator i) {
     dataunion.subintmap_value->erase(i);
 }
 
-void TrackerElement::add_vector(shared_ptr<TrackerElement> s) {
+void TrackerElement::add_vector(const shared_ptr<TrackerElement>& s) {
     except_type_mismatch(TrackerVector);
 
     dataunion.subvector_value->push_back(s);
@@ -1130,69 +1199,256 @@ size_t TrackerElement::size() {
             return dataunion.substringmap_value->size();
         case TrackerDoubleMap:
             return dataunion.subdoublemap_value->size();
+        case TrackerInt64Vector:
+            return dataunion.int64vector_value->size();
         default:
             throw std::runtime_error(string("can't get size of a " + type_to_string(type)));
     }
 }
 
-template<> string GetTrackerValue(shared_ptr<TrackerElement> e) {
+size_t TrackerElement::get_own_memory_estimate() {
+    // Allocation overhead of a std::map node (color, parent, left, right)
+    const size_t map_node = 4 * sizeof(void *);
+
+    // Ourselves, plus the shared_ptr control block
+    size_t sz = sizeof(TrackerElement) + 2 * sizeof(void *) + local_name.capacity();
+
+    switch (type) {
+        case TrackerString:
+            // Interned strings are shared and accounted for by the pool
+            if (!string_interned)
+                sz += sizeof(string) + dataunion.string_value->capacity();
+            break;
+        case TrackerMac:
+            sz += sizeof(mac_addr);
+            break;
+        case TrackerUuid:
+            sz += sizeof(uuid);
+            break;
+        case TrackerByteArray:
+            sz += sizeof(shared_ptr<uint8_t>) + bytearray_value_len;
+            break;
+        case TrackerVector:
+            sz += sizeof(tracked_vector) + 
+                dataunion.subvector_value->capacity() * sizeof(SharedTrackerElement);
+            break;
+        case TrackerInt64Vector:
+            sz += sizeof(tracked_int64_vector) + 
+                dataunion.int64vector_value->capacity() * sizeof(int64_t);
+            break;
+        case TrackerMap:
+            sz += sizeof(tracked_map) + 
+                dataunion.submap_value->capacity() * sizeof(tracked_pair);
+            break;
+        case TrackerIntMap:
+            sz += sizeof(tracked_int_map) +
+                dataunion.subintmap_value->capacity() * sizeof(int_map_pair);
+            break;
+        case TrackerMacMap:
+            sz += sizeof(tracked_mac_map) + 
+                dataunion.submacmap_value->size() * (map_node + sizeof(mac_map_pair));
+            break;
+        case TrackerStringMap:
+            sz += sizeof(tracked_string_map);
+            for (auto& i : *(dataunion.substringmap_value))
+                sz += map_node + sizeof(string_map_pair) + i.first.capacity();
+            break;
+        case TrackerDoubleMap:
+            sz += sizeof(tracked_double_map) + 
+                dataunion.subdoublemap_value->size() * (map_node + sizeof(double_map_pair));
+            break;
+        default:
+            break;
+    }
+
+    return sz;
+}
+
+size_t TrackerElement::get_memory_estimate() {
+    size_t sz = get_own_memory_estimate();
+
+    switch (type) {
+        case TrackerVector:
+            for (auto& i : *(dataunion.subvector_value)) {
+                if (i != NULL)
+                    sz += i->get_memory_estimate();
+            }
+            break;
+        case TrackerMap:
+            for (auto& i : *(dataunion.submap_value)) {
+                if (i.second != NULL)
+                    sz += i.second->get_memory_estimate();
+            }
+            break;
+        case TrackerIntMap:
+            for (auto& i : *(dataunion.subintmap_value)) {
+                if (i.second != NULL)
+                    sz += i.second->get_memory_estimate();
+            }
+            break;
+        case TrackerMacMap:
+            for (auto& i : *(dataunion.submacmap_value)) {
+                if (i.second != NULL)
+                    sz += i.second->get_memory_estimate();
+            }
+            break;
+        case TrackerStringMap:
+            for (auto& i : *(dataunion.substringmap_value)) {
+                if (i.second != NULL)
+                    sz += i.second->get_memory_estimate();
+            }
+            break;
+        case TrackerDoubleMap:
+            for (auto& i : *(dataunion.subdoublemap_value)) {
+                if (i.second != NULL)
+                    sz += i.second->get_memory_estimate();
+            }
+            break;
+        default:
+            break;
+    }
+
+    return sz;
+}
+
+void TrackerElement::get_memory_by_field(field_memory_map& in_map) {
+    field_memory& fm = in_map[get_id()];
+    fm.count++;
+    fm.bytes += get_own_memory_estimate();
+
+    switch (type) {
+        case TrackerVector:
+            for (auto& i : *(dataunion.subvector_value)) {
+                if (i != NULL)
+                    i->get_memory_by_field(in_map);
+            }
+            break;
+        case TrackerMap:
+            for (auto& i : *(dataunion.submap_value)) {
+                if (i.second != NULL)
+                    i.second->get_memory_by_field(in_map);
+            }
+            break;
+        case TrackerIntMap:
+            for (auto& i : *(dataunion.subintmap_value)) {
+                if (i.second != NULL)
+                    i.second->get_memory_by_field(in_map);
+            }
+            break;
+        case TrackerMacMap:
+            for (auto& i : *(dataunion.submacmap_value)) {
+                if (i.second != NULL)
+                    i.second->get_memory_by_field(in_map);
+            }
+            break;
+        case TrackerStringMap:
+            for (auto& i : *(dataunion.substringmap_value)) {
+                if (i.second != NULL)
+                    i.second->get_memory_by_field(in_map);
+            }
+            break;
+        case TrackerDoubleMap:
+            for (auto& i : *(dataunion.subdoublemap_value)) {
+                if (i.second != NULL)
+                    i.second->get_memory_by_field(in_map);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+size_t TrackerElement::get_type_size(TrackerType t) {
+    // Element, shared_ptr control block, and whatever fixed object the type
+    // allocates; container contents aren't included
+    size_t sz = sizeof(TrackerElement) + 2 * sizeof(void *);
+
+    switch (t) {
+        case TrackerString:
+            return sz + sizeof(string);
+        case TrackerMac:
+            return sz + sizeof(mac_addr);
+        case TrackerUuid:
+            return sz + sizeof(uuid);
+        case TrackerByteArray:
+            return sz + sizeof(shared_ptr<uint8_t>);
+        case TrackerVector:
+            return sz + sizeof(tracked_vector);
+        case TrackerInt64Vector:
+            return sz + sizeof(tracked_int64_vector);
+        case TrackerMap:
+            return sz + sizeof(tracked_map);
+        case TrackerIntMap:
+            return sz + sizeof(tracked_int_map);
+        case TrackerMacMap:
+            return sz + sizeof(tracked_mac_map);
+        case TrackerStringMap:
+            return sz + sizeof(tracked_string_map);
+        case TrackerDoubleMap:
+            return sz + sizeof(tracked_double_map);
+        default:
+            return sz;
+    }
+}
+
+template<> string GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_string();
 }
 
-template<> int8_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> int8_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_int8();
 }
 
-template<> uint8_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> uint8_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_uint8();
 }
 
-template<> int16_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> int16_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_int16();
 }
 
-template<> uint16_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> uint16_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_uint16();
 }
 
-template<> int32_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> int32_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_int32();
 }
 
-template<> uint32_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> uint32_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_uint32();
 }
 
-template<> int64_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> int64_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_int64();
 }
 
-template<> uint64_t GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> uint64_t GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_uint64();
 }
 
-template<> float GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> float GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_float();
 }
 
-template<> double GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> double GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_double();
 }
 
-template<> mac_addr GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> mac_addr GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_mac();
 }
 
-template<> TrackerElement::tracked_map *GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> TrackerElement::tracked_map *GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_map();
 }
 
 template<> TrackerElement::tracked_vector 
-    *GetTrackerValue(shared_ptr<TrackerElement> e) {
+    *GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_vector();
 }
 
-template<> uuid GetTrackerValue(shared_ptr<TrackerElement> e) {
+template<> uuid GetTrackerValue(const shared_ptr<TrackerElement>& e) {
     return e->get_uuid();
 }
 
@@ -1338,7 +1594,7 @@ bool operator<(TrackerElement &te1, TrackerElement &te2) {
     }
 }
 
-bool operator<(SharedTrackerElement te1, SharedTrackerElement te2) {
+bool operator<(const SharedTrackerElement& te1, const SharedTrackerElement& te2) {
     if (te1 == NULL)
         return false;
 
@@ -1433,6 +1689,10 @@ tracker_component::tracker_component(GlobalRegistry *in_globalreg, int in_id) {
     globalreg = in_globalreg;
     tracker = in_globalreg->entrytracker;
 
+    field_layout = NULL;
+    field_layout_owned = false;
+    field_layout_pos = 0;
+
     set_type(TrackerMap);
     set_id(in_id);
 }
@@ -1443,18 +1703,21 @@ tracker_component::tracker_component(GlobalRegistry *in_globalreg, int in_id,
     globalreg = in_globalreg;
     tracker = in_globalreg->entrytracker;
 
+    field_layout = NULL;
+    field_layout_owned = false;
+    field_layout_pos = 0;
+
     set_type(TrackerMap);
     set_id(in_id);
 }
 
 tracker_component::~tracker_component() { 
-    for (unsigned int i = 0; i < registered_fields.size(); i++) {
-        delete registered_fields[i];
-    }
+    if (field_layout_owned)
+        delete field_layout;
 }
 
 shared_ptr<TrackerElement> tracker_component::clone_type() {
-    return shared_ptr<TrackerElement>(new tracker_component(globalreg, get_id()));
+    return AllocTrackedElement<tracker_component>(globalreg, get_id());
 }
 
 string tracker_component::get_name() {
@@ -1465,53 +1728,407 @@ string tracker_component::get_name(int in_id) {
     return globalreg->entrytracker->GetFieldName(in_id);
 }
 
-int tracker_component::RegisterField(string in_name, TrackerType in_type, 
-        string in_desc, shared_ptr<TrackerElement> *in_dest) {
-    int id = tracker->RegisterField(in_name, in_type, in_desc);
+// Field IDs never change once registered, and component field names are 
+// string literals, so the ID for a name can be cached by the address of the
+// name.  This is an insert-only open addressing table which can be read 
+// without locking; a copy of each name is kept so a non-literal name which
+// happens to reuse an address is never mistaken for another field.
+class tracker_field_id_cache {
+public:
+    static const unsigned int num_slots = 2048;
 
-    registered_field *rf = new registered_field(id, in_dest);
+    int lookup(const char *in_name) {
+        unsigned int h = hash(in_name);
 
-    registered_fields.push_back(rf);
+        for (unsigned int p = 0; p < max_probe; p++) {
+            cache_slot& s = slots[(h + p) % num_slots];
 
-    return id;
+            const char *k = s.key.load(std::memory_order_acquire);
+
+            if (k == NULL)
+                return -1;
+
+            if (k != in_name)
+                continue;
+
+            if (!s.ready.load(std::memory_order_acquire))
+                return -1;
+
+            if (strcmp(s.name, in_name) != 0)
+                return -1;
+
+            return s.id;
+        }
+
+        return -1;
+    }
+
+    void insert(const char *in_name, int in_id) {
+        if (in_id < 0)
+            return;
+
+        unsigned int h = hash(in_name);
+
+        for (unsigned int p = 0; p < max_probe; p++) {
+            cache_slot& s = slots[(h + p) % num_slots];
+
+            const char *expected = NULL;
+
+            if (s.key.compare_exchange_strong(expected, in_name)) {
+                s.name = strdup(in_name);
+                s.id = in_id;
+                s.ready.store(true, std::memory_order_release);
+                return;
+            }
+
+            // Someone else has (or is) caching this address
+            if (expected == in_name)
+                return;
+        }
+
+        // Table is full around this hash; we just don't cache it
+    }
+
+protected:
+    static const unsigned int max_probe = 64;
+
+    class cache_slot {
+    public:
+        std::atomic<const char *> key;
+        std::atomic<bool> ready;
+        char *name;
+        int id;
+    };
+
+    unsigned int hash(const char *in_name) {
+        uintptr_t v = (uintptr_t) in_name;
+        return (unsigned int) (((v >> 3) * 2654435761U) % num_slots);
+    }
+
+    // Static storage, so every slot starts zeroed
+    cache_slot slots[num_slots];
+};
+
+static tracker_field_id_cache field_id_cache;
+
+int tracker_component::FetchCachedFieldId(const char *in_name) {
+    return field_id_cache.lookup(in_name);
+}
+
+// Fields registered by a component class, in registration order.  Once the
+// first instance of a class has registered its fields the layout is shared
+// and never changes.
+class tracker_field_layout {
+public:
+    class field {
+    public:
+        // Name as passed to RegisterField; compared by address only
+        const char *name;
+        int id;
+        // Basic type, or TrackerUnassigned for fields built from a builder
+        TrackerType type;
+        // Offset of the destination field from the component, or -1 for
+        // fields which aren't assigned during reserve_fields
+        ptrdiff_t offset;
+        // Only imported, never created, during reserve_fields
+        bool dynamic;
+    };
+
+    tracker_field_layout(const std::type_info *in_type) :
+        type(in_type) { }
+
+    const std::type_info *type;
+    vector<field> fields;
+};
+
+// Layouts by component class, keyed by the address of the type_info of the
+// class.  Insert-only and read without locking, like the field ID cache; a
+// class whose type_info shows up at more than one address (across a plugin
+// boundary, for instance) just records its layout once per address.
+class tracker_field_layout_cache {
+public:
+    static const unsigned int num_slots = 512;
+
+    tracker_field_layout *lookup(const std::type_info *in_type) {
+        unsigned int h = hash(in_type);
+
+        for (unsigned int p = 0; p < max_probe; p++) {
+            cache_slot& s = slots[(h + p) % num_slots];
+
+            const std::type_info *k = s.key.load(std::memory_order_acquire);
+
+            if (k == NULL)
+                return NULL;
+
+            if (k == in_type)
+                return s.layout.load(std::memory_order_acquire);
+        }
+
+        return NULL;
+    }
+
+    // Publish a layout; returns false if the class already has one (or the
+    // table is full), in which case the caller still owns the layout
+    bool insert(tracker_field_layout *in_layout) {
+        unsigned int h = hash(in_layout->type);
+
+        for (unsigned int p = 0; p < max_probe; p++) {
+            cache_slot& s = slots[(h + p) % num_slots];
+
+            const std::type_info *expected = NULL;
+
+            if (s.key.compare_exchange_strong(expected, in_layout->type)) {
+                s.layout.store(in_layout, std::memory_order_release);
+                return true;
+            }
+
+            if (expected == in_layout->type)
+                return false;
+        }
+
+        return false;
+    }
+
+protected:
+    static const unsigned int max_probe = 64;
+
+    class cache_slot {
+    public:
+        std::atomic<const std::type_info *> key;
+        std::atomic<tracker_field_layout *> layout;
+    };
+
+    unsigned int hash(const std::type_info *in_type) {
+        uintptr_t v = (uintptr_t) in_type;
+        return (unsigned int) (((v >> 3) * 2654435761U) % num_slots);
+    }
+
+    // Static storage, so every slot starts zeroed
+    cache_slot slots[num_slots];
+};
+
+static tracker_field_layout_cache field_layout_cache;
+
+int tracker_component::next_layout_field(const char *in_name) {
+    const std::type_info *t = &typeid(*this);
+
+    // Start of a register_fields pass; a base class constructor may already
+    // have run one for its own class
+    if (field_layout == NULL || field_layout->type != t) {
+        if (field_layout_owned)
+            delete field_layout;
+
+        field_layout = field_layout_cache.lookup(t);
+        field_layout_owned = false;
+        field_layout_pos = 0;
+
+        if (field_layout == NULL) {
+            field_layout = new tracker_field_layout(t);
+            field_layout_owned = true;
+        }
+    }
+
+    if (field_layout_owned)
+        return -1;
+
+    if (field_layout_pos < field_layout->fields.size() &&
+            field_layout->fields[field_layout_pos].name == in_name)
+        return field_layout->fields[field_layout_pos++].id;
+
+    // This instance doesn't match the layout of its class; keep our own copy
+    // of what did match and carry on registering
+    tracker_field_layout *l = new tracker_field_layout(t);
+    l->fields.assign(field_layout->fields.begin(),
+            field_layout->fields.begin() + field_layout_pos);
+    field_layout = l;
+    field_layout_owned = true;
+
+    return -1;
 }
 
-int tracker_component::RegisterField(string in_name, TrackerType in_type, 
-        string in_desc) {
-    int id = tracker->RegisterField(in_name, in_type, in_desc);
+int tracker_component::add_layout_field(const char *in_name, int in_id,
+        TrackerType in_type, shared_ptr<TrackerElement> *in_dest, bool in_dynamic) {
+    tracker_field_layout::field f;
 
-    return id;
+    f.name = in_name;
+    f.id = in_id;
+    f.type = in_type;
+    f.dynamic = in_dynamic;
+
+    if (in_dest == NULL)
+        f.offset = -1;
+    else
+        f.offset = (char *) in_dest - (char *) this;
+
+    field_layout->fields.push_back(f);
+    field_layout_pos++;
+
+    return in_id;
+}
+
+int tracker_component::RegisterField(const char *in_name, TrackerType in_type, 
+        const char *in_desc, shared_ptr<TrackerElement> *in_dest) {
+    int id = next_layout_field(in_name);
+
+    if (id >= 0)
+        return id;
+
+    id = field_id_cache.lookup(in_name);
+
+    if (id < 0) {
+        id = tracker->RegisterField(in_name, in_type, in_desc);
+        field_id_cache.insert(in_name, id);
+    }
+
+    return add_layout_field(in_name, id, in_type, in_dest, false);
 }
 
-int tracker_component::RegisterField(string in_name, 
+int tracker_component::RegisterDynamicField(const char *in_name, TrackerType in_type, 
+        const char *in_desc, shared_ptr<TrackerElement> *in_dest) {
+    int id = next_layout_field(in_name);
+
+    if (id >= 0)
+        return id;
+
+    id = field_id_cache.lookup(in_name);
+
+    if (id < 0) {
+        id = tracker->RegisterField(in_name, in_type, in_desc);
+        field_id_cache.insert(in_name, id);
+    }
+
+    return add_layout_field(in_name, id, in_type, in_dest, true);
+}
+
+int tracker_component::RegisterField(const char *in_name, TrackerType in_type, 
+        const char *in_desc) {
+    int id = next_layout_field(in_name);
+
+    if (id >= 0)
+        return id;
+
+    id = field_id_cache.lookup(in_name);
+
+    if (id < 0) {
+        id = tracker->RegisterField(in_name, in_type, in_desc);
+        field_id_cache.insert(in_name, id);
+    }
+
+    return add_layout_field(in_name, id, in_type, NULL, false);
+}
+
+int tracker_component::RegisterField(const char *in_name, 
         shared_ptr<TrackerElement> in_builder, 
-        string in_desc, shared_ptr<TrackerElement> *in_dest) {
-    int id = tracker->RegisterField(in_name, in_builder, in_desc);
+        const char *in_desc, shared_ptr<TrackerElement> *in_dest) {
+    int id = next_layout_field(in_name);
 
-    registered_field *rf = new registered_field(id, in_dest);
+    if (id >= 0)
+        return id;
 
-    registered_fields.push_back(rf);
+    id = field_id_cache.lookup(in_name);
 
-    return id;
+    if (id < 0) {
+        id = tracker->RegisterField(in_name, in_builder, in_desc);
+        field_id_cache.insert(in_name, id);
+    }
+
+    return add_layout_field(in_name, id, TrackerUnassigned, in_dest, false);
 } 
 
-int tracker_component::RegisterComplexField(string in_name, 
+int tracker_component::RegisterComplexField(const char *in_name, 
         shared_ptr<TrackerElement> in_builder, 
-        string in_desc) {
-    int id = tracker->RegisterField(in_name, in_builder, in_desc);
+        const char *in_desc) {
+    int id = next_layout_field(in_name);
+
+    if (id < 0) {
+        id = field_id_cache.lookup(in_name);
+
+        if (id < 0) {
+            id = tracker->RegisterField(in_name, in_builder, in_desc);
+            field_id_cache.insert(in_name, id);
+        }
+
+        add_layout_field(in_name, id, TrackerUnassigned, NULL, false);
+    }
+
     in_builder->set_id(id);
     return id;
 }
 
+shared_ptr<TrackerElement>& 
+    tracker_component::materialize_field(shared_ptr<TrackerElement>& in_field, 
+            int in_id) {
+    if (in_field == NULL) {
+        in_field = tracker->GetTrackedInstance(in_id);
+        add_map(in_field);
+    }
+
+    return in_field;
+}
+
 void tracker_component::reserve_fields(shared_ptr<TrackerElement> e) {
-    for (unsigned int i = 0; i < registered_fields.size(); i++) {
-        registered_field *rf = registered_fields[i];
+    // Nothing registered
+    if (field_layout == NULL)
+        return;
+
+    // Only the fields registered by this pass; an instance can stop short of
+    // the layout of its class
+    const vector<tracker_field_layout::field>& fields = field_layout->fields;
+    unsigned int num_registered = field_layout_pos;
+
+    size_t num_fields = 0;
+
+    for (unsigned int i = 0; i < num_registered; i++) {
+        if (fields[i].offset >= 0 && !fields[i].dynamic)
+            num_fields++;
+    }
+
+    // We know how many fields we'll hold, unless dynamic fields get created
+    reserve_map(num_fields);
 
-        if (rf->assign != NULL) {
-            *(rf->assign) = import_or_new(e, rf->id);
+    for (unsigned int i = 0; i < num_registered; i++) {
+        const tracker_field_layout::field& rf = fields[i];
+
+        if (rf.offset < 0)
+            continue;
+
+        shared_ptr<TrackerElement> *assign =
+            (shared_ptr<TrackerElement> *) ((char *) this + rf.offset);
+
+        if (rf.dynamic) {
+            if (e != NULL) {
+                *assign = e->get_map_value(rf.id);
+
+                if (*assign != NULL)
+                    add_map(*assign);
+            }
+
+            continue;
+        }
+
+        // Basic fields we build from scratch get their own slab block with
+        // the reference count alongside, so a field held past its component
+        // (by a summary, a cache, or another map) only keeps itself alive
+        if (rf.id >= 0 && rf.type != TrackerUnassigned &&
+                (e == NULL || e->get_map_value(rf.id) == NULL)) {
+            shared_ptr<TrackerElement> r =
+                AllocTrackedElement<TrackerElement>(rf.type, rf.id);
+            add_map(r);
+
+            *assign = r;
         } else {
+            *assign = import_or_new(e, rf.id);
         }
     }
+
+    // The first instance of a class shares the layout it recorded; any other
+    // private layout is dropped
+    if (field_layout_owned && !field_layout_cache.insert(field_layout))
+        delete field_layout;
+
+    field_layout = NULL;
+    field_layout_owned = false;
+    field_layout_pos = 0;
 }
 
 shared_ptr<TrackerElement> 
@@ -1576,6 +2193,16 @@ shared_ptr<TrackerElement>
     return next_elem;
 }
 
+void TrackerElementSerializer::serialize_vector_summary(std::stringstream &stream,
+        size_t in_index, const SharedTrackerElement& in_elem,
+        const shared_ptr<TrackerElementSummaryPlan>& in_plan) {
+    SharedTrackerElement simple;
+
+    SummarizeTrackerElement(in_elem, in_plan, simple);
+
+    serialize_vector_element(stream, in_index, simple);
+}
+
 void TrackerElementSerializer::pre_serialize_path(SharedElementSummary in_summary) {
 
     // Iterate through the path on this object, calling pre-serialize as
@@ -1607,6 +2234,7 @@ TrackerElementSummary::TrackerElementSummary(SharedElementSummary in_c) {
     parent_element = in_c->parent_element;
     resolved_path = in_c->resolved_path;
     rename = in_c->rename;
+    path = in_c->path;
 }
 
 TrackerElementSummary::TrackerElementSummary(string in_path, string in_rename,
@@ -1651,6 +2279,10 @@ void TrackerElementSummary::parse_path(vector<string> in_path, string in_rename,
         if (in_path[x].length() == 0)
             continue;
 
+        if (path.length() != 0)
+            path += "/";
+        path += in_path[x];
+
         int id = entrytracker->GetFieldId(in_path[x]);
 
         if (id < 0)
@@ -1667,15 +2299,15 @@ void TrackerElementSummary::parse_path(vector<string> in_path, string in_rename,
 }
 
 shared_ptr<TrackerElement> GetTrackerElementPath(string in_path, 
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker) {
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker) {
     return GetTrackerElementPath(StrTokenize(in_path, "/"),
             elem, entrytracker);
 }
 
-shared_ptr<TrackerElement> GetTrackerElementPath(std::vector<string> in_path, 
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker) {
+shared_ptr<TrackerElement> GetTrackerElementPath(const std::vector<string>& in_path, 
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker) {
 
     if (in_path.size() < 1)
         return NULL;
@@ -1707,13 +2339,15 @@ shared_ptr<TrackerElement> GetTrackerElementPath(std::vector<string> in_path,
     return next_elem;
 }
 
-shared_ptr<TrackerElement> GetTrackerElementPath(std::vector<int> in_path, 
-        SharedTrackerElement elem) {
+shared_ptr<TrackerElement> GetTrackerElementPath(const std::vector<int>& in_path, 
+        const SharedTrackerElement& elem) {
 
     if (in_path.size() < 1)
         return NULL;
 
-    shared_ptr<TrackerElement> next_elem = NULL;
+    // Walk the path by reference and only take a reference count on the
+    // element we return
+    const SharedTrackerElement *next_elem = &elem;
 
     for (unsigned int x = 0; x < in_path.size(); x++) {
         int id = in_path[x];
@@ -1722,30 +2356,29 @@ shared_ptr<TrackerElement> GetTrackerElementPath(std::vector<int> in_path,
             return NULL;
         }
 
-        if (next_elem == NULL)
-            next_elem = elem->get_map_value(id);
-        else
-            next_elem = 
-                next_elem->get_map_value(id);
+        TrackerElement::tracked_map *m = (*next_elem)->get_map();
+        TrackerElement::map_iterator i = m->find(id);
 
-        if (next_elem == NULL) {
+        if (i == m->end() || i->second == NULL) {
             return NULL;
         }
+
+        next_elem = &(i->second);
     }
 
-    return next_elem;
+    return *next_elem;
 }
 
 std::vector<SharedTrackerElement> GetTrackerElementMultiPath(string in_path, 
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker) {
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker) {
     return GetTrackerElementMultiPath(StrTokenize(in_path, "/"),
             elem, entrytracker);
 }
 
-std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<string> in_path, 
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker) {
+std::vector<SharedTrackerElement> GetTrackerElementMultiPath(const std::vector<string>& in_path, 
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker) {
 
     std::vector<SharedTrackerElement> ret;
 
@@ -1755,7 +2388,7 @@ std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<string>
     shared_ptr<TrackerElement> next_elem = NULL;
 
     bool complex_fulfilled = false;
-    for (vector<string>::iterator x = in_path.begin(); x != in_path.end(); ++x) {
+    for (vector<string>::const_iterator x = in_path.begin(); x != in_path.end(); ++x) {
         // Skip empty path element
         if (x->length() == 0)
             continue;
@@ -1867,8 +2500,8 @@ std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<string>
     return ret;
 }
 
-std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<int> in_path, 
-        SharedTrackerElement elem) {
+std::vector<SharedTrackerElement> GetTrackerElementMultiPath(const std::vector<int>& in_path, 
+        const SharedTrackerElement& elem) {
 
     std::vector<SharedTrackerElement> ret;
 
@@ -1878,7 +2511,7 @@ std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<int> in
     shared_ptr<TrackerElement> next_elem = NULL;
 
     bool complex_fulfilled = false;
-    for (vector<int>::iterator x = in_path.begin(); x != in_path.end(); ++x) {
+    for (vector<int>::const_iterator x = in_path.begin(); x != in_path.end(); ++x) {
         int id = *x;
 
         if (id < 0) {
@@ -1986,57 +2619,85 @@ std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<int> in
     return ret;
 }
 
-void SummarizeTrackerElement(shared_ptr<EntryTracker> entrytracker,
-        SharedTrackerElement in, 
-        vector<SharedElementSummary> in_summarization, 
-        SharedTrackerElement &ret_elem, 
-        TrackerElementSerializer::rename_map &rename_map) {
+TrackerElementSummaryPlan::TrackerElementSummaryPlan(
+        const shared_ptr<EntryTracker>& entrytracker,
+        const vector<SharedElementSummary>& in_summarization) {
 
     unsigned int fn = 0;
-    ret_elem.reset(new TrackerElement(TrackerMap));
 
-    for (vector<SharedElementSummary>::iterator si = in_summarization.begin();
+    for (vector<SharedElementSummary>::const_iterator si = in_summarization.begin();
             si != in_summarization.end(); ++si) {
         fn++;
 
         if ((*si)->resolved_path.size() == 0)
             continue;
 
-        SharedTrackerElement f =
-            GetTrackerElementPath((*si)->resolved_path, in);
-
-        if (f == NULL) {
-            f = entrytracker->RegisterAndGetField("unknown" + IntToString(fn),
-                    TrackerInt8, "unallocated field");
-
-            f = SharedTrackerElement(new TrackerElement(TrackerUInt8));
-            f->set((uint8_t) 0);
-        
-            if ((*si)->rename.length() != 0) {
-                f->set_local_name((*si)->rename);
-            } else {
-                // Get the last name of the field in the path, if we can...
-                int lastid = (*si)->resolved_path[(*si)->resolved_path.size() - 1];
-
-                if (lastid < 0)
-                    f->set_local_name("unknown" + IntToString(fn));
-                else
-                    f->set_local_name(entrytracker->GetFieldName(lastid));
+        field f;
+
+        f.resolved_path = (*si)->resolved_path;
+        f.rename = (*si)->rename;
+
+        // Fields the record doesn't have are sent as a placeholder named by
+        // the rename, the field, or the position in the request
+        if (f.rename.length() != 0) {
+            f.missing_name = f.rename;
+        } else {
+            int lastid = f.resolved_path[f.resolved_path.size() - 1];
+
+            if (lastid < 0)
+                f.missing_name = "unknown" + IntToString(fn);
+            else
+                f.missing_name = entrytracker->GetFieldName(lastid);
+        }
+
+        fields.push_back(f);
+    }
+}
+
+void TrackerElementSummaryPlan::resolve(const SharedTrackerElement& in, 
+        vector<resolved_field>& ret) const {
+    ret.clear();
+    ret.reserve(fields.size());
+
+    for (vector<field>::const_iterator fi = fields.begin(); fi != fields.end(); ++fi) {
+        resolved_field r;
+
+        r.plan_field = &(*fi);
+        r.elem = GetTrackerElementPath(fi->resolved_path, in);
+
+        if (r.elem == NULL) {
+            // Placeholders are unregistered elements
+            r.id = -1;
+        } else {
+            r.id = r.elem->get_id();
+
+            // Pathed and renamed fields pre-serialize the path down to them 
+            // (see pre_serialize_path); the field itself is pre-serialized
+            // when it's written
+            if (fi->rename.length() != 0 || fi->resolved_path.size() > 1) {
+                SharedTrackerElement inter = in;
+
+                for (size_t p = 0; p + 1 < fi->resolved_path.size(); p++) {
+                    inter = inter->get_map_value(fi->resolved_path[p]);
+                    inter->pre_serialize();
+                }
             }
-        } 
-
-       
-        // If we're renaming it or we're a path, we put the record in.  We need
-        // to duplicate the summary object and make a reference to our parent
-        // object so that when we serialize we can descend the path calling
-        // the proper pre-serialization methods
-        if ((*si)->rename.length() != 0 || (*si)->resolved_path.size() > 1) {
-            SharedElementSummary sum(new TrackerElementSummary(*si));
-            sum->parent_element = in;
-            rename_map[f] = sum;
         }
 
-        ret_elem->add_map(f);
+        ret.push_back(r);
     }
+
+    // A summarized map is ordered by field id, with duplicates in the order
+    // they were added
+    std::stable_sort(ret.begin(), ret.end(), 
+            [](const resolved_field& a, const resolved_field& b) {
+                return a.id < b.id;
+            });
+}
+
+void SummarizeTrackerElement(const SharedTrackerElement& in,
+        const shared_ptr<TrackerElementSummaryPlan>& in_plan,
+        SharedTrackerElement &ret_elem) {
+    ret_elem = AllocTrackedElement<TrackerElementSummaryRef>(in, in_plan);
 }
 
@@ -34,6 +34,9 @@
 
 #include "macaddr.h"
 #include "uuid.h"
+#include "kis_flat_map.h"
+#include "kis_slab.h"
+#include "kis_string_pool.h"
 
 // Type safety can be disabled by commenting out this definition.  This will no
 // longer validate that the type of element matches the use; if used improperly this
@@ -58,6 +61,15 @@ class TrackerElement;
 
 typedef std::shared_ptr<TrackerElement> SharedTrackerElement;
 
+// Allocate a tracked element or component with its reference count in the same
+// block, from a slab pool for that type.  Prefer this to shared_ptr<T>(new T),
+// which makes two separate heap allocations per element.
+template<class T, class... Args>
+std::shared_ptr<T> AllocTrackedElement(Args&&... args) {
+    return std::allocate_shared<T>(kis_slab_allocator<T>(), 
+            std::forward<Args>(args)...);
+}
+
 // Types of fields we can track and automatically resolve
 // Statically assigned type numbers which MUST NOT CHANGE as things go forwards for 
 // binary/fast serialization, new types must be added to the end of the list
@@ -103,8 +115,18 @@ enum TrackerType {
 
     // Byte array
     TrackerByteArray = 19,
+
+    // Vector of plain int64s, serialized like a vector of TrackerInt64
+    // elements but without an element per value
+    TrackerInt64Vector = 20,
+
+    // Summarized record (TrackerElementSummaryRef); holds no data of its own,
+    // serializers expand it from the original record and the summary plan
+    TrackerSummary = 21,
 };
 
+class TrackerElementSummaryRef;
+
 class TrackerElement {
 public:
     TrackerElement() {
@@ -120,8 +142,7 @@ public:
 
     // Factory-style for easily making more of the same if we're subclassed
     virtual shared_ptr<TrackerElement> clone_type() {
-        shared_ptr<TrackerElement> dup1(new TrackerElement(get_type(), get_id()));
-        return dup1;
+        return AllocTrackedElement<TrackerElement>(get_type(), get_id());
     }
 
     virtual shared_ptr<TrackerElement> clone_type(int in_id) {
@@ -134,6 +155,10 @@ public:
     // Called prior to serialization output
     virtual void pre_serialize() { }
 
+    // Summarized records are expanded by the serializers instead of being
+    // serialized as themselves
+    virtual TrackerElementSummaryRef *get_summary_ref() { return NULL; }
+
     int get_id() {
         return tracked_id;
     }
@@ -158,14 +183,19 @@ public:
     typedef vector<shared_ptr<TrackerElement> >::iterator vector_iterator;
     typedef vector<shared_ptr<TrackerElement> >::const_iterator vector_const_iterator;
 
-    typedef multimap<int, shared_ptr<TrackerElement> > tracked_map;
-    typedef multimap<int, shared_ptr<TrackerElement> >::iterator map_iterator;
-    typedef multimap<int, shared_ptr<TrackerElement> >::const_iterator map_const_iterator;
+    typedef vector<int64_t> tracked_int64_vector;
+
+    // Field maps and int maps are small and extremely numerous, so they're
+    // stored as sorted arrays rather than trees.  They share an iterator type
+    // so either can be walked via begin()/end()/find().
+    typedef kis_flat_map<int, shared_ptr<TrackerElement>, true> tracked_map;
+    typedef tracked_map::iterator map_iterator;
+    typedef tracked_map::const_iterator map_const_iterator;
     typedef pair<int, shared_ptr<TrackerElement> > tracked_pair;
 
-    typedef map<int, shared_ptr<TrackerElement> > tracked_int_map;
-    typedef map<int, shared_ptr<TrackerElement> >::iterator int_map_iterator;
-    typedef map<int, shared_ptr<TrackerElement> >::const_iterator int_map_const_iterator;
+    typedef kis_flat_map<int, shared_ptr<TrackerElement> > tracked_int_map;
+    typedef tracked_int_map::iterator int_map_iterator;
+    typedef tracked_int_map::const_iterator int_map_const_iterator;
     typedef pair<int, shared_ptr<TrackerElement> > int_map_pair;
 
     typedef map<mac_addr, shared_ptr<TrackerElement> > tracked_mac_map;
@@ -186,6 +216,29 @@ public:
     // Getter per type, use templated GetTrackerValue() for easy fetch
     string get_string() {
         except_type_mismatch(TrackerString);
+
+        if (string_interned) {
+            if (dataunion.interned_value == NULL)
+                return string();
+            return dataunion.interned_value->first;
+        }
+
+        return *(dataunion.string_value);
+    }
+
+    // Reference to the string without copying it, for serializers; only valid
+    // until the element is changed
+    const string& get_string_ref() {
+        static const string empty_string;
+
+        except_type_mismatch(TrackerString);
+
+        if (string_interned) {
+            if (dataunion.interned_value == NULL)
+                return empty_string;
+            return dataunion.interned_value->first;
+        }
+
         return *(dataunion.string_value);
     }
 
@@ -249,6 +302,11 @@ public:
         return dataunion.subvector_value;
     }
 
+    tracked_int64_vector *get_int64_vector() {
+        except_type_mismatch(TrackerInt64Vector);
+        return dataunion.int64vector_value;
+    }
+
     shared_ptr<TrackerElement> get_vector_value(unsigned int offt) {
         except_type_mismatch(TrackerVector);
         return (*dataunion.subvector_value)[offt];
@@ -262,8 +320,7 @@ public:
     shared_ptr<TrackerElement> get_map_value(int fn) {
         except_type_mismatch(TrackerMap);
 
-        map<int, shared_ptr<TrackerElement> >::iterator i = 
-            dataunion.submap_value->find(fn);
+        map_iterator i = dataunion.submap_value->find(fn);
 
         if (i == dataunion.submap_value->end()) {
             return NULL;
@@ -272,7 +329,7 @@ public:
         return i->second;
     }
 
-    map<int, shared_ptr<TrackerElement> > *get_intmap() {
+    tracked_int_map *get_intmap() {
         except_type_mismatch(TrackerIntMap);
         return dataunion.subintmap_value;
     }
@@ -300,9 +357,19 @@ public:
     // Overloaded set
     void set(string v) {
         except_type_mismatch(TrackerString);
+
+        if (string_interned) {
+            set_interned(v);
+            return;
+        }
+
         *(dataunion.string_value) = v;
     }
 
+    // Store a string value in the global string pool instead of in this
+    // element; the element stays interned for any later set()
+    void set_interned(const string& v);
+
     void set(uint8_t v) {
         except_type_mismatch(TrackerUInt8);
         dataunion.uint8_value = v;
@@ -367,6 +434,23 @@ public:
 
     size_t size();
 
+    // Approximate number of bytes used by this element and everything under
+    // it, including container overhead.  Shared children are counted each time
+    // they are referenced.
+    size_t get_memory_estimate();
+
+    // Live elements and approximate bytes, keyed by field id
+    struct field_memory {
+        field_memory() : count(0), bytes(0) { }
+        uint64_t count;
+        uint64_t bytes;
+    };
+    typedef map<int, field_memory> field_memory_map;
+
+    // Add this element and everything under it to a per-field breakdown;
+    // bytes are only what each element holds itself, not its children
+    void get_memory_by_field(field_memory_map& in_map);
+
     vector_iterator vec_begin();
     vector_iterator vec_end();
 
@@ -376,14 +460,15 @@ public:
     void clear_map();
     size_t size_map();
 
-    void add_map(int f, shared_ptr<TrackerElement> s);
-    void add_map(shared_ptr<TrackerElement> s); 
+    void add_map(int f, const shared_ptr<TrackerElement>& s);
+    void add_map(const shared_ptr<TrackerElement>& s);
     void del_map(int f);
-    void del_map(shared_ptr<TrackerElement> s);
+    void del_map(const shared_ptr<TrackerElement>& s);
     void del_map(map_iterator i);
     void insert_map(tracked_pair p);
+    void reserve_map(size_t n);
 
-    void add_intmap(int i, shared_ptr<TrackerElement> s);
+    void add_intmap(int i, const shared_ptr<TrackerElement>& s);
     void del_intmap(int i);
     void del_intmap(int_map_iterator i);
     void clear_intmap();
@@ -395,7 +480,7 @@ public:
     int_map_iterator int_end();
     int_map_iterator int_find(int k);
 
-    void add_macmap(mac_addr i, shared_ptr<TrackerElement> s);
+    void add_macmap(mac_addr i, const shared_ptr<TrackerElement>& s);
     void del_macmap(mac_addr i);
     void del_macmap(mac_map_iterator i);
     void clear_macmap();
@@ -407,7 +492,7 @@ public:
     mac_map_iterator mac_end();
     mac_map_iterator mac_find(mac_addr k);
 
-    void add_stringmap(string i, shared_ptr<TrackerElement> s);
+    void add_stringmap(string i, const shared_ptr<TrackerElement>& s);
     void del_stringmap(string i);
     void del_stringmap(string_map_iterator i);
     void clear_stringmap();
@@ -419,7 +504,7 @@ public:
     string_map_iterator string_end();
     string_map_iterator string_find(string k);
 
-    void add_doublemap(double i, shared_ptr<TrackerElement> s);
+    void add_doublemap(double i, const shared_ptr<TrackerElement>& s);
     void del_doublemap(double i);
     void del_doublemap(double_map_iterator i);
     void clear_doublemap();
@@ -431,7 +516,7 @@ public:
     double_map_iterator double_end();
     double_map_iterator double_find(double k);
 
-    void add_vector(shared_ptr<TrackerElement> s);
+    void add_vector(const shared_ptr<TrackerElement>& s);
     void del_vector(unsigned int p);
     void del_vector(vector_iterator i);
     void clear_vector();
@@ -501,7 +586,8 @@ public:
 
     // Valid for comparing two fields of the same type
     friend bool operator<(TrackerElement &te1, TrackerElement &te2);
-    friend bool operator<(SharedTrackerElement te1, SharedTrackerElement te2);
+    friend bool operator<(const SharedTrackerElement& te1, 
+            const SharedTrackerElement& te2);
 
     friend bool operator>(TrackerElement &te1, int8_t i);
     friend bool operator>(TrackerElement &te1, uint8_t i);
@@ -549,6 +635,12 @@ public:
     static string type_to_string(TrackerType t);
 
 protected:
+    // Bytes held by this element itself, excluding any children
+    size_t get_own_memory_estimate();
+
+    // Fixed size of an element of a given type, for kis_mem_account
+    static size_t get_type_size(TrackerType t);
+
     // Generic coercion exception
 #ifdef TE_TYPE_SAFETY
     inline void except_type_mismatch(const TrackerType t) const {
@@ -567,6 +659,9 @@ protected:
     TrackerType type;
     int tracked_id;
 
+    // String value lives in the global string pool
+    bool string_interned;
+
     // Overridden name for this instance only
     string local_name;
 
@@ -577,6 +672,8 @@ protected:
     union du {
         string *string_value;
 
+        const kis_string_pool::entry *interned_value;
+
         uint8_t uint8_value;
         int8_t int8_value;
 
@@ -596,7 +693,7 @@ protected:
         tracked_map *submap_value;
 
         // Index int,Element keyed map
-        map<int, shared_ptr<TrackerElement> > *subintmap_value;
+        tracked_int_map *subintmap_value;
 
         // Index mac,element keyed map
         map<mac_addr, shared_ptr<TrackerElement> > *submacmap_value;
@@ -609,6 +706,8 @@ protected:
 
         vector<shared_ptr<TrackerElement> > *subvector_value;
 
+        tracked_int64_vector *int64vector_value;
+
         mac_addr *mac_value;
 
         uuid *uuid_value;
@@ -921,24 +1020,24 @@ public:
 
 // Templated access functions
 
-template<typename T> T GetTrackerValue(shared_ptr<TrackerElement>);
-
-template<> string GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> int8_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> uint8_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> int16_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> uint16_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> int32_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> uint32_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> int64_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> uint64_t GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> float GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> double GetTrackerValue(shared_ptr<TrackerElement> e);
-template<> mac_addr GetTrackerValue(shared_ptr<TrackerElement> e);
+template<typename T> T GetTrackerValue(const shared_ptr<TrackerElement>&);
+
+template<> string GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> int8_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> uint8_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> int16_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> uint16_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> int32_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> uint32_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> int64_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> uint64_t GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> float GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> double GetTrackerValue(const shared_ptr<TrackerElement>& e);
+template<> mac_addr GetTrackerValue(const shared_ptr<TrackerElement>& e);
 template<> map<int, shared_ptr<TrackerElement> > 
-    GetTrackerValue(shared_ptr<TrackerElement> e);
+    GetTrackerValue(const shared_ptr<TrackerElement>& e);
 template<> vector<shared_ptr<TrackerElement> > 
-    GetTrackerValue(shared_ptr<TrackerElement> e);
+    GetTrackerValue(const shared_ptr<TrackerElement>& e);
 
 // Complex trackable unit based on trackertype dataunion.
 //
@@ -955,6 +1054,12 @@ template<> vector<shared_ptr<TrackerElement> >
 // Fields are allocated via the reserve_fields function, which must be called before
 // use of the component.  By passing an existing trackermap object, a parsed tree
 // can be annealed into the c++ representation without copying/re-parsing the data.
+//
+// Field registrations are assumed to be the same for every instance of a class;
+// an instance which registers something else still works, it just registers
+// its fields the slow way.
+class tracker_field_layout;
+
 class tracker_component : public TrackerElement {
 
 // Ugly trackercomponent macro for proxying trackerelement values
@@ -974,6 +1079,20 @@ class tracker_component : public TrackerElement {
         cvar->set((ptype) in); \
     }
 
+// Proxy for a TrackerString whose values repeat across many records (manuf,
+// channel, ssid, etc); values are stored in the global string pool so that
+// equal values share one copy
+#define __ProxyInterned(name, cvar) \
+    virtual shared_ptr<TrackerElement> get_tracker_##name() { \
+        return (shared_ptr<TrackerElement>) cvar; \
+    } \
+    virtual string get_##name() const { \
+        return GetTrackerValue<string>(cvar); \
+    } \
+    virtual void set_##name(const string& in) { \
+        cvar->set_interned(in); \
+    }
+
 // Ugly trackercomponent macro for proxying trackerelement values
 // Defines get_<name> function, for a TrackerElement of type <ptype>, returning type 
 // <rtype>, referencing class variable <cvar>
@@ -1092,6 +1211,39 @@ class tracker_component : public TrackerElement {
         return static_pointer_cast<TrackerElement>(cvar); \
     } 
 
+// Proxy a dynamic field (name, tracker type, input type, return type, class 
+// variable, field id), which must have been registered with RegisterDynamicField.
+// The field is only created the first time it is set; until then get_<name>
+// returns the default value of <ptype> and get_tracker_<name> returns NULL.
+#define __ProxyDynamic(name, ptype, itype, rtype, cvar, id) \
+    virtual shared_ptr<TrackerElement> get_tracker_##name() { \
+        return cvar; \
+    } \
+    virtual rtype get_##name() const { \
+        if (cvar == NULL) \
+            return (rtype) ptype(); \
+        return (rtype) GetTrackerValue<ptype>(cvar); \
+    } \
+    virtual void set_##name(itype in) { \
+        materialize_field(cvar, id)->set((ptype) in); \
+    }
+
+// Proxy increment and decrement functions for a dynamic field, creating the 
+// field if needed
+#define __ProxyDynamicIncDec(name, ptype, rtype, cvar, id) \
+    virtual void inc_##name() { \
+        (*materialize_field(cvar, id))++; \
+    } \
+    virtual void inc_##name(rtype i) { \
+        (*materialize_field(cvar, id)) += (ptype) i; \
+    } \
+    virtual void dec_##name() { \
+        (*materialize_field(cvar, id))--; \
+    } \
+    virtual void dec_##name(rtype i) { \
+        (*materialize_field(cvar, id)) -= (ptype) i; \
+    }
+
 // Proxy bitset functions (name, trackable type, data type, class var)
 #define __ProxyBitset(name, dtype, cvar) \
     virtual void bitset_##name(dtype bs) { \
@@ -1105,8 +1257,7 @@ class tracker_component : public TrackerElement {
     }
 
 #define __RegisterComplexField(type, id, name, description) \
-    shared_ptr< type > builder_##id(new type(globalreg, 0)); \
-    id = RegisterComplexField(name, builder_##id, description);
+    id = RegisterComplexField< type >(name, description);
 
 public:
     // Build a basic component.  All basic components are maps.
@@ -1137,28 +1288,79 @@ protected:
     // Reserve a field via the entrytracker, using standard entrytracker build methods.
     // This field will be automatically assigned or created during the reservefields 
     // stage.
-    int RegisterField(string in_name, TrackerType in_type, string in_desc, 
+    //
+    // Field names and descriptions are expected to be string literals.  The
+    // first instance of each class records its fields, in order, in a layout
+    // shared by the class; later instances only step through that layout, so
+    // registering a field is an index lookup with no string handling.
+    int RegisterField(const char *in_name, TrackerType in_type, const char *in_desc, 
             shared_ptr<TrackerElement> *in_dest);
 
+    // Reserve a dynamic field.  Dynamic fields are imported during the 
+    // reservefields stage if they exist in the source element, but are otherwise
+    // left NULL and only created when first set (see __ProxyDynamic and 
+    // __ProxyDynamicTrackable), so fields which are rarely used cost nothing 
+    // until they are.  Absent fields are omitted when serialized.
+    int RegisterDynamicField(const char *in_name, TrackerType in_type, 
+            const char *in_desc, shared_ptr<TrackerElement> *in_dest);
+
     // Reserve a field via the entrytracker, using standard entrytracker build methods,
     // but do not assign or create during the reservefields stage.
     // This can be used for registering sub-components of maps which are not directly
     // instantiated as top-level fields.
-    int RegisterField(string in_name, TrackerType in_type, string in_desc);
+    int RegisterField(const char *in_name, TrackerType in_type, const char *in_desc);
 
     // Reserve a field via the entrytracker, using standard entrytracker build methods.
     // This field will be automatically assigned or created during the reservefields 
     // stage.
     // You will nearly always want to use registercomplex below since fields with 
     // specific builders typically want to inherit from a subtype
-    int RegisterField(string in_name, shared_ptr<TrackerElement> in_builder, 
-            string in_desc, shared_ptr<TrackerElement> *in_dest);
+    int RegisterField(const char *in_name, shared_ptr<TrackerElement> in_builder, 
+            const char *in_desc, shared_ptr<TrackerElement> *in_dest);
 
     // Reserve a complex via the entrytracker, using standard entrytracker build methods.
     // This field will NOT be automatically assigned or built during the reservefields 
     // stage, callers should manually create these fields, importing from the parent
-    int RegisterComplexField(string in_name, shared_ptr<TrackerElement> in_builder, 
-            string in_desc);
+    int RegisterComplexField(const char *in_name, shared_ptr<TrackerElement> in_builder, 
+            const char *in_desc);
+
+    // Reserve a complex field, building a prototype of type T for the entrytracker
+    // only the first time the field is registered.  Prefer this over building a
+    // prototype by hand in register_fields, which would otherwise happen for
+    // every instance.
+    template<class T>
+    int RegisterComplexField(const char *in_name, const char *in_desc) {
+        int id = next_layout_field(in_name);
+
+        if (id >= 0)
+            return id;
+
+        id = FetchCachedFieldId(in_name);
+
+        if (id < 0) {
+            shared_ptr<T> builder(new T(globalreg, 0));
+            return RegisterComplexField(in_name, builder, in_desc);
+        }
+
+        return add_layout_field(in_name, id, TrackerUnassigned, NULL, false);
+    }
+
+    // Look up a previously registered field ID by the address of its name, 
+    // without locking; returns -1 if it isn't cached
+    static int FetchCachedFieldId(const char *in_name);
+
+    // Fetch the ID of the next field in the layout of this class, if the layout
+    // is known and the field is the one expected there; returns -1 when the
+    // field has to be registered (and then recorded with add_layout_field)
+    int next_layout_field(const char *in_name);
+
+    // Record a field registered by this instance, returning the ID
+    int add_layout_field(const char *in_name, int in_id, TrackerType in_type,
+            shared_ptr<TrackerElement> *in_dest, bool in_dynamic);
+
+    // Create a dynamic field if it hasn't been created yet
+    shared_ptr<TrackerElement>& materialize_field(shared_ptr<TrackerElement>& in_field,
+            int in_id);
 
     // Register field types and get a field ID.  Called during record creation, prior to 
     // assigning an existing trackerelement tree or creating a new one
@@ -1170,6 +1372,11 @@ protected:
     //  that we can track usage and delete() appropriately.
     // Populate automatically based on the fields we have reserved, subclasses can 
     // override if they really need to do something special
+    //
+    // Newly created basic-typed fields are allocated from the element slab pool,
+    // each with its reference count in the same block, instead of as two
+    // separate heap objects.  Every field owns its own block, so a field which
+    // outlives its component doesn't keep any of its siblings alive.
     virtual void reserve_fields(shared_ptr<TrackerElement> e);
 
     // Inherit from an existing element or assign a new one.
@@ -1177,21 +1384,15 @@ protected:
     virtual shared_ptr<TrackerElement> 
         import_or_new(shared_ptr<TrackerElement> e, int i);
 
-    class registered_field {
-        public:
-            registered_field(int id, shared_ptr<TrackerElement> *assign) { 
-                this->id = id; 
-                this->assign = assign;
-            }
-
-            int id;
-            shared_ptr<TrackerElement> *assign;
-    };
-
     GlobalRegistry *globalreg;
     EntryTracker *tracker;
 
-    vector<registered_field *> registered_fields;
+    // Fields registered by the current register_fields pass; either the
+    // shared layout of the class, or a private one while the first instance
+    // records it (or if this instance registers different fields)
+    tracker_field_layout *field_layout;
+    bool field_layout_owned;
+    unsigned int field_layout_pos;
 };
 
 class TrackerElementSummary;
@@ -1220,11 +1421,80 @@ public:
     vector<int> resolved_path;
     string rename;
 
+    // Path as requested, for error messages; empty when built from ids
+    string path;
+
 protected:
     void parse_path(vector<string> in_path, string in_rename, 
             shared_ptr<EntryTracker> entrytracker);
 };
 
+// A summarization compiled once per request and applied to every record.
+//
+// Summarizing by copying each record into a simplified map needs a rename
+// record per field per record, and every element serialized then has to be
+// looked up in the rename map; with a plan the serializers write the summary
+// fields straight out of the original record instead.
+class TrackerElementSummaryPlan {
+public:
+    TrackerElementSummaryPlan(const shared_ptr<EntryTracker>& entrytracker,
+            const vector<SharedElementSummary>& in_summarization);
+
+    struct field {
+        vector<int> resolved_path;
+
+        // Name forced by the summary, if any
+        string rename;
+
+        // Name used when a record doesn't have the field
+        string missing_name;
+    };
+
+    // Field of a record resolved against the plan; elem is NULL when the 
+    // record doesn't have the field
+    struct resolved_field {
+        const field *plan_field;
+        SharedTrackerElement elem;
+        int id;
+    };
+
+    size_t size() const { return fields.size(); }
+
+    // Resolve the plan against a record, in the order the fields are
+    // serialized (the order a summarized map would hold them in), calling
+    // pre_serialize on the parents of pathed fields.
+    void resolve(const SharedTrackerElement& in, vector<resolved_field>& ret) const;
+
+protected:
+    vector<field> fields;
+};
+
+// Summarized record, which the serializers expand from the original record and
+// the plan.  It is its own type rather than a map, so a consumer which doesn't
+// know how to expand it fails (or skips it) instead of writing an empty map.
+// It takes the field id of the record, so it stands in for the record in
+// formats which name elements by field.
+class TrackerElementSummaryRef : public TrackerElement {
+public:
+    TrackerElementSummaryRef(const SharedTrackerElement& in_elem, 
+            const shared_ptr<TrackerElementSummaryPlan>& in_plan) :
+        TrackerElement(TrackerSummary),
+        summarized_elem(in_elem),
+        plan(in_plan) {
+        if (in_elem != NULL)
+            set_id(in_elem->get_id());
+    }
+
+    virtual TrackerElementSummaryRef *get_summary_ref() { return this; }
+
+    const SharedTrackerElement& get_summarized_element() { return summarized_elem; }
+    const shared_ptr<TrackerElementSummaryPlan>& get_plan() { return plan; }
+
+protected:
+    SharedTrackerElement summarized_elem;
+    shared_ptr<TrackerElementSummaryPlan> plan;
+};
+
 // Generic serializer class to allow easy swapping of serializers
 class TrackerElementSerializer {
 public:
@@ -1235,9 +1505,36 @@ public:
     typedef map<SharedTrackerElement, SharedElementSummary> rename_map;
 
     virtual ~TrackerElementSerializer() { }
-    virtual void serialize(shared_ptr<TrackerElement> in_elem, 
+    virtual void serialize(const SharedTrackerElement& in_elem, 
             std::stringstream &stream, rename_map *name_map = NULL) = 0;
 
+    // Incremental serialization of a vector, so that large lists can be sent
+    // as they're generated instead of being built whole in memory.  Opening
+    // the vector, serializing each element in turn, and closing it must give
+    // the same output as serialize() on a TrackerVector of those elements; if
+    // in_wrapper_key is set, the vector is wrapped in a single-key map the 
+    // same way the REST endpoints wrap a vector with a local name.
+    //
+    // Serializers which can't do this leave can_stream_vector false.
+    virtual bool can_stream_vector() { return false; }
+    virtual void serialize_vector_open(std::stringstream &stream __attribute__((unused)),
+            size_t in_count __attribute__((unused)),
+            const string& in_wrapper_key __attribute__((unused))) { }
+    virtual void serialize_vector_element(std::stringstream &stream __attribute__((unused)),
+            size_t in_index __attribute__((unused)),
+            const SharedTrackerElement& in_elem __attribute__((unused)),
+            rename_map *name_map __attribute__((unused)) = NULL) { }
+    virtual void serialize_vector_close(std::stringstream &stream __attribute__((unused)),
+            const string& in_wrapper_key __attribute__((unused))) { }
+
+    // Serialize a vector element projected through a summary plan, writing
+    // only the planned fields straight from the record.  This must give the
+    // same output as serialize_vector_element on the record summarized with
+    // SummarizeTrackerElement, which is what the default does.
+    virtual void serialize_vector_summary(std::stringstream &stream, size_t in_index,
+            const SharedTrackerElement& in_elem,
+            const shared_ptr<TrackerElementSummaryPlan>& in_plan);
+
     // Fields extracted from a summary path need to preserialize their parent
     // paths or updates may not happen in the expected fashion, serializers should
     // call this when necessary
@@ -1249,15 +1546,15 @@ protected:
 // Get an element using path semantics
 // Full string path
 shared_ptr<TrackerElement> GetTrackerElementPath(string in_path, 
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker);
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker);
 // Split string path
-shared_ptr<TrackerElement> GetTrackerElementPath(std::vector<string> in_path, 
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker);
+shared_ptr<TrackerElement> GetTrackerElementPath(const std::vector<string>& in_path, 
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker);
 // Resolved field ID path
-shared_ptr<TrackerElement> GetTrackerElementPath(std::vector<int> in_path, 
-        SharedTrackerElement elem);
+shared_ptr<TrackerElement> GetTrackerElementPath(const std::vector<int>& in_path, 
+        const SharedTrackerElement& elem);
 
 // Get a list of elements from a complex path which may include vectors
 // or key maps.  Returns a vector of all elements within that map.
@@ -1266,24 +1563,21 @@ shared_ptr<TrackerElement> GetTrackerElementPath(std::vector<int> in_path,
 // it would return a vector of dot11.advertised.ssid for every SSID in
 // the dot11.device.advertised.ssid.map keyed map
 std::vector<SharedTrackerElement> GetTrackerElementMultiPath(string in_path,
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker);
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker);
 // Split string path
-std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<string> in_path, 
-        SharedTrackerElement elem,
-        shared_ptr<EntryTracker> entrytracker);
+std::vector<SharedTrackerElement> GetTrackerElementMultiPath(const std::vector<string>& in_path, 
+        const SharedTrackerElement& elem,
+        const shared_ptr<EntryTracker>& entrytracker);
 // Resolved field ID path
-std::vector<SharedTrackerElement> GetTrackerElementMultiPath(std::vector<int> in_path, 
-        SharedTrackerElement elem);
-
-// Summarize a complex record using a collection of summary elements.  The summarized
-// element is returned in ret_elem, and the rename mapping for serialization is
-// completed in rename.
-void SummarizeTrackerElement(shared_ptr<EntryTracker> entrytracker,
-        SharedTrackerElement in, 
-        vector<SharedElementSummary> in_summarization, 
-        SharedTrackerElement &ret_elem, 
-        TrackerElementSerializer::rename_map &rename_map);
+std::vector<SharedTrackerElement> GetTrackerElementMultiPath(const std::vector<int>& in_path, 
+        const SharedTrackerElement& elem);
+
+// Summarize a complex record using a compiled plan of summary elements; the
+// returned element is only meaningful to the serializers
+void SummarizeTrackerElement(const SharedTrackerElement& in,
+        const shared_ptr<TrackerElementSummaryPlan>& in_plan,
+        SharedTrackerElement &ret_elem);
 
 
 #endif
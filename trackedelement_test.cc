@@ -0,0 +1,278 @@
+/* test harness for tracked element storage
+ *
+ * Tracked maps and int maps are sorted vectors (kis_flat_map), so erasing
+ * invalidates iterators the way a vector does; this checks the
+ * erase-while-iterating patterns the tracker uses (restart from begin() after
+ * an erase, as the dot11 phy does when it expires SSIDs, or continue from the
+ * iterator erase() returns).
+ *
+ * It also checks that a component field held after its component is gone
+ * only keeps itself alive, and not the other fields of the component, and
+ * that instances of a component which register different fields than the
+ * rest of their class still get the right fields.
+ *
+ * # build kismet
+ * make
+ *
+ * # build test harness
+ * g++ -o trackedelement_test.o -c trackedelement_test.cc
+ * g++ -o trackedelement_test trackedelement_test.o \
+ *      $(filter-out kismet_server.o, $(PSO)) $(LIBS)
+ *
+ * ./trackedelement_test
+ *
+ */
+
+#include "config.hpp"
+
+#include <stdio.h>
+#include <set>
+
+#include "globalregistry.h"
+#include "entrytracker.h"
+#include "trackedelement.h"
+#include "kis_flat_map.h"
+#include "devicetracker_component.h"
+
+static int failures = 0;
+
+#define CHECK(c) \
+    do { \
+        if (!(c)) { \
+            fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); \
+            failures++; \
+        } \
+    } while (0)
+
+// Build an int map of times, keyed 0 to n-1
+static SharedTrackerElement build_times(int n) {
+    SharedTrackerElement m(new TrackerElement(TrackerIntMap));
+
+    for (int i = 0; i < n; i++) {
+        SharedTrackerElement t(new TrackerElement(TrackerUInt64));
+        t->set((uint64_t) (i * 7) % 10);
+        m->add_intmap(i, t);
+    }
+
+    return m;
+}
+
+static std::set<int> expected_survivors(int n, uint64_t cutoff) {
+    std::set<int> r;
+
+    for (int i = 0; i < n; i++) {
+        if ((uint64_t) (i * 7) % 10 >= cutoff)
+            r.insert(i);
+    }
+
+    return r;
+}
+
+static std::set<int> keys(SharedTrackerElement m) {
+    std::set<int> r;
+    TrackerElementIntMap im(m);
+
+    for (TrackerElementIntMap::iterator i = im.begin(); i != im.end(); ++i)
+        r.insert(i->first);
+
+    return r;
+}
+
+static void test_erase_restart() {
+    SharedTrackerElement m = build_times(50);
+    TrackerElementIntMap im(m);
+
+    // Expire by erasing and restarting from the beginning
+    TrackerElementIntMap::iterator i = im.begin();
+    while (i != im.end()) {
+        if (GetTrackerValue<uint64_t>(i->second) < 5) {
+            im.erase(i);
+            i = im.begin();
+            continue;
+        }
+
+        ++i;
+    }
+
+    CHECK(keys(m) == expected_survivors(50, 5));
+    CHECK(im.size() == expected_survivors(50, 5).size());
+}
+
+static void test_erase_returned_iterator() {
+    kis_flat_map<int, int> fm;
+
+    for (int i = 0; i < 100; i++)
+        fm.insert(std::make_pair(i, i));
+
+    // Remove the odd keys, continuing from the iterator erase hands back
+    for (kis_flat_map<int, int>::iterator i = fm.begin(); i != fm.end(); ) {
+        if (i->first % 2)
+            i = fm.erase(i);
+        else
+            ++i;
+    }
+
+    CHECK(fm.size() == 50);
+
+    int expect = 0;
+    for (kis_flat_map<int, int>::iterator i = fm.begin(); i != fm.end(); ++i) {
+        CHECK(i->first == expect);
+        CHECK(i->second == expect);
+        expect += 2;
+    }
+
+    // Erasing everything leaves a usable, empty map
+    for (kis_flat_map<int, int>::iterator i = fm.begin(); i != fm.end(); )
+        i = fm.erase(i);
+
+    CHECK(fm.size() == 0);
+    CHECK(fm.find(0) == fm.end());
+
+    fm.insert(std::make_pair(4, 4));
+    CHECK(fm.find(4) != fm.end());
+}
+
+static void test_multimap_erase() {
+    // Component maps allow duplicate ids, in insertion order
+    SharedTrackerElement m(new TrackerElement(TrackerMap));
+
+    for (int i = 0; i < 30; i++) {
+        SharedTrackerElement e(new TrackerElement(TrackerUInt64, i % 3));
+        e->set((uint64_t) i);
+        m->add_map(e);
+    }
+
+    TrackerElementMap tm(m);
+
+    TrackerElementMap::iterator i = tm.begin();
+    while (i != tm.end()) {
+        if (i->first == 1) {
+            tm.erase(i);
+            i = tm.begin();
+            continue;
+        }
+
+        ++i;
+    }
+
+    CHECK(tm.size() == 20);
+
+    // Survivors are still grouped by id, and in insertion order within an id
+    int last_id = -1;
+    uint64_t last_val = 0;
+    for (i = tm.begin(); i != tm.end(); ++i) {
+        CHECK(i->first != 1);
+        CHECK(i->first >= last_id);
+
+        uint64_t v = GetTrackerValue<uint64_t>(i->second);
+
+        if (i->first == last_id)
+            CHECK(v > last_val);
+
+        last_id = i->first;
+        last_val = v;
+    }
+}
+
+static void test_field_lifetime(GlobalRegistry *globalreg) {
+    int id = globalreg->entrytracker->RegisterField("kismet.test.seenby",
+            shared_ptr<TrackerElement>(new kis_tracked_seenby_data(globalreg, 0)),
+            "test seenby");
+
+    shared_ptr<kis_tracked_seenby_data> sb =
+        AllocTrackedElement<kis_tracked_seenby_data>(globalreg, id);
+
+    sb->set_first_time(10);
+    sb->set_last_time(20);
+
+    SharedTrackerElement held = sb->get_tracker_last_time();
+    std::weak_ptr<TrackerElement> sibling(sb->get_tracker_first_time());
+
+    CHECK(!sibling.expired());
+
+    sb.reset();
+
+    // The field we held survives on its own; its siblings are released
+    CHECK(held.use_count() == 1);
+    CHECK(GetTrackerValue<uint64_t>(held) == 20);
+    CHECK(sibling.expired());
+}
+
+// Registers an extra field only for some instances
+class test_component : public tracker_component {
+public:
+    test_component(GlobalRegistry *in_globalreg, int in_id, bool in_extra) :
+        tracker_component(in_globalreg, in_id) {
+        extra = in_extra;
+        register_fields();
+        reserve_fields(NULL);
+    }
+
+    SharedTrackerElement a;
+    SharedTrackerElement b;
+    SharedTrackerElement c;
+    int b_id;
+
+protected:
+    virtual void register_fields() {
+        RegisterField("kismet.test.component.a", TrackerUInt32, "a", &a);
+
+        if (extra)
+            b_id = RegisterField("kismet.test.component.b", TrackerString, "b", &b);
+
+        RegisterField("kismet.test.component.c", TrackerUInt64, "c", &c);
+    }
+
+    bool extra;
+};
+
+static void test_component_layout(GlobalRegistry *globalreg) {
+    int a_id = globalreg->entrytracker->RegisterField("kismet.test.component.a",
+            TrackerUInt32, "a");
+    int c_id = globalreg->entrytracker->RegisterField("kismet.test.component.c",
+            TrackerUInt64, "c");
+
+    // The first instance records the layout of the class, and the others
+    // either follow it or register their own way
+    bool extra[] = { false, false, true, false, true, true };
+
+    for (unsigned int i = 0; i < sizeof(extra) / sizeof(bool); i++) {
+        test_component t(globalreg, 0, extra[i]);
+
+        CHECK(t.a != NULL && t.a->get_id() == a_id);
+        CHECK(t.a != NULL && t.a->get_type() == TrackerUInt32);
+        CHECK(t.c != NULL && t.c->get_id() == c_id);
+        CHECK(t.c != NULL && t.c->get_type() == TrackerUInt64);
+        CHECK(t.get_map_value(c_id) == t.c);
+
+        if (extra[i]) {
+            CHECK(t.b != NULL && t.b->get_id() == t.b_id);
+            CHECK(t.b != NULL && t.b->get_type() == TrackerString);
+            CHECK(t.size() == 3);
+        } else {
+            CHECK(t.b == NULL);
+            CHECK(t.size() == 2);
+        }
+    }
+}
+
+int main(void) {
+    GlobalRegistry *globalreg = new GlobalRegistry();
+    shared_ptr<EntryTracker> entrytracker =
+        EntryTracker::create_entrytracker(globalreg);
+    globalreg->entrytracker = entrytracker.get();
+
+    test_erase_restart();
+    test_erase_returned_iterator();
+    test_multimap_erase();
+    test_field_lifetime(globalreg);
+    test_component_layout(globalreg);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("ok\n");
+    return 0;
+}
@@ -19,6 +19,7 @@
 #include "config.hpp"
 
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <list>
 #include <map>
@@ -29,6 +30,82 @@
 #include "util.h"
 #include "xmlserialize_adapter.h"
 
+static const string xml_declaration = "<?xml version=\"1.0\"?>";
+
+void XmlStreamWriter::write(const char *in_data, size_t in_len) {
+    if (in_len == 0)
+        return;
+
+    if (file != NULL)
+        fwrite(in_data, in_len, 1, file);
+    else
+        stream->write(in_data, in_len);
+}
+
+void XmlStreamWriter::escape(const string& in_str, bool in_attr) {
+    const char *data = in_str.data();
+    size_t run = 0;
+
+    // Copy runs of plain text in one write, breaking only for entities
+    for (size_t x = 0; x < in_str.length(); x++) {
+        const char *ent;
+
+        switch (data[x]) {
+            case '&':
+                ent = "&amp;";
+                break;
+            case '<':
+                ent = "&lt;";
+                break;
+            case '>':
+                ent = "&gt;";
+                break;
+            case '"':
+                ent = in_attr ? "&quot;" : NULL;
+                break;
+            default:
+                ent = NULL;
+                break;
+        }
+
+        if (ent == NULL)
+            continue;
+
+        write(data + run, x - run);
+        write(ent, strlen(ent));
+        run = x + 1;
+    }
+
+    write(data + run, in_str.length() - run);
+}
+
+void XmlStreamWriter::text(const string& in_str) {
+    escape(in_str, false);
+}
+
+void XmlStreamWriter::attr(const string& in_str) {
+    escape(in_str, true);
+}
+
+void XmlStreamWriter::value(int64_t in_v) {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%lld", (long long) in_v);
+    write(buf, len);
+}
+
+void XmlStreamWriter::value(uint64_t in_v) {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%llu", (unsigned long long) in_v);
+    write(buf, len);
+}
+
+void XmlStreamWriter::value(double in_v) {
+    // Same as the default stream formatting
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%g", in_v);
+    write(buf, len);
+}
+
 XmlserializeAdapter::~XmlserializeAdapter() {
     map<string, Xmladapter *>::iterator i;
 
@@ -37,12 +114,105 @@ XmlserializeAdapter::~XmlserializeAdapter() {
     }
 }
 
-void XmlserializeAdapter::XmlSerialize(SharedTrackerElement v, 
+void XmlserializeAdapter::Xmladapter::BuildTags() {
+    string nstag;
+
+    if (local_namespace != "") {
+        nstag = local_namespace + string(":") + xml_entity;
+    } else {
+        nstag = xml_entity;
+    }
+
+    open_tag = "<" + nstag;
+
+    if (xml_xsi_type != "")
+        open_tag += " xsi:type=\"" + xml_xsi_type + "\"";
+
+    if (namespace_location != "") {
+        open_tag += " xmlns:" + local_namespace + "=\"" + namespace_location + "\"";
+        // Automatically include the xsi definitions
+        open_tag += " xmlns:xs=\"http://www.w3.org/2001/XMLSchema\" "
+            "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"";
+
+        open_tag += " xsi:schemaLocation=\"" + xsi_schema_location + "\"";
+    }
+
+    open_tag += ">";
+
+    // Pack a schema tag if we need one
+    if (schema_import_vector.size() != 0) {
+        open_tag += "<xs:schema xmlns:xs=\"http://www.w3.org/2001/XMLSchema\""
+            " xmlns=\"http://xmlns.myexample.com/version3\"";
+
+        for (unsigned int s = 0; s < schema_import_vector.size(); s++) {
+            Schemaimportlocation *sl = schema_import_vector[s];
+            open_tag += " xmlns:" + sl->ns + "=\"" + sl->nslocation + "\"";
+        }
+
+        open_tag += " targetNamespace=\"" + namespace_location + "\""
+            " elementFormDefault=\"unqualified\""
+            " attributeFromDefault=\"unqualified\">";
+
+        for (unsigned int s = 0; s < schema_import_vector.size(); s++) {
+            Schemaimportlocation *sl = schema_import_vector[s];
+
+            open_tag += "<xs:import namespace=\"" + sl->nslocation + "\"" +
+                " schemaLocation=\"" + sl->url + "\" />";
+        }
+
+        open_tag += "</xs:schema>";
+    }
+
+    close_tag = "</" + nstag + ">";
+
+    entry_open = "<" + map_entry_element + " " + map_key_attribute + "=\"";
+    entry_value = "\" " + map_value_attribute + "=\"";
+    entry_close = "\" />";
+}
+
+bool XmlserializeAdapter::XmlOpen(int in_field_id, XmlStreamWriter &writer) {
+    std::unordered_map<int, Xmladapter *>::iterator mi = field_id_map.find(in_field_id);
+
+    if (mi == field_id_map.end())
+        return false;
+
+    writer.write(mi->second->open_tag);
+
+    return true;
+}
+
+bool XmlserializeAdapter::XmlClose(int in_field_id, XmlStreamWriter &writer) {
+    std::unordered_map<int, Xmladapter *>::iterator mi = field_id_map.find(in_field_id);
+
+    if (mi == field_id_map.end())
+        return false;
+
+    writer.write(mi->second->close_tag);
+
+    return true;
+}
+
+void XmlserializeAdapter::XmlSerialize(const SharedTrackerElement& v, 
         std::stringstream &stream) {
+    XmlStreamWriter writer(stream);
+
+    XmlSerialize(v, writer);
+}
+
+void XmlserializeAdapter::XmlSerialize(const SharedTrackerElement& v,
+        XmlStreamWriter &writer) {
 
     if (v == NULL)
         return;
 
+    // Only registered fields are part of the document
+    std::unordered_map<int, Xmladapter *>::iterator mi = field_id_map.find(v->get_id());
+
+    if (mi == field_id_map.end())
+        return;
+
+    Xmladapter *adapter = mi->second;
+
     v->pre_serialize();
 
     TrackerElement::tracked_map *tmap;
@@ -62,68 +232,12 @@ void XmlserializeAdapter::XmlSerialize(SharedTrackerElement v,
 
     TrackerElement::tracked_vector *tvec;
 
-    unsigned int tvi;
-
-    string name = globalreg->entrytracker->GetFieldName(v->get_id());
+    TrackerElementSummaryRef *summary_ref;
+    vector<TrackerElementSummaryPlan::resolved_field> summary_fields;
 
-    map<string, Xmladapter *>::iterator mi = 
-        field_adapter_map.find(StrLower(name));
-
-    if (mi == field_adapter_map.end()) {
-        fprintf(stderr, "debug - xmlserialize no xml field for %s\n", name.c_str());
-        return;
-    }
-
-    Xmladapter *adapter = mi->second;
-
-    string xsi;
-    string nstag;
-
-    if (adapter->local_namespace != "") {
-        nstag = adapter->local_namespace + string(":") + adapter->xml_entity;
-    } else {
-        nstag = adapter->xml_entity;
-    }
-
-    if (adapter->xml_xsi_type != "")
-        xsi += " xsi:type=\"" + adapter->xml_xsi_type + "\"";
-
-    stream << "<" << nstag << xsi;
-
-    if (adapter->namespace_location != "") {
-        stream << " xmlns:" << adapter->local_namespace << "=\"" 
-            << adapter->namespace_location << "\"";
-        // Automatically include the xsi definitions
-        stream << " xmlns:xs=\"http://www.w3.org/2001/XMLSchema\" "
-            << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"";
-
-        stream << " xsi:schemaLocation=\"" << adapter->xsi_schema_location << "\"";
-    }
-    
-    stream << ">";
-
-    // Pack a schema tag if we need one
-    if (adapter->schema_import_vector.size() != 0) {
-        stream << "<xs:schema xmlns:xs=\"http://www.w3.org/2001/XMLSchema\""
-            << " xmlns=\"http://xmlns.myexample.com/version3\"";
-
-        for (unsigned int s = 0; s < adapter->schema_import_vector.size(); s++) {
-            Schemaimportlocation *sl = adapter->schema_import_vector[s];
-            stream << " xmlns:" 
-                << sl->ns << "=\"" << sl->nslocation << "\"";
-        }
+    unsigned int tvi;
 
-        stream << " targetNamespace=\"" << adapter->namespace_location << "\""
-            << " elementFormDefault=\"unqualified\""
-            << " attributeFromDefault=\"unqualified\">";
-        for (unsigned int s = 0; s < adapter->schema_import_vector.size(); s++) {
-            Schemaimportlocation *sl = adapter->schema_import_vector[s];
-
-            stream << "<xs:import namespace=\"" << sl->nslocation << "\"" <<
-                " schemaLocation=\"" << sl->url << "\" />";
-        }
-        stream << "</xs:schema>";
-    }
+    writer.write(adapter->open_tag);
 
     switch (v->get_type()) {
         case TrackerString:
@@ -139,19 +253,19 @@ void XmlserializeAdapter::XmlSerialize(SharedTrackerElement v,
         case TrackerDouble:
         case TrackerMac:
         case TrackerUuid:
-            StreamSimpleValue(v, stream);
+            StreamSimpleValue(v, writer, false);
             break;
         case TrackerVector:
             tvec = v->get_vector();
             for (tvi = 0; tvi < tvec->size(); tvi++) {
-                XmlSerialize((*tvec)[tvi], stream);
+                XmlSerialize((*tvec)[tvi], writer);
             }
             break;
         case TrackerMap:
             tmap = v->get_map();
             for (map_iter = tmap->begin(); map_iter != tmap->end(); 
                     ++map_iter) {
-                XmlSerialize(map_iter->second, stream);
+                XmlSerialize(map_iter->second, writer);
             }
             break;
         case TrackerIntMap:
@@ -162,12 +276,11 @@ void XmlserializeAdapter::XmlSerialize(SharedTrackerElement v,
                 // TODO be smarter
                 for (int_map_iter = tintmap->begin(); int_map_iter != tintmap->end(); 
                         ++int_map_iter) {
-                    stream << "<" << adapter->map_entry_element <<
-                        " " << adapter->map_key_attribute << "=\"" <<
-                        int_map_iter->first << "\" " <<
-                        adapter->map_value_attribute << "=\"";
-                    StreamSimpleValue(int_map_iter->second, stream);
-                    stream << "\" />";
+                    writer.write(adapter->entry_open);
+                    writer.value((int64_t) int_map_iter->first);
+                    writer.write(adapter->entry_value);
+                    StreamSimpleValue(int_map_iter->second, writer, true);
+                    writer.write(adapter->entry_close);
                 }
             }
             break;
@@ -178,12 +291,11 @@ void XmlserializeAdapter::XmlSerialize(SharedTrackerElement v,
                 // TODO be smarter
                 for (mac_map_iter = tmacmap->begin(); mac_map_iter != tmacmap->end(); 
                         ++mac_map_iter) {
-                    stream << "<" << adapter->map_entry_element <<
-                        " " << adapter->map_key_attribute << "=\"" <<
-                        mac_map_iter->first.MacFull2String() << "\" " <<
-                        adapter->map_value_attribute << "=\"";
-                    StreamSimpleValue(mac_map_iter->second, stream);
-                    stream << "\" />";
+                    writer.write(adapter->entry_open);
+                    writer.write(mac_map_iter->first.MacFull2String());
+                    writer.write(adapter->entry_value);
+                    StreamSimpleValue(mac_map_iter->second, writer, true);
+                    writer.write(adapter->entry_close);
                 }
             }
             break;
@@ -195,12 +307,11 @@ void XmlserializeAdapter::XmlSerialize(SharedTrackerElement v,
                 for (string_map_iter = tstringmap->begin(); 
                         string_map_iter != tstringmap->end(); 
                         ++string_map_iter) {
-                    stream << "<" << adapter->map_entry_element <<
-                        " " << adapter->map_key_attribute << "=\"" <<
-                        string_map_iter->first << "\" " <<
-                        adapter->map_value_attribute << "=\"";
-                    StreamSimpleValue(string_map_iter->second, stream);
-                    stream << "\" />";
+                    writer.write(adapter->entry_open);
+                    writer.attr(string_map_iter->first);
+                    writer.write(adapter->entry_value);
+                    StreamSimpleValue(string_map_iter->second, writer, true);
+                    writer.write(adapter->entry_close);
                 }
             }
             break;
@@ -212,65 +323,78 @@ void XmlserializeAdapter::XmlSerialize(SharedTrackerElement v,
                 for (double_map_iter = tdoublemap->begin(); 
                         double_map_iter != tdoublemap->end(); 
                         ++double_map_iter) {
-                    stream << "<" << adapter->map_entry_element <<
-                        " " << adapter->map_key_attribute << "=\"" <<
-                        double_map_iter->first << "\" " <<
-                        adapter->map_value_attribute << "=\"";
-                    StreamSimpleValue(double_map_iter->second, stream);
-                    stream << "\" />";
+                    writer.write(adapter->entry_open);
+                    writer.value(double_map_iter->first);
+                    writer.write(adapter->entry_value);
+                    StreamSimpleValue(double_map_iter->second, writer, true);
+                    writer.write(adapter->entry_close);
                 }
             }
             break;
 
+        case TrackerSummary:
+            // XML names elements by field and ignores renames, so a summarized
+            // record is just the planned fields the record has
+            summary_ref = v->get_summary_ref();
+            summary_ref->get_plan()->resolve(summary_ref->get_summarized_element(),
+                    summary_fields);
+            for (tvi = 0; tvi < summary_fields.size(); tvi++) {
+                XmlSerialize(summary_fields[tvi].elem, writer);
+            }
+            break;
+
         default:
             break;
     }
 
-    stream << "</" << nstag << ">";
+    writer.write(adapter->close_tag);
 
 }
 
-bool XmlserializeAdapter::StreamSimpleValue(SharedTrackerElement v,
-        std::stringstream &stream) {
+bool XmlserializeAdapter::StreamSimpleValue(const SharedTrackerElement& v,
+        XmlStreamWriter &writer, bool in_attr) {
     switch (v->get_type()) {
         case TrackerString:
-            stream << SanitizeXML(GetTrackerValue<string>(v));
+            if (in_attr)
+                writer.attr(v->get_string_ref());
+            else
+                writer.text(v->get_string_ref());
             break;
         case TrackerInt8:
-            stream << GetTrackerValue<int8_t>(v);
+            writer.value((int64_t) GetTrackerValue<int8_t>(v));
             break;
         case TrackerUInt8:
-            stream << GetTrackerValue<uint8_t>(v);
+            writer.value((uint64_t) GetTrackerValue<uint8_t>(v));
             break;
         case TrackerInt16:
-            stream << GetTrackerValue<int16_t>(v);
+            writer.value((int64_t) GetTrackerValue<int16_t>(v));
             break;
         case TrackerUInt16:
-            stream << GetTrackerValue<uint16_t>(v);
+            writer.value((uint64_t) GetTrackerValue<uint16_t>(v));
             break;
         case TrackerInt32:
-            stream << GetTrackerValue<int32_t>(v);
+            writer.value((int64_t) GetTrackerValue<int32_t>(v));
             break;
         case TrackerUInt32:
-            stream << GetTrackerValue<uint32_t>(v);
+            writer.value((uint64_t) GetTrackerValue<uint32_t>(v));
             break;
         case TrackerInt64:
-            stream << GetTrackerValue<int64_t>(v);
+            writer.value(GetTrackerValue<int64_t>(v));
             break;
         case TrackerUInt64:
-            stream << GetTrackerValue<uint64_t>(v);
+            writer.value(GetTrackerValue<uint64_t>(v));
             break;
         case TrackerFloat:
-            stream << GetTrackerValue<float>(v);
+            writer.value((double) GetTrackerValue<float>(v));
             break;
         case TrackerDouble:
-            stream << GetTrackerValue<double>(v);
+            writer.value(GetTrackerValue<double>(v));
             break;
         case TrackerMac:
-            stream << GetTrackerValue<mac_addr>(v).MacFull2String();
+            writer.write(GetTrackerValue<mac_addr>(v).MacFull2String());
             break;
         case TrackerUuid:
-            stream << GetTrackerValue<uuid>(v).UUID2String();
+            writer.write(GetTrackerValue<uuid>(v).UUID2String());
             break;
         default:
             return false;
@@ -279,62 +403,62 @@ bool XmlserializeAdapter::StreamSimpleValue(SharedTrackerElement v,
     return true;
 }
 
-void XmlserializeAdapter::RegisterField(string in_field, string in_entity) {
-    Xmladapter *adapter;
-
+XmlserializeAdapter::Xmladapter *XmlserializeAdapter::FetchAdapter(
+        const string& in_field, bool in_create) {
     map<string, Xmladapter *>::iterator mi = 
         field_adapter_map.find(StrLower(in_field));
-    if (mi == field_adapter_map.end()) {
-        adapter = new Xmladapter();
-        field_adapter_map[StrLower(in_field)] = adapter;
-    }  else {
-        adapter = mi->second;
-    }
+
+    if (mi != field_adapter_map.end())
+        return mi->second;
+
+    if (!in_create)
+        return NULL;
+
+    Xmladapter *adapter = new Xmladapter();
+    field_adapter_map[StrLower(in_field)] = adapter;
+
+    int id = globalreg->entrytracker->GetFieldId(in_field);
+
+    if (id >= 0)
+        field_id_map[id] = adapter;
+
+    return adapter;
+}
+
+void XmlserializeAdapter::RegisterField(string in_field, string in_entity) {
+    Xmladapter *adapter = FetchAdapter(in_field, true);
 
     adapter->kis_field = in_field;
     adapter->xml_entity = in_entity;
+
+    adapter->BuildTags();
 }
 
 void XmlserializeAdapter::RegisterFieldAttr(string in_field, string in_path,
         string in_attr) {
-    Xmladapter *adapter;
-    map<string, Xmladapter *>::iterator mi =
-        field_adapter_map.find(StrLower(in_field));
+    Xmladapter *adapter = FetchAdapter(in_field, false);
 
-    if (mi == field_adapter_map.end())
+    if (adapter == NULL)
         return;
 
-    adapter = mi->second;
-
     adapter->kis_path_xml_element_map[StrLower(in_path)] = in_attr;
 }
 
 void XmlserializeAdapter::RegisterFieldXsitype(string in_field, string in_xsi) {
-    Xmladapter *adapter;
-    map<string, Xmladapter *>::iterator mi =
-        field_adapter_map.find(StrLower(in_field));
+    Xmladapter *adapter = FetchAdapter(in_field, false);
 
-    if (mi == field_adapter_map.end())
+    if (adapter == NULL)
         return;
 
-    adapter = mi->second;
-
     adapter->xml_xsi_type = in_xsi;
+
+    adapter->BuildTags();
 }
 
 void XmlserializeAdapter::RegisterMapField(string in_field, string in_entity, 
         string in_map_entity, string in_map_key_attr, string in_map_value_attr) {
 
-    Xmladapter *adapter;
-    map<string, Xmladapter *>::iterator mi =
-        field_adapter_map.find(StrLower(in_field));
-
-    if (mi != field_adapter_map.end()) {
-        adapter = mi->second;
-    } else {
-        adapter = new Xmladapter();
-        field_adapter_map[StrLower(in_field)] = adapter;
-    }
+    Xmladapter *adapter = FetchAdapter(in_field, true);
 
     adapter->kis_field = in_field;
     adapter->xml_entity = in_entity;
@@ -342,20 +466,18 @@ void XmlserializeAdapter::RegisterMapField(string in_field, string in_entity,
     adapter->map_entry_element = in_map_entity;
     adapter->map_key_attribute = in_map_key_attr;
     adapter->map_value_attribute = in_map_value_attr;
+
+    adapter->BuildTags();
 }
 
 void XmlserializeAdapter::RegisterFieldSchema(string in_field, string in_ns,
         string in_nslocation, string in_url) {
 
-    Xmladapter *adapter;
-    map<string, Xmladapter *>::iterator mi =
-        field_adapter_map.find(StrLower(in_field));
+    Xmladapter *adapter = FetchAdapter(in_field, false);
 
-    if (mi == field_adapter_map.end())
+    if (adapter == NULL)
         return;
 
-    adapter = mi->second;
-
     Schemaimportlocation *schema = new Schemaimportlocation();
 
     schema->ns = in_ns;
@@ -363,24 +485,56 @@ void XmlserializeAdapter::RegisterFieldSchema(string in_field, string in_ns,
     schema->url = in_url;
 
     adapter->schema_import_vector.push_back(schema);
+
+    adapter->BuildTags();
 }
 
 void XmlserializeAdapter::RegisterFieldNamespace(string in_field, string in_ns,
         string in_nsloc, string in_url) {
 
-    Xmladapter *adapter;
-    map<string, Xmladapter *>::iterator mi =
-        field_adapter_map.find(StrLower(in_field));
+    Xmladapter *adapter = FetchAdapter(in_field, false);
 
-    if (mi == field_adapter_map.end())
+    if (adapter == NULL)
         return;
 
-    adapter = mi->second;
-
     adapter->local_namespace = in_ns;
     adapter->namespace_location = in_nsloc;
     adapter->xsi_schema_location = in_url;
+
+    adapter->BuildTags();
+}
+
+void XmlserializeAdapterSerializer::serialize(const SharedTrackerElement& in_elem,
+        std::stringstream &stream, rename_map *name_map __attribute__((unused))) {
+    XmlStreamWriter writer(stream);
+
+    writer.write(xml_declaration);
+
+    adapter->XmlSerialize(in_elem, writer);
 }
 
+void XmlserializeAdapterSerializer::serialize_vector_open(std::stringstream &stream,
+        size_t in_count __attribute__((unused)),
+        const string& in_wrapper_key __attribute__((unused))) {
+    XmlStreamWriter writer(stream);
 
+    writer.write(xml_declaration);
+
+    adapter->XmlOpen(root_id, writer);
+}
+
+void XmlserializeAdapterSerializer::serialize_vector_element(std::stringstream &stream,
+        size_t in_index __attribute__((unused)), const SharedTrackerElement& in_elem,
+        rename_map *name_map __attribute__((unused))) {
+    XmlStreamWriter writer(stream);
+
+    adapter->XmlSerialize(in_elem, writer);
+}
+
+void XmlserializeAdapterSerializer::serialize_vector_close(std::stringstream &stream,
+        const string& in_wrapper_key __attribute__((unused))) {
+    XmlStreamWriter writer(stream);
+
+    adapter->XmlClose(root_id, writer);
+}
 
@@ -29,6 +29,8 @@
 #include <algorithm>
 #include <string>
 #include <sstream>
+#include <ostream>
+#include <unordered_map>
 
 #include "globalregistry.h"
 #include "trackedelement.h"
@@ -54,8 +56,50 @@
  *  <frequency freq="1234" packets="5678"/>
  * </frequencies>
  *
+ * Fields are resolved to their ids when they're registered, and the tags for
+ * each field are built once then, so fields must already be known to the
+ * entrytracker.  Serializing is a walk of the record which writes the
+ * precomputed tags and the values straight to an XmlStreamWriter.
+ *
  */
 
+// Event-style XML output.  Markup and values are written through to a FILE
+// or a stream as they're produced, so a large document is never built in
+// memory; text is escaped as it's copied out.
+class XmlStreamWriter {
+public:
+    XmlStreamWriter(FILE *in_file) {
+        file = in_file;
+        stream = NULL;
+    }
+
+    XmlStreamWriter(std::ostream &in_stream) {
+        file = NULL;
+        stream = &in_stream;
+    }
+
+    // Raw markup, such as a precomputed tag
+    void write(const char *in_data, size_t in_len);
+    void write(const string& in_str) {
+        write(in_str.data(), in_str.length());
+    }
+
+    // Character data, escaped the same way as SanitizeXML
+    void text(const string& in_str);
+    // Attribute value, which also escapes quotes
+    void attr(const string& in_str);
+
+    void value(int64_t in_v);
+    void value(uint64_t in_v);
+    void value(double in_v);
+
+protected:
+    FILE *file;
+    std::ostream *stream;
+
+    void escape(const string& in_str, bool in_attr);
+};
+
 class XmlserializeAdapter {
 public:
     XmlserializeAdapter(GlobalRegistry *in_globalreg) {
@@ -64,7 +108,13 @@ public:
 
     ~XmlserializeAdapter();
 
-    void XmlSerialize(SharedTrackerElement v, std::stringstream &steam);
+    void XmlSerialize(const SharedTrackerElement& v, std::stringstream &stream);
+    void XmlSerialize(const SharedTrackerElement& v, XmlStreamWriter &writer);
+
+    // Write only the opening or closing tag of a registered field, so that a
+    // large container can be written one child at a time
+    bool XmlOpen(int in_field_id, XmlStreamWriter &writer);
+    bool XmlClose(int in_field_id, XmlStreamWriter &writer);
 
     void RegisterField(string in_field, string in_entity);
     void RegisterFieldAttr(string in_field, string in_path, string in_attr);
@@ -100,6 +150,9 @@ protected:
             }
         }
 
+        // Rebuild the tags after any change to the adapter
+        void BuildTags();
+
         // Map a kismet record to a XML tag
         string kis_field;
         string xml_entity;
@@ -125,12 +178,52 @@ protected:
        
         // List of items to be included in the xs:schema tag
         vector<Schemaimportlocation *> schema_import_vector;
+
+        // Complete opening tag (with any namespace and schema) and closing
+        // tag, and the pieces of a map entry around its key and value
+        string open_tag;
+        string close_tag;
+        string entry_open;
+        string entry_value;
+        string entry_close;
     };
 
-    bool StreamSimpleValue(SharedTrackerElement v, std::stringstream &stream);
+    Xmladapter *FetchAdapter(const string& in_field, bool in_create);
+
+    bool StreamSimpleValue(const SharedTrackerElement& v, XmlStreamWriter &writer,
+            bool in_attr);
 
     map<string, Xmladapter *> field_adapter_map;
+    std::unordered_map<int, Xmladapter *> field_id_map;
 };
 
-#endif
+// Serializer for documents described by an XmlserializeAdapter, with the
+// root element given by field id.  Vectors of the root field can be streamed
+// one element at a time.
+class XmlserializeAdapterSerializer : public TrackerElementSerializer {
+public:
+    XmlserializeAdapterSerializer(GlobalRegistry *in_globalreg,
+            shared_ptr<XmlserializeAdapter> in_adapter, int in_root_id) :
+        TrackerElementSerializer(in_globalreg) {
+        adapter = in_adapter;
+        root_id = in_root_id;
+    }
 
+    virtual void serialize(const SharedTrackerElement& in_elem, std::stringstream &stream,
+            rename_map *name_map = NULL);
+
+    virtual bool can_stream_vector() { return true; }
+
+    virtual void serialize_vector_open(std::stringstream &stream, size_t in_count,
+            const string& in_wrapper_key);
+    virtual void serialize_vector_element(std::stringstream &stream, size_t in_index,
+            const SharedTrackerElement& in_elem, rename_map *name_map = NULL);
+    virtual void serialize_vector_close(std::stringstream &stream,
+            const string& in_wrapper_key);
+
+protected:
+    shared_ptr<XmlserializeAdapter> adapter;
+    int root_id;
+};
+
+#endif
@@ -0,0 +1,171 @@
+/* test harness for summarized records through the XML serializer
+ *
+ * Sends a device list through the XML serializer the way the all_devices.xml
+ * endpoint streams it, once summarized and once as maps holding the same
+ * fields; the two documents must match, and must hold the field values rather
+ * than empty records.
+ *
+ * # build kismet
+ * make
+ *
+ * # build test harness
+ * g++ -o xmlserialize_adapter_test.o -c xmlserialize_adapter_test.cc
+ * g++ -o xmlserialize_adapter_test xmlserialize_adapter_test.o \
+ *      $(filter-out kismet_server.o, $(PSO)) $(LIBS)
+ *
+ * ./xmlserialize_adapter_test
+ *
+ */
+
+#include "config.hpp"
+
+#include <stdio.h>
+#include <sstream>
+
+#include "globalregistry.h"
+#include "entrytracker.h"
+#include "trackedelement.h"
+#include "devicetracker_component.h"
+#include "devicetracker.h"
+#include "xmlserialize_adapter.h"
+#include "kis_net_microhttpd.h"
+
+static int failures = 0;
+
+#define CHECK(c) \
+    do { \
+        if (!(c)) { \
+            fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); \
+            failures++; \
+        } \
+    } while (0)
+
+static string stream_xml(shared_ptr<TrackerElementSerializer> ser,
+        vector<SharedTrackerElement> in_vec,
+        shared_ptr<TrackerElementSummaryPlan> in_plan) {
+    std::stringstream stream;
+
+    Kis_Net_Httpd_Vector_Stream_Generator gen(ser, in_vec, NULL, "", NULL, in_plan);
+
+    while (gen.Generate(stream))
+        ;
+
+    return stream.str();
+}
+
+int main(void) {
+    GlobalRegistry *globalreg = new GlobalRegistry();
+    shared_ptr<EntryTracker> entrytracker =
+        EntryTracker::create_entrytracker(globalreg);
+    globalreg->entrytracker = entrytracker.get();
+
+    int list_id = entrytracker->RegisterField("kismet.device.list",
+            TrackerVector, "list of devices");
+    int device_id = entrytracker->RegisterField("kismet.device.base",
+            shared_ptr<TrackerElement>(new kis_tracked_device_base(globalreg, 0)),
+            "device");
+
+    // The same document layout as the device list endpoint, trimmed
+    shared_ptr<XmlserializeAdapter> xml(new XmlserializeAdapter(globalreg));
+    xml->RegisterField("kismet.device.list", "SummaryDevices");
+    xml->RegisterField("kismet.device.base", "summary");
+    xml->RegisterField("kismet.device.base.name", "name");
+    xml->RegisterField("kismet.device.base.key", "key");
+    xml->RegisterField("kismet.device.base.macaddr", "macaddress");
+    xml->RegisterField("kismet.device.base.last_time", "lastseen");
+
+    shared_ptr<TrackerElementSerializer> ser(
+            new XmlserializeAdapterSerializer(globalreg, xml, list_id));
+
+    vector<SharedTrackerElement> devs;
+
+    for (int i = 0; i < 5; i++) {
+        shared_ptr<kis_tracked_device_base> d =
+            AllocTrackedElement<kis_tracked_device_base>(globalreg, device_id);
+
+        d->set_key(1000 + i);
+        d->set_macaddr(mac_addr((uint64_t) 0x001122334400ULL + i));
+        d->set_last_time(1500000000 + i);
+        d->set_devicename("device " + IntToString(i));
+        d->set_channel("6");
+
+        devs.push_back(d);
+    }
+
+    // Fields in and out of the document, renamed, and missing from the record
+    vector<SharedElementSummary> summary;
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "kismet.device.base.name", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "kismet.device.base.last_time", "seen", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "kismet.device.base.macaddr", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "kismet.device.base.channel", entrytracker)));
+    summary.push_back(SharedElementSummary(new TrackerElementSummary(
+                    "kismet.device.base.no_such_field", entrytracker)));
+
+    shared_ptr<TrackerElementSummaryPlan> plan(
+            new TrackerElementSummaryPlan(entrytracker, summary));
+
+    // What the summarized records should come out as
+    vector<SharedTrackerElement> expanded;
+
+    for (unsigned int i = 0; i < devs.size(); i++) {
+        vector<TrackerElementSummaryPlan::resolved_field> resolved;
+        plan->resolve(devs[i], resolved);
+
+        SharedTrackerElement m(new TrackerElement(TrackerMap, device_id));
+
+        for (unsigned int r = 0; r < resolved.size(); r++) {
+            if (resolved[r].elem != NULL)
+                m->add_map(resolved[r].elem);
+        }
+
+        expanded.push_back(m);
+    }
+
+    string summarized = stream_xml(ser, devs, plan);
+    string expected = stream_xml(ser, expanded, NULL);
+
+    CHECK(summarized == expected);
+    CHECK(summarized.find("<name>device 3</name>") != string::npos);
+    CHECK(summarized.find("<lastseen>1500000004</lastseen>") != string::npos);
+    CHECK(summarized.find("<key>") == string::npos);
+    CHECK(summarized.find("<summary></summary>") == string::npos);
+
+    // Summarized records serialized whole, rather than streamed
+    SharedTrackerElement vec(new TrackerElement(TrackerVector, list_id));
+
+    for (unsigned int i = 0; i < devs.size(); i++) {
+        SharedTrackerElement simple;
+        SummarizeTrackerElement(devs[i], plan, simple);
+
+        CHECK(simple->get_type() == TrackerSummary);
+        CHECK(simple->get_id() == device_id);
+
+        vec->add_vector(simple);
+    }
+
+    SharedTrackerElement expanded_vec(new TrackerElement(TrackerVector, list_id));
+
+    for (unsigned int i = 0; i < expanded.size(); i++)
+        expanded_vec->add_vector(expanded[i]);
+
+    std::stringstream whole, whole_expected;
+    ser->serialize(vec, whole);
+    ser->serialize(expanded_vec, whole_expected);
+
+    CHECK(whole.str() == whole_expected.str());
+    CHECK(whole.str().find("<name>device 0</name>") != string::npos);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        fprintf(stderr, "summarized: %s\nexpected: %s\n", summarized.c_str(),
+                expected.c_str());
+        return 1;
+    }
+
+    printf("ok\n");
+    return 0;
+}